@@ -1,14 +1,60 @@
 #include <algorithm> 
 #include <cmath>
 #include <cassert>
+#include <cstring>
 
 #include "DelayLine.h"
+#include "KernelDispatch.h"
+#include "Trace.h"
 
 namespace primitives
 {
 
-DelayLine::DelayLine(uint32_t maxDelaySamples, uint32_t initDelaySamples) :
-    delayValue { static_cast<float>(initDelaySamples) }
+namespace
+{
+
+// Scalar conversions of the delay storage, rounding as the packing kernels do
+
+uint16_t toBFloat16(float x)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    bits += 0x7FFFu + ((bits >> 16) & 1u);
+    return static_cast<uint16_t>(bits >> 16);
+}
+
+float fromBFloat16(uint16_t x)
+{
+    const uint32_t bits { static_cast<uint32_t>(x) << 16 };
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+// Saturated, then rounded to nearest even: adding and subtracting 1.5 * 2^mantissa leaves no fraction bits
+template <typename SampleType>
+uint16_t toFixed16(SampleType x)
+{
+    constexpr SampleType magic { sizeof(SampleType) == sizeof(float) ? SampleType { 12582912.0f } : SampleType { 6755399441055744.0 } };
+    x = x > SampleType { -32768 } ? x : SampleType { -32768 };
+    x = x < SampleType { 32767 } ? x : SampleType { 32767 };
+    return static_cast<uint16_t>(static_cast<int16_t>((x + magic) - magic));
+}
+
+}
+
+//================================================
+
+template <typename SampleType>
+DelayLine<SampleType>::DelayLine(uint32_t maxDelaySamples, uint32_t initDelaySamples, DelayStorage initStorage /*= DelayStorage::float32*/, float initHeadroom /*= defaultHeadroom*/) :
+    delayValue { static_cast<float>(initDelaySamples) },
+    storage { initStorage },
+    headroom { initHeadroom },
+    fixedStep { static_cast<SampleType>(initHeadroom) / SampleType { 32768 } },
+    fixedInverseStep { SampleType { 32768 } / static_cast<SampleType>(initHeadroom) },
+    fadeOutDelay { static_cast<float>(initDelaySamples) },
+    crossfadeSamples { 1024u },
+    crossfadeRemaining { 0u }
 {
     // Check if the maximum delay samples is valid
     assert(maxDelaySamples > 0 && "Maximum delay of the delay line must be greater than zero");
@@ -16,7 +62,11 @@ DelayLine::DelayLine(uint32_t maxDelaySamples, uint32_t initDelaySamples) :
     delayBufferSize = static_cast<size_t>(maxDelaySamples) + size_t { 1u };
 
     // Initialize the delay buffer with maximum delay size and fill it with zeros
-    delayBuffer.resize(delayBufferSize, 0.f);
+    assert(initHeadroom > 0.0f && "Headroom of the delay storage must be greater than zero");
+    if (storage == DelayStorage::float32)
+        delayBuffer.resize(delayBufferSize, SampleType { 0 });
+    else
+        compactBuffer.resize(delayBufferSize, uint16_t { 0u });
 
     // Initialize the current delay with a smoothing time to the requested value
     delayValue.setSmoothingTime(uint32_t { 1200u });
@@ -30,56 +80,392 @@ DelayLine::DelayLine(uint32_t maxDelaySamples, uint32_t initDelaySamples) :
 
 //================================================
 
-void DelayLine::setDelay(uint32_t newDelaySamples)
+template <typename SampleType>
+void DelayLine<SampleType>::setDelay(uint32_t newDelaySamples)
 {
     assert(static_cast<size_t>(newDelaySamples) <= delayBufferSize - size_t{ 1u } && "New delay must be less than the maximum delay");
     delayValue.setTarget(static_cast<float>(newDelaySamples), false);
 }
 
+template <typename SampleType>
+void DelayLine<SampleType>::crossfadeToDelay(uint32_t newDelaySamples)
+{
+    assert(static_cast<size_t>(newDelaySamples) <= delayBufferSize - size_t{ 1u } && "New delay must be less than the maximum delay");
+    assert(newDelaySamples > 0 && "Delay of the delay line must be greater than zero");
+
+    // A running crossfade is not restarted, which would drop its old head at full gain:
+    // a new delay waits for it to end, replacing any delay already waiting
+    const float newDelay { static_cast<float>(newDelaySamples) };
+    if (crossfadeRemaining > 0u)
+    {
+        pendingDelay = newDelay == delayValue.getTarget() ? 0u : newDelaySamples;
+        return;
+    }
+    if (newDelay == delayValue.getTarget())
+        return;
+
+    startCrossfade(newDelay);
+}
+
+template <typename SampleType>
+void DelayLine<SampleType>::startCrossfade(float newDelay)
+{
+    // The old head continues from where the current one is, the new one starts at the new delay
+    fadeOutDelay = delayValue.getCurrentValue();
+    delayValue.setTarget(newDelay, true);
+    crossfadeRemaining = crossfadeSamples;
+}
+
+template <typename SampleType>
+void DelayLine<SampleType>::setCrossfadeTime(uint32_t newTimeInSamples)
+{
+    assert(newTimeInSamples > 0 && "Crossfade time must be greater than zero");
+    crossfadeSamples = newTimeInSamples;
+}
+
+template <typename SampleType>
+void DelayLine<SampleType>::setInterpolation(Interpolation newInterpolation)
+{
+    interpolation = newInterpolation;
+}
+
+template <typename SampleType>
+uint32_t DelayLine<SampleType>::getMaxDelay() const
+{
+    return static_cast<uint32_t>(delayBufferSize - size_t { 1u });
+}
+
+template <typename SampleType>
+DelayStorage DelayLine<SampleType>::getStorage() const
+{
+    return storage;
+}
+
+template <typename SampleType>
+float DelayLine<SampleType>::getHeadroom() const
+{
+    return headroom;
+}
+
+template <typename SampleType>
+void DelayLine<SampleType>::copyStateFrom(const DelayLine& other)
+{
+    assert(delayBufferSize >= other.delayBufferSize && "Delay buffer must be at least as large as the source buffer");
+
+    // Linearise the other ring buffer, oldest sample first, then continue writing after it.
+    // Delays longer than the other buffer read the zeroed tail.
+    auto copyLinearised = [&other](auto& buffer, const auto& otherBuffer)
+    {
+        const auto otherWrite = otherBuffer.begin() + static_cast<std::ptrdiff_t>(other.writeIndex);
+        auto copyEnd = std::copy(otherWrite, otherBuffer.end(), buffer.begin());
+        copyEnd = std::copy(otherBuffer.begin(), otherWrite, copyEnd);
+        std::fill(copyEnd, buffer.end(), 0);
+    };
+
+    if (storage == other.storage && (storage != DelayStorage::fixed16 || headroom == other.headroom))
+    {
+        if (storage == DelayStorage::float32)
+            copyLinearised(delayBuffer, other.delayBuffer);
+        else
+            copyLinearised(compactBuffer, other.compactBuffer);
+    }
+    else
+    {
+        // Another format: convert sample by sample
+        for (size_t i = 0; i < other.delayBufferSize; ++i)
+            store(i, other.load((other.writeIndex + i) % other.delayBufferSize));
+        for (size_t i = other.delayBufferSize; i < delayBufferSize; ++i)
+            store(i, SampleType { 0 });
+    }
+    writeIndex = other.delayBufferSize % delayBufferSize;
+    migration = {};
+    copyReadState(other);
+}
+
+template <typename SampleType>
+bool DelayLine<SampleType>::migrateStateFrom(const DelayLine& other, size_t maxBlockSize)
+{
+    assert(delayBufferSize >= other.delayBufferSize && "Delay buffer must be at least as large as the source buffer");
+    assert(storage == other.storage && headroom == other.headroom && "Migration requires the same storage");
+
+    // A block could wrap the other ring before the next call: copy it whole, which costs no more than the block
+    const size_t otherSize { other.delayBufferSize };
+    if (otherSize <= maxBlockSize)
+    {
+        copyStateFrom(other);
+        return true;
+    }
+
+    // The ring of this line continues the other one from its write index at the start: the samples written since
+    // follow it, and the history before it wraps to the end of this, larger, ring
+    if (! migration.active)
+        migration = { true, other.writeIndex, other.writeIndex, 0u, 0u };
+
+    const size_t numWritten { (other.writeIndex + otherSize - migration.lastIndex) % otherSize };
+    copyRing(other, migration.lastIndex, (migration.startIndex + migration.numWritten) % delayBufferSize, numWritten);
+    migration.lastIndex = other.writeIndex;
+    migration.numWritten += numWritten;
+
+    // The oldest history first, a block ahead of the samples the other line overwrites before the next call
+    const size_t numCopied { std::min(migration.numCopied + std::max(migrationSamples, maxBlockSize), otherSize) };
+    copyRing(other, (migration.startIndex + migration.numCopied) % otherSize,
+             (migration.startIndex + migration.numCopied + delayBufferSize - otherSize) % delayBufferSize,
+             numCopied - migration.numCopied);
+    migration.numCopied = numCopied;
+
+    writeIndex = (migration.startIndex + migration.numWritten) % delayBufferSize;
+    copyReadState(other);
+    return migration.numCopied == otherSize;
+}
+
+template <typename SampleType>
+void DelayLine<SampleType>::copyRing(const DelayLine& other, size_t otherIndex, size_t index, size_t numSamples)
+{
+    auto copy = [&](auto& buffer, const auto& otherBuffer)
+    {
+        while (numSamples > 0u)
+        {
+            const size_t runLength { std::min({ numSamples, other.delayBufferSize - otherIndex, delayBufferSize - index }) };
+            std::copy_n(otherBuffer.begin() + static_cast<std::ptrdiff_t>(otherIndex), runLength,
+                        buffer.begin() + static_cast<std::ptrdiff_t>(index));
+            otherIndex = (otherIndex + runLength) % other.delayBufferSize;
+            index = (index + runLength) % delayBufferSize;
+            numSamples -= runLength;
+        }
+    };
+
+    if (storage == DelayStorage::float32)
+        copy(delayBuffer, other.delayBuffer);
+    else
+        copy(compactBuffer, other.compactBuffer);
+}
+
+template <typename SampleType>
+void DelayLine<SampleType>::copyReadState(const DelayLine& other)
+{
+    delayValue = other.delayValue;
+    fadeOutDelay = other.fadeOutDelay;
+    crossfadeSamples = other.crossfadeSamples;
+    crossfadeRemaining = other.crossfadeRemaining;
+    pendingDelay = other.pendingDelay;
+    interpolation = other.interpolation;
+}
+
+template <typename SampleType>
+void DelayLine<SampleType>::visitMemory(const utils::MemoryVisitor& visitor) const
+{
+    if (storage == DelayStorage::float32)
+        visitor(delayBuffer.data(), delayBuffer.size() * sizeof(SampleType));
+    else
+        visitor(compactBuffer.data(), compactBuffer.size() * sizeof(uint16_t));
+}
+
+template <typename SampleType>
+utils::MemoryFootprint DelayLine<SampleType>::getMemoryFootprint() const
+{
+    return { utils::MemoryFootprint::of(delayBuffer) + utils::MemoryFootprint::of(compactBuffer), 0u };
+}
+
 //================================================
 
-void DelayLine::prepare()
+template <typename SampleType>
+void DelayLine<SampleType>::prepare()
 {
     delayValue.prepare();
-    DelayLine::clear();
+    // The buffer is cleared: no crossfade to finish, a waiting delay applies at once
+    if (pendingDelay > 0u)
+        delayValue.setTarget(static_cast<float>(pendingDelay), true);
+    crossfadeRemaining = 0u;
+    pendingDelay = 0u;
+    DelayLine<SampleType>::clear();
 }
 
-void DelayLine::clear()
+template <typename SampleType>
+void DelayLine<SampleType>::clear()
 {
-    std::fill(delayBuffer.begin(), delayBuffer.end(), 0.f);
+    std::fill(delayBuffer.begin(), delayBuffer.end(), SampleType { 0 });
+    std::fill(compactBuffer.begin(), compactBuffer.end(), uint16_t { 0u });
     writeIndex = size_t { 0u };
+    migration = {};
 }
 
 //================================================
 
-void DelayLine::processSample(float* outSample, const float* inSample, float modInput /*= 0.0f*/)
+template <typename SampleType>
+SampleType DelayLine<SampleType>::load(size_t index) const
+{
+    if (storage == DelayStorage::float32)
+        return delayBuffer[index];
+    if (storage == DelayStorage::bfloat16)
+        return static_cast<SampleType>(fromBFloat16(compactBuffer[index]));
+    return static_cast<SampleType>(static_cast<int16_t>(compactBuffer[index])) * fixedStep;
+}
+
+template <typename SampleType>
+void DelayLine<SampleType>::store(size_t index, SampleType sample)
+{
+    if (storage == DelayStorage::float32)
+        delayBuffer[index] = sample;
+    else if (storage == DelayStorage::bfloat16)
+        compactBuffer[index] = toBFloat16(static_cast<float>(sample));
+    else
+        compactBuffer[index] = toFixed16(sample * fixedInverseStep);
+}
+
+template <typename SampleType>
+SampleType DelayLine<SampleType>::readInterpolated(float delay) const
 {
-    // Interpolate the read index for smooth ramping
-    float delay = delayValue.getSample();
-    delay += modInput;
     const float delayCeil  { std::ceil(delay) };
-    const float delayFrac1 { delayCeil - delay };
-    const float delayFrac0 {  1.f - delayFrac1 };
+    const SampleType delayFrac1 { static_cast<SampleType>(delayCeil - delay) };
+    const SampleType delayFrac0 { SampleType { 1 } - delayFrac1 };
 
     // Calculate interpolation read indices based on the modulation value
     const size_t readIndex0 { (writeIndex + delayBufferSize - static_cast<size_t>(delayCeil)) % delayBufferSize };
     const size_t readIndex1 { (readIndex0 + delayBufferSize + static_cast<size_t>(    1u   )) % delayBufferSize };
 
+    // Read output from the delay buffer
+    const SampleType read0 = load(readIndex0);
+    const SampleType read1 = load(readIndex1);
+    return read0 * delayFrac0 + read1 * delayFrac1;
+}
+
+template <typename SampleType>
+SampleType DelayLine<SampleType>::readNearest(float delay) const
+{
+    const size_t readIndex { (writeIndex + delayBufferSize - static_cast<size_t>(delay + 0.5f)) % delayBufferSize };
+    return load(readIndex);
+}
+
+template <typename SampleType>
+SampleType DelayLine<SampleType>::read(float delay) const
+{
+    return interpolation == Interpolation::linear ? readInterpolated(delay) : readNearest(delay);
+}
+
+template <typename SampleType>
+void DelayLine<SampleType>::processSample(SampleType* outSample, const SampleType* inSample, float modInput /*= 0.0f*/)
+{
+    // Interpolate the read index for smooth ramping
+    float delay = delayValue.getSample();
+    delay += modInput;
+
     // Write input to the delay buffer
-    delayBuffer.at(writeIndex) = *inSample;
+    store(writeIndex, *inSample);
     // Read output from the delay buffer
-    const float read0 = delayBuffer.at(readIndex0);
-    const float read1 = delayBuffer.at(readIndex1);
-    *outSample = read0 * delayFrac0 + read1 * delayFrac1;
+    *outSample = read(delay);
+
+    // Crossfade from the old read head while the delay time jumps
+    if (crossfadeRemaining > 0u)
+    {
+        const SampleType fadeOutGain { static_cast<SampleType>(crossfadeRemaining) / static_cast<SampleType>(crossfadeSamples) };
+        const SampleType fadeOutSample { read(fadeOutDelay + modInput) };
+        *outSample += fadeOutGain * (fadeOutSample - *outSample);
+        --crossfadeRemaining;
+
+        if (crossfadeRemaining == 0u && pendingDelay > 0u)
+        {
+            startCrossfade(static_cast<float>(pendingDelay));
+            pendingDelay = 0u;
+        }
+    }
 
     // Update persistent write index
     ++writeIndex; writeIndex %= delayBufferSize;
 }
 
-void DelayLine::processBlock(float* outBlock, const float* inBlock, uint32_t numSamples, const float* modInput /*= nullptr*/)
+template <typename SampleType>
+void DelayLine<SampleType>::processBlock(SampleType* outBlock, const SampleType* inBlock, uint32_t numSamples, const float* modInput /*= nullptr*/)
 {
+    DSP_TRACE_SCOPE("DelayLine::processBlock");
+    if (modInput == nullptr && crossfadeRemaining == 0u && interpolation == Interpolation::linear && ! delayValue.needsSmoothing())
+    {
+        processStaticBlock(outBlock, inBlock, numSamples);
+        return;
+    }
+
     for (uint32_t n = 0; n < numSamples; n++)
-        DelayLine::processSample(&outBlock[n], &inBlock[n], modInput ? modInput[n] : 0.0f);
+        DelayLine<SampleType>::processSample(&outBlock[n], &inBlock[n], modInput ? modInput[n] : 0.0f);
 }
 
+template <typename SampleType>
+void DelayLine<SampleType>::processStaticBlock(SampleType* outBlock, const SampleType* inBlock, uint32_t numSamples)
+{
+    // Not smoothing: the delay is the target from now on
+    const float delay { delayValue.getSample() };
+    const float delayCeil { std::ceil(delay) };
+    const size_t readOffset { static_cast<size_t>(delayCeil) };
+    const SampleType delayFrac1 { static_cast<SampleType>(delayCeil - delay) };
+    const SampleType delayFrac0 { SampleType { 1 } - delayFrac1 };
+    const auto& kernels { DSP::KernelDispatch::getKernels<SampleType>() };
+
+    uint32_t n { 0u };
+    while (n < numSamples)
+    {
+        const size_t readIndex0 { (writeIndex + delayBufferSize - readOffset) % delayBufferSize };
+
+        // A run writes its input first, then reads: it must not wrap around the buffer, neither where it
+        // writes nor where it reads, and must not overwrite what it still reads (runs of at most
+        // delayBufferSize - readOffset samples). A delay under one sample reads ahead of the write
+        size_t runLength { static_cast<size_t>(numSamples - n) };
+        runLength = std::min(runLength, delayBufferSize - writeIndex);
+        runLength = std::min(runLength, delayBufferSize - readIndex0 - size_t { 1u });
+        runLength = std::min(runLength, readOffset > 0u ? delayBufferSize - readOffset : size_t { 0u });
+        if (runLength == 0u)
+        {
+            DelayLine<SampleType>::processSample(&outBlock[n], &inBlock[n]);
+            ++n;
+            continue;
+        }
+
+        if (storage == DelayStorage::float32)
+        {
+            std::copy(inBlock + n, inBlock + n + runLength, delayBuffer.begin() + static_cast<std::ptrdiff_t>(writeIndex));
+            kernels.interpolateLinear(outBlock + n, &delayBuffer[readIndex0], &delayBuffer[readIndex0 + 1u], delayFrac0, delayFrac1, static_cast<uint32_t>(runLength));
+        }
+        else
+        {
+            writeRun(inBlock + n, runLength);
+            interpolateRun(outBlock + n, readIndex0, delayFrac0, delayFrac1, runLength);
+        }
+
+        writeIndex = (writeIndex + runLength) % delayBufferSize;
+        n += static_cast<uint32_t>(runLength);
+    }
+}
+
+template <typename SampleType>
+void DelayLine<SampleType>::writeRun(const SampleType* inBlock, size_t runLength)
+{
+    const auto& kernels { DSP::KernelDispatch::getKernels<SampleType>() };
+    uint16_t* destination { &compactBuffer[writeIndex] };
+    if (storage == DelayStorage::bfloat16)
+        kernels.packBFloat16(destination, inBlock, static_cast<uint32_t>(runLength));
+    else
+        kernels.packFixed16(reinterpret_cast<int16_t*>(destination), inBlock, fixedInverseStep, static_cast<uint32_t>(runLength));
+}
+
+template <typename SampleType>
+void DelayLine<SampleType>::interpolateRun(SampleType* outBlock, size_t readIndex0, SampleType delayFrac0, SampleType delayFrac1, size_t runLength)
+{
+    const auto& kernels { DSP::KernelDispatch::getKernels<SampleType>() };
+
+    // Each output interpolates two neighbouring samples: convert one more than the outputs
+    SampleType taps[conversionSamples + 1u];
+    for (size_t offset = 0; offset < runLength; offset += conversionSamples)
+    {
+        const uint32_t numSamples { static_cast<uint32_t>(std::min(conversionSamples, runLength - offset)) };
+        const uint16_t* source { &compactBuffer[readIndex0 + offset] };
+        if (storage == DelayStorage::bfloat16)
+            kernels.unpackBFloat16(taps, source, numSamples + 1u);
+        else
+            kernels.unpackFixed16(taps, reinterpret_cast<const int16_t*>(source), fixedStep, numSamples + 1u);
+        kernels.interpolateLinear(outBlock + offset, taps, taps + 1, delayFrac0, delayFrac1, numSamples);
+    }
+}
+
+//================================================
+
+template class DelayLine<float>;
+template class DelayLine<double>;
+
 }
\ No newline at end of file
@@ -1,13 +1,36 @@
 #pragma once
 
+#include <cstdint>
 #include <type_traits>
 #include <vector>
 
+#include "MemoryFootprint.h"
+#include "MemoryLock.h"
 #include "SmoothParameter.h"
 
 namespace primitives
 {
 
+// Read interpolation of the delay lines: linear, or none (the nearest sample, cheaper but stepped while the delay glides)
+enum class Interpolation
+{
+    linear,
+    none
+};
+
+// Sample format of the delay memory. The 16-bit formats halve the memory the reads stream through, so
+// that long or many delays stay in cache, at the cost of a conversion on every write and read:
+// - bfloat16: single precision with an 8-bit mantissa, about 50 dB of signal to rounding noise at any level
+// - fixed16: 16-bit integers scaled by a per-line headroom, the largest magnitude they hold (saturated above).
+//   A fixed noise floor about 90 dB under the headroom, below which quiet tails stop decaying smoothly
+enum class DelayStorage
+{
+    float32,
+    bfloat16,
+    fixed16
+};
+
+template <typename SampleType>
 class DelayLine
 {
 public:
@@ -16,7 +39,9 @@ public:
     DelayLine() = delete;
     DelayLine(
         uint32_t maxDelaySamples,
-        uint32_t initDelaySamples
+        uint32_t initDelaySamples,
+        DelayStorage initStorage = DelayStorage::float32,
+        float initHeadroom = defaultHeadroom
     );
 
     // Destructor -> default
@@ -31,9 +56,42 @@ public:
 
     //================================================
 
-    // Set the current delay time
+    // Set the current delay time, gliding to it (pitch shift while smoothing)
     void setDelay(uint32_t newDelaySamples);
 
+    // Jump to a new delay time, crossfading from the old read head to the new one (no pitch shift).
+    // During a crossfade, the latest new delay starts once it ends
+    void crossfadeToDelay(uint32_t newDelaySamples);
+
+    // Set the crossfade duration used by crossfadeToDelay
+    void setCrossfadeTime(uint32_t newTimeInSamples);
+
+    // Set the read interpolation
+    void setInterpolation(Interpolation newInterpolation);
+
+    // Returns the maximum delay time
+    uint32_t getMaxDelay() const;
+
+    // Sample format of the delay memory, and the largest magnitude fixed16 holds
+    DelayStorage getStorage() const;
+    float getHeadroom() const;
+
+    // Copy the delay history and the read state of another delay line, converting it to this line's storage.
+    // This buffer must be at least as large as the other one: no allocation, audio-thread safe
+    void copyStateFrom(const DelayLine& other);
+
+    // The same, in steps, while the other line keeps processing. Call once per block, before the other line processes
+    // at most maxBlockSize samples: each call mirrors what it wrote since the last one and copies a bounded part of its
+    // older history. Returns true once the history is complete: this line then matches the other line after each call.
+    // Same storage and headroom only, no allocation, audio-thread safe
+    bool migrateStateFrom(const DelayLine& other, size_t maxBlockSize);
+
+    // Pass the delay buffer to a visitor
+    void visitMemory(const utils::MemoryVisitor& visitor) const;
+
+    // Heap memory of the delay buffer
+    utils::MemoryFootprint getMemoryFootprint() const;
+
     //================================================
 
     // Prepare the delay line for processing
@@ -44,25 +102,92 @@ public:
 
     //================================================
 
-    // Process audio sample - linear interpolation only
-    void processSample(float* outSample, const float* inSample, float modInput = 0.0f);
+    // Process audio sample - linear interpolation, or none
+    void processSample(SampleType* outSample, const SampleType* inSample, float modInput = 0.0f);
 
-    // Process block of audio - wrapper of processSample
-    void processBlock(float* outBlock, const float* inBlock, uint32_t numSamples, const float* modInput = nullptr);
+    // Process block of audio - wrapper of processSample.
+    // A static delay, unmodulated and linearly interpolated, is processed in runs of contiguous samples instead
+    void processBlock(SampleType* outBlock, const SampleType* inBlock, uint32_t numSamples, const float* modInput = nullptr);
 
     //================================================
 
+    // fixed16 headroom when none is given: +12 dBFS, a power of two so that the scaling is exact
+    static constexpr float defaultHeadroom { 4.0f };
+
 private:
 
+    // Sample at a buffer index, and write one, in the storage format
+    SampleType load(size_t index) const;
+    void store(size_t index, SampleType sample);
+
+    // Read the buffer at a fractional delay - linear interpolation
+    SampleType readInterpolated(float delay) const;
+
+    // Read the buffer at the nearest whole delay
+    SampleType readNearest(float delay) const;
+
+    // Read with the current interpolation
+    SampleType read(float delay) const;
+
+    // Crossfade from the current read head to a new delay
+    void startCrossfade(float newDelay);
+
+    // processBlock of a static delay: the same output as processSample, a run of samples at a time
+    void processStaticBlock(SampleType* outBlock, const SampleType* inBlock, uint32_t numSamples);
+
+    // Runs of the 16-bit formats: write the input, then interpolate through a conversion buffer of this many samples
+    void writeRun(const SampleType* inBlock, size_t runLength);
+    void interpolateRun(SampleType* outBlock, size_t readIndex0, SampleType delayFrac0, SampleType delayFrac1, size_t runLength);
+    static constexpr size_t conversionSamples { 256u };
+
+    // Copy samples from a ring index of the other line to a ring index of this one, in the storage format
+    void copyRing(const DelayLine& other, size_t otherIndex, size_t index, size_t numSamples);
+    // Delay, crossfade and interpolation state, as the other line has it
+    void copyReadState(const DelayLine& other);
+
+    // Samples of older history migrateStateFrom copies per call, at least
+    static constexpr size_t migrationSamples { 1024u };
+
+    //================================================
+
     utils::SmoothParameter delayValue;
     size_t delayBufferSize;
-    std::vector<float> delayBuffer;
+    // One of the two holds the delay memory: float32, or the 16-bit formats
+    std::vector<SampleType> delayBuffer;
+    std::vector<uint16_t> compactBuffer;
+    DelayStorage storage;
+    // fixed16: value of one step, and its inverse
+    float headroom;
+    SampleType fixedStep;
+    SampleType fixedInverseStep;
     size_t writeIndex;
+    Interpolation interpolation { Interpolation::linear };
+
+    // Second read head, faded out while crossfading to a new delay time
+    float fadeOutDelay;
+    uint32_t crossfadeSamples;
+    uint32_t crossfadeRemaining;
+    // Delay requested during a crossfade, started after it (0: none)
+    uint32_t pendingDelay { 0u };
+
+    // migrateStateFrom: the other line's write index when it started and at the last call, the samples it wrote
+    // since it started, and how much of its history at the start is copied, oldest first
+    struct Migration
+    {
+        bool active { false };
+        size_t startIndex { 0u };
+        size_t lastIndex { 0u };
+        size_t numWritten { 0u };
+        size_t numCopied { 0u };
+    };
+    Migration migration;
 
     //================================================
 
-    static_assert(std::is_move_constructible_v<DelayLine>, "DelayLine must be movable");
-    static_assert(std::is_nothrow_move_assignable_v<DelayLine>, "Move assignment should not throw");
+    static_assert(std::is_floating_point_v<SampleType>, "DelayLine requires a floating-point sample type");
 };
 
-}
\ No newline at end of file
+static_assert(std::is_move_constructible_v<DelayLine<float>>, "DelayLine must be movable");
+static_assert(std::is_nothrow_move_assignable_v<DelayLine<float>>, "Move assignment should not throw");
+
+}
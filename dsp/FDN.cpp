@@ -1,49 +1,114 @@
 #include "FDN.h"
+#include "Trace.h"
 #include "juce_core/system/juce_PlatformDefs.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstddef>
-
+#include <limits>
 #include <random>
+#include <string>
 
 namespace DSP
 {
 
-FDN::FDN(uint32_t initOrder, float initT60DC, float initBrightness) :
+namespace
+{
+    template <typename SampleType>
+    const KernelTable<SampleType>& getKernelTable(const KernelTables& tables)
+    {
+        if constexpr (std::is_same_v<SampleType, float>)
+            return tables.floatKernels;
+        else
+            return tables.doubleKernels;
+    }
+}
+
+utils::MemoryFootprint FDNMemoryFootprint::getTotal() const
+{
+    utils::MemoryFootprint total { delayLines };
+    total += absorption;
+    total += feedbackMatrix;
+    total += state;
+    return total;
+}
+
+FDNMemoryFootprint& FDNMemoryFootprint::operator+=(const FDNMemoryFootprint& other)
+{
+    delayLines += other.delayLines;
+    absorption += other.absorption;
+    feedbackMatrix += other.feedbackMatrix;
+    state += other.state;
+    return *this;
+}
+
+// =============================================
+
+template <typename SampleType>
+FDN<SampleType>::FDN(uint32_t initOrder, SampleType initT60DC, SampleType initBrightness, uint32_t initSeed /*= 0u*/) :
     // Check if the order is valid
     order { checkOrder(initOrder) },
+    seed { initSeed },
     // Initialize sample rate
-    feedbackMatrix { static_cast<int>(order), static_cast<int>(order) }
+    feedbackMatrix { static_cast<int>(order), static_cast<int>(order), seed }
+{
+    baseDelayLengths = computeDelayLengths();
+    initialize(initT60DC, initBrightness);
+}
+
+template <typename SampleType>
+FDN<SampleType>::FDN(const FDNSnapshot& snapshot, SampleType initT60DC, SampleType initBrightness) :
+    order { checkOrder(snapshot.order) },
+    seed { snapshot.seed },
+    feedbackMatrix { snapshot.feedbackMatrix }
+{
+    jassert(snapshot.isValid() && "FDN snapshot is inconsistent");
+    baseDelayLengths.assign(snapshot.delayLengths.begin(), snapshot.delayLengths.end());
+    initialize(initT60DC, initBrightness);
+}
+
+template <typename SampleType>
+void FDN<SampleType>::initialize(SampleType initT60DC, SampleType initBrightness)
 {
     // Initialize delay lines
-    delayLengths.reserve(order);
-    delayLengths = computeDelayLengths();
-    maxDelayLengths = computeMaxDelayLinesLengths();
-    delayLines = std::make_unique<MultichannelDelay>(
+    delayLengths = baseDelayLengths;
+    maxDelayLengths = computeMaxDelayLinesLengths(reservedRoomSize);
+    delayLines = std::make_unique<MultichannelDelay<SampleType>>(
         order,
         maxDelayLengths,
-        delayLengths
+        delayLengths,
+        delayStorage,
+        delayHeadroom
     );
 
     // Initialize absorption filters
-    jassert(initT60DC > 0.f && "T60 at DC must be greater than zero");
-    jassert(initBrightness >= 0.f && initBrightness <= 1.f && "Brightness must be in [0, 1]");
+    jassert(initT60DC > SampleType { 0 } && "T60 at DC must be greater than zero");
+    jassert(initBrightness >= SampleType { 0 } && initBrightness <= SampleType { 1 } && "Brightness must be in [0, 1]");
     T60DC = initT60DC;
     brightness = initBrightness;
     absorptionMagnitudeValues = computeAbsorptionMagValues(T60DC, brightness, this->sampleRate);
-    absorptionFilters = std::make_unique<MultichannelAbsorption>(
+    absorptionFilters = std::make_unique<MultichannelAbsorption<SampleType>>(
         order, 
         absorptionMagnitudeValues
     );
 
     // Initialize feedback state
     feedbackState.resize(order);
-    std::fill(feedbackState.begin(), feedbackState.end(), 0.f);
+    std::fill(feedbackState.begin(), feedbackState.end(), SampleType { 0 });
+
+    // Allocate the rotation state of the feedback matrix here, so that prepare does not
+    feedbackMatrix.prepareModulation(this->sampleRate);
 }
 
-FDN::~FDN()
+template <typename SampleType>
+FDN<SampleType>::~FDN()
 {
+    delete pendingDelayLines.exchange(nullptr);
+    delete retiredDelayLines.exchange(nullptr);
 }
 
-uint32_t FDN::checkOrder(uint32_t order)
+template <typename SampleType>
+uint32_t FDN<SampleType>::checkOrder(uint32_t order)
 {
     for (const auto validOrder : possibleOrders)
     {
@@ -54,28 +119,72 @@ uint32_t FDN::checkOrder(uint32_t order)
     return 0u;
 }
 
-std::vector<size_t> FDN::computeDelayLengths()
+template <typename SampleType>
+uint32_t FDN<SampleType>::getSeed() const
+{
+    return seed;
+}
+
+template <typename SampleType>
+FDNSnapshot FDN<SampleType>::getSnapshot() const
 {
-    std::vector<size_t> delayLengths;
-    delayLengths.reserve(this->order);
+    FDNSnapshot snapshot;
+    snapshot.order = order;
+    snapshot.seed = seed;
+    snapshot.delayLengths.reserve(order);
+    for (const size_t delayLength : baseDelayLengths)
+        snapshot.delayLengths.push_back(static_cast<uint32_t>(delayLength));
+    snapshot.feedbackMatrix = feedbackMatrix.getSnapshot();
+    return snapshot;
+}
 
-    // Define min and max delay length values (replace with your desired values)
-    const size_t minDelay = 300; // example minimum
-    const size_t maxDelay = 2600; // example maximum
+template <typename SampleType>
+void FDN<SampleType>::setSnapshot(const FDNSnapshot& snapshot)
+{
+    DSP_TRACE_SCOPE("FDN::setSnapshot");
+    jassert(snapshot.isValid() && "FDN snapshot is inconsistent");
+    jassert(snapshot.order == order && "Snapshot order must match the FDN order");
 
-    // Seed random generator (could use std::random_device for more randomness)
-    std::mt19937 rng(static_cast<unsigned int>(std::time(nullptr)));
-    std::uniform_int_distribution<size_t> dist(minDelay, maxDelay);
+    seed = snapshot.seed;
 
-    for (uint32_t i = 0; i < this->order; ++i)
-    {
-        delayLengths.push_back(dist(rng));
-    }
-    
-    return delayLengths;
+    // Restore delay lines, with the memory reserved so far
+    delete pendingDelayLines.exchange(nullptr);
+    migratingDelayLines.reset();
+    baseDelayLengths.assign(snapshot.delayLengths.begin(), snapshot.delayLengths.end());
+    maxDelayLengths = computeMaxDelayLinesLengths(reservedRoomSize);
+    delayLines = std::make_unique<MultichannelDelay<SampleType>>(
+        order,
+        maxDelayLengths,
+        baseDelayLengths,
+        delayStorage,
+        delayHeadroom
+    );
+    scaleDelayLengths(currentRoomSize);
+    delayLines->setDelayLinesLengths(delayLengths);
+    delayLines->prepare(this->sampleRate, 0);
+    delayLines->setInterpolation(interpolation);
+
+    // Restore feedback matrix
+    feedbackMatrix.setSnapshot(snapshot.feedbackMatrix);
+
+    // Absorption depends on the delay lengths
+    updateAbsorption();
+
+    clear();
+}
+
+template <typename SampleType>
+std::vector<size_t> FDN<SampleType>::computeDelayLengths()
+{
+    // Seed-addressed: the same order and seed always give the same delay set
+    const auto sharedDelayLengths = TopologyCache::getDelayLengths(this->order, minBaseDelay, maxBaseDelay, this->seed);
+
+    return *sharedDelayLengths;
 }
 
-std::vector<size_t> FDN::computeMaxDelayLinesLengths(
+template <typename SampleType>
+std::vector<size_t> FDN<SampleType>::computeMaxDelayLinesLengths(
+    SampleType roomSize /*= SampleType { 1 }*/
     // TODO: Add time variation
 )
 {
@@ -85,88 +194,445 @@ std::vector<size_t> FDN::computeMaxDelayLinesLengths(
     // Calculate the maximum delay lengths for each filter
     for (uint32_t i = 0; i < this->order; ++i)
     {
-        size_t maxLength = this->delayLengths[i] + 100;
+        const SampleType scaledLength { std::ceil(static_cast<SampleType>(this->baseDelayLengths[i]) * std::max(roomSize, SampleType { 1 })) };
+        size_t maxLength = static_cast<size_t>(scaledLength) + 100;
         maxDelayLengths.push_back(maxLength);
     }
 
     return maxDelayLengths;
 }
 
-std::vector<std::pair<float, float>> FDN::computeAbsorptionMagValues(
-    float T60DC,
-    float brightness,
+template <typename SampleType>
+void FDN<SampleType>::setRoomSize(SampleType newRoomSize)
+{
+    jassert(newRoomSize > SampleType { 0 } && "Room size must be greater than zero");
+    targetRoomSize.store(newRoomSize, std::memory_order_relaxed);
+}
+
+template <typename SampleType>
+SampleType FDN<SampleType>::getRoomSize() const
+{
+    return targetRoomSize.load(std::memory_order_relaxed);
+}
+
+template <typename SampleType>
+void FDN<SampleType>::reserveRoomSize()
+{
+    DSP_TRACE_SCOPE("FDN::reserveRoomSize");
+    // Free the delay memory the audio thread replaced
+    delete retiredDelayLines.exchange(nullptr, std::memory_order_acq_rel);
+
+    const SampleType roomSize { targetRoomSize.load(std::memory_order_relaxed) };
+    if (roomSize <= reservedRoomSize)
+        return;
+
+    // A set that was not adopted yet is replaced by a larger one
+    delete pendingDelayLines.exchange(nullptr, std::memory_order_acq_rel);
+
+    // Grow with some margin, so that dragging the room size does not reallocate on every step
+    reservedRoomSize = roomSize * SampleType { 1.25 };
+    maxDelayLengths = computeMaxDelayLinesLengths(reservedRoomSize);
+    auto grownDelayLines = std::make_unique<MultichannelDelay<SampleType>>(
+        order,
+        maxDelayLengths,
+        baseDelayLengths,
+        delayStorage,
+        delayHeadroom
+    );
+    pendingDelayLines.store(grownDelayLines.release(), std::memory_order_release);
+}
+
+template <typename SampleType>
+void FDN<SampleType>::setMaxRoomSize(SampleType maxRoomSize)
+{
+    jassert(maxRoomSize > SampleType { 0 } && "Room size must be greater than zero");
+    if (maxRoomSize <= reservedRoomSize)
+        return;
+
+    // Replaces any grown set that was not adopted yet
+    delete pendingDelayLines.exchange(nullptr, std::memory_order_acq_rel);
+    migratingDelayLines.reset();
+
+    reservedRoomSize = maxRoomSize;
+    maxDelayLengths = computeMaxDelayLinesLengths(reservedRoomSize);
+    auto grownDelayLines = std::make_unique<MultichannelDelay<SampleType>>(
+        order,
+        maxDelayLengths,
+        baseDelayLengths,
+        delayStorage,
+        delayHeadroom
+    );
+    grownDelayLines->copyStateFrom(*delayLines);
+    delayLines = std::move(grownDelayLines);
+
+    // Lengths clamped by the previous memory reach their room size
+    scaleDelayLengths(currentRoomSize);
+    delayLines->crossfadeDelayLinesLengths(delayLengths);
+}
+
+template <typename SampleType>
+std::pair<SampleType, SampleType> FDN<SampleType>::computeAbsorptionMagValue(
+    size_t delayLength,
+    SampleType T60DC,
+    SampleType brightness,
     double sampleRate
 )
 {
-    std::vector<std::pair<float, float>> absorptionMagnitudeValues;
+    SampleType magDCdB = static_cast<SampleType>(delayLength) * ( SampleType { -60 } / ( T60DC * static_cast<SampleType>(sampleRate) )) ;
+    SampleType magDClinear = std::pow(SampleType { 10 }, magDCdB / SampleType { 20 });
+    SampleType T60Nyquist = T60DC * brightness;
+    SampleType magNYdB = static_cast<SampleType>(delayLength) * ( SampleType { -60 } / ( T60Nyquist * static_cast<SampleType>(sampleRate) )) ;
+    SampleType magNYlinear = std::pow(SampleType { 10 }, magNYdB / SampleType { 20 });
+
+    return { magDClinear, magNYlinear };
+}
+
+template <typename SampleType>
+std::vector<std::pair<SampleType, SampleType>> FDN<SampleType>::computeAbsorptionMagValues(
+    SampleType T60DC,
+    SampleType brightness,
+    double sampleRate
+)
+{
+    std::vector<std::pair<SampleType, SampleType>> absorptionMagnitudeValues;
     absorptionMagnitudeValues.reserve(this->order);
 
     // Calculate the magnitude values for each filter
     for (uint32_t i = 0; i < this->order; ++i)
-    {
-        float magDCdB = static_cast<float>(this->delayLengths[i]) * ( -60.f / ( T60DC * static_cast<float>(sampleRate) )) ;
-        float magDClinear = std::powf(10.f, magDCdB / 20.f);
-        float T60Nyquist = T60DC * brightness;
-        float magNYdB = static_cast<float>(this->delayLengths[i]) * ( -60.f / ( T60Nyquist * static_cast<float>(sampleRate) )) ;
-        float magNYlinear = std::powf(10.f, magNYdB / 20.f);
-
-        absorptionMagnitudeValues.emplace_back(magDClinear, magNYlinear);
-    }
+        absorptionMagnitudeValues.push_back(computeAbsorptionMagValue(this->delayLengths[i], T60DC, brightness, sampleRate));
 
     return absorptionMagnitudeValues;
 }
 
-void FDN::setT60(float newT60DC)
+template <typename SampleType>
+void FDN<SampleType>::updateAbsorption()
 {
-    jassert(newT60DC > 0.f && "T60 at DC must be greater than zero");
+    DSP_TRACE_SCOPE("FDN::updateAbsorption");
+    jassert(absorptionMagnitudeValues.size() == static_cast<size_t>(order) && "Absorption values must be allocated");
+
+    for (uint32_t i = 0; i < this->order; ++i)
+        absorptionMagnitudeValues[i] = computeAbsorptionMagValue(this->delayLengths[i], this->T60DC, this->brightness, this->sampleRate);
+
+    absorptionFilters->setFiltersMagnitudeValues(absorptionMagnitudeValues);
+}
+
+template <typename SampleType>
+void FDN<SampleType>::scaleDelayLengths(SampleType roomSize)
+{
+    for (uint32_t i = 0; i < this->order; ++i)
+    {
+        const SampleType scaledLength { std::round(static_cast<SampleType>(baseDelayLengths[i]) * roomSize) };
+        delayLengths[i] = std::clamp(static_cast<size_t>(scaledLength), size_t { 1u }, delayLines->getMaxDelayLineLength(i));
+    }
+}
+
+template <typename SampleType>
+void FDN<SampleType>::setT60(SampleType newT60DC)
+{
+    jassert(newT60DC > SampleType { 0 } && "T60 at DC must be greater than zero");
     
     T60DC = newT60DC;
 
     // Update absorption filters with the new values
-    absorptionMagnitudeValues = computeAbsorptionMagValues(T60DC, this->brightness, this->sampleRate);
-    absorptionFilters->setFiltersMagnitudeValues(absorptionMagnitudeValues);
+    updateAbsorption();
 }
 
-void FDN::setBrightness(float newBrightness)
+template <typename SampleType>
+void FDN<SampleType>::setBrightness(SampleType newBrightness)
 {
-    jassert(newBrightness >= 0.f && newBrightness <= 1.f && "Brightness must be in [0, 1]");
+    jassert(newBrightness >= SampleType { 0 } && newBrightness <= SampleType { 1 } && "Brightness must be in [0, 1]");
     
     brightness = newBrightness;
 
     // Update absorption filters with the new values
-    absorptionMagnitudeValues = computeAbsorptionMagValues(this->T60DC, brightness, this->sampleRate);
-    absorptionFilters->setFiltersMagnitudeValues(absorptionMagnitudeValues);
+    updateAbsorption();
 }
 
-void FDN::prepare(double newSampleRate, int samplesPerBlock)
+template <typename SampleType>
+void FDN<SampleType>::setModulation(SampleType newRateHz, SampleType newDepth)
+{
+    modulationRate = newRateHz;
+    modulationDepth = newDepth;
+    feedbackMatrix.setModulation(static_cast<float>(newRateHz), static_cast<float>(newDepth));
+}
+
+template <typename SampleType>
+void FDN<SampleType>::setControlRateSmoothing(bool shouldUseControlRate)
+{
+    absorptionFilters->setControlInterval(shouldUseControlRate ? controlInterval : 1u);
+    feedbackMatrix.setRotationSmoothing(! shouldUseControlRate);
+}
+
+template <typename SampleType>
+void FDN<SampleType>::setInterpolation(primitives::Interpolation newInterpolation)
+{
+    // Grown delay memory copies the interpolation of the lines it replaces
+    interpolation = newInterpolation;
+    delayLines->setInterpolation(interpolation);
+}
+
+template <typename SampleType>
+void FDN<SampleType>::setInstructionSet(InstructionSet newInstructionSet)
+{
+    jassert(KernelDispatch::isSupported(newInstructionSet) && "Instruction set must be supported");
+    const KernelTable<SampleType>& kernels { getKernelTable<SampleType>(KernelDispatch::getTables(newInstructionSet)) };
+    feedbackMatrix.setKernels(&kernels);
+    absorptionFilters->setKernels(&kernels);
+}
+
+template <typename SampleType>
+void FDN<SampleType>::setAutoTuning(bool shouldAutoTune)
+{
+    autoTuning = shouldAutoTune;
+}
+
+template <typename SampleType>
+TuningDecision FDN<SampleType>::getTuning() const
+{
+    return tuning;
+}
+
+template <typename SampleType>
+void FDN<SampleType>::setTuning(const TuningDecision& decision)
+{
+    tuning = decision;
+    if (tuning.tuned)
+        setInstructionSet(tuning.instructionSet);
+}
+
+template <typename SampleType>
+void FDN<SampleType>::visitMemory(const utils::MemoryVisitor& visitor) const
+{
+    delayLines->visitMemory(visitor);
+    absorptionFilters->visitMemory(visitor);
+    feedbackMatrix.visitMemory(visitor);
+    visitor(feedbackState.data(), feedbackState.size() * sizeof(SampleType));
+}
+
+template <typename SampleType>
+FDNMemoryFootprint FDN<SampleType>::getMemoryFootprint() const
+{
+    FDNMemoryFootprint footprint;
+
+    for (const auto* lines : { delayLines.get(), migratingDelayLines.get(), pendingDelayLines.load(std::memory_order_acquire), retiredDelayLines.load(std::memory_order_acquire) })
+    {
+        if (lines == nullptr)
+            continue;
+        footprint.delayLines.owned += sizeof(*lines);
+        footprint.delayLines += lines->getMemoryFootprint();
+    }
+
+    footprint.absorption.owned = sizeof(*absorptionFilters);
+    footprint.absorption += absorptionFilters->getMemoryFootprint();
+    footprint.feedbackMatrix = feedbackMatrix.getMemoryFootprint();
+
+    for (const auto* lengths : { &baseDelayLengths, &delayLengths, &maxDelayLengths })
+        footprint.state.owned += utils::MemoryFootprint::of(*lengths);
+    footprint.state.owned += utils::MemoryFootprint::of(feedbackState) + utils::MemoryFootprint::of(absorptionMagnitudeValues);
+    return footprint;
+}
+
+template <typename SampleType>
+void FDN<SampleType>::setDelayStorage(primitives::DelayStorage newStorage, float newHeadroom /*= primitives::DelayLine<SampleType>::defaultHeadroom*/)
+{
+    jassert(newHeadroom > 0.0f && "Headroom of the delay storage must be greater than zero");
+    if (newStorage == delayStorage && newHeadroom == delayHeadroom)
+        return;
+
+    delayStorage = newStorage;
+    delayHeadroom = newHeadroom;
+
+    // A grown set not adopted yet has the old storage: convert into its size instead
+    delete pendingDelayLines.exchange(nullptr, std::memory_order_acq_rel);
+    migratingDelayLines.reset();
+
+    auto convertedDelayLines = std::make_unique<MultichannelDelay<SampleType>>(
+        order,
+        maxDelayLengths,
+        baseDelayLengths,
+        delayStorage,
+        delayHeadroom
+    );
+    convertedDelayLines->copyStateFrom(*delayLines);
+    delayLines = std::move(convertedDelayLines);
+
+    // Lengths clamped by the previous memory reach their room size
+    scaleDelayLengths(currentRoomSize);
+    delayLines->crossfadeDelayLinesLengths(delayLengths);
+    updateAbsorption();
+}
+
+template <typename SampleType>
+primitives::DelayStorage FDN<SampleType>::getDelayStorage() const
+{
+    return delayStorage;
+}
+
+template <typename SampleType>
+void FDN<SampleType>::tune(int samplesPerBlock)
+{
+    DSP_TRACE_SCOPE("FDN::tune");
+
+    // The candidates depend on the active instruction set, so it is part of the configuration
+    const std::string configuration {
+        std::string { "FDN<" } + (std::is_same_v<SampleType, float> ? "float" : "double") + ">"
+        + " order " + std::to_string(order)
+        + " block " + std::to_string(samplesPerBlock)
+        + " rate " + std::to_string(static_cast<int>(std::round(sampleRate)))
+        + " active " + KernelDispatch::getName(KernelDispatch::getActive())
+    };
+
+    TuningDecision decision;
+    if (! TuningCache::find(configuration, decision))
+    {
+        decision = measureInstructionSets(samplesPerBlock);
+        if (decision.nanosecondsPerSample > 0.0)
+            TuningCache::store(configuration, decision);
+    }
+
+    tuning = decision;
+    setInstructionSet(tuning.instructionSet);
+}
+
+template <typename SampleType>
+TuningDecision FDN<SampleType>::measureInstructionSets(int samplesPerBlock) const
+{
+    // Candidates are the supported sets that round like the active one: tuning never changes the output
+    const InstructionSet active { KernelDispatch::getActive() };
+    std::vector<InstructionSet> candidates;
+    for (uint32_t i = 0; i <= static_cast<uint32_t>(KernelDispatch::getSupported()); ++i)
+    {
+        const InstructionSet candidate { static_cast<InstructionSet>(i) };
+        if (KernelDispatch::roundsAlike(candidate, active))
+            candidates.push_back(candidate);
+    }
+
+    TuningDecision decision;
+    decision.tuned = true;
+    decision.instructionSet = active;
+    // Nothing to choose from: keep the active set, unmeasured
+    if (candidates.size() < 2u)
+        return decision;
+
+    // Scratch FDN of the same configuration and topology (restored ones included), processing noise in blocks of the host's size
+    FDN scratch { getSnapshot(), T60DC, brightness };
+    scratch.setModulation(modulationRate, modulationDepth);
+    scratch.setInterpolation(interpolation);
+    scratch.setDelayStorage(delayStorage, delayHeadroom);
+    scratch.prepare(sampleRate, samplesPerBlock);
+
+    const int blockLength { std::max(samplesPerBlock, 1) };
+    const int numBlocks { (minTimedSamples + blockLength - 1) / blockLength };
+    const double numTimedSamples { static_cast<double>(numBlocks) * static_cast<double>(blockLength) };
+
+    std::vector<SampleType> input(static_cast<size_t>(blockLength) * order);
+    std::vector<SampleType> output(order);
+    std::minstd_rand random { seed };
+    std::uniform_real_distribution<SampleType> noise { SampleType { -1 }, SampleType { 1 } };
+    for (auto& sample : input)
+        sample = noise(random);
+
+    // Interleaved rounds, so that a frequency change or an interruption hits all candidates alike.
+    // The fastest round of each candidate is its time
+    std::vector<double> fastest(candidates.size(), std::numeric_limits<double>::max());
+    for (uint32_t round = 0; round <= tuningRounds; ++round)
+    {
+        for (size_t c = 0; c < candidates.size(); ++c)
+        {
+            scratch.setInstructionSet(candidates[c]);
+
+            const auto start { std::chrono::steady_clock::now() };
+            for (int block = 0; block < numBlocks; ++block)
+            {
+                scratch.update();
+                for (int n = 0; n < blockLength; ++n)
+                    scratch.process(output.data(), input.data() + static_cast<size_t>(n) * order, order);
+            }
+            const std::chrono::duration<double, std::nano> elapsed { std::chrono::steady_clock::now() - start };
+
+            // Round 0 warms up the caches and the branch predictors
+            if (round > 0u)
+                fastest[c] = std::min(fastest[c], elapsed.count() / numTimedSamples);
+        }
+    }
+
+    const size_t activeIndex { static_cast<size_t>(std::find(candidates.begin(), candidates.end(), active) - candidates.begin()) };
+    size_t best { activeIndex };
+    for (size_t c = 0; c < candidates.size(); ++c)
+    {
+        if (fastest[c] < fastest[best] * tuningMargin)
+            best = c;
+    }
+
+    decision.instructionSet = candidates[best];
+    decision.nanosecondsPerSample = fastest[best];
+    return decision;
+}
+
+template <typename SampleType>
+void FDN<SampleType>::prepare(double newSampleRate, int samplesPerBlock)
 {
     jassert(newSampleRate > 0.0 && "Sample rate must be greater than zero");
     sampleRate = newSampleRate;
+    maxBlockSize = static_cast<size_t>(std::max(samplesPerBlock, 1));
 
     // Prepare delay lines
     delayLines->prepare(this->sampleRate, samplesPerBlock);
 
     // Prepare absorption filters
-    absorptionMagnitudeValues = computeAbsorptionMagValues(
-        this->T60DC,
-        this->brightness,
-        this->sampleRate
-    );
-    absorptionFilters->setFiltersMagnitudeValues(absorptionMagnitudeValues);
+    updateAbsorption();
     absorptionFilters->prepare(this->sampleRate, samplesPerBlock);
+
+    // Prepare feedback matrix rotations
+    feedbackMatrix.prepareModulation(this->sampleRate);
+
+    if (autoTuning)
+        tune(samplesPerBlock);
 }
 
-void FDN::clear()
+template <typename SampleType>
+void FDN<SampleType>::clear()
 {   
     // Clear fdn state
-    std::fill(feedbackState.begin(), feedbackState.end(), 0.f);
-    // Clear delay lines
+    std::fill(feedbackState.begin(), feedbackState.end(), SampleType { 0 });
+    // Clear delay lines, and the grown ones being filled, which start again
     delayLines->clear();
+    if (migratingDelayLines != nullptr)
+        migratingDelayLines->clear();
     // Clear absorption filters
     absorptionFilters->clear();
 }
 
-void FDN::process(float* output, const float* input, uint32_t numChannels)
+template <typename SampleType>
+void FDN<SampleType>::update()
+{
+    DSP_TRACE_SCOPE("FDN::update");
+    bool capacityChanged { false };
+
+    // Take the grown delay memory once the previously retired one has been freed, and copy the history into it
+    // a bounded part per block, while the current lines keep processing: then adopt it
+    if (migratingDelayLines == nullptr && retiredDelayLines.load(std::memory_order_acquire) == nullptr)
+        migratingDelayLines.reset(pendingDelayLines.exchange(nullptr, std::memory_order_acq_rel));
+    if (migratingDelayLines != nullptr && migratingDelayLines->migrateStateFrom(*delayLines, maxBlockSize))
+    {
+        retiredDelayLines.store(delayLines.release(), std::memory_order_release);
+        delayLines = std::move(migratingDelayLines);
+        capacityChanged = true;
+    }
+
+    // Jump to the new delay lengths with a crossfade, not a pitch glide
+    const SampleType roomSize { targetRoomSize.load(std::memory_order_relaxed) };
+    if (roomSize != currentRoomSize || capacityChanged)
+    {
+        currentRoomSize = roomSize;
+        scaleDelayLengths(currentRoomSize);
+        delayLines->crossfadeDelayLinesLengths(delayLengths);
+        updateAbsorption();
+    }
+}
+
+template <typename SampleType>
+void FDN<SampleType>::process(SampleType* output, const SampleType* input, uint32_t numChannels)
 {
     jassert(numChannels == order && "Number of channels must match FDN order");
 
@@ -180,4 +646,9 @@ void FDN::process(float* output, const float* input, uint32_t numChannels)
     feedbackMatrix.processSample(feedbackState.data(), output, order, order);
 }
 
+// =============================================
+
+template class FDN<float>;
+template class FDN<double>;
+
 }
\ No newline at end of file
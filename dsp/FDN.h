@@ -1,25 +1,51 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <type_traits>
 
 #include <JuceHeader.h>
 #include <Eigen/Dense>
 
 
 #include "Matrix.h"
+#include "MemoryFootprint.h"
 #include "MultichannelDelay.h"
 #include "MultichannelAbsorption.h"
+#include "TopologySnapshot.h"
+#include "TuningCache.h"
 
 namespace DSP
 {
 
+// Heap memory of an FDN, by part
+struct FDNMemoryFootprint
+{
+    utils::MemoryFootprint delayLines;      // with a grown set not adopted yet, or a retired one not freed yet
+    utils::MemoryFootprint absorption;
+    utils::MemoryFootprint feedbackMatrix;
+    utils::MemoryFootprint state;           // feedback state, delay lengths and absorption magnitudes
+
+    utils::MemoryFootprint getTotal() const;
+
+    FDNMemoryFootprint& operator+=(const FDNMemoryFootprint& other);
+};
+
+template <typename SampleType>
 class FDN
 {
 public:
     FDN(
         uint32_t initOrder,
-        float initT60DC,
-        float initBrightness
+        SampleType initT60DC,
+        SampleType initBrightness,
+        uint32_t initSeed = 0u
+    );
+    // FDN of a stored topology, restored without generating it
+    FDN(
+        const FDNSnapshot& snapshot,
+        SampleType initT60DC,
+        SampleType initBrightness
     );
     ~FDN();
 
@@ -38,30 +64,89 @@ public:
 
     // Constants
     static constexpr uint32_t possibleOrders[] = { 2u, 4u, 8u, 16u, 32u, 64u };
+    // Range of the generated delay lengths, in samples, before the room size scales them
+    static constexpr uint32_t minBaseDelay { 300u };
+    static constexpr uint32_t maxBaseDelay { 2600u };
 
     // =============================================
 
     // Check if the order is valid
     static uint32_t checkOrder(uint32_t order);
 
+    // Topology
+    // Seed of the delay lengths and of the feedback matrix. Equal seeds give equal sound
+    uint32_t getSeed() const;
+    // Store the delay lengths and the feedback matrix
+    FDNSnapshot getSnapshot() const;
+    // Restore a stored topology without generating it again. Reallocates: not for the audio thread
+    void setSnapshot(const FDNSnapshot& snapshot);
+
     // Delay Lines
     // Compute the delay line lengths
     std::vector<size_t> computeDelayLengths();
-    // Compute the maximum delay lengths for the delay lines
-    std::vector<size_t> computeMaxDelayLinesLengths();
-    // Set the delay lines lengths
-    // void setDelayLinesLengths(const std::vector<size_t>& newDelayLinesLengths);
+    // Compute the maximum delay lengths for the delay lines, for a given room size
+    std::vector<size_t> computeMaxDelayLinesLengths(SampleType roomSize = SampleType { 1 });
+
+    // Room size: scales the delay lengths of the topology
+    // Set the room size. Audio-thread safe: lengths exceeding the reserved memory are clamped until reserveRoomSize has run
+    void setRoomSize(SampleType newRoomSize);
+    SampleType getRoomSize() const;
+    // Grow the delay memory for the requested room size and hand it over to the audio thread.
+    // Also frees the memory the audio thread retired. Allocates: message thread only, call periodically
+    void reserveRoomSize();
+    // Allocate the delay memory for room sizes up to maxRoomSize at once, so that it never grows while playing.
+    // Keeps the delay histories. Reallocates: not while processing
+    void setMaxRoomSize(SampleType maxRoomSize);
 
     // Absorption Filters
     // Compute the absorption filters' magnitude values
-    std::vector<std::pair<float, float>> computeAbsorptionMagValues(
-        float T60DC,
-        float brightness,
+    std::vector<std::pair<SampleType, SampleType>> computeAbsorptionMagValues(
+        SampleType T60DC,
+        SampleType brightness,
+        double sampleRate
+    );
+    // Absorption filter magnitudes at DC and Nyquist for one delay line
+    static std::pair<SampleType, SampleType> computeAbsorptionMagValue(
+        size_t delayLength,
+        SampleType T60DC,
+        SampleType brightness,
         double sampleRate
     );
     // Set the reverberation time at DC and brightness
-    void setT60(float newT60DC);
-    void setBrightness(float newBrightness);
+    void setT60(SampleType newT60DC);
+    void setBrightness(SampleType newBrightness);
+
+    // Feedback matrix modulation: rate in Hz and maximum rotation angle in radians (0 keeps the matrix static)
+    void setModulation(SampleType newRateHz, SampleType newDepth);
+
+    // Cost reduction, for CPU pressure. Audio-thread safe
+    // Advance the absorption ramps and the matrix rotations at control rate instead of every sample
+    void setControlRateSmoothing(bool shouldUseControlRate);
+    // Read interpolation of the delay lines
+    void setInterpolation(primitives::Interpolation newInterpolation);
+
+    // Kernels
+    // Run the matrix and absorption kernels of a supported instruction set instead of the active one. Not while processing
+    void setInstructionSet(InstructionSet newInstructionSet);
+    // Let prepare measure the kernel variants at the sample rate and block size, and keep the fastest.
+    // Decisions are cached per CPU model (TuningCache). Off by default, applies from the next prepare
+    void setAutoTuning(bool shouldAutoTune);
+    // Outcome of the last tuning, for diagnostics. Message thread
+    TuningDecision getTuning() const;
+    // Run the kernels of a decision taken for the same configuration by another FDN, rather than measuring again.
+    // Not while processing
+    void setTuning(const TuningDecision& decision);
+
+    // Memory
+    // Pass the memory the audio thread works on to a visitor: delay lines, absorption, matrix and state
+    void visitMemory(const utils::MemoryVisitor& visitor) const;
+    // Heap memory of each part, to size orders and room sizes against a RAM budget. Not while processing
+    FDNMemoryFootprint getMemoryFootprint() const;
+    // Sample format of the delay memory, and the largest magnitude of fixed16. The 16-bit formats halve the delay
+    // memory and its bandwidth; the feedback state and the matrix stay in the sample type.
+    // Converts the delay histories. Reallocates: not while processing
+    void setDelayStorage(primitives::DelayStorage newStorage, float newHeadroom = primitives::DelayLine<SampleType>::defaultHeadroom);
+    primitives::DelayStorage getDelayStorage() const;
 
     // =============================================
 
@@ -71,28 +156,81 @@ public:
     // Clear contents
     void clear();
 
+    // Apply pending reconfigurations (grown delay memory, room size). Call on the audio thread once per block, before process
+    void update();
+
     // Process audio
-    void process(float* output, const float* input, uint32_t numChannels);
+    void process(SampleType* output, const SampleType* input, uint32_t numChannels);
     
     // =============================================
 
 private:
+    // Allocate the delay lines, absorption and state of the topology's delay lengths
+    void initialize(SampleType initT60DC, SampleType initBrightness);
+    // Recompute the absorption of the current delay lengths in place, without allocating
+    void updateAbsorption();
+    // Scale the topology's delay lengths by the room size, within the current delay memory
+    void scaleDelayLengths(SampleType roomSize);
+    // Pick the instruction set of this configuration, from the cache or by measuring it
+    void tune(int samplesPerBlock);
+    // Time the candidate instruction sets on a scratch FDN of the same configuration
+    TuningDecision measureInstructionSets(int samplesPerBlock) const;
+
+    // =============================================
+
     double sampleRate { 48000.0 };
 
     uint32_t order;
+    uint32_t seed;
 
+    // Delay lengths of the topology, and the ones in use (scaled by the room size)
+    std::vector<size_t> baseDelayLengths;
     std::vector<size_t> delayLengths;
+    // Delay memory reserved by the message thread
     std::vector<size_t> maxDelayLengths;
-    std::unique_ptr<DSP::MultichannelDelay> delayLines;
+    std::unique_ptr<DSP::MultichannelDelay<SampleType>> delayLines;
+
+    // Room size requested by setRoomSize, applied by update, and reserved by reserveRoomSize
+    std::atomic<SampleType> targetRoomSize { SampleType { 1 } };
+    SampleType currentRoomSize { SampleType { 1 } };
+    SampleType reservedRoomSize { SampleType { 1 } };
+    // Hand-over of grown delay memory: message thread -> audio thread, and retired memory back
+    std::atomic<DSP::MultichannelDelay<SampleType>*> pendingDelayLines { nullptr };
+    std::atomic<DSP::MultichannelDelay<SampleType>*> retiredDelayLines { nullptr };
+    // Grown delay memory the audio thread fills with the history over a few blocks before adopting it
+    std::unique_ptr<DSP::MultichannelDelay<SampleType>> migratingDelayLines;
+    // Longest block processed between two updates, which bounds each step of the migration
+    size_t maxBlockSize { 512u };
     // TODO: store max time variation for delay lines
-
-    DSP::Matrix feedbackMatrix;
-    std::vector<float> feedbackState;
-
-    float T60DC;
-    float brightness;
-    std::vector<std::pair<float, float>> absorptionMagnitudeValues;
-    std::unique_ptr<DSP::MultichannelAbsorption> absorptionFilters;
+    // Read interpolation of the delay lines, kept for the lines setSnapshot creates
+    primitives::Interpolation interpolation { primitives::Interpolation::linear };
+    // Delay storage of the lines the FDN creates
+    primitives::DelayStorage delayStorage { primitives::DelayStorage::float32 };
+    float delayHeadroom { primitives::DelayLine<SampleType>::defaultHeadroom };
+
+    DSP::Matrix<SampleType> feedbackMatrix;
+    std::vector<SampleType> feedbackState;
+    // Kept for the scratch FDN of the tuning
+    SampleType modulationRate { 0 };
+    SampleType modulationDepth { 0 };
+
+    SampleType T60DC;
+    SampleType brightness;
+    std::vector<std::pair<SampleType, SampleType>> absorptionMagnitudeValues;
+    std::unique_ptr<DSP::MultichannelAbsorption<SampleType>> absorptionFilters;
+
+    bool autoTuning { false };
+    TuningDecision tuning;
+
+    // Absorption ramp interval when smoothing at control rate, the same as the matrix rotations
+    static constexpr uint32_t controlInterval { 32u };
+    // Tuning: timed rounds per candidate after a warm-up one, and the least samples per timing
+    static constexpr uint32_t tuningRounds { 7u };
+    static constexpr int minTimedSamples { 256 };
+    // A candidate replaces the active instruction set only when it is faster by this factor, so that timing noise does not flip the decision
+    static constexpr double tuningMargin { 0.97 };
+
+    static_assert(std::is_floating_point_v<SampleType>, "FDN requires a floating-point sample type");
 };
 
 }
\ No newline at end of file
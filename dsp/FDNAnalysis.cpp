@@ -0,0 +1,255 @@
+#include "FDNAnalysis.h"
+#include "FDN.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace DSP
+{
+
+namespace
+{
+    // Lines of delay-line inputs along time, so that each line reads its history contiguously
+    using LineHistory = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+    // Octave band-pass (RBJ, 0 dB peak gain, Q = sqrt(2)), transposed direct form II
+    void bandPass(double* samples, size_t numSamples, double centerFrequency, double sampleRate)
+    {
+        const double w0 { juce::MathConstants<double>::twoPi * centerFrequency / sampleRate };
+        const double alpha { std::sin(w0) / (2.0 * juce::MathConstants<double>::sqrt2) };
+        const double a0 { 1.0 + alpha };
+        const double b0 { alpha / a0 };
+        const double b2 { -alpha / a0 };
+        const double a1 { -2.0 * std::cos(w0) / a0 };
+        const double a2 { (1.0 - alpha) / a0 };
+
+        double z1 { 0.0 };
+        double z2 { 0.0 };
+        for (size_t n = 0; n < numSamples; ++n)
+        {
+            const double input { samples[n] };
+            const double output { b0 * input + z1 };
+            z1 = -a1 * output + z2;
+            z2 = b2 * input - a2 * output;
+            samples[n] = output;
+        }
+    }
+}
+
+// =============================================
+
+FDNAnalysis::FDNAnalysis(const FDNSnapshot& snapshot, double initT60DC, double initBrightness, double initSampleRate, double initRoomSize /*= 1.0*/) :
+    order { snapshot.order },
+    sampleRate { initSampleRate }
+{
+    jassert(snapshot.isValid() && "FDN snapshot is inconsistent");
+    jassert(sampleRate > 0.0 && "Sample rate must be greater than zero");
+    jassert(initRoomSize > 0.0 && "Room size must be greater than zero");
+
+    delayLengths.reserve(order);
+    b0Values.resize(order);
+    a1Values.resize(order);
+    for (uint32_t i = 0; i < order; ++i)
+    {
+        // As FDN::scaleDelayLengths, with all the delay memory the room size needs
+        const double scaledLength { std::round(static_cast<double>(snapshot.delayLengths[i]) * initRoomSize) };
+        delayLengths.push_back(std::max(static_cast<size_t>(scaledLength), size_t { 1u }));
+
+        // As OnePoleFilter
+        const auto [magDC, magNY] = FDN<double>::computeAbsorptionMagValue(delayLengths.back(), initT60DC, initBrightness, sampleRate);
+        const double r { magDC / magNY };
+        a1Values[i] = (1.0 - r) / (1.0 + r);
+        b0Values[i] = (1.0 - a1Values[i]) * magNY;
+    }
+    blockLength = *std::min_element(delayLengths.begin(), delayLengths.end());
+
+    feedbackMatrix = Eigen::Map<const Eigen::MatrixXd>(snapshot.feedbackMatrix.coefficients.data(), order, order);
+    inputCoupling = Eigen::MatrixXd::Ones(order, 1);
+    outputCoupling = Eigen::MatrixXd::Ones(1, order);
+}
+
+void FDNAnalysis::setCoupling(const MatrixSnapshot& newInputCoupling, const MatrixSnapshot& newOutputCoupling)
+{
+    jassert(newInputCoupling.isValid() && newOutputCoupling.isValid() && "Matrix snapshot is inconsistent");
+    jassert(newInputCoupling.dim1 == static_cast<int>(order) && newOutputCoupling.dim2 == static_cast<int>(order) && "Couplings must match the FDN order");
+
+    inputCoupling = Eigen::Map<const Eigen::MatrixXd>(newInputCoupling.coefficients.data(), newInputCoupling.dim1, newInputCoupling.dim2);
+    outputCoupling = Eigen::Map<const Eigen::MatrixXd>(newOutputCoupling.coefficients.data(), newOutputCoupling.dim1, newOutputCoupling.dim2);
+}
+
+uint32_t FDNAnalysis::getOrder() const
+{
+    return order;
+}
+
+int FDNAnalysis::getNumOutputChannels() const
+{
+    return static_cast<int>(outputCoupling.rows());
+}
+
+// =============================================
+
+Eigen::MatrixXd FDNAnalysis::computeImpulseResponse(uint32_t numSamples, int inputChannel /*= 0*/) const
+{
+    DSP_TRACE_SCOPE("FDNAnalysis::computeImpulseResponse");
+    jassert(inputChannel >= 0 && inputChannel < inputCoupling.cols() && "Input channel out of range");
+
+    const Eigen::Index numLines { static_cast<Eigen::Index>(order) };
+    Eigen::MatrixXd response(outputCoupling.rows(), static_cast<Eigen::Index>(numSamples));
+
+    // Inputs of the delay lines, s[n] = x[n] + M y[n - 1], in a ring that holds the longest delay and a block
+    const size_t maxDelay { *std::max_element(delayLengths.begin(), delayLengths.end()) };
+    size_t ringSize { 1u };
+    while (ringSize < maxDelay + blockLength)
+        ringSize <<= 1u;
+    const size_t ringMask { ringSize - 1u };
+    LineHistory lineInputs { LineHistory::Zero(numLines, static_cast<Eigen::Index>(ringSize)) };
+
+    // Absorbed outputs of the lines, y[n], after the last output of the previous block in the first column
+    Eigen::MatrixXd outputs { Eigen::MatrixXd::Zero(numLines, static_cast<Eigen::Index>(blockLength) + 1) };
+    Eigen::MatrixXd feedback(numLines, static_cast<Eigen::Index>(blockLength));
+
+    for (size_t start = 0; start < numSamples; start += blockLength)
+    {
+        const size_t length { std::min(blockLength, static_cast<size_t>(numSamples) - start) };
+        const Eigen::Index blockSize { static_cast<Eigen::Index>(length) };
+
+        // Delayed and absorbed: y_i[n] = H_i(s_i[n - L_i]), read from before the block as L_i >= blockLength
+        for (Eigen::Index i = 0; i < numLines; ++i)
+        {
+            const double* history { lineInputs.row(i).data() };
+            const double b0 { b0Values[i] };
+            const double a1 { a1Values[i] };
+            size_t readIndex { (start + ringSize - delayLengths[static_cast<size_t>(i)]) & ringMask };
+            double state { outputs(i, 0) };
+            for (Eigen::Index n = 1; n <= blockSize; ++n)
+            {
+                state = b0 * history[readIndex] - a1 * state;
+                outputs(i, n) = state;
+                readIndex = (readIndex + 1u) & ringMask;
+            }
+        }
+
+        response.middleCols(static_cast<Eigen::Index>(start), blockSize).noalias() = outputCoupling * outputs.middleCols(1, blockSize);
+
+        // Feedback of the block, from the outputs one sample earlier
+        feedback.leftCols(blockSize).noalias() = feedbackMatrix * outputs.leftCols(blockSize);
+        if (start == 0u)
+            feedback.col(0) += inputCoupling.col(inputChannel);
+
+        const size_t writeIndex { start & ringMask };
+        const Eigen::Index firstPart { static_cast<Eigen::Index>(std::min(length, ringSize - writeIndex)) };
+        lineInputs.middleCols(static_cast<Eigen::Index>(writeIndex), firstPart) = feedback.leftCols(firstPart);
+        if (firstPart < blockSize)
+            lineInputs.leftCols(blockSize - firstPart) = feedback.middleCols(firstPart, blockSize - firstPart);
+
+        outputs.col(0) = outputs.col(blockSize);
+    }
+
+    return response;
+}
+
+double FDNAnalysis::getDesignT60(double frequency) const
+{
+    // Decay of each line in dB per sample: its filter's gain, once per pass through the line
+    const double cosine { std::cos(juce::MathConstants<double>::twoPi * frequency / sampleRate) };
+    double decayRate { 0.0 };
+    for (uint32_t i = 0; i < order; ++i)
+    {
+        const double a1 { a1Values[i] };
+        const double magnitude { b0Values[i] / std::sqrt(1.0 + a1 * a1 + 2.0 * a1 * cosine) };
+        decayRate += 20.0 * std::log10(magnitude) / static_cast<double>(delayLengths[i]);
+    }
+    decayRate /= static_cast<double>(order);
+
+    if (decayRate >= 0.0)
+        return std::numeric_limits<double>::infinity();
+    return -60.0 / (decayRate * sampleRate);
+}
+
+std::vector<BandDecay> FDNAnalysis::analyzeBands(const double* impulseResponse, size_t numSamples) const
+{
+    DSP_TRACE_SCOPE("FDNAnalysis::analyzeBands");
+    std::vector<BandDecay> bands;
+    std::vector<double> filtered(numSamples);
+
+    for (const double frequency : octaveBands)
+    {
+        if (frequency > 0.45 * sampleRate)
+            break;
+
+        // Two passes: 4th order, so that the neighboring bands do not dominate the late decay
+        std::copy(impulseResponse, impulseResponse + numSamples, filtered.begin());
+        bandPass(filtered.data(), numSamples, frequency, sampleRate);
+        bandPass(filtered.data(), numSamples, frequency, sampleRate);
+
+        BandDecay band;
+        band.centerFrequency = frequency;
+        band.t60 = estimateT60(computeEnergyDecay(filtered.data(), numSamples), sampleRate);
+        band.designT60 = getDesignT60(frequency);
+        bands.push_back(band);
+    }
+    return bands;
+}
+
+// =============================================
+
+std::vector<double> FDNAnalysis::computeEnergyDecay(const double* impulseResponse, size_t numSamples)
+{
+    std::vector<double> energyDecay(numSamples);
+
+    // Energy left after each sample, summed from the end
+    double remaining { 0.0 };
+    for (size_t n = numSamples; n-- > 0u;)
+    {
+        remaining += impulseResponse[n] * impulseResponse[n];
+        energyDecay[n] = remaining;
+    }
+
+    const double total { remaining };
+    for (double& energy : energyDecay)
+        energy = total > 0.0 && energy > 0.0 ? 10.0 * std::log10(energy / total) : -std::numeric_limits<double>::infinity();
+    return energyDecay;
+}
+
+double FDNAnalysis::estimateT60(const std::vector<double>& energyDecayDb, double sampleRate, double startDb /*= -5.0*/, double endDb /*= -35.0*/)
+{
+    jassert(endDb < startDb && "The fit must end below its start");
+
+    const auto first { std::find_if(energyDecayDb.begin(), energyDecayDb.end(), [startDb](double level) { return level <= startDb; }) };
+    const auto last { std::find_if(first, energyDecayDb.end(), [endDb](double level) { return level <= endDb; }) };
+    if (last == energyDecayDb.end())
+        return 0.0;
+
+    // Least-squares line through the curve between the two levels
+    const size_t begin { static_cast<size_t>(first - energyDecayDb.begin()) };
+    const size_t end { static_cast<size_t>(last - energyDecayDb.begin()) + 1u };
+    const double count { static_cast<double>(end - begin) };
+    double meanTime { 0.0 };
+    double meanLevel { 0.0 };
+    for (size_t n = begin; n < end; ++n)
+    {
+        meanTime += static_cast<double>(n);
+        meanLevel += energyDecayDb[n];
+    }
+    meanTime /= count;
+    meanLevel /= count;
+
+    double covariance { 0.0 };
+    double variance { 0.0 };
+    for (size_t n = begin; n < end; ++n)
+    {
+        const double time { static_cast<double>(n) - meanTime };
+        covariance += time * (energyDecayDb[n] - meanLevel);
+        variance += time * time;
+    }
+    if (variance <= 0.0 || covariance >= 0.0)
+        return 0.0;
+
+    // Slope in dB per sample
+    return -60.0 * variance / (covariance * sampleRate);
+}
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <JuceHeader.h>
+#include <Eigen/Dense>
+
+#include "TopologySnapshot.h"
+
+namespace DSP
+{
+
+// Reverberation time of one frequency band
+struct BandDecay
+{
+    double centerFrequency { 0.0 };
+    double t60 { 0.0 };         // fitted on the energy decay curve, in seconds; 0 if the fit range was not reached
+    double designT60 { 0.0 };   // the absorption filters are designed for
+};
+
+// Offline analysis of a static FDN (unmodulated matrix, fixed room size): impulse response, energy decay curve
+// and octave-band T60, computed from the topology instead of rendering FDN::process sample by sample.
+// The delay lines are at least as long as the shortest one, so a whole block of that length reads only samples
+// written before it: the blocks run the absorption filters line by line, and the feedback and output matrices
+// as products with the block (GEMM). Double precision, as the coefficients of FDN<double>, so that the response
+// matches it
+class FDNAnalysis
+{
+public:
+    // Topology and decay of the FDN, as FDN::setSnapshot, setT60, setBrightness, setRoomSize and prepare set them
+    FDNAnalysis(
+        const FDNSnapshot& snapshot,
+        double initT60DC,
+        double initBrightness,
+        double initSampleRate,
+        double initRoomSize = 1.0
+    );
+
+    // =============================================
+
+    // Octave bands of analyzeBands
+    static constexpr double octaveBands[] = { 125.0, 250.0, 500.0, 1000.0, 2000.0, 4000.0, 8000.0 };
+
+    // Couplings between the channels and the delay lines (order x numInputChannels and numOutputChannels x order),
+    // as in TVFDN. Without them, every line is fed and summed with unit gain
+    void setCoupling(const MatrixSnapshot& inputCoupling, const MatrixSnapshot& outputCoupling);
+
+    uint32_t getOrder() const;
+    int getNumOutputChannels() const;
+
+    // Impulse response of an input channel, one row per output channel
+    Eigen::MatrixXd computeImpulseResponse(uint32_t numSamples, int inputChannel = 0) const;
+
+    // T60 the absorption filters give at a frequency, from their decay rates averaged over the delay lines
+    double getDesignT60(double frequency) const;
+
+    // T60 of each octave band below 0.45 times the sample rate: the response is band-passed (4th order),
+    // integrated backwards and fitted from -5 to -35 dB (T30). Give at least the expected T60 of response
+    std::vector<BandDecay> analyzeBands(const double* impulseResponse, size_t numSamples) const;
+
+    // =============================================
+
+    // Energy decay curve (Schroeder backward integration), in dB relative to the total energy
+    static std::vector<double> computeEnergyDecay(const double* impulseResponse, size_t numSamples);
+
+    // T60 of a linear fit of an energy decay curve between two levels, extrapolated to -60 dB.
+    // Returns 0 if the curve does not reach the end level
+    static double estimateT60(const std::vector<double>& energyDecayDb, double sampleRate, double startDb = -5.0, double endDb = -35.0);
+
+private:
+    uint32_t order;
+    double sampleRate;
+
+    // Delay lengths scaled by the room size, and the shortest one: the block length
+    std::vector<size_t> delayLengths;
+    size_t blockLength;
+
+    Eigen::MatrixXd feedbackMatrix;
+    Eigen::MatrixXd inputCoupling;
+    Eigen::MatrixXd outputCoupling;
+
+    // Absorption filter of each line: y = b0 * x - a1 * y[n - 1]
+    Eigen::VectorXd b0Values;
+    Eigen::VectorXd a1Values;
+};
+
+}
@@ -0,0 +1,238 @@
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if DSP_KERNELS_X86
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <cpuid.h>
+    #endif
+#endif
+
+#include "KernelDispatch.h"
+
+namespace DSP
+{
+
+namespace
+{
+#if DSP_KERNELS_X86
+    struct CpuidRegisters
+    {
+        uint32_t eax { 0u };
+        uint32_t ebx { 0u };
+        uint32_t ecx { 0u };
+        uint32_t edx { 0u };
+    };
+
+    CpuidRegisters cpuid(uint32_t leaf, uint32_t subleaf)
+    {
+        CpuidRegisters registers;
+    #if defined(_MSC_VER)
+        int values[4];
+        __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+        registers.eax = static_cast<uint32_t>(values[0]);
+        registers.ebx = static_cast<uint32_t>(values[1]);
+        registers.ecx = static_cast<uint32_t>(values[2]);
+        registers.edx = static_cast<uint32_t>(values[3]);
+    #else
+        __cpuid_count(leaf, subleaf, registers.eax, registers.ebx, registers.ecx, registers.edx);
+    #endif
+        return registers;
+    }
+
+    // Register state the OS saves on context switches (XCR0)
+    uint64_t getSavedRegisterState()
+    {
+    #if defined(_MSC_VER)
+        return _xgetbv(0);
+    #else
+        uint32_t low { 0u };
+        uint32_t high { 0u };
+        __asm__ volatile ("xgetbv" : "=a" (low), "=d" (high) : "c" (0));
+        return (static_cast<uint64_t>(high) << 32) | low;
+    #endif
+    }
+
+    std::string readCpuName()
+    {
+        char brand[49] {};
+        if (cpuid(0x80000000u, 0u).eax < 0x80000004u)
+            return "x86";
+        for (uint32_t i = 0; i < 3u; ++i)
+        {
+            const CpuidRegisters registers { cpuid(0x80000002u + i, 0u) };
+            std::memcpy(brand + 16u * i, &registers, sizeof(registers));
+        }
+
+        // The brand string is padded with spaces
+        std::string name { brand };
+        const size_t first { name.find_first_not_of(' ') };
+        const size_t last { name.find_last_not_of(' ') };
+        return first == std::string::npos ? std::string { "x86" } : name.substr(first, last - first + 1u);
+    }
+
+    InstructionSet detectInstructionSet()
+    {
+        const uint32_t maxLeaf { cpuid(0u, 0u).eax };
+        const CpuidRegisters features { cpuid(1u, 0u) };
+        const CpuidRegisters extendedFeatures { maxLeaf >= 7u ? cpuid(7u, 0u) : CpuidRegisters {} };
+
+        const bool hasSSE2 { (features.edx & (1u << 26)) != 0u };
+        const bool hasFMA { (features.ecx & (1u << 12)) != 0u };
+        const bool hasAVX { (features.ecx & (1u << 28)) != 0u };
+        const bool hasAVX2 { (extendedFeatures.ebx & (1u << 5)) != 0u };
+        const bool hasAVX512F { (extendedFeatures.ebx & (1u << 16)) != 0u };
+
+        // The wide registers are only usable if the OS saves them: OSXSAVE, then the XCR0 bits of
+        // the SSE and AVX state, and for AVX-512 of the opmask and upper ZMM state too
+        const bool hasOSXSAVE { (features.ecx & (1u << 27)) != 0u };
+        const uint64_t savedState { hasOSXSAVE ? getSavedRegisterState() : 0u };
+        const bool savesYMM { (savedState & 0x06u) == 0x06u };
+        const bool savesZMM { (savedState & 0xe6u) == 0xe6u };
+
+        if (hasAVX512F && hasAVX2 && hasFMA && savesZMM)
+            return InstructionSet::avx512;
+        if (hasAVX && hasAVX2 && hasFMA && savesYMM)
+            return InstructionSet::avx2;
+        if (hasSSE2)
+            return InstructionSet::sse2;
+        return InstructionSet::generic;
+    }
+#else
+    std::string readCpuName()
+    {
+        return "unknown";
+    }
+
+    InstructionSet detectInstructionSet()
+    {
+        return InstructionSet::generic;
+    }
+#endif
+
+    // The widest supported set at or below the requested one
+    InstructionSet clampToSupported(InstructionSet set)
+    {
+        const InstructionSet supported { KernelDispatch::getSupported() };
+        return static_cast<uint32_t>(set) > static_cast<uint32_t>(supported) ? supported : set;
+    }
+
+    // Active kernels, chosen at the first use
+    struct Selection
+    {
+        Selection()
+        {
+            InstructionSet set { KernelDispatch::getSupported() };
+            InstructionSet forced { InstructionSet::generic };
+            if (const char* name { std::getenv("DSP_INSTRUCTION_SET") }; name != nullptr && KernelDispatch::parseName(name, forced))
+                set = clampToSupported(forced);
+            select(set);
+        }
+
+        void select(InstructionSet set)
+        {
+            tables.store(&KernelDispatch::getTables(set), std::memory_order_release);
+            active.store(set, std::memory_order_relaxed);
+        }
+
+        std::atomic<const KernelTables*> tables { nullptr };
+        std::atomic<InstructionSet> active { InstructionSet::generic };
+    };
+
+    Selection& getSelection()
+    {
+        static Selection selection;
+        return selection;
+    }
+
+    constexpr const char* names[] { "generic", "sse2", "avx2", "avx512" };
+    static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(InstructionSet::numInstructionSets), "One name per instruction set");
+}
+
+// =============================================
+
+bool KernelDispatch::isSupported(InstructionSet set)
+{
+    return static_cast<uint32_t>(set) <= static_cast<uint32_t>(getSupported());
+}
+
+InstructionSet KernelDispatch::getSupported()
+{
+    static const InstructionSet supported { detectInstructionSet() };
+    return supported;
+}
+
+InstructionSet KernelDispatch::getActive()
+{
+    return getSelection().active.load(std::memory_order_relaxed);
+}
+
+InstructionSet KernelDispatch::setActive(InstructionSet set)
+{
+    const InstructionSet selected { clampToSupported(set) };
+    getSelection().select(selected);
+    return selected;
+}
+
+bool KernelDispatch::roundsAlike(InstructionSet a, InstructionSet b)
+{
+    const auto usesFMA = [](InstructionSet set) { return set == InstructionSet::avx2 || set == InstructionSet::avx512; };
+    return usesFMA(a) == usesFMA(b);
+}
+
+const char* KernelDispatch::getName(InstructionSet set)
+{
+    const uint32_t index { static_cast<uint32_t>(set) };
+    return index < static_cast<uint32_t>(InstructionSet::numInstructionSets) ? names[index] : "unknown";
+}
+
+bool KernelDispatch::parseName(const char* name, InstructionSet& set)
+{
+    for (uint32_t i = 0; i < static_cast<uint32_t>(InstructionSet::numInstructionSets); ++i)
+    {
+        if (std::strcmp(name, names[i]) == 0)
+        {
+            set = static_cast<InstructionSet>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* KernelDispatch::getCpuName()
+{
+    static const std::string name { readCpuName() };
+    return name.c_str();
+}
+
+// =============================================
+
+template <>
+const KernelTable<float>& KernelDispatch::getKernels<float>()
+{
+    return getSelection().tables.load(std::memory_order_acquire)->floatKernels;
+}
+
+template <>
+const KernelTable<double>& KernelDispatch::getKernels<double>()
+{
+    return getSelection().tables.load(std::memory_order_acquire)->doubleKernels;
+}
+
+const KernelTables& KernelDispatch::getTables(InstructionSet set)
+{
+    switch (set)
+    {
+#if DSP_KERNELS_X86
+        case InstructionSet::avx512: return kernels::getAVX512Tables();
+        case InstructionSet::avx2:   return kernels::getAVX2Tables();
+        case InstructionSet::sse2:   return kernels::getSSE2Tables();
+#endif
+        default:                     return kernels::getGenericTables();
+    }
+}
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+
+// Only <cstdint> here: the per-instruction-set units include this header, and any inline
+// function they compiled for a wider instruction set could be picked by the linker for all callers.
+
+namespace DSP
+{
+
+// Instruction sets the hot kernels are built for, from the narrowest
+enum class InstructionSet : uint32_t
+{
+    generic,    // portable C++, the compiler's baseline
+    sse2,
+    avx2,       // with FMA
+    avx512,     // AVX-512F
+    numInstructionSets
+};
+
+// Hot kernels of one sample type, all compiled for one instruction set
+template <typename SampleType>
+struct KernelTable
+{
+    // output = matrix * input, matrix column-major (numRows x numColumns). Output must not alias input
+    void (*multiplyMatrixVector)(SampleType* output, const SampleType* matrix, const SampleType* input, uint32_t numRows, uint32_t numColumns);
+
+    // Bank of one-pole filters, one per channel: output = b0 * input - a1 * state, then state = output.
+    // Output may alias input
+    void (*processOnePoleBank)(SampleType* output, const SampleType* input, const SampleType* b0, const SampleType* a1, SampleType* state, uint32_t numChannels);
+
+    // Linear interpolation between two delay taps: output = tap0 * fraction0 + tap1 * fraction1
+    void (*interpolateLinear)(SampleType* output, const SampleType* tap0, const SampleType* tap1, SampleType fraction0, SampleType fraction1, uint32_t numSamples);
+
+    // Gain ramps: data *= gain0 * gain1, the gains multiplied in single precision
+    void (*applyGains)(SampleType* data, const float* gain0, const float* gain1, uint32_t numSamples);
+
+    // Reduced-precision delay storage. To bfloat16, rounded to nearest even (double samples are rounded
+    // to single precision first), and back
+    void (*packBFloat16)(uint16_t* output, const SampleType* input, uint32_t numSamples);
+    void (*unpackBFloat16)(SampleType* output, const uint16_t* input, uint32_t numSamples);
+
+    // To 16-bit fixed point: output = input * inverseStep, saturated and rounded to nearest even, and back: output = input * step
+    void (*packFixed16)(int16_t* output, const SampleType* input, SampleType inverseStep, uint32_t numSamples);
+    void (*unpackFixed16)(SampleType* output, const int16_t* input, SampleType step, uint32_t numSamples);
+};
+
+// The kernels of both sample types for one instruction set
+struct KernelTables
+{
+    KernelTable<float> floatKernels;
+    KernelTable<double> doubleKernels;
+};
+
+// Defined by the KernelsXXX.cpp units, each compiled for its instruction set. Use KernelDispatch
+namespace kernels
+{
+    const KernelTables& getGenericTables();
+    const KernelTables& getSSE2Tables();
+    const KernelTables& getAVX2Tables();
+    const KernelTables& getAVX512Tables();
+}
+
+// =============================================
+
+// Run-time selection of the kernels: one binary runs the widest variant the CPU supports.
+// The instruction set is chosen once, at the first use, from cpuid (and the OS support of the
+// wide registers). The DSP_INSTRUCTION_SET environment variable (generic, sse2, avx2, avx512)
+// or setActive force a narrower one, for testing and benchmarks.
+class KernelDispatch
+{
+public:
+    // No instances
+    KernelDispatch() = delete;
+
+    // =============================================
+
+    // Whether this build has kernels for the set and the machine can run them
+    static bool isSupported(InstructionSet set);
+
+    // Widest supported instruction set
+    static InstructionSet getSupported();
+
+    // Instruction set of the kernels in use
+    static InstructionSet getActive();
+
+    // Use the kernels of an instruction set, or of the widest supported one below it. Returns the set in use.
+    // Thread safe, but the kernels of a running processor change between two calls: not while processing
+    static InstructionSet setActive(InstructionSet set);
+
+    // Whether two instruction sets give bit-identical results: the FMA ones (avx2, avx512) round the
+    // matrix product differently from the others
+    static bool roundsAlike(InstructionSet a, InstructionSet b);
+
+    // Lower-case name, as in DSP_INSTRUCTION_SET
+    static const char* getName(InstructionSet set);
+
+    // Instruction set of a name. Returns false if there is none
+    static bool parseName(const char* name, InstructionSet& set);
+
+    // Model name of the CPU (cpuid brand string on x86), to key what is measured on it
+    static const char* getCpuName();
+
+    // =============================================
+
+    // Kernels of the active instruction set. Real-time safe
+    template <typename SampleType>
+    static const KernelTable<SampleType>& getKernels();
+
+    // Kernels of a given instruction set, for objects that run other kernels than the active ones.
+    // The set must be supported
+    static const KernelTables& getTables(InstructionSet set);
+};
+
+template <>
+const KernelTable<float>& KernelDispatch::getKernels<float>();
+template <>
+const KernelTable<double>& KernelDispatch::getKernels<double>();
+
+}
@@ -0,0 +1,17 @@
+// AVX2 and FMA kernels. Built with -mavx2 -mfma -ffp-contract=off (/arch:AVX2), only called on CPUs that have both
+#include "KernelsImpl.h"
+
+#if ! defined(__AVX2__)
+    #error "KernelsAVX2.cpp must be compiled with AVX2 enabled"
+#endif
+
+namespace DSP::kernels
+{
+
+const KernelTables& getAVX2Tables()
+{
+    static const KernelTables tables { makeKernelTables<Float8, Double4>() };
+    return tables;
+}
+
+}
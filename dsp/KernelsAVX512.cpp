@@ -0,0 +1,17 @@
+// AVX-512F kernels. Built with -mavx512f -mfma -ffp-contract=off (/arch:AVX512), only called on CPUs and OSes that support it
+#include "KernelsImpl.h"
+
+#if ! defined(__AVX512F__)
+    #error "KernelsAVX512.cpp must be compiled with AVX-512F enabled"
+#endif
+
+namespace DSP::kernels
+{
+
+const KernelTables& getAVX512Tables()
+{
+    static const KernelTables tables { makeKernelTables<Float16, Double8>() };
+    return tables;
+}
+
+}
@@ -0,0 +1,13 @@
+// Portable kernels, for the baseline instruction set of the build (and the only ones off x86-64)
+#include "KernelsImpl.h"
+
+namespace DSP::kernels
+{
+
+const KernelTables& getGenericTables()
+{
+    static const KernelTables tables { makeKernelTables<ScalarBatch<float>, ScalarBatch<double>>() };
+    return tables;
+}
+
+}
@@ -0,0 +1,551 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(__AVX2__) || defined(__AVX512F__)
+    // GCC 12 reports the _mm512_undefined_* sources of its AVX-512 intrinsics as maybe uninitialized
+    // wherever they are inlined (GCC bug 105593): a false positive, silenced for the header alone
+    #if defined(__GNUC__) && ! defined(__clang__)
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+        #include <immintrin.h>
+        #pragma GCC diagnostic pop
+    #else
+        #include <immintrin.h>
+    #endif
+#endif
+
+#include "KernelDispatch.h"
+
+// Kernel algorithms, written once over batches of SIMD lanes. Included only by the KernelsXXX.cpp
+// units: each compiles them for one instruction set, with the batches its compiler flags enable.
+// Everything is in an anonymous namespace and the standard library stays out (but for memcpy, a C
+// function), so that no function compiled for a wide instruction set is shared with, and picked by
+// the linker for, other units.
+//
+// A batch holds `width` samples and provides zero, broadcast, load, loadFloatProduct (two single-precision
+// values multiplied, then converted to the sample type), store, add, sub, mul and mulAdd (a * b + c, fused
+// where the instruction set can).
+// For the delay storage it also converts from and to 16 bits: loadBFloat16 and storeBFloat16 (bfloat16,
+// rounded to nearest even), loadInt16 and storeInt16 (integers, saturated and rounded to nearest even).
+// Its Half is the batch of half the width the remainder of a row is processed with, down to scalars.
+// Only mulAdd may round differently from the scalar code: the other kernels are bit-exact.
+
+namespace DSP
+{
+namespace
+{
+
+// bfloat16 bits of a single-precision value, rounded to nearest even
+uint16_t toBFloat16(float x)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    bits += 0x7FFFu + ((bits >> 16) & 1u);
+    return static_cast<uint16_t>(bits >> 16);
+}
+
+float fromBFloat16(uint16_t x)
+{
+    const uint32_t bits { static_cast<uint32_t>(x) << 16 };
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+// Rounded to the nearest integer, ties to even, as the SIMD conversions in the default rounding mode.
+// Adding and subtracting 1.5 * 2^mantissa leaves no fraction bits, for |x| < 2^(mantissa - 1)
+template <typename Type>
+Type roundToInteger(Type x)
+{
+    constexpr Type magic { sizeof(Type) == sizeof(float) ? Type { 12582912.0f } : Type { 6755399441055744.0 } };
+    return (x + magic) - magic;
+}
+
+// 16-bit integer of a sample, saturated (NaN to the minimum, as the SIMD max) and rounded
+template <typename Type>
+int16_t toInt16(Type x)
+{
+    x = x > Type { -32768 } ? x : Type { -32768 };
+    x = x < Type { 32767 } ? x : Type { 32767 };
+    return static_cast<int16_t>(roundToInteger(x));
+}
+
+//================================================
+
+template <typename Type>
+struct ScalarBatch
+{
+    using SampleType = Type;
+    static constexpr uint32_t width { 1u };
+
+    static ScalarBatch zero() { return { Type { 0 } }; }
+    static ScalarBatch broadcast(Type x) { return { x }; }
+    static ScalarBatch load(const Type* data) { return { *data }; }
+    static ScalarBatch loadFloatProduct(const float* a, const float* b) { return { static_cast<Type>(*a * *b) }; }
+    void store(Type* data) const { *data = value; }
+
+    static ScalarBatch add(ScalarBatch a, ScalarBatch b) { return { a.value + b.value }; }
+    static ScalarBatch sub(ScalarBatch a, ScalarBatch b) { return { a.value - b.value }; }
+    static ScalarBatch mul(ScalarBatch a, ScalarBatch b) { return { a.value * b.value }; }
+    static ScalarBatch mulAdd(ScalarBatch a, ScalarBatch b, ScalarBatch c) { return { a.value * b.value + c.value }; }
+
+    static ScalarBatch loadBFloat16(const uint16_t* data) { return { static_cast<Type>(fromBFloat16(*data)) }; }
+    void storeBFloat16(uint16_t* data) const { *data = toBFloat16(static_cast<float>(value)); }
+    static ScalarBatch loadInt16(const int16_t* data) { return { static_cast<Type>(*data) }; }
+    void storeInt16(int16_t* data) const { *data = toInt16(value); }
+
+    Type value;
+};
+
+//================================================
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(__AVX2__) || defined(__AVX512F__)
+
+struct Float4
+{
+    using SampleType = float;
+    using Half = ScalarBatch<float>;
+    static constexpr uint32_t width { 4u };
+
+    static Float4 zero() { return { _mm_setzero_ps() }; }
+    static Float4 broadcast(float x) { return { _mm_set1_ps(x) }; }
+    static Float4 load(const float* data) { return { _mm_loadu_ps(data) }; }
+    static Float4 loadFloatProduct(const float* a, const float* b) { return { _mm_mul_ps(_mm_loadu_ps(a), _mm_loadu_ps(b)) }; }
+    void store(float* data) const { _mm_storeu_ps(data, value); }
+
+    static Float4 add(Float4 a, Float4 b) { return { _mm_add_ps(a.value, b.value) }; }
+    static Float4 sub(Float4 a, Float4 b) { return { _mm_sub_ps(a.value, b.value) }; }
+    static Float4 mul(Float4 a, Float4 b) { return { _mm_mul_ps(a.value, b.value) }; }
+    static Float4 mulAdd(Float4 a, Float4 b, Float4 c) { return add(mul(a, b), c); }
+
+    // bfloat16 values rounded to nearest even, sign-extended in 32-bit lanes: the signed packing keeps them
+    static __m128i roundToBFloat16(__m128 x)
+    {
+        const __m128i bits { _mm_castps_si128(x) };
+        const __m128i bias { _mm_add_epi32(_mm_set1_epi32(0x7FFF), _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(1))) };
+        return _mm_srai_epi32(_mm_add_epi32(bits, bias), 16);
+    }
+    // Saturated and rounded to integers in 32-bit lanes
+    static __m128i roundToInt16(__m128 x)
+    {
+        return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-32768.0f)), _mm_set1_ps(32767.0f)));
+    }
+
+    static Float4 loadBFloat16(const uint16_t* data)
+    {
+        return { _mm_castsi128_ps(_mm_unpacklo_epi16(_mm_setzero_si128(), _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data)))) };
+    }
+    void storeBFloat16(uint16_t* data) const
+    {
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(data), _mm_packs_epi32(roundToBFloat16(value), _mm_setzero_si128()));
+    }
+    static Float4 loadInt16(const int16_t* data)
+    {
+        const __m128i values { _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data)) };
+        return { _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(values, values), 16)) };
+    }
+    void storeInt16(int16_t* data) const
+    {
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(data), _mm_packs_epi32(roundToInt16(value), _mm_setzero_si128()));
+    }
+
+    __m128 value;
+};
+
+struct Double2
+{
+    using SampleType = double;
+    using Half = ScalarBatch<double>;
+    static constexpr uint32_t width { 2u };
+
+    // Two single-precision values, in the low half
+    static __m128 loadTwoFloats(const float* data) { return _mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(data))); }
+
+    static Double2 zero() { return { _mm_setzero_pd() }; }
+    static Double2 broadcast(double x) { return { _mm_set1_pd(x) }; }
+    static Double2 load(const double* data) { return { _mm_loadu_pd(data) }; }
+    static Double2 loadFloatProduct(const float* a, const float* b) { return { _mm_cvtps_pd(_mm_mul_ps(loadTwoFloats(a), loadTwoFloats(b))) }; }
+    void store(double* data) const { _mm_storeu_pd(data, value); }
+
+    static Double2 add(Double2 a, Double2 b) { return { _mm_add_pd(a.value, b.value) }; }
+    static Double2 sub(Double2 a, Double2 b) { return { _mm_sub_pd(a.value, b.value) }; }
+    static Double2 mul(Double2 a, Double2 b) { return { _mm_mul_pd(a.value, b.value) }; }
+    static Double2 mulAdd(Double2 a, Double2 b, Double2 c) { return add(mul(a, b), c); }
+
+    // Two 16-bit values, in the low 32 bits
+    static __m128i loadTwoShorts(const uint16_t* data)
+    {
+        return _mm_cvtsi32_si128(static_cast<int>(static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 16)));
+    }
+    static void storeTwoShorts(uint16_t* data, __m128i values)
+    {
+        const uint32_t bits { static_cast<uint32_t>(_mm_cvtsi128_si32(values)) };
+        data[0] = static_cast<uint16_t>(bits);
+        data[1] = static_cast<uint16_t>(bits >> 16);
+    }
+
+    static Double2 loadBFloat16(const uint16_t* data)
+    {
+        return { _mm_cvtps_pd(_mm_castsi128_ps(_mm_unpacklo_epi16(_mm_setzero_si128(), loadTwoShorts(data)))) };
+    }
+    void storeBFloat16(uint16_t* data) const
+    {
+        storeTwoShorts(data, _mm_packs_epi32(Float4::roundToBFloat16(_mm_cvtpd_ps(value)), _mm_setzero_si128()));
+    }
+    static Double2 loadInt16(const int16_t* data)
+    {
+        return { _mm_cvtepi32_pd(_mm_set_epi32(0, 0, data[1], data[0])) };
+    }
+    void storeInt16(int16_t* data) const
+    {
+        const __m128d clamped { _mm_min_pd(_mm_max_pd(value, _mm_set1_pd(-32768.0)), _mm_set1_pd(32767.0)) };
+        storeTwoShorts(reinterpret_cast<uint16_t*>(data), _mm_packs_epi32(_mm_cvtpd_epi32(clamped), _mm_setzero_si128()));
+    }
+
+    __m128d value;
+};
+
+#endif
+
+//================================================
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+
+struct Float8
+{
+    using SampleType = float;
+    using Half = Float4;
+    static constexpr uint32_t width { 8u };
+
+    static Float8 zero() { return { _mm256_setzero_ps() }; }
+    static Float8 broadcast(float x) { return { _mm256_set1_ps(x) }; }
+    static Float8 load(const float* data) { return { _mm256_loadu_ps(data) }; }
+    static Float8 loadFloatProduct(const float* a, const float* b) { return { _mm256_mul_ps(_mm256_loadu_ps(a), _mm256_loadu_ps(b)) }; }
+    void store(float* data) const { _mm256_storeu_ps(data, value); }
+
+    static Float8 add(Float8 a, Float8 b) { return { _mm256_add_ps(a.value, b.value) }; }
+    static Float8 sub(Float8 a, Float8 b) { return { _mm256_sub_ps(a.value, b.value) }; }
+    static Float8 mul(Float8 a, Float8 b) { return { _mm256_mul_ps(a.value, b.value) }; }
+    static Float8 mulAdd(Float8 a, Float8 b, Float8 c) { return { _mm256_fmadd_ps(a.value, b.value, c.value) }; }
+
+    // Signed packing of 32-bit lanes that hold 16-bit values, in order
+    static void storeShorts(void* data, __m256i values)
+    {
+        const __m128i packed { _mm_packs_epi32(_mm256_castsi256_si128(values), _mm256_extracti128_si256(values, 1)) };
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data), packed);
+    }
+
+    static Float8 loadBFloat16(const uint16_t* data)
+    {
+        const __m256i values { _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data))) };
+        return { _mm256_castsi256_ps(_mm256_slli_epi32(values, 16)) };
+    }
+    void storeBFloat16(uint16_t* data) const
+    {
+        const __m256i bits { _mm256_castps_si256(value) };
+        const __m256i bias { _mm256_add_epi32(_mm256_set1_epi32(0x7FFF), _mm256_and_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(1))) };
+        storeShorts(data, _mm256_srai_epi32(_mm256_add_epi32(bits, bias), 16));
+    }
+    static Float8 loadInt16(const int16_t* data)
+    {
+        return { _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)))) };
+    }
+    void storeInt16(int16_t* data) const
+    {
+        const __m256 clamped { _mm256_min_ps(_mm256_max_ps(value, _mm256_set1_ps(-32768.0f)), _mm256_set1_ps(32767.0f)) };
+        storeShorts(data, _mm256_cvtps_epi32(clamped));
+    }
+
+    __m256 value;
+};
+
+struct Double4
+{
+    using SampleType = double;
+    using Half = Double2;
+    static constexpr uint32_t width { 4u };
+
+    static Double4 zero() { return { _mm256_setzero_pd() }; }
+    static Double4 broadcast(double x) { return { _mm256_set1_pd(x) }; }
+    static Double4 load(const double* data) { return { _mm256_loadu_pd(data) }; }
+    static Double4 loadFloatProduct(const float* a, const float* b) { return { _mm256_cvtps_pd(_mm_mul_ps(_mm_loadu_ps(a), _mm_loadu_ps(b))) }; }
+    void store(double* data) const { _mm256_storeu_pd(data, value); }
+
+    static Double4 add(Double4 a, Double4 b) { return { _mm256_add_pd(a.value, b.value) }; }
+    static Double4 sub(Double4 a, Double4 b) { return { _mm256_sub_pd(a.value, b.value) }; }
+    static Double4 mul(Double4 a, Double4 b) { return { _mm256_mul_pd(a.value, b.value) }; }
+    static Double4 mulAdd(Double4 a, Double4 b, Double4 c) { return { _mm256_fmadd_pd(a.value, b.value, c.value) }; }
+
+    static Double4 loadBFloat16(const uint16_t* data) { return { _mm256_cvtps_pd(Float4::loadBFloat16(data).value) }; }
+    void storeBFloat16(uint16_t* data) const { Float4 { _mm256_cvtpd_ps(value) }.storeBFloat16(data); }
+    static Double4 loadInt16(const int16_t* data)
+    {
+        return { _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(data)))) };
+    }
+    void storeInt16(int16_t* data) const
+    {
+        const __m256d clamped { _mm256_min_pd(_mm256_max_pd(value, _mm256_set1_pd(-32768.0)), _mm256_set1_pd(32767.0)) };
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(data), _mm_packs_epi32(_mm256_cvtpd_epi32(clamped), _mm_setzero_si128()));
+    }
+
+    __m256d value;
+};
+
+#endif
+
+//================================================
+
+#if defined(__AVX512F__)
+
+struct Float16
+{
+    using SampleType = float;
+    using Half = Float8;
+    static constexpr uint32_t width { 16u };
+
+    static Float16 zero() { return { _mm512_setzero_ps() }; }
+    static Float16 broadcast(float x) { return { _mm512_set1_ps(x) }; }
+    static Float16 load(const float* data) { return { _mm512_loadu_ps(data) }; }
+    static Float16 loadFloatProduct(const float* a, const float* b) { return { _mm512_mul_ps(_mm512_loadu_ps(a), _mm512_loadu_ps(b)) }; }
+    void store(float* data) const { _mm512_storeu_ps(data, value); }
+
+    static Float16 add(Float16 a, Float16 b) { return { _mm512_add_ps(a.value, b.value) }; }
+    static Float16 sub(Float16 a, Float16 b) { return { _mm512_sub_ps(a.value, b.value) }; }
+    static Float16 mul(Float16 a, Float16 b) { return { _mm512_mul_ps(a.value, b.value) }; }
+    static Float16 mulAdd(Float16 a, Float16 b, Float16 c) { return { _mm512_fmadd_ps(a.value, b.value, c.value) }; }
+
+    static Float16 loadBFloat16(const uint16_t* data)
+    {
+        const __m512i values { _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data))) };
+        return { _mm512_castsi512_ps(_mm512_slli_epi32(values, 16)) };
+    }
+    void storeBFloat16(uint16_t* data) const
+    {
+        const __m512i bits { _mm512_castps_si512(value) };
+        const __m512i bias { _mm512_add_epi32(_mm512_set1_epi32(0x7FFF), _mm512_and_si512(_mm512_srli_epi32(bits, 16), _mm512_set1_epi32(1))) };
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data), _mm512_cvtsepi32_epi16(_mm512_srai_epi32(_mm512_add_epi32(bits, bias), 16)));
+    }
+    static Float16 loadInt16(const int16_t* data)
+    {
+        return { _mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)))) };
+    }
+    void storeInt16(int16_t* data) const
+    {
+        const __m512 clamped { _mm512_min_ps(_mm512_max_ps(value, _mm512_set1_ps(-32768.0f)), _mm512_set1_ps(32767.0f)) };
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data), _mm512_cvtsepi32_epi16(_mm512_cvtps_epi32(clamped)));
+    }
+
+    __m512 value;
+};
+
+struct Double8
+{
+    using SampleType = double;
+    using Half = Double4;
+    static constexpr uint32_t width { 8u };
+
+    static Double8 zero() { return { _mm512_setzero_pd() }; }
+    static Double8 broadcast(double x) { return { _mm512_set1_pd(x) }; }
+    static Double8 load(const double* data) { return { _mm512_loadu_pd(data) }; }
+    static Double8 loadFloatProduct(const float* a, const float* b) { return { _mm512_cvtps_pd(_mm256_mul_ps(_mm256_loadu_ps(a), _mm256_loadu_ps(b))) }; }
+    void store(double* data) const { _mm512_storeu_pd(data, value); }
+
+    static Double8 add(Double8 a, Double8 b) { return { _mm512_add_pd(a.value, b.value) }; }
+    static Double8 sub(Double8 a, Double8 b) { return { _mm512_sub_pd(a.value, b.value) }; }
+    static Double8 mul(Double8 a, Double8 b) { return { _mm512_mul_pd(a.value, b.value) }; }
+    static Double8 mulAdd(Double8 a, Double8 b, Double8 c) { return { _mm512_fmadd_pd(a.value, b.value, c.value) }; }
+
+    static Double8 loadBFloat16(const uint16_t* data) { return { _mm512_cvtps_pd(Float8::loadBFloat16(data).value) }; }
+    void storeBFloat16(uint16_t* data) const { Float8 { _mm512_cvtpd_ps(value) }.storeBFloat16(data); }
+    static Double8 loadInt16(const int16_t* data)
+    {
+        return { _mm512_cvtepi32_pd(_mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)))) };
+    }
+    void storeInt16(int16_t* data) const
+    {
+        const __m512d clamped { _mm512_min_pd(_mm512_max_pd(value, _mm512_set1_pd(-32768.0)), _mm512_set1_pd(32767.0)) };
+        Float8::storeShorts(data, _mm512_cvtpd_epi32(clamped));
+    }
+
+    __m512d value;
+};
+
+#endif
+
+//================================================
+
+// Rows [row, numRows) of output = matrix * input, a batch of rows at a time down the columns
+template <typename Batch, typename SampleType = typename Batch::SampleType>
+void multiplyRows(SampleType* output, const SampleType* matrix, const SampleType* input, uint32_t numRows, uint32_t numColumns, uint32_t row)
+{
+    for (; row + Batch::width <= numRows; row += Batch::width)
+    {
+        Batch sum { Batch::zero() };
+        for (uint32_t column = 0; column < numColumns; ++column)
+            sum = Batch::mulAdd(Batch::load(matrix + static_cast<size_t>(column) * numRows + row), Batch::broadcast(input[column]), sum);
+        sum.store(output + row);
+    }
+
+    if constexpr (Batch::width > 1u)
+        if (row < numRows)
+            multiplyRows<typename Batch::Half>(output, matrix, input, numRows, numColumns, row);
+}
+
+template <typename Batch, typename SampleType = typename Batch::SampleType>
+void multiplyMatrixVector(SampleType* output, const SampleType* matrix, const SampleType* input, uint32_t numRows, uint32_t numColumns)
+{
+    multiplyRows<Batch>(output, matrix, input, numRows, numColumns, 0u);
+}
+
+// Channels [channel, numChannels) of the one-pole bank. Each batch reads its inputs before it
+// writes its outputs, so that the output may alias the input
+template <typename Batch, typename SampleType = typename Batch::SampleType>
+void processOnePoleChannels(SampleType* output, const SampleType* input, const SampleType* b0, const SampleType* a1, SampleType* state, uint32_t numChannels, uint32_t channel)
+{
+    for (; channel + Batch::width <= numChannels; channel += Batch::width)
+    {
+        const Batch feedforward { Batch::mul(Batch::load(b0 + channel), Batch::load(input + channel)) };
+        const Batch feedback { Batch::mul(Batch::load(a1 + channel), Batch::load(state + channel)) };
+        const Batch result { Batch::sub(feedforward, feedback) };
+        result.store(output + channel);
+        result.store(state + channel);
+    }
+
+    if constexpr (Batch::width > 1u)
+        if (channel < numChannels)
+            processOnePoleChannels<typename Batch::Half>(output, input, b0, a1, state, numChannels, channel);
+}
+
+template <typename Batch, typename SampleType = typename Batch::SampleType>
+void processOnePoleBank(SampleType* output, const SampleType* input, const SampleType* b0, const SampleType* a1, SampleType* state, uint32_t numChannels)
+{
+    processOnePoleChannels<Batch>(output, input, b0, a1, state, numChannels, 0u);
+}
+
+template <typename Batch, typename SampleType = typename Batch::SampleType>
+void interpolateSamples(SampleType* output, const SampleType* tap0, const SampleType* tap1, SampleType fraction0, SampleType fraction1, uint32_t numSamples, uint32_t n)
+{
+    const Batch weight0 { Batch::broadcast(fraction0) };
+    const Batch weight1 { Batch::broadcast(fraction1) };
+    for (; n + Batch::width <= numSamples; n += Batch::width)
+        Batch::add(Batch::mul(Batch::load(tap0 + n), weight0), Batch::mul(Batch::load(tap1 + n), weight1)).store(output + n);
+
+    if constexpr (Batch::width > 1u)
+        if (n < numSamples)
+            interpolateSamples<typename Batch::Half>(output, tap0, tap1, fraction0, fraction1, numSamples, n);
+}
+
+template <typename Batch, typename SampleType = typename Batch::SampleType>
+void interpolateLinear(SampleType* output, const SampleType* tap0, const SampleType* tap1, SampleType fraction0, SampleType fraction1, uint32_t numSamples)
+{
+    interpolateSamples<Batch>(output, tap0, tap1, fraction0, fraction1, numSamples, 0u);
+}
+
+template <typename Batch, typename SampleType = typename Batch::SampleType>
+void applyGainSamples(SampleType* data, const float* gain0, const float* gain1, uint32_t numSamples, uint32_t n)
+{
+    for (; n + Batch::width <= numSamples; n += Batch::width)
+        Batch::mul(Batch::load(data + n), Batch::loadFloatProduct(gain0 + n, gain1 + n)).store(data + n);
+
+    if constexpr (Batch::width > 1u)
+        if (n < numSamples)
+            applyGainSamples<typename Batch::Half>(data, gain0, gain1, numSamples, n);
+}
+
+template <typename Batch, typename SampleType = typename Batch::SampleType>
+void applyGains(SampleType* data, const float* gain0, const float* gain1, uint32_t numSamples)
+{
+    applyGainSamples<Batch>(data, gain0, gain1, numSamples, 0u);
+}
+
+template <typename Batch, typename SampleType = typename Batch::SampleType>
+void packBFloat16Samples(uint16_t* output, const SampleType* input, uint32_t numSamples, uint32_t n)
+{
+    for (; n + Batch::width <= numSamples; n += Batch::width)
+        Batch::load(input + n).storeBFloat16(output + n);
+
+    if constexpr (Batch::width > 1u)
+        if (n < numSamples)
+            packBFloat16Samples<typename Batch::Half>(output, input, numSamples, n);
+}
+
+template <typename Batch, typename SampleType = typename Batch::SampleType>
+void packBFloat16(uint16_t* output, const SampleType* input, uint32_t numSamples)
+{
+    packBFloat16Samples<Batch>(output, input, numSamples, 0u);
+}
+
+template <typename Batch, typename SampleType = typename Batch::SampleType>
+void unpackBFloat16Samples(SampleType* output, const uint16_t* input, uint32_t numSamples, uint32_t n)
+{
+    for (; n + Batch::width <= numSamples; n += Batch::width)
+        Batch::loadBFloat16(input + n).store(output + n);
+
+    if constexpr (Batch::width > 1u)
+        if (n < numSamples)
+            unpackBFloat16Samples<typename Batch::Half>(output, input, numSamples, n);
+}
+
+template <typename Batch, typename SampleType = typename Batch::SampleType>
+void unpackBFloat16(SampleType* output, const uint16_t* input, uint32_t numSamples)
+{
+    unpackBFloat16Samples<Batch>(output, input, numSamples, 0u);
+}
+
+template <typename Batch, typename SampleType = typename Batch::SampleType>
+void packFixed16Samples(int16_t* output, const SampleType* input, SampleType inverseStep, uint32_t numSamples, uint32_t n)
+{
+    const Batch scale { Batch::broadcast(inverseStep) };
+    for (; n + Batch::width <= numSamples; n += Batch::width)
+        Batch::mul(Batch::load(input + n), scale).storeInt16(output + n);
+
+    if constexpr (Batch::width > 1u)
+        if (n < numSamples)
+            packFixed16Samples<typename Batch::Half>(output, input, inverseStep, numSamples, n);
+}
+
+template <typename Batch, typename SampleType = typename Batch::SampleType>
+void packFixed16(int16_t* output, const SampleType* input, SampleType inverseStep, uint32_t numSamples)
+{
+    packFixed16Samples<Batch>(output, input, inverseStep, numSamples, 0u);
+}
+
+template <typename Batch, typename SampleType = typename Batch::SampleType>
+void unpackFixed16Samples(SampleType* output, const int16_t* input, SampleType step, uint32_t numSamples, uint32_t n)
+{
+    const Batch scale { Batch::broadcast(step) };
+    for (; n + Batch::width <= numSamples; n += Batch::width)
+        Batch::mul(Batch::loadInt16(input + n), scale).store(output + n);
+
+    if constexpr (Batch::width > 1u)
+        if (n < numSamples)
+            unpackFixed16Samples<typename Batch::Half>(output, input, step, numSamples, n);
+}
+
+template <typename Batch, typename SampleType = typename Batch::SampleType>
+void unpackFixed16(SampleType* output, const int16_t* input, SampleType step, uint32_t numSamples)
+{
+    unpackFixed16Samples<Batch>(output, input, step, numSamples, 0u);
+}
+
+//================================================
+
+template <typename Batch>
+KernelTable<typename Batch::SampleType> makeKernelTable()
+{
+    return {
+        &multiplyMatrixVector<Batch>, &processOnePoleBank<Batch>, &interpolateLinear<Batch>, &applyGains<Batch>,
+        &packBFloat16<Batch>, &unpackBFloat16<Batch>, &packFixed16<Batch>, &unpackFixed16<Batch>
+    };
+}
+
+template <typename FloatBatch, typename DoubleBatch>
+KernelTables makeKernelTables()
+{
+    return { makeKernelTable<FloatBatch>(), makeKernelTable<DoubleBatch>() };
+}
+
+}
+}
@@ -0,0 +1,17 @@
+// SSE2 kernels. Built with -msse2 -ffp-contract=off
+#include "KernelsImpl.h"
+
+#if ! defined(__SSE2__) && ! defined(_M_X64)
+    #error "KernelsSSE2.cpp must be compiled with SSE2 enabled"
+#endif
+
+namespace DSP::kernels
+{
+
+const KernelTables& getSSE2Tables()
+{
+    static const KernelTables tables { makeKernelTables<Float4, Double2>() };
+    return tables;
+}
+
+}
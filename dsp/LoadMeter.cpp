@@ -0,0 +1,95 @@
+#include <cassert>
+#include <cmath>
+
+#include "LoadMeter.h"
+
+namespace utils
+{
+
+void LoadMeter::prepare(double newSampleRate)
+{
+    assert(newSampleRate > 0.0);
+    sampleRate = newSampleRate;
+
+    // Not processing: reset at once
+    load.store(0.0f, std::memory_order_relaxed);
+    lastLoad.store(0.0f, std::memory_order_relaxed);
+    resetRequested.store(false, std::memory_order_relaxed);
+    resetCounters();
+}
+
+void LoadMeter::setAveragingTime(double newTimeInSeconds)
+{
+    assert(newTimeInSeconds > 0.0);
+    averagingTime = newTimeInSeconds;
+}
+
+//================================================
+
+void LoadMeter::addBlock(uint32_t numSamples, double seconds) noexcept
+{
+    if (numSamples == 0u)
+        return;
+
+    // Only this thread writes the peak and the counters, so a reset cannot interleave with their updates
+    if (resetRequested.exchange(false, std::memory_order_acquire))
+        resetCounters();
+
+    const double budget { static_cast<double>(numSamples) / sampleRate };
+    const float blockLoad { static_cast<float>(seconds / budget) };
+
+    // One-pole average weighted by the block duration, so that it does not depend on the block size
+    const float weight { static_cast<float>(1.0 - std::exp(-budget / averagingTime)) };
+    const float previousLoad { load.load(std::memory_order_relaxed) };
+    load.store(previousLoad + weight * (blockLoad - previousLoad), std::memory_order_relaxed);
+    lastLoad.store(blockLoad, std::memory_order_relaxed);
+
+    if (blockLoad > peakLoad.load(std::memory_order_relaxed))
+        peakLoad.store(blockLoad, std::memory_order_relaxed);
+
+    if (blockLoad > 1.0f)
+        overruns.fetch_add(1u, std::memory_order_relaxed);
+
+    numBlocks.fetch_add(1u, std::memory_order_relaxed);
+}
+
+//================================================
+
+float LoadMeter::getLoad() const noexcept
+{
+    return load.load(std::memory_order_relaxed);
+}
+
+float LoadMeter::getLastLoad() const noexcept
+{
+    return lastLoad.load(std::memory_order_relaxed);
+}
+
+float LoadMeter::getPeakLoad() const noexcept
+{
+    return peakLoad.load(std::memory_order_relaxed);
+}
+
+uint64_t LoadMeter::getOverruns() const noexcept
+{
+    return overruns.load(std::memory_order_relaxed);
+}
+
+uint64_t LoadMeter::getNumBlocks() const noexcept
+{
+    return numBlocks.load(std::memory_order_relaxed);
+}
+
+void LoadMeter::resetPeak() noexcept
+{
+    resetRequested.store(true, std::memory_order_release);
+}
+
+void LoadMeter::resetCounters() noexcept
+{
+    peakLoad.store(0.0f, std::memory_order_relaxed);
+    overruns.store(0u, std::memory_order_relaxed);
+    numBlocks.store(0u, std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace utils
+{
+
+// Measures how much of its real-time budget (numSamples / sampleRate) each processed block uses.
+// The audio thread writes, any thread reads: all counters are lock-free atomics.
+class LoadMeter
+{
+public:
+
+    // Times the enclosing scope as one block of the given size
+    class ScopedMeasurement
+    {
+    public:
+        ScopedMeasurement(LoadMeter& initMeter, uint32_t initNumSamples) noexcept :
+            meter { initMeter },
+            numSamples { initNumSamples },
+            start { Clock::now() }
+        {}
+
+        ~ScopedMeasurement()
+        {
+            meter.addBlock(numSamples, std::chrono::duration<double>(Clock::now() - start).count());
+        }
+
+        ScopedMeasurement(const ScopedMeasurement&) = delete;
+        ScopedMeasurement& operator=(const ScopedMeasurement&) = delete;
+
+    private:
+        LoadMeter& meter;
+        uint32_t numSamples;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    //================================================
+
+    // Constructor
+    LoadMeter() = default;
+
+    // No copy, no move: the counters are shared between threads
+    LoadMeter(const LoadMeter&) = delete;
+    LoadMeter& operator=(const LoadMeter&) = delete;
+
+    //================================================
+
+    // Set the sample rate and reset the counters
+    void prepare(double newSampleRate);
+
+    // Set the time constant of the averaged load
+    void setAveragingTime(double newTimeInSeconds);
+
+    //================================================
+
+    // Account one block processed in the given wall-clock time. Real-time safe
+    void addBlock(uint32_t numSamples, double seconds) noexcept;
+
+    //================================================
+
+    // Load averaged over the averaging time, 1 being the whole budget
+    float getLoad() const noexcept;
+
+    // Load of the last block
+    float getLastLoad() const noexcept;
+
+    // Highest load of a single block since the last reset
+    float getPeakLoad() const noexcept;
+
+    // Number of blocks that took longer than their budget since the last reset
+    uint64_t getOverruns() const noexcept;
+
+    // Number of blocks measured since the last reset
+    uint64_t getNumBlocks() const noexcept;
+
+    // Clear the peak, the overruns and the block count. Any thread: the audio thread applies it at its next block
+    void resetPeak() noexcept;
+
+    //================================================
+
+private:
+
+    using Clock = std::chrono::steady_clock;
+
+    // Clear the peak, the overruns and the block count. The thread that adds the blocks
+    void resetCounters() noexcept;
+
+    //================================================
+
+    double sampleRate { 48000.0 };
+    double averagingTime { 0.3 };
+
+    std::atomic<float> load { 0.0f };
+    std::atomic<float> lastLoad { 0.0f };
+    std::atomic<float> peakLoad { 0.0f };
+    std::atomic<uint64_t> overruns { 0u };
+    std::atomic<uint64_t> numBlocks { 0u };
+    // Set by resetPeak, consumed by addBlock
+    std::atomic<bool> resetRequested { false };
+
+    static_assert(std::atomic<float>::is_always_lock_free, "Load must be lock-free");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "Counters must be lock-free");
+};
+
+}
@@ -1,10 +1,16 @@
 #include "Matrix.h"
+#include "KernelDispatch.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 
 namespace DSP
 {
 
-Matrix::Matrix(int initDim)
+template <typename SampleType>
+Matrix<SampleType>::Matrix(int initDim) :
+    seed { 0u }
 {
     jassert(initDim >= 0 && "Matrix dimension must be greater than or equal to zero");
     dim1 = initDim;
@@ -12,7 +18,9 @@ Matrix::Matrix(int initDim)
     matrix = genRandomOrthogonal(dim1);
 }
 
-Matrix::Matrix(int initDim1, int initDim2)
+template <typename SampleType>
+Matrix<SampleType>::Matrix(int initDim1, int initDim2, uint32_t initSeed /*= 0u*/) :
+    seed { initSeed }
 {
     jassert(initDim1 >= 0 && initDim2 >= 0 && "Matrix dimensions must be greater than or equal to zero");
     dim1 = initDim1;
@@ -20,32 +28,34 @@ Matrix::Matrix(int initDim1, int initDim2)
     matrix = genRandomCoupling(dim1, dim2);
 }
 
-Matrix::~Matrix()
+template <typename SampleType>
+Matrix<SampleType>::Matrix(const MatrixSnapshot& snapshot) :
+    seed { snapshot.seed }
 {
+    setSnapshot(snapshot);
 }
 
-Eigen::MatrixXf Matrix::genRandomOrthogonal(int dim)
+template <typename SampleType>
+Matrix<SampleType>::~Matrix()
 {
-    // Generate a random orthogonal square matrix
-    Eigen::MatrixXf random = Eigen::MatrixXf::Random(dim, dim);
-    // Perform QR decomposition to obtain an orthogonal matrix
-    Eigen::HouseholderQR<Eigen::MatrixXf> qr(random);
-    // Set the matrix to the orthogonal matrix obtained from QR decomposition
-    return qr.householderQ();
 }
 
-Eigen::MatrixXf Matrix::genRandomCoupling(int dim1, int dim2)
+template <typename SampleType>
+TopologyCache::SharedMatrix<SampleType> Matrix<SampleType>::genRandomOrthogonal(int dim)
 {
-    int maxDim = std::max(dim1, dim2);
-    // Generate a random matrix with specified dimensions
-    Eigen::MatrixXf random = Eigen::MatrixXf::Random(maxDim, maxDim);
-    // Perform QR decomposition to obtain an orthogonal matrix
-    Eigen::HouseholderQR<Eigen::MatrixXf> qr(random);
-    // Set the matrix to the orthogonal matrix obtained from QR decomposition
-    return Eigen::MatrixXf::Identity(dim1, maxDim) * qr.householderQ() * Eigen::MatrixXf::Identity(maxDim, dim2);
+    // Random orthogonal square matrix, generated once per (dim, seed) in the process
+    return TopologyCache::getOrthogonalMatrix<SampleType>(dim, seed);
 }
 
-void Matrix::setDimensions(int newDim)
+template <typename SampleType>
+TopologyCache::SharedMatrix<SampleType> Matrix<SampleType>::genRandomCoupling(int dim1, int dim2)
+{
+    // Random coupling matrix, generated once per (dim1, dim2, seed) in the process
+    return TopologyCache::getCouplingMatrix<SampleType>(dim1, dim2, seed);
+}
+
+template <typename SampleType>
+void Matrix<SampleType>::setDimensions(int newDim)
 {
     jassert(newDim >= 0 && "Matrix dimension must be greater than or equal to zero");
     dim1 = newDim;
@@ -53,7 +63,8 @@ void Matrix::setDimensions(int newDim)
     matrix = genRandomOrthogonal(dim1);
 }
 
-void Matrix::setDimensions(int newDim1, int newDim2)
+template <typename SampleType>
+void Matrix<SampleType>::setDimensions(int newDim1, int newDim2)
 {
     jassert(newDim1 >= 0 && newDim2 >= 0 && "Matrix dimensions must be greater than or equal to zero");
     dim1 = newDim1;
@@ -61,7 +72,49 @@ void Matrix::setDimensions(int newDim1, int newDim2)
     matrix = genRandomCoupling(dim1, dim2);
 }
 
-void Matrix::prepare(int newDim)
+template <typename SampleType>
+void Matrix<SampleType>::setSeed(uint32_t newSeed)
+{
+    if (newSeed != seed)
+    {
+        seed = newSeed;
+        matrix = genRandomCoupling(dim1, dim2);
+    }
+}
+
+template <typename SampleType>
+uint32_t Matrix<SampleType>::getSeed() const
+{
+    return seed;
+}
+
+template <typename SampleType>
+MatrixSnapshot Matrix<SampleType>::getSnapshot() const
+{
+    MatrixSnapshot snapshot;
+    snapshot.dim1 = dim1;
+    snapshot.dim2 = dim2;
+    snapshot.seed = seed;
+    snapshot.coefficients.resize(static_cast<size_t>(dim1) * static_cast<size_t>(dim2));
+
+    Eigen::Map<Eigen::MatrixXd> coefficients(snapshot.coefficients.data(), dim1, dim2);
+    coefficients = matrix->template cast<double>();
+    return snapshot;
+}
+
+template <typename SampleType>
+void Matrix<SampleType>::setSnapshot(const MatrixSnapshot& snapshot)
+{
+    DSP_TRACE_SCOPE("Matrix::setSnapshot");
+    jassert(snapshot.isValid() && "Matrix snapshot is inconsistent");
+    dim1 = snapshot.dim1;
+    dim2 = snapshot.dim2;
+    seed = snapshot.seed;
+    matrix = TopologyCache::adoptCouplingMatrix<SampleType>(dim1, dim2, seed, snapshot.coefficients);
+}
+
+template <typename SampleType>
+void Matrix<SampleType>::prepare(int newDim)
 {   
     if (newDim != dim1 || newDim != dim2)
     {
@@ -71,7 +124,8 @@ void Matrix::prepare(int newDim)
     }
 }
 
-void Matrix::prepare(int newDim1, int newDim2)
+template <typename SampleType>
+void Matrix<SampleType>::prepare(int newDim1, int newDim2)
 {
     if (newDim1 != dim1 || newDim2 != dim2)
     {
@@ -81,22 +135,182 @@ void Matrix::prepare(int newDim1, int newDim2)
     }
 }
 
-void Matrix::clear()
+template <typename SampleType>
+void Matrix<SampleType>::clear()
+{
+}
+
+template <typename SampleType>
+void Matrix<SampleType>::prepareModulation(double newSampleRate, uint32_t newControlInterval /*= 32u*/)
+{
+    jassert(dim1 == dim2 && "Only square matrices can be time-varying");
+    jassert(newControlInterval > 0u && "Control interval must be greater than zero");
+
+    const uint32_t numPairs { static_cast<uint32_t>(dim1) / 2u };
+    controlInterval = newControlInterval;
+    controlCounter = 0u;
+    rotating = false;
+
+    // One oscillator per channel pair
+    if (numPairs > 0u && numPairs != angleOscillators.getNumOscillators())
+        angleOscillators = primitives::OscillatorBank(numPairs, primitives::Waveform::sine, 0.0f);
+
+    angles.assign(numPairs, 0.0f);
+    angleTargets.assign(numPairs, 0.0f);
+    cosines.assign(numPairs, SampleType { 1 });
+    sines.assign(numPairs, SampleType { 0 });
+    cosineSteps.assign(numPairs, SampleType { 1 });
+    sineSteps.assign(numPairs, SampleType { 0 });
+    rotatedInput.assign(static_cast<size_t>(dim2), SampleType { 0 });
+
+    // Keep the rate and depth set before, for the new sample rate
+    setModulation(modulationRate, modulationDepth);
+    angleOscillators.prepare(newSampleRate, 1u);
+}
+
+template <typename SampleType>
+void Matrix<SampleType>::setModulation(float newRateHz, float newDepth)
+{
+    jassert(newRateHz >= 0.0f && "Modulation rate must be greater than or equal to zero");
+    jassert(newDepth >= 0.0f && "Modulation depth must be greater than or equal to zero");
+
+    modulationRate = newRateHz;
+    modulationDepth = newDepth;
+
+    // Slightly spread rates, so that the pairs do not rotate in lockstep
+    const uint32_t numPairs { static_cast<uint32_t>(angles.size()) };
+    for (uint32_t i = 0; i < numPairs; ++i)
+        angleOscillators.setFrequency(i, modulationRate * (1.0f + 0.25f * static_cast<float>(i) / static_cast<float>(numPairs)));
+}
+
+template <typename SampleType>
+void Matrix<SampleType>::setRotationSmoothing(bool shouldSmooth)
 {
+    smoothRotations = shouldSmooth;
 }
 
-void Matrix::processSample(float* outSamples, const float* inSamples, uint32_t numOutputChannels, uint32_t numInputChannels)
+template <typename SampleType>
+void Matrix<SampleType>::setKernels(const KernelTable<SampleType>* newKernels)
+{
+    kernels = newKernels;
+}
+
+template <typename SampleType>
+void Matrix<SampleType>::visitMemory(const utils::MemoryVisitor& visitor) const
+{
+    visitor(matrix->data(), static_cast<size_t>(matrix->size()) * sizeof(SampleType));
+    visitor(angles.data(), angles.size() * sizeof(float));
+    visitor(angleTargets.data(), angleTargets.size() * sizeof(float));
+    visitor(cosines.data(), cosines.size() * sizeof(SampleType));
+    visitor(sines.data(), sines.size() * sizeof(SampleType));
+    visitor(cosineSteps.data(), cosineSteps.size() * sizeof(SampleType));
+    visitor(sineSteps.data(), sineSteps.size() * sizeof(SampleType));
+    visitor(rotatedInput.data(), rotatedInput.size() * sizeof(SampleType));
+}
+
+template <typename SampleType>
+utils::MemoryFootprint Matrix<SampleType>::getMemoryFootprint() const
+{
+    utils::MemoryFootprint footprint { angleOscillators.getMemoryFootprint() };
+    for (const auto* values : { &cosines, &sines, &cosineSteps, &sineSteps, &rotatedInput })
+        footprint.owned += utils::MemoryFootprint::of(*values);
+    footprint.owned += utils::MemoryFootprint::of(angles) + utils::MemoryFootprint::of(angleTargets);
+    footprint.shared += matrix != nullptr ? static_cast<size_t>(matrix->size()) * sizeof(SampleType) : 0u;
+    return footprint;
+}
+
+template <typename SampleType>
+void Matrix<SampleType>::updateRotationTargets()
+{
+    DSP_TRACE_SCOPE("Matrix::updateRotationTargets");
+    const size_t numPairs { angles.size() };
+
+    // The previous targets are reached: resynchronise on their exact cosines and sines,
+    // so that rounding in the per-sample recurrence never accumulates
+    bool anyRotation { false };
+    for (size_t i = 0; i < numPairs; ++i)
+    {
+        angles[i] = angleTargets[i];
+        cosines[i] = std::cos(static_cast<SampleType>(angles[i]));
+        sines[i] = std::sin(static_cast<SampleType>(angles[i]));
+        anyRotation = anyRotation || angles[i] != 0.0f;
+    }
+
+    // Next targets, and the rotation each angle moves by per sample to reach them
+    angleOscillators.processControl(angleTargets.data(), controlInterval);
+    const float stepScale { 1.0f / static_cast<float>(controlInterval) };
+    for (size_t i = 0; i < numPairs; ++i)
+    {
+        angleTargets[i] *= modulationDepth;
+        const float step { (angleTargets[i] - angles[i]) * stepScale };
+        cosineSteps[i] = std::cos(static_cast<SampleType>(step));
+        sineSteps[i] = std::sin(static_cast<SampleType>(step));
+        anyRotation = anyRotation || angleTargets[i] != 0.0f;
+    }
+
+    rotating = anyRotation;
+}
+
+template <typename SampleType>
+void Matrix<SampleType>::applyRotations(const SampleType* inSamples)
+{
+    const size_t numPairs { angles.size() };
+
+    for (size_t i = 0; i < numPairs; ++i)
+    {
+        const SampleType c { cosines[i] };
+        const SampleType s { sines[i] };
+        const SampleType x0 { inSamples[2 * i] };
+        const SampleType x1 { inSamples[2 * i + 1] };
+        rotatedInput[2 * i] = c * x0 - s * x1;
+        rotatedInput[2 * i + 1] = s * x0 + c * x1;
+
+        // Advance the angle by one step: a rotation of (cos, sin), so their norm stays one
+        if (smoothRotations)
+        {
+            cosines[i] = c * cosineSteps[i] - s * sineSteps[i];
+            sines[i] = s * cosineSteps[i] + c * sineSteps[i];
+        }
+    }
+
+    // Odd dimension: the last channel is not rotated
+    if (static_cast<size_t>(dim2) > 2 * numPairs)
+        rotatedInput[2 * numPairs] = inSamples[2 * numPairs];
+}
+
+template <typename SampleType>
+void Matrix<SampleType>::processSample(SampleType* outSamples, const SampleType* inSamples, uint32_t numOutputChannels, uint32_t numInputChannels)
 {
     jassert(numInputChannels == dim2 && "Number of channels must match the matrix dimension");
     jassert(numOutputChannels == dim1 && "Number of channels must match the matrix dimension");
+    jassert(outSamples != inSamples && "Output and input must not alias");
+
+    // Time-varying: update the rotation angles at control rate
+    if (! angles.empty())
+    {
+        jassert(angles.size() == static_cast<size_t>(dim2) / 2 && "Modulation must be prepared again after a dimension change");
+        if (controlCounter == 0u)
+        {
+            updateRotationTargets();
+            controlCounter = controlInterval;
+        }
+        --controlCounter;
+
+        if (rotating)
+        {
+            applyRotations(inSamples);
+            inSamples = rotatedInput.data();
+        }
+    }
 
-    // Map the input samples to an Eigen matrix
-    Eigen::Map<const Eigen::VectorXf> input(inSamples, numInputChannels);
-    // Map the output samples to an Eigen matrix
-    Eigen::Map<Eigen::VectorXf> output(outSamples, numOutputChannels);
-    // Perform matrix multiplication
-    output = matrix * input;
+    // Matrix-vector product with the kernel of the CPU's instruction set (column-major, as Eigen stores it)
+    const KernelTable<SampleType>& kernelTable { kernels != nullptr ? *kernels : KernelDispatch::getKernels<SampleType>() };
+    kernelTable.multiplyMatrixVector(outSamples, matrix->data(), inSamples, numOutputChannels, numInputChannels);
 }
 
+// =============================================
+
+template class Matrix<float>;
+template class Matrix<double>;
 
 }
\ No newline at end of file
@@ -1,23 +1,44 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
 
 #include <JuceHeader.h>
 
 #include <Eigen/Dense>
 
+#include "KernelDispatch.h"
+#include "MemoryFootprint.h"
+#include "MemoryLock.h"
+#include "OscillatorBank.h"
+#include "TopologyCache.h"
+#include "TopologySnapshot.h"
+
 namespace DSP
 {
 
+template <typename SampleType>
 class Matrix
 {
 public:
-    Matrix(
+    using MatrixType = Eigen::Matrix<SampleType, Eigen::Dynamic, Eigen::Dynamic>;
+    using VectorType = Eigen::Matrix<SampleType, Eigen::Dynamic, 1>;
+
+    // Orthogonal square matrix, generated from seed 0
+    explicit Matrix(
         int initDim
     );
+    // Coupling matrix (orthogonal when the dimensions match)
     Matrix(
         int initDim1,
-        int initDim2
+        int initDim2,
+        uint32_t initSeed = 0u
+    );
+    // Matrix restored from stored coefficients, without generating it
+    explicit Matrix(
+        const MatrixSnapshot& snapshot
     );
     ~Matrix();
 
@@ -34,16 +55,24 @@ public:
 
     // =============================================
 
-    // Generates the matrix
-    Eigen::MatrixXf genRandomOrthogonal(int dim);
+    // Get the orthogonal matrix for the seed from the topology cache
+    TopologyCache::SharedMatrix<SampleType> genRandomOrthogonal(int dim);
 
-    // Generates the matrix with specified dimensions
-    Eigen::MatrixXf genRandomCoupling(int dim1, int dim2);
+    // Get the coupling matrix with specified dimensions for the seed from the topology cache
+    TopologyCache::SharedMatrix<SampleType> genRandomCoupling(int dim1, int dim2);
 
     // Set the number of delay lines
     void setDimensions(int newDim);
     void setDimensions(int newDim1, int newDim2);
 
+    // Set the seed the matrix is generated from
+    void setSeed(uint32_t newSeed);
+    uint32_t getSeed() const;
+
+    // Store the coefficients, or restore them without generating the matrix again
+    MatrixSnapshot getSnapshot() const;
+    void setSnapshot(const MatrixSnapshot& snapshot);
+
     // =============================================
 
     // Reallocate delay buffer for the maxLength and clear its contents
@@ -53,17 +82,68 @@ public:
     // Clear the contents of the delay buffer
     void clear();
 
-    // Process multi-channel sample
-    void processSample(float* outSamples, const float* inSamples, uint32_t numOutputChannels, uint32_t numInputChannels);
+    // =============================================
+
+    // Time variation, square matrices only: y = M R(t) x, where R(t) rotates disjoint channel pairs
+    // by angles that follow a bank of slow sine oscillators. M R(t) stays orthogonal, and the
+    // rotations cost O(N) per sample on top of the product: the matrix is never regenerated.
+    // Allocate the rotation state; angles are updated every controlInterval samples
+    void prepareModulation(double newSampleRate, uint32_t newControlInterval = 32u);
+
+    // Set the rotation rate in Hz and the maximum rotation angle in radians (0 disables the rotations)
+    void setModulation(float newRateHz, float newDepth);
+
+    // Interpolate the rotation angles every sample (true), or hold them between control ticks (cheaper, stepped)
+    void setRotationSmoothing(bool shouldSmooth);
+
+    // Run the product with the kernels of one instruction set instead of the active ones (nullptr: the active ones)
+    void setKernels(const KernelTable<SampleType>* newKernels);
+
+    // Pass the coefficients and the rotation state to a visitor
+    void visitMemory(const utils::MemoryVisitor& visitor) const;
+
+    // Heap memory of the rotation state, and of the coefficients, shared through the TopologyCache
+    utils::MemoryFootprint getMemoryFootprint() const;
+
+    // Process multi-channel sample. Output and input must not alias
+    void processSample(SampleType* outSamples, const SampleType* inSamples, uint32_t numOutputChannels, uint32_t numInputChannels);
 
 private:
+    // Compute the next angle targets and the per-sample rotation steps towards them
+    void updateRotationTargets();
+
+    // Rotate the channel pairs of the input into rotatedInput, and advance the rotations by one sample
+    void applyRotations(const SampleType* inSamples);
+
     int dim1;
     int dim2;
-    Eigen::MatrixXf matrix;
-
-    // static_assert(std::is_copy_constructible_v<Matrix>);
-    // static_assert(std::is_move_constructible_v<Matrix>);
-    static_assert(std::is_nothrow_move_assignable_v<Matrix>);
+    uint32_t seed;
+    // Read-only, shared with every matrix of the same dimensions and seed
+    TopologyCache::SharedMatrix<SampleType> matrix;
+
+    // Rotation state, one entry per channel pair
+    primitives::OscillatorBank angleOscillators { 1u, primitives::Waveform::sine, 0.0f };
+    uint32_t controlInterval { 32u };
+    uint32_t controlCounter { 0u };
+    float modulationRate { 0.0f };
+    float modulationDepth { 0.0f };
+    bool rotating { false };
+    bool smoothRotations { true };
+    std::vector<float> angles;
+    std::vector<float> angleTargets;
+    std::vector<SampleType> cosines;
+    std::vector<SampleType> sines;
+    std::vector<SampleType> cosineSteps;
+    std::vector<SampleType> sineSteps;
+    std::vector<SampleType> rotatedInput;
+
+    const KernelTable<SampleType>* kernels { nullptr };
+
+    static_assert(std::is_floating_point_v<SampleType>, "Matrix requires a floating-point sample type");
 };
 
-}
\ No newline at end of file
+// static_assert(std::is_copy_constructible_v<Matrix<float>>);
+// static_assert(std::is_move_constructible_v<Matrix<float>>);
+static_assert(std::is_nothrow_move_assignable_v<Matrix<float>>);
+
+}
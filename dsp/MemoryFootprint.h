@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace utils
+{
+
+// Heap memory of an object, in bytes. Owned memory is allocated for the object alone, counted by
+// capacity: what it holds, not what it uses. Shared memory is held with other objects of the
+// process (the topology matrices of the TopologyCache), and is paid once however many share it.
+struct MemoryFootprint
+{
+    size_t owned { 0u };
+    size_t shared { 0u };
+
+    // Owned and shared bytes
+    size_t getBytes() const
+    {
+        return owned + shared;
+    }
+
+    MemoryFootprint& operator+=(const MemoryFootprint& other)
+    {
+        owned += other.owned;
+        shared += other.shared;
+        return *this;
+    }
+
+    // Owned bytes of a vector's storage
+    template <typename Value>
+    static size_t of(const std::vector<Value>& values)
+    {
+        return values.capacity() * sizeof(Value);
+    }
+};
+
+}
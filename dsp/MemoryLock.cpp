@@ -0,0 +1,103 @@
+#include <cassert>
+
+#if defined(_WIN32)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+#endif
+
+#include "MemoryLock.h"
+
+namespace utils
+{
+
+MemoryLock::~MemoryLock()
+{
+    unlockAll();
+}
+
+//================================================
+
+void MemoryLock::setLocking(bool shouldLock)
+{
+    locking = shouldLock;
+}
+
+bool MemoryLock::add(const void* data, size_t numBytes)
+{
+    if (data == nullptr || numBytes == 0u)
+        return true;
+
+    touch(data, numBytes);
+    touchedBytes += numBytes;
+
+    if (! locking)
+        return true;
+    if (! lockRegion(data, numBytes))
+        return false;
+
+    lockedRegions.emplace_back(data, numBytes);
+    lockedBytes += numBytes;
+    return true;
+}
+
+void MemoryLock::unlockAll()
+{
+    for (const auto& [data, numBytes] : lockedRegions)
+        unlockRegion(data, numBytes);
+    lockedRegions.clear();
+    touchedBytes = 0u;
+    lockedBytes = 0u;
+}
+
+//================================================
+
+size_t MemoryLock::getTouchedBytes() const
+{
+    return touchedBytes;
+}
+
+size_t MemoryLock::getLockedBytes() const
+{
+    return lockedBytes;
+}
+
+void MemoryLock::touch(const void* data, size_t numBytes)
+{
+    assert(data != nullptr && "Region must not be null");
+
+    // Volatile, so that the accesses are not optimised out; the last byte covers a partial last page.
+    // The regions belong to objects the audio thread writes: only the visitors see them as const
+    volatile unsigned char* bytes { static_cast<volatile unsigned char*>(const_cast<void*>(data)) };
+    for (size_t offset = 0; offset < numBytes; offset += pageSize)
+        bytes[offset] = bytes[offset];
+    bytes[numBytes - 1u] = bytes[numBytes - 1u];
+}
+
+//================================================
+
+bool MemoryLock::lockRegion(const void* data, size_t numBytes)
+{
+#if defined(_WIN32)
+    return VirtualLock(const_cast<void*>(data), numBytes) != 0;
+#else
+    return mlock(data, numBytes) == 0;
+#endif
+}
+
+void MemoryLock::unlockRegion(const void* data, size_t numBytes)
+{
+#if defined(_WIN32)
+    VirtualUnlock(const_cast<void*>(data), numBytes);
+#else
+    munlock(data, numBytes);
+#endif
+}
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace utils
+{
+
+// Receives the memory regions an object processes audio in, e.g. to prefault or lock them
+using MemoryVisitor = std::function<void(const void* data, size_t numBytes)>;
+
+// Keeps the memory of the audio thread resident. Adding a region touches each of its pages, so that
+// memory paged out while idle comes back before the first block instead of faulting in it, and
+// optionally locks them into RAM (mlock, VirtualLock) so that they are not paged out again.
+// Locking is best effort: the OS caps it (RLIMIT_MEMLOCK, the working set), and locks do not nest,
+// so unlocking a region also unlocks the pages it shares with other allocations.
+class MemoryLock
+{
+public:
+
+    // Constructor
+    MemoryLock() = default;
+
+    // Destructor: unlocks all regions
+    ~MemoryLock();
+
+    // No copy, no move: the locks belong to this object
+    MemoryLock(const MemoryLock&) = delete;
+    MemoryLock& operator=(const MemoryLock&) = delete;
+
+    //================================================
+
+    // Whether the regions added from now on are also locked. Off by default
+    void setLocking(bool shouldLock);
+
+    // Touch the pages of a region, and lock them if locking is on.
+    // Returns false if the lock was refused; the pages are touched anyway. Not for the audio thread
+    bool add(const void* data, size_t numBytes);
+
+    // Unlock and forget all regions
+    void unlockAll();
+
+    //================================================
+
+    // Bytes touched and locked since the last unlockAll
+    size_t getTouchedBytes() const;
+    size_t getLockedBytes() const;
+
+    // Read one byte of each page of a region and write it back, faulting in the ones that are not resident:
+    // a read alone leaves untouched and copy-on-write pages mapped to a shared page, which the first write of the
+    // audio thread then faults on. The region must be writable and not written by another thread meanwhile
+    static void touch(const void* data, size_t numBytes);
+
+private:
+
+    static bool lockRegion(const void* data, size_t numBytes);
+    static void unlockRegion(const void* data, size_t numBytes);
+
+    //================================================
+
+    bool locking { false };
+    size_t touchedBytes { 0u };
+    size_t lockedBytes { 0u };
+    std::vector<std::pair<const void*, size_t>> lockedRegions;
+
+    // Smallest page size of the supported platforms: larger pages are just touched more than once
+    static constexpr size_t pageSize { 4096u };
+};
+
+}
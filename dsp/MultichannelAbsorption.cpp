@@ -1,9 +1,13 @@
+#include <algorithm>
+
 #include "MultichannelAbsorption.h"
+#include "KernelDispatch.h"
 
 namespace DSP
 {
 
-MultichannelAbsorption::MultichannelAbsorption(uint32_t initFiltersNumber, const std::vector<std::pair<float, float>>& initFiltersMagValues)
+template <typename SampleType>
+MultichannelAbsorption<SampleType>::MultichannelAbsorption(uint32_t initFiltersNumber, const std::vector<std::pair<SampleType, SampleType>>& initFiltersMagValues)
 {
     // Check if the number of filters is valid
     jassert(initFiltersNumber > 0u && "Number of filters must be greater than zero");
@@ -16,20 +20,55 @@ MultichannelAbsorption::MultichannelAbsorption(uint32_t initFiltersNumber, const
     jassert(initFiltersMagValues.size() == static_cast<size_t>(filtersNumber) && "Filter magnitude values size must match the number of filters");
     for (size_t i = 0; i < static_cast<size_t>(filtersNumber); ++i)
         filters.emplace_back(initFiltersMagValues[i].first, initFiltersMagValues[i].second);
+
+    b0Values.resize(static_cast<size_t>(filtersNumber));
+    a1Values.resize(static_cast<size_t>(filtersNumber));
+    states.resize(static_cast<size_t>(filtersNumber), SampleType { 0 });
 }
 
-MultichannelAbsorption::~MultichannelAbsorption()
+template <typename SampleType>
+MultichannelAbsorption<SampleType>::~MultichannelAbsorption()
 {
 }
 
-void MultichannelAbsorption::setFiltersMagnitudeValues(const std::vector<std::pair<float, float>>& newFiltersMagValues)
+template <typename SampleType>
+void MultichannelAbsorption<SampleType>::setFiltersMagnitudeValues(const std::vector<std::pair<SampleType, SampleType>>& newFiltersMagValues)
 {
     jassert(newFiltersMagValues.size() == filtersNumber && "New filter magnitude values size must match the number of filters");
     for (size_t i = 0; i < static_cast<size_t>(filtersNumber); ++i)
         filters[i].setMagValues(newFiltersMagValues[i].first, newFiltersMagValues[i].second);
 }
 
-void MultichannelAbsorption::prepare(double newSampleRate, int samplesPerBlock)
+template <typename SampleType>
+void MultichannelAbsorption<SampleType>::setControlInterval(uint32_t newControlInterval)
+{
+    for (auto& filter : filters)
+        filter.setControlInterval(newControlInterval);
+}
+
+template <typename SampleType>
+void MultichannelAbsorption<SampleType>::setKernels(const KernelTable<SampleType>* newKernels)
+{
+    kernels = newKernels;
+}
+
+template <typename SampleType>
+void MultichannelAbsorption<SampleType>::visitMemory(const utils::MemoryVisitor& visitor) const
+{
+    visitor(filters.data(), filters.size() * sizeof(filters[0]));
+    visitor(b0Values.data(), b0Values.size() * sizeof(SampleType));
+    visitor(a1Values.data(), a1Values.size() * sizeof(SampleType));
+    visitor(states.data(), states.size() * sizeof(SampleType));
+}
+
+template <typename SampleType>
+utils::MemoryFootprint MultichannelAbsorption<SampleType>::getMemoryFootprint() const
+{
+    return { utils::MemoryFootprint::of(filters) + utils::MemoryFootprint::of(b0Values) + utils::MemoryFootprint::of(a1Values) + utils::MemoryFootprint::of(states), 0u };
+}
+
+template <typename SampleType>
+void MultichannelAbsorption<SampleType>::prepare(double newSampleRate, int samplesPerBlock)
 {
     jassert(newSampleRate > 0.0 && "Sample rate must be greater than zero");
     sampleRate = newSampleRate;
@@ -39,19 +78,30 @@ void MultichannelAbsorption::prepare(double newSampleRate, int samplesPerBlock)
         filters[i].prepare(newSampleRate, samplesPerBlock);
 }
 
-void MultichannelAbsorption::clear()
+template <typename SampleType>
+void MultichannelAbsorption<SampleType>::clear()
 {
     for (size_t i = 0; i < static_cast<size_t>(filtersNumber); ++i)
         filters[i].clear();
+    std::fill(states.begin(), states.end(), SampleType { 0 });
 }
 
-void MultichannelAbsorption::processSample(float* outSamples, const float* inSamples, uint32_t numChannels)
+template <typename SampleType>
+void MultichannelAbsorption<SampleType>::processSample(SampleType* outSamples, const SampleType* inSamples, uint32_t numChannels)
 {
     jassert(numChannels == filtersNumber && "Number of channels must match the number of filters");
 
-    // Process each channel independently
+    // Coefficients of each channel, then all channels with the kernel of the CPU's instruction set
     for (size_t ch = 0; ch < static_cast<size_t>(numChannels); ++ch)
-        filters[ch].processSample(&outSamples[ch], &inSamples[ch]);
+        filters[ch].getNextCoefficients(b0Values[ch], a1Values[ch]);
+
+    const KernelTable<SampleType>& kernelTable { kernels != nullptr ? *kernels : KernelDispatch::getKernels<SampleType>() };
+    kernelTable.processOnePoleBank(outSamples, inSamples, b0Values.data(), a1Values.data(), states.data(), numChannels);
 }
 
+// =============================================
+
+template class MultichannelAbsorption<float>;
+template class MultichannelAbsorption<double>;
+
 }
\ No newline at end of file
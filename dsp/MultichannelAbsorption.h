@@ -1,20 +1,26 @@
 #pragma once
 
 #include <cstdint>
+#include <type_traits>
+#include <vector>
 
 #include <JuceHeader.h>
 
+#include "KernelDispatch.h"
+#include "MemoryFootprint.h"
+#include "MemoryLock.h"
 #include "OnePoleFilter.h"
 
 namespace DSP
 {
 
+template <typename SampleType>
 class MultichannelAbsorption
 {
 public:
     MultichannelAbsorption(
         uint32_t initFiltersNumber,
-        const std::vector<std::pair<float, float>>& initFiltersMagValues
+        const std::vector<std::pair<SampleType, SampleType>>& initFiltersMagValues
     );
     ~MultichannelAbsorption();
 
@@ -32,7 +38,19 @@ public:
     // =============================================
 
     // Set the filter coefficients (SOS) for the filters
-    void setFiltersMagnitudeValues(const std::vector<std::pair<float, float>>& newFiltersMagValues);
+    void setFiltersMagnitudeValues(const std::vector<std::pair<SampleType, SampleType>>& newFiltersMagValues);
+
+    // Advance the coefficient ramps of all filters once every interval samples
+    void setControlInterval(uint32_t newControlInterval);
+
+    // Run the bank with the kernels of one instruction set instead of the active ones (nullptr: the active ones)
+    void setKernels(const KernelTable<SampleType>* newKernels);
+
+    // Pass the filters, their coefficients and states to a visitor
+    void visitMemory(const utils::MemoryVisitor& visitor) const;
+
+    // Heap memory of the filters, their coefficients and states
+    utils::MemoryFootprint getMemoryFootprint() const;
 
     // =============================================
 
@@ -43,17 +61,25 @@ public:
     void clear();
 
     // Process multi-channel sample
-    void processSample(float* outSamples, const float* inSamples, uint32_t numChannels);
+    void processSample(SampleType* outSamples, const SampleType* inSamples, uint32_t numChannels);
 
 private:
     double sampleRate { 48000.0 };
 
     uint32_t filtersNumber;
-    std::vector<DSP::OnePoleFilter> filters;
+    // The filters run their coefficient ramps, the bank processes all channels at once
+    std::vector<DSP::OnePoleFilter<SampleType>> filters;
+    std::vector<SampleType> b0Values;
+    std::vector<SampleType> a1Values;
+    std::vector<SampleType> states;
+
+    const KernelTable<SampleType>* kernels { nullptr };
 
-    // static_assert(std::is_copy_constructible_v<MultichannelAbsorption>);
-    // static_assert(std::is_move_constructible_v<MultichannelAbsorption>);
-    static_assert(std::is_nothrow_move_assignable_v<MultichannelAbsorption>);
+    static_assert(std::is_floating_point_v<SampleType>, "MultichannelAbsorption requires a floating-point sample type");
 };
 
+// static_assert(std::is_copy_constructible_v<MultichannelAbsorption<float>>);
+// static_assert(std::is_move_constructible_v<MultichannelAbsorption<float>>);
+static_assert(std::is_nothrow_move_assignable_v<MultichannelAbsorption<float>>);
+
 }
\ No newline at end of file
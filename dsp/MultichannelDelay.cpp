@@ -1,12 +1,16 @@
 #include "MultichannelDelay.h"
+#include "Trace.h"
 
 namespace DSP
 {
 
-MultichannelDelay::MultichannelDelay(
+template <typename SampleType>
+MultichannelDelay<SampleType>::MultichannelDelay(
     uint32_t initDelayLinesNumber,
     const std::vector<size_t>& initDelayLinesMaxLengths,
-    const std::vector<size_t>& initDelayLengths
+    const std::vector<size_t>& initDelayLengths,
+    primitives::DelayStorage initStorage /*= primitives::DelayStorage::float32*/,
+    float initHeadroom /*= primitives::DelayLine<SampleType>::defaultHeadroom*/
 )
 {
     // Check if the number of delay lines is valid
@@ -20,37 +24,106 @@ MultichannelDelay::MultichannelDelay(
     jassert(initDelayLinesMaxLengths.size() == static_cast<size_t>(delayLinesNumber) && "Delay-line-length size must match the number of delay lines");
     jassert(initDelayLengths.size() == static_cast<size_t>(delayLinesNumber) && "Initial delay lengths size must match the number of delay lines");
     for (size_t i = 0; i < static_cast<size_t>(delayLinesNumber); ++i)
-        delayLines.emplace_back(initDelayLinesMaxLengths[i], initDelayLengths[i]);
+        delayLines.emplace_back(static_cast<uint32_t>(initDelayLinesMaxLengths[i]), static_cast<uint32_t>(initDelayLengths[i]), initStorage, initHeadroom);
 }
 
-MultichannelDelay::~MultichannelDelay()
+template <typename SampleType>
+MultichannelDelay<SampleType>::~MultichannelDelay()
 {
 }
 
-void MultichannelDelay::setDelayLinesLengths(const std::vector<size_t>& newDelaysSamples)
+template <typename SampleType>
+void MultichannelDelay<SampleType>::setDelayLinesLengths(const std::vector<size_t>& newDelaysSamples)
 {
     jassert(newDelaysSamples.size() == delayLinesNumber && "New delay-line-length size must match the number of delay lines");
     for (size_t i = 0; i < static_cast<size_t>(delayLinesNumber); ++i)
-        delayLines[i].setDelay(newDelaysSamples[i]);
+        delayLines[i].setDelay(static_cast<uint32_t>(newDelaysSamples[i]));
 }
 
-void MultichannelDelay::prepare(double newSampleRate, int samplesPerBlock)
+template <typename SampleType>
+void MultichannelDelay<SampleType>::crossfadeDelayLinesLengths(const std::vector<size_t>& newDelaysSamples)
+{
+    jassert(newDelaysSamples.size() == delayLinesNumber && "New delay-line-length size must match the number of delay lines");
+    for (size_t i = 0; i < static_cast<size_t>(delayLinesNumber); ++i)
+        delayLines[i].crossfadeToDelay(static_cast<uint32_t>(newDelaysSamples[i]));
+}
+
+template <typename SampleType>
+void MultichannelDelay<SampleType>::setInterpolation(primitives::Interpolation newInterpolation)
+{
+    for (auto& delayLine : delayLines)
+        delayLine.setInterpolation(newInterpolation);
+}
+
+template <typename SampleType>
+size_t MultichannelDelay<SampleType>::getMaxDelayLineLength(uint32_t delayLineIndex) const
+{
+    jassert(delayLineIndex < delayLinesNumber && "Delay line index out of range");
+    return static_cast<size_t>(delayLines[delayLineIndex].getMaxDelay());
+}
+
+template <typename SampleType>
+primitives::DelayStorage MultichannelDelay<SampleType>::getStorage() const
+{
+    return delayLines.front().getStorage();
+}
+
+template <typename SampleType>
+void MultichannelDelay<SampleType>::copyStateFrom(const MultichannelDelay& other)
+{
+    DSP_TRACE_SCOPE("MultichannelDelay::copyStateFrom");
+    jassert(other.delayLinesNumber == delayLinesNumber && "Number of delay lines must match");
+    for (size_t i = 0; i < static_cast<size_t>(delayLinesNumber); ++i)
+        delayLines[i].copyStateFrom(other.delayLines[i]);
+}
+
+template <typename SampleType>
+bool MultichannelDelay<SampleType>::migrateStateFrom(const MultichannelDelay& other, size_t maxBlockSize)
+{
+    DSP_TRACE_SCOPE("MultichannelDelay::migrateStateFrom");
+    jassert(other.delayLinesNumber == delayLinesNumber && "Number of delay lines must match");
+    bool complete { true };
+    for (size_t i = 0; i < static_cast<size_t>(delayLinesNumber); ++i)
+        complete = delayLines[i].migrateStateFrom(other.delayLines[i], maxBlockSize) && complete;
+    return complete;
+}
+
+template <typename SampleType>
+void MultichannelDelay<SampleType>::visitMemory(const utils::MemoryVisitor& visitor) const
+{
+    for (const auto& delayLine : delayLines)
+        delayLine.visitMemory(visitor);
+}
+
+template <typename SampleType>
+utils::MemoryFootprint MultichannelDelay<SampleType>::getMemoryFootprint() const
+{
+    utils::MemoryFootprint footprint { utils::MemoryFootprint::of(delayLines), 0u };
+    for (const auto& delayLine : delayLines)
+        footprint += delayLine.getMemoryFootprint();
+    return footprint;
+}
+
+template <typename SampleType>
+void MultichannelDelay<SampleType>::prepare(double newSampleRate, int samplesPerBlock)
 {
     jassert(newSampleRate > 0.0 && "Sample rate must be greater than zero");
     sampleRate = newSampleRate;
 
     // Prepare each delay line for processing
     for (size_t i = 0; i < static_cast<size_t>(delayLinesNumber); ++i)
-        delayLines[i].prepare(newSampleRate, samplesPerBlock);
+        delayLines[i].prepare();
 }
 
-void MultichannelDelay::clear()
+template <typename SampleType>
+void MultichannelDelay<SampleType>::clear()
 {
     for (size_t i = 0; i < static_cast<size_t>(delayLinesNumber); ++i)
         delayLines[i].clear();
 }
 
-void MultichannelDelay::processSample(float* outSamples, const float* inSamples, uint32_t numChannels)
+template <typename SampleType>
+void MultichannelDelay<SampleType>::processSample(SampleType* outSamples, const SampleType* inSamples, uint32_t numChannels)
 {
     jassert(numChannels == delayLinesNumber && "Number of channels must match the number of delay lines");
 
@@ -59,13 +132,19 @@ void MultichannelDelay::processSample(float* outSamples, const float* inSamples,
         delayLines[ch].processSample(&outSamples[ch], &inSamples[ch]);
 }
 
-void MultichannelDelay::processSample(float* outSamples, const float* inSamples, const float* modInput, uint32_t numChannels)
+template <typename SampleType>
+void MultichannelDelay<SampleType>::processSample(SampleType* outSamples, const SampleType* inSamples, const float* modInput, uint32_t numChannels)
 {
     jassert(numChannels == delayLinesNumber && "Number of channels must match the number of delay lines");
 
     // Process each channel independently with modulation
     for (size_t ch = 0; ch < static_cast<size_t>(numChannels); ++ch)
-        delayLines[ch].processSample(&outSamples[ch], &inSamples[ch], &modInput[ch]);
+        delayLines[ch].processSample(&outSamples[ch], &inSamples[ch], modInput[ch]);
 }
 
+// =============================================
+
+template class MultichannelDelay<float>;
+template class MultichannelDelay<double>;
+
 }
\ No newline at end of file
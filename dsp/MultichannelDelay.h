@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <type_traits>
 
 #include <JuceHeader.h>
 
@@ -9,13 +10,16 @@
 namespace DSP
 {
 
+template <typename SampleType>
 class MultichannelDelay
 {
 public:
     MultichannelDelay(
         uint32_t initDelayLinesNumber,
         const std::vector<size_t>& initDelayLinesMaxLengths,
-        const std::vector<size_t>& initDelayLengths
+        const std::vector<size_t>& initDelayLengths,
+        primitives::DelayStorage initStorage = primitives::DelayStorage::float32,
+        float initHeadroom = primitives::DelayLine<SampleType>::defaultHeadroom
     );
     ~MultichannelDelay();
 
@@ -35,6 +39,30 @@ public:
     // Set the delay time in samples of the delay lines
     void setDelayLinesLengths(const std::vector<size_t>& newDelayLinesLengths);
 
+    // Jump to new delay times with a crossfade between the old and the new read heads
+    void crossfadeDelayLinesLengths(const std::vector<size_t>& newDelayLinesLengths);
+
+    // Set the read interpolation of all delay lines
+    void setInterpolation(primitives::Interpolation newInterpolation);
+
+    // Returns the maximum delay time of one delay line
+    size_t getMaxDelayLineLength(uint32_t delayLineIndex) const;
+
+    // Sample format of the delay memory
+    primitives::DelayStorage getStorage() const;
+
+    // Copy the delay histories of another, smaller or equal, multichannel delay, in this one's storage. No allocation
+    void copyStateFrom(const MultichannelDelay& other);
+    // The same, in bounded steps per block while the other one keeps processing (DelayLine::migrateStateFrom).
+    // Returns true once every line holds its history
+    bool migrateStateFrom(const MultichannelDelay& other, size_t maxBlockSize);
+
+    // Pass the delay buffers to a visitor
+    void visitMemory(const utils::MemoryVisitor& visitor) const;
+
+    // Heap memory of the delay lines and their buffers
+    utils::MemoryFootprint getMemoryFootprint() const;
+
     // =============================================
 
     // Prepare the delay lines for processing
@@ -45,21 +73,23 @@ public:
 
     // Fixed delay length
     // Process multi-channel sample
-    void processSample(float* outSamples, const float* inSamples, uint32_t numChannels);
+    void processSample(SampleType* outSamples, const SampleType* inSamples, uint32_t numChannels);
 
     // Modulated delay length (linear interpolation)
     // Process multi-channel sample
-    void processSample(float* outSamples, const float* inSamples, const float* modInput, uint32_t numChannels);
+    void processSample(SampleType* outSamples, const SampleType* inSamples, const float* modInput, uint32_t numChannels);
 
 private:
     double sampleRate { 48000.0 };
 
     uint32_t delayLinesNumber;
-    std::vector<DSP::DelayLine> delayLines;
+    std::vector<primitives::DelayLine<SampleType>> delayLines;
 
-    // static_assert(std::is_copy_constructible_v<MultichannelDelay>);
-    // static_assert(std::is_move_constructible_v<MultichannelDelay>);
-    static_assert(std::is_nothrow_move_assignable_v<MultichannelDelay>);
+    static_assert(std::is_floating_point_v<SampleType>, "MultichannelDelay requires a floating-point sample type");
 };
 
+// static_assert(std::is_copy_constructible_v<MultichannelDelay<float>>);
+// static_assert(std::is_move_constructible_v<MultichannelDelay<float>>);
+static_assert(std::is_nothrow_move_assignable_v<MultichannelDelay<float>>);
+
 }
\ No newline at end of file
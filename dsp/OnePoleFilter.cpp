@@ -1,18 +1,45 @@
 #include "OnePoleFilter.h"
+#include "Trace.h"
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <vector>
 
 namespace DSP
 {
 
-OnePoleFilter::OnePoleFilter(float initMagDC, float initMagNY) : 
-    b0Ramp { 480u },
-    a1Ramp { 480u },
-    feedbackState { 0.f }
+template <typename SampleType>
+void OnePoleFilter<SampleType>::CoefficientRamp::setTarget(SampleType newTarget, bool skipRamp /*= false*/)
+{
+    target = newTarget;
+    if (skipRamp)
+    {
+        current = target;
+        remaining = 0u;
+        return;
+    }
+    step = (target - current) / static_cast<SampleType>(rampSamples);
+    remaining = rampSamples;
+}
+
+template <typename SampleType>
+SampleType OnePoleFilter<SampleType>::CoefficientRamp::getNextValue()
+{
+    // Land on the target exactly at the end of the ramp
+    if (remaining > 0u)
+        current = --remaining == 0u ? target : current + step;
+    return current;
+}
+
+// =============================================
+
+template <typename SampleType>
+OnePoleFilter<SampleType>::OnePoleFilter(SampleType initMagDC, SampleType initMagNY) : 
+    feedbackState { 0 }
 {
     // Check if the magnitudes at DC and Nyquist are in the valid range
-    jassert(initMagDC >= 0.f && initMagDC <= 1.f && "Magnitude at DC must be in [0, 1]");
-    jassert(initMagNY >= 0.f && initMagNY <= 1.f && "Magnitude at Nyquist must be in [0, 1]");
+    jassert(initMagDC >= SampleType { 0 } && initMagDC <= SampleType { 1 } && "Magnitude at DC must be in [0, 1]");
+    jassert(initMagNY >= SampleType { 0 } && initMagNY <= SampleType { 1 } && "Magnitude at Nyquist must be in [0, 1]");
     // Initialize the magnitudes
     currentMagDC = initMagDC;
     currentMagNY = initMagNY;
@@ -25,27 +52,30 @@ OnePoleFilter::OnePoleFilter(float initMagDC, float initMagNY) :
     a1Ramp.setTarget(a1, true);
 }
 
-OnePoleFilter::~OnePoleFilter()
+template <typename SampleType>
+OnePoleFilter<SampleType>::~OnePoleFilter()
 {
 }
 
-void OnePoleFilter::computeCoefficients()
+template <typename SampleType>
+void OnePoleFilter<SampleType>::computeCoefficients()
 {
     // Calculate the coefficients based on the updated magnitudes
-    float r = currentMagDC / currentMagNY;
+    SampleType r = currentMagDC / currentMagNY;
 
-    a1 = ( 1 -  r ) / ( 1 + r ); 
-    b0 = ( 1 - a1 ) * currentMagNY;
+    a1 = ( SampleType { 1 } -  r ) / ( SampleType { 1 } + r ); 
+    b0 = ( SampleType { 1 } - a1 ) * currentMagNY;
 
     // Set the targets for the ramps
     b0Ramp.setTarget(b0);
     a1Ramp.setTarget(a1);
 }
 
-void OnePoleFilter::setMagValues(float newMagDC, float newMagNY)
+template <typename SampleType>
+void OnePoleFilter<SampleType>::setMagValues(SampleType newMagDC, SampleType newMagNY)
 {
-    jassert(newMagDC >= 0.f && newMagDC <= 1.f && "Magnitude at DC must be in [0, 1]");
-    jassert(newMagNY >= 0.f && newMagNY <= 1.f && "Magnitude at Nyquist must be in [0, 1]");
+    jassert(newMagDC >= SampleType { 0 } && newMagDC <= SampleType { 1 } && "Magnitude at DC must be in [0, 1]");
+    jassert(newMagNY >= SampleType { 0 } && newMagNY <= SampleType { 1 } && "Magnitude at Nyquist must be in [0, 1]");
     currentMagDC = newMagDC;
     currentMagNY = newMagNY;
 
@@ -53,46 +83,89 @@ void OnePoleFilter::setMagValues(float newMagDC, float newMagNY)
     computeCoefficients();
 }
 
-void OnePoleFilter::prepare(double newSampleRate, int samplesPerBlock)
+template <typename SampleType>
+void OnePoleFilter<SampleType>::setControlInterval(uint32_t newControlInterval)
+{
+    jassert(newControlInterval > 0u && "Control interval must be greater than zero");
+    controlInterval = newControlInterval;
+    controlCounter = 0u;
+}
+
+template <typename SampleType>
+void OnePoleFilter<SampleType>::prepare(double /*newSampleRate*/, int samplesPerBlock)
 {
-    b0Ramp.prepare(newSampleRate, samplesPerBlock);
-    a1Ramp.prepare(newSampleRate, samplesPerBlock);
+    // The ramps are counted in samples, at any rate
+    b0Values.resize(static_cast<size_t>(std::max(samplesPerBlock, 1)));
+    a1Values.resize(static_cast<size_t>(std::max(samplesPerBlock, 1)));
 }
 
 
-void OnePoleFilter::clear()
+template <typename SampleType>
+void OnePoleFilter<SampleType>::clear()
 {
     // Clear the feedback state for each channel
-    feedbackState = 0.f;
+    feedbackState = SampleType { 0 };
 }
 
-void OnePoleFilter::processSample(float* output, const float* input)
+template <typename SampleType>
+void OnePoleFilter<SampleType>::getNextCoefficients(SampleType& b0Value, SampleType& a1Value)
+{
+    // Get the next ramp values, held between control ticks
+    if (controlCounter == 0u)
+    {
+        b0Held = b0Ramp.getNextValue();
+        a1Held = a1Ramp.getNextValue();
+        controlCounter = controlInterval;
+    }
+    --controlCounter;
+
+    b0Value = b0Held;
+    a1Value = a1Held;
+}
+
+template <typename SampleType>
+void OnePoleFilter<SampleType>::processSample(SampleType* output, const SampleType* input)
 {   
-    // Get the next ramp values
-    float b0Value;
-    float a1Value;
-    b0Ramp.assignSample(&b0Value);
-    a1Ramp.assignSample(&a1Value);
+    getNextCoefficients(b0Held, a1Held);
 
     // Process single-channel sample
-    *output = ( b0Value * *input ) - ( a1Value * feedbackState );
+    *output = ( b0Held * *input ) - ( a1Held * feedbackState );
     feedbackState = *output;
 }
 
-void OnePoleFilter::processBuffer(float* output, const float* input, uint32_t numSamples)
+template <typename SampleType>
+void OnePoleFilter<SampleType>::processBuffer(SampleType* output, const SampleType* input, uint32_t numSamples)
 {
-    // Get the next ramp values
-    std::vector<float> b0Value(numSamples);
-    std::vector<float> a1Value(numSamples);
-    b0Ramp.assignBuffer(b0Value.data(), numSamples);
-    a1Ramp.assignBuffer(a1Value.data(), numSamples);
-
-    // Process single-channel buffer
-    for (size_t n = 0; n < static_cast<size_t>(numSamples); ++n)
+    DSP_TRACE_SCOPE("OnePoleFilter::processBuffer");
+    jassert(! b0Values.empty() && "Filter must be prepared");
+    if (b0Values.empty())
+        return;
+
+    // In parts of at most the prepared block size
+    for (uint32_t start = 0; start < numSamples;)
     {
-        output[n] = ( b0Value[n] * input[n] ) - ( a1Value[n] * feedbackState );
-        feedbackState = output[n];
+        const size_t partSize { std::min(static_cast<size_t>(numSamples - start), b0Values.size()) };
+
+        // Get the next ramp values
+        for (size_t n = 0; n < partSize; ++n)
+        {
+            b0Values[n] = b0Ramp.getNextValue();
+            a1Values[n] = a1Ramp.getNextValue();
+        }
+
+        // Process single-channel buffer
+        for (size_t n = 0; n < partSize; ++n)
+        {
+            output[start + n] = ( b0Values[n] * input[start + n] ) - ( a1Values[n] * feedbackState );
+            feedbackState = output[start + n];
+        }
+        start += static_cast<uint32_t>(partSize);
     }
 }
 
-}
\ No newline at end of file
+// =============================================
+
+template class OnePoleFilter<float>;
+template class OnePoleFilter<double>;
+
+}
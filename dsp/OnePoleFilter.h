@@ -1,17 +1,22 @@
 #pragma once
 
-#include "Ramp.h"
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include <JuceHeader.h>
 
 namespace DSP
 {
 
+template <typename SampleType>
 class OnePoleFilter
 {
 public:
     // Constructor
     OnePoleFilter(
-        float initMagDC,
-        float initMagNY
+        SampleType initMagDC,
+        SampleType initMagNY
     );
     // Destructor
     ~OnePoleFilter();
@@ -29,11 +34,15 @@ public:
     void computeCoefficients();
 
     // Set new coefficients
-    void setMagValues(float newMagDC, float newMagNY);
+    void setMagValues(SampleType newMagDC, SampleType newMagNY);
+
+    // Advance the coefficient ramps once every interval samples (1: every sample).
+    // Larger intervals are cheaper, and stretch the ramps by the interval
+    void setControlInterval(uint32_t newControlInterval);
 
     // =============================================
 
-    // Prepare coefficient ramp
+    // Allocate the coefficient buffers of processBuffer for blocks of up to samplesPerBlock
     void prepare(double newSampleRate, int samplesPerBlock);
 
     // Clear content of internal buffer
@@ -41,29 +50,60 @@ public:
 
     // =============================================
     // Process single-channel sample
-    void processSample(float* output, const float* input);
+    void processSample(SampleType* output, const SampleType* input);
+
+    // Advance the coefficient ramps by one sample and get the coefficients, for a filter bank that
+    // keeps the states of its filters itself (see MultichannelAbsorption)
+    void getNextCoefficients(SampleType& b0Value, SampleType& a1Value);
 
     // Process single-channel buffer
-    void processBuffer(float* output, const float* input, uint32_t numSamples);
+    void processBuffer(SampleType* output, const SampleType* input, uint32_t numSamples);
 
     // =============================================
 
 private:
+    // Linear ramp of a coefficient to its target, over rampSamples samples
+    struct CoefficientRamp
+    {
+        // Start a ramp from the current value, or jump to the target
+        void setTarget(SampleType newTarget, bool skipRamp = false);
+        // Advance by one sample
+        SampleType getNextValue();
+
+        SampleType current { 0 };
+        SampleType target { 0 };
+        SampleType step { 0 };
+        uint32_t remaining { 0u };
+    };
+
+    static constexpr uint32_t rampSamples { 480u };
+
     // Magnitude at DC and Nyquist
-    float currentMagDC;
-    float currentMagNY;
-    // Filter coefficients
-    DSP::Ramp b0Ramp;
-    float b0;
-    DSP::Ramp a1Ramp;
-    float a1;
+    SampleType currentMagDC;
+    SampleType currentMagNY;
+    // Filter coefficients, ramped in SampleType precision
+    CoefficientRamp b0Ramp;
+    SampleType b0;
+    CoefficientRamp a1Ramp;
+    SampleType a1;
+    // Ramp values held between control ticks
+    SampleType b0Held { 0 };
+    SampleType a1Held { 0 };
+    uint32_t controlInterval { 1u };
+    uint32_t controlCounter { 0u };
 
     // one state per channel
-    float feedbackState;
+    SampleType feedbackState;
+
+    // Coefficients of each sample of a processBuffer part, allocated in prepare
+    std::vector<SampleType> b0Values;
+    std::vector<SampleType> a1Values;
 
-    // static_assert(std::is_copy_constructible_v<OnePoleFilter>);
-    // static_assert(std::is_move_constructible_v<OnePoleFilter>);
-    static_assert(std::is_nothrow_move_assignable_v<OnePoleFilter>);
+    static_assert(std::is_floating_point_v<SampleType>, "OnePoleFilter requires a floating-point sample type");
 };
 
-}
\ No newline at end of file
+// static_assert(std::is_copy_constructible_v<OnePoleFilter<float>>);
+// static_assert(std::is_move_constructible_v<OnePoleFilter<float>>);
+static_assert(std::is_nothrow_move_assignable_v<OnePoleFilter<float>>);
+
+}
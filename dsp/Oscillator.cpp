@@ -1,6 +1,5 @@
-#pragma once
-
 #include <cassert>
+#include <cmath>
 
 #include "Oscillator.h"
 
@@ -11,6 +10,7 @@ Oscillator::Oscillator(float initFrequency) :
     frequency { initFrequency }
 {
     amplitude.setSmoothingTime( uint32_t { 200u } );
+    Oscillator::setFrequency(initFrequency);
 }
 
 //================================================
@@ -19,28 +19,42 @@ void Oscillator::setFrequency(float newFrequency)
 {
     assert(newFrequency > 0.0f);
     frequency = newFrequency;
+    increment = static_cast<float>(static_cast<double>(frequency) / sampleRate);
 }
 
 //================================================
 
-void Oscillator::prepare()
+void Oscillator::prepare(double newSampleRate)
 {
+    assert(newSampleRate > 0.0);
+    sampleRate = newSampleRate;
+    Oscillator::setFrequency(frequency);
 
+    amplitude.prepare();
+    phase = 0.0f;
 }
 
 //================================================
 
 void Oscillator::fadeOut()
 {
-
+    amplitude.setTarget(0.0f);
 }
 
 void Oscillator::fadeIn()
 {
+    amplitude.setTarget(1.0f);
+}
+
+void Oscillator::processSample(float* outSample, const float* inSample)
+{
+    *outSample = *inSample * amplitude.getSample() * waveform::sine(phase);
 
+    phase += increment;
+    phase -= std::floor(phase);
 }
 
-void Oscillator::processBlock(float* outBlock, float* inBlock, uint32_t numSamples)
+void Oscillator::processBlock(float* outBlock, const float* inBlock, uint32_t numSamples)
 {
     for (uint32_t n = 0; n < numSamples; n++)
     {
@@ -48,4 +62,4 @@ void Oscillator::processBlock(float* outBlock, float* inBlock, uint32_t numSampl
     }
 }
 
-}
\ No newline at end of file
+}
@@ -1,14 +1,16 @@
 #pragma once
 
-// #include <cstdint>
-// #include <cstddef>
+#include <cstdint>
 #include <type_traits>
 
+#include "OscillatorBank.h"
 #include "SmoothParameter.h"
 
 namespace primitives
 {
 
+// Single sine oscillator, multiplying its input (tremolo / ring modulation).
+// For several modulation signals use OscillatorBank, which generates them block-wise.
 class Oscillator
 {
 public:
@@ -32,25 +34,33 @@ public:
 
     //================================================
 
-    void prepare();
+    // Set the sample rate and restart the phase
+    void prepare(double newSampleRate);
 
     //================================================
 
+    // Smoothly fade the amplitude to zero or to one
     void fadeOut();
     void fadeIn();
 
     //================================================
 
-    virtual void processSample(float* outSample, float* inSample);
+    void processSample(float* outSample, const float* inSample);
 
-    void processBlock(float* outBlock, float* inBlock, uint32_t numSamples);
+    void processBlock(float* outBlock, const float* inBlock, uint32_t numSamples);
 
 private:
 
+    double sampleRate { 48000.0 };
+
     float frequency;
+    float phase { 0.0f };
+    float increment { 0.0f };
 
     utils::SmoothParameter amplitude { float { 1.0f } };
 
 };
 
-}
\ No newline at end of file
+static_assert(std::is_nothrow_move_assignable_v<Oscillator>, "Move assignment should not throw");
+
+}
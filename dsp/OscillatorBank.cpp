@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "OscillatorBank.h"
+#include "Trace.h"
+
+namespace primitives
+{
+
+OscillatorBank::OscillatorBank(uint32_t initNumOscillators, Waveform initWaveform, float initFrequency) :
+    numOscillators { initNumOscillators },
+    waveform { initWaveform }
+{
+    assert(numOscillators > 0 && "Number of oscillators must be greater than zero");
+    assert(initFrequency >= 0.0f && "Frequency must not be negative");
+
+    frequencies.resize(numOscillators, initFrequency);
+    increments.resize(numOscillators, 0.0f);
+
+    // Equally spread phase offsets
+    phaseOffsets.resize(numOscillators);
+    for (uint32_t i = 0; i < numOscillators; ++i)
+        phaseOffsets[i] = static_cast<float>(i) / static_cast<float>(numOscillators);
+    phases = phaseOffsets;
+
+    // One random stream per oscillator (xorshift state must not be zero)
+    randomStates.resize(numOscillators);
+    for (uint32_t i = 0; i < numOscillators; ++i)
+        randomStates[i] = 0x9E3779B9u * (i + 1u);
+    randomFrom.resize(numOscillators, 0.0f);
+    randomTo.resize(numOscillators, 0.0f);
+
+    amplitude.setSmoothingTime( uint32_t { 200u } );
+
+    OscillatorBank::setFrequency(initFrequency);
+}
+
+//================================================
+
+void OscillatorBank::setFrequency(float newFrequency)
+{
+    for (uint32_t i = 0; i < numOscillators; ++i)
+        OscillatorBank::setFrequency(i, newFrequency);
+}
+
+void OscillatorBank::setFrequency(uint32_t oscillatorIndex, float newFrequency)
+{
+    assert(oscillatorIndex < numOscillators && "Oscillator index out of range");
+    assert(newFrequency >= 0.0f && "Frequency must not be negative");
+    assert(static_cast<double>(newFrequency) < 0.5 * sampleRate && "Frequency must be below Nyquist");
+
+    frequencies[oscillatorIndex] = newFrequency;
+    increments[oscillatorIndex] = static_cast<float>(static_cast<double>(newFrequency) / sampleRate);
+}
+
+void OscillatorBank::setWaveform(Waveform newWaveform)
+{
+    waveform = newWaveform;
+}
+
+void OscillatorBank::setAmplitude(float newAmplitude)
+{
+    amplitude.setTarget(newAmplitude);
+}
+
+uint32_t OscillatorBank::getNumOscillators() const
+{
+    return numOscillators;
+}
+
+utils::MemoryFootprint OscillatorBank::getMemoryFootprint() const
+{
+    utils::MemoryFootprint footprint;
+    for (const auto* values : { &frequencies, &phaseOffsets, &phases, &increments, &randomFrom, &randomTo, &amplitudeBuffer })
+        footprint.owned += utils::MemoryFootprint::of(*values);
+    footprint.owned += utils::MemoryFootprint::of(randomStates);
+    return footprint;
+}
+
+//================================================
+
+void OscillatorBank::prepare(double newSampleRate, uint32_t maxBlockSize)
+{
+    assert(newSampleRate > 0.0 && "Sample rate must be greater than zero");
+    sampleRate = newSampleRate;
+
+    // Increments depend on the sample rate
+    for (uint32_t i = 0; i < numOscillators; ++i)
+        increments[i] = static_cast<float>(static_cast<double>(frequencies[i]) / sampleRate);
+
+    amplitudeBuffer.resize(static_cast<size_t>(maxBlockSize));
+    amplitude.prepare();
+
+    OscillatorBank::reset();
+}
+
+void OscillatorBank::reset()
+{
+    phases = phaseOffsets;
+    for (uint32_t i = 0; i < numOscillators; ++i)
+    {
+        randomFrom[i] = nextRandom(i);
+        randomTo[i] = nextRandom(i);
+    }
+}
+
+//================================================
+
+void OscillatorBank::fadeOut()
+{
+    amplitude.setTarget(0.0f);
+}
+
+void OscillatorBank::fadeIn()
+{
+    amplitude.setTarget(1.0f);
+}
+
+//================================================
+
+void OscillatorBank::processBlock(float* const* outputs, uint32_t numSamples)
+{
+    DSP_TRACE_SCOPE("OscillatorBank::processBlock");
+    assert(static_cast<size_t>(numSamples) <= amplitudeBuffer.size() && "Block is larger than the prepared block size");
+
+    // Amplitude is shared by all oscillators
+    amplitude.getBlock(amplitudeBuffer.data(), numSamples);
+    const float* amplitudeData { amplitudeBuffer.data() };
+    // Signed sample index, and phases wrapped by truncation as they are non-negative: both convert with
+    // vector instructions, where uint32 to float and std::floor keep the loops scalar
+    const int32_t length { static_cast<int32_t>(numSamples) };
+
+    for (uint32_t i = 0; i < numOscillators; ++i)
+    {
+        float* output { outputs[i] };
+        const float startPhase { phases[i] };
+        const float increment { increments[i] };
+
+        switch (waveform)
+        {
+            case Waveform::sine:
+                for (int32_t n = 0; n < length; ++n)
+                {
+                    float phase { startPhase + increment * static_cast<float>(n) };
+                    phase -= static_cast<float>(static_cast<int32_t>(phase));
+                    output[n] = amplitudeData[n] * waveform::sine(phase);
+                }
+                break;
+
+            case Waveform::triangle:
+                for (int32_t n = 0; n < length; ++n)
+                {
+                    float phase { startPhase + increment * static_cast<float>(n) };
+                    phase -= static_cast<float>(static_cast<int32_t>(phase));
+                    output[n] = amplitudeData[n] * waveform::triangle(phase);
+                }
+                break;
+
+            case Waveform::noise:
+            {
+                // New random target on every wrap: sequential, but only a compare per sample
+                float phase { startPhase };
+                for (uint32_t n = 0; n < numSamples; ++n)
+                {
+                    output[n] = amplitudeData[n] * (randomFrom[i] + (randomTo[i] - randomFrom[i]) * phase);
+                    phase += increment;
+                    if (phase >= 1.0f)
+                    {
+                        phase -= 1.0f;
+                        randomFrom[i] = randomTo[i];
+                        randomTo[i] = nextRandom(i);
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    advance(numSamples);
+}
+
+void OscillatorBank::processControl(float* outValues, uint32_t numSamples)
+{
+    DSP_TRACE_SCOPE("OscillatorBank::processControl");
+    // One amplitude step per control tick
+    const float amplitudeValue { amplitude.getSample() };
+
+    for (uint32_t i = 0; i < numOscillators; ++i)
+    {
+        switch (waveform)
+        {
+            case Waveform::sine:     outValues[i] = amplitudeValue * waveform::sine(phases[i]); break;
+            case Waveform::triangle: outValues[i] = amplitudeValue * waveform::triangle(phases[i]); break;
+            case Waveform::noise:    outValues[i] = amplitudeValue * (randomFrom[i] + (randomTo[i] - randomFrom[i]) * phases[i]); break;
+        }
+    }
+
+    // Draw new random targets for the oscillators that complete a cycle
+    if (waveform == Waveform::noise)
+        for (uint32_t i = 0; i < numOscillators; ++i)
+            if (phases[i] + increments[i] * static_cast<float>(numSamples) >= 1.0f)
+            {
+                randomFrom[i] = randomTo[i];
+                randomTo[i] = nextRandom(i);
+            }
+
+    advance(numSamples);
+}
+
+//================================================
+
+void OscillatorBank::advance(uint32_t numSamples)
+{
+    for (uint32_t i = 0; i < numOscillators; ++i)
+    {
+        phases[i] += increments[i] * static_cast<float>(numSamples);
+        phases[i] -= std::floor(phases[i]);
+    }
+}
+
+float OscillatorBank::nextRandom(uint32_t oscillatorIndex)
+{
+    uint32_t state { randomStates[oscillatorIndex] };
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    randomStates[oscillatorIndex] = state;
+
+    // Top 24 bits to [-1, 1]
+    return static_cast<float>(state >> 8) * (2.0f / 16777215.0f) - 1.0f;
+}
+
+}
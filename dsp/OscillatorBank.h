@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "MemoryFootprint.h"
+#include "SmoothParameter.h"
+
+namespace primitives
+{
+
+// Waveforms of the oscillator bank
+enum class Waveform
+{
+    sine,
+    triangle,
+    noise   // smoothed random: a new random target every cycle, linearly interpolated
+};
+
+//================================================
+
+// Waveform kernels, for a phase in [0, 1). Branch-free, so loops over them vectorize
+namespace waveform
+{
+    // Parabolic sine approximation with one refinement step (max error ~0.1%)
+    inline float sine(float phase)
+    {
+        // Shift to [-0.5, 0.5): sin(2 pi phase) = -sin(2 pi t)
+        const float t { phase - 0.5f };
+        const float y { -8.0f * t * (1.0f - 2.0f * std::fabs(t)) };
+        return 0.225f * (y * std::fabs(y) - y) + y;
+    }
+
+    // Triangle with the same phase as the sine: 0 at phase 0, 1 at phase 0.25
+    inline float triangle(float phase)
+    {
+        // Non-negative: truncation wraps it, and vectorizes where floor does not
+        float shifted { phase + 0.25f };
+        shifted -= static_cast<float>(static_cast<int32_t>(shifted));
+        return 1.0f - 4.0f * std::fabs(shifted - 0.5f);
+    }
+}
+
+//================================================
+
+// Bank of N low-frequency oscillators with equally spread phase offsets, for delay and matrix modulation.
+// Each oscillator's block is computed from its start phase (no sample-to-sample recurrence), so the
+// inner loops vectorize. The waveform is chosen once per block: there is no dispatch in the inner loop.
+class OscillatorBank
+{
+public:
+    // Constructor
+    OscillatorBank() = delete;
+    OscillatorBank(
+        uint32_t numOscillators,
+        Waveform initWaveform,
+        float initFrequency
+    );
+
+    // Destructor -> default
+
+    // Copy
+    OscillatorBank(const OscillatorBank&) = default;
+    OscillatorBank& operator=(const OscillatorBank&) = default;
+
+    // Move
+    OscillatorBank(OscillatorBank&&) noexcept = default;
+    OscillatorBank& operator=(OscillatorBank&&) noexcept = default;
+
+    //================================================
+
+    // Set the frequency in Hz of all the oscillators
+    void setFrequency(float newFrequency);
+
+    // Set the frequency in Hz of one oscillator
+    void setFrequency(uint32_t oscillatorIndex, float newFrequency);
+
+    // Set the waveform of all the oscillators
+    void setWaveform(Waveform newWaveform);
+
+    // Set the output amplitude, smoothed
+    void setAmplitude(float newAmplitude);
+
+    // Returns the number of oscillators
+    uint32_t getNumOscillators() const;
+
+    // Heap memory of the oscillator states and the amplitude buffer
+    utils::MemoryFootprint getMemoryFootprint() const;
+
+    //================================================
+
+    // Set the sample rate and allocate the amplitude buffer for the maximum block size
+    void prepare(double newSampleRate, uint32_t maxBlockSize);
+
+    // Restart the oscillators at their phase offsets
+    void reset();
+
+    //================================================
+
+    // Smoothly fade the amplitude to zero or to one
+    void fadeOut();
+    void fadeIn();
+
+    //================================================
+
+    // Generate a block per oscillator: outputs[oscillator][sample]
+    void processBlock(float* const* outputs, uint32_t numSamples);
+
+    // Control rate: write one value per oscillator and advance the phases by numSamples
+    void processControl(float* outValues, uint32_t numSamples);
+
+private:
+
+    // Advance the phases by numSamples and wrap them in [0, 1)
+    void advance(uint32_t numSamples);
+
+    // Next value of the xorshift generator of one oscillator, in [-1, 1]
+    float nextRandom(uint32_t oscillatorIndex);
+
+    //================================================
+
+    double sampleRate { 48000.0 };
+
+    uint32_t numOscillators;
+    Waveform waveform;
+
+    // Structure of arrays, one entry per oscillator
+    std::vector<float> frequencies;
+    std::vector<float> phaseOffsets;
+    std::vector<float> phases;
+    std::vector<float> increments;
+
+    // Smoothed random state, one entry per oscillator
+    std::vector<uint32_t> randomStates;
+    std::vector<float> randomFrom;
+    std::vector<float> randomTo;
+
+    utils::SmoothParameter amplitude { float { 1.0f } };
+    std::vector<float> amplitudeBuffer;
+};
+
+static_assert(std::is_nothrow_move_assignable_v<OscillatorBank>, "Move assignment should not throw");
+
+}
@@ -0,0 +1,482 @@
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+#include "PagedDelayLine.h"
+#include "KernelDispatch.h"
+#include "Trace.h"
+
+namespace primitives
+{
+
+template <typename SampleType>
+DelayPagePool<SampleType>::DelayPagePool(uint32_t initPageSize /*= defaultPageSize*/) :
+    pageSize { initPageSize }
+{
+    assert(pageSize > 0u && (pageSize & (pageSize - 1u)) == 0u && "Page size must be a power of two");
+}
+
+template <typename SampleType>
+DelayPagePool<SampleType>::~DelayPagePool()
+{
+    trim();
+}
+
+template <typename SampleType>
+std::shared_ptr<DelayPagePool<SampleType>> DelayPagePool<SampleType>::getShared()
+{
+    static const std::shared_ptr<DelayPagePool> shared { std::make_shared<DelayPagePool>() };
+    return shared;
+}
+
+template <typename SampleType>
+uint32_t DelayPagePool<SampleType>::getPageSize() const
+{
+    return pageSize;
+}
+
+template <typename SampleType>
+SampleType* DelayPagePool<SampleType>::acquire()
+{
+    SampleType* page { nullptr };
+    {
+        const std::lock_guard<std::mutex> lock { mutex };
+        if (! idlePages.empty())
+        {
+            page = idlePages.back();
+            idlePages.pop_back();
+        }
+    }
+
+    if (page == nullptr)
+        page = new SampleType[pageSize];
+    std::fill(page, page + pageSize, SampleType { 0 });
+    return page;
+}
+
+template <typename SampleType>
+void DelayPagePool<SampleType>::release(SampleType* page)
+{
+    assert(page != nullptr && "Released page must not be null");
+    const std::lock_guard<std::mutex> lock { mutex };
+    idlePages.push_back(page);
+}
+
+template <typename SampleType>
+void DelayPagePool<SampleType>::trim(size_t numKeptPages /*= 0u*/)
+{
+    const std::lock_guard<std::mutex> lock { mutex };
+    while (idlePages.size() > numKeptPages)
+    {
+        delete[] idlePages.back();
+        idlePages.pop_back();
+    }
+}
+
+template <typename SampleType>
+size_t DelayPagePool<SampleType>::getNumIdlePages() const
+{
+    const std::lock_guard<std::mutex> lock { mutex };
+    return idlePages.size();
+}
+
+template <typename SampleType>
+utils::MemoryFootprint DelayPagePool<SampleType>::getMemoryFootprint() const
+{
+    const std::lock_guard<std::mutex> lock { mutex };
+    return { idlePages.size() * pageSize * sizeof(SampleType) + utils::MemoryFootprint::of(idlePages), 0u };
+}
+
+//================================================
+
+template <typename SampleType>
+PagedDelayLine<SampleType>::PagedDelayLine(uint32_t maxDelaySamples, uint32_t initDelaySamples, std::shared_ptr<DelayPagePool<SampleType>> initPool /*= nullptr*/) :
+    pool { initPool != nullptr ? std::move(initPool) : DelayPagePool<SampleType>::getShared() },
+    pageSize { pool->getPageSize() },
+    maxDelay { maxDelaySamples },
+    requestedDelay { initDelaySamples },
+    delayValue { static_cast<float>(initDelaySamples) },
+    fadeOutDelay { static_cast<float>(initDelaySamples) }
+{
+    assert(maxDelaySamples > 0 && "Maximum delay of the delay line must be greater than zero");
+    assert(initDelaySamples > 0 && "Initial delay of the delay line must be greater than zero");
+    assert(initDelaySamples <= maxDelaySamples && "Initial delay must be less than the maximum delay");
+
+    pageShift = 0u;
+    while ((1u << pageShift) < pageSize)
+        ++pageShift;
+    pageMask = static_cast<size_t>(pageSize) - size_t { 1u };
+
+    for (auto& slot : committedPages)
+        slot.store(nullptr, std::memory_order_relaxed);
+    for (auto& slot : retiredPages)
+        slot.store(nullptr, std::memory_order_relaxed);
+
+    // Page table for the maximum delay, so that linking pages never allocates. Pages for the initial delay
+    pages.resize(getPagesForDelay(maxDelay), nullptr);
+    numPages = getPagesForDelay(initDelaySamples);
+    for (size_t i = 0; i < numPages; ++i)
+        pages[i] = pool->acquire();
+    capacity = numPages << pageShift;
+    linkedPages.store(static_cast<uint32_t>(numPages), std::memory_order_release);
+
+    delayValue.setSmoothingTime(uint32_t { 1200u });
+    delayValue.setTarget(static_cast<float>(initDelaySamples), true);
+}
+
+template <typename SampleType>
+PagedDelayLine<SampleType>::~PagedDelayLine()
+{
+    for (size_t i = 0; i < numPages; ++i)
+        pool->release(pages[i]);
+    for (auto* slots : { &committedPages, &retiredPages })
+        for (auto& slot : *slots)
+            if (auto* page = slot.exchange(nullptr, std::memory_order_acq_rel))
+                pool->release(page);
+}
+
+//================================================
+
+template <typename SampleType>
+void PagedDelayLine<SampleType>::setDelay(uint32_t newDelaySamples)
+{
+    assert(newDelaySamples <= maxDelay && "New delay must be less than the maximum delay");
+    requestedDelay.store(newDelaySamples, std::memory_order_relaxed);
+    crossfadeRequested = false;
+    applyDelay();
+}
+
+template <typename SampleType>
+void PagedDelayLine<SampleType>::crossfadeToDelay(uint32_t newDelaySamples)
+{
+    assert(newDelaySamples <= maxDelay && "New delay must be less than the maximum delay");
+    assert(newDelaySamples > 0 && "Delay of the delay line must be greater than zero");
+    requestedDelay.store(newDelaySamples, std::memory_order_relaxed);
+    crossfadeRequested = true;
+    applyDelay();
+}
+
+template <typename SampleType>
+void PagedDelayLine<SampleType>::setCrossfadeTime(uint32_t newTimeInSamples)
+{
+    assert(newTimeInSamples > 0 && "Crossfade time must be greater than zero");
+    crossfadeSamples = newTimeInSamples;
+}
+
+template <typename SampleType>
+void PagedDelayLine<SampleType>::setInterpolation(Interpolation newInterpolation)
+{
+    interpolation = newInterpolation;
+}
+
+template <typename SampleType>
+uint32_t PagedDelayLine<SampleType>::getMaxDelay() const
+{
+    return maxDelay;
+}
+
+template <typename SampleType>
+uint32_t PagedDelayLine<SampleType>::getCommittedDelay() const
+{
+    return static_cast<uint32_t>(capacity - size_t { 1u });
+}
+
+template <typename SampleType>
+void PagedDelayLine<SampleType>::commitPages()
+{
+    DSP_TRACE_SCOPE("PagedDelayLine::commitPages");
+    const uint32_t wantedPages { getPagesForDelay(requestedDelay.load(std::memory_order_relaxed)) };
+
+    // Pages linked or waiting in a slot. Only this thread fills the slots: the audio thread empties them
+    uint32_t availablePages { linkedPages.load(std::memory_order_acquire) };
+    for (const auto& slot : committedPages)
+        if (slot.load(std::memory_order_acquire) != nullptr)
+            ++availablePages;
+
+    for (auto& slot : committedPages)
+    {
+        if (availablePages < wantedPages && slot.load(std::memory_order_acquire) == nullptr)
+        {
+            slot.store(pool->acquire(), std::memory_order_release);
+            ++availablePages;
+        }
+        // A shorter delay was requested since: take back what is not linked yet
+        else if (availablePages > wantedPages)
+        {
+            if (auto* page = slot.exchange(nullptr, std::memory_order_acq_rel))
+            {
+                pool->release(page);
+                --availablePages;
+            }
+        }
+    }
+
+    for (auto& slot : retiredPages)
+        if (auto* page = slot.exchange(nullptr, std::memory_order_acq_rel))
+            pool->release(page);
+}
+
+template <typename SampleType>
+void PagedDelayLine<SampleType>::visitMemory(const utils::MemoryVisitor& visitor) const
+{
+    for (size_t i = 0; i < numPages; ++i)
+        visitor(pages[i], static_cast<size_t>(pageSize) * sizeof(SampleType));
+}
+
+template <typename SampleType>
+utils::MemoryFootprint PagedDelayLine<SampleType>::getMemoryFootprint() const
+{
+    size_t numHeldPages { numPages };
+    for (const auto* slots : { &committedPages, &retiredPages })
+        for (const auto& slot : *slots)
+            if (slot.load(std::memory_order_acquire) != nullptr)
+                ++numHeldPages;
+
+    return { numHeldPages * pageSize * sizeof(SampleType) + utils::MemoryFootprint::of(pages), 0u };
+}
+
+//================================================
+
+template <typename SampleType>
+void PagedDelayLine<SampleType>::prepare()
+{
+    // Not processing: link the pages of the requested delay at once, and start on it
+    commitPages();
+    clear();
+    turnPage();
+    delayValue.setTarget(static_cast<float>(std::min(requestedDelay.load(std::memory_order_relaxed), getCommittedDelay())), true);
+    crossfadeRemaining = 0u;
+    delayPending = false;
+}
+
+template <typename SampleType>
+void PagedDelayLine<SampleType>::clear()
+{
+    for (size_t i = 0; i < numPages; ++i)
+        std::fill(pages[i], pages[i] + pageSize, SampleType { 0 });
+    writeIndex = size_t { 0u };
+}
+
+//================================================
+
+template <typename SampleType>
+SampleType PagedDelayLine<SampleType>::load(size_t index) const
+{
+    return pages[index >> pageShift][index & pageMask];
+}
+
+template <typename SampleType>
+SampleType PagedDelayLine<SampleType>::readInterpolated(float delay) const
+{
+    delay = std::min(delay, static_cast<float>(capacity - size_t { 1u }));
+    const float delayCeil  { std::ceil(delay) };
+    const SampleType delayFrac1 { static_cast<SampleType>(delayCeil - delay) };
+    const SampleType delayFrac0 { SampleType { 1 } - delayFrac1 };
+
+    const size_t readIndex0 { (writeIndex + capacity - static_cast<size_t>(delayCeil)) % capacity };
+    const size_t readIndex1 { (readIndex0 + size_t { 1u }) % capacity };
+    return load(readIndex0) * delayFrac0 + load(readIndex1) * delayFrac1;
+}
+
+template <typename SampleType>
+SampleType PagedDelayLine<SampleType>::readNearest(float delay) const
+{
+    delay = std::min(delay, static_cast<float>(capacity - size_t { 1u }));
+    return load((writeIndex + capacity - static_cast<size_t>(delay + 0.5f)) % capacity);
+}
+
+template <typename SampleType>
+SampleType PagedDelayLine<SampleType>::read(float delay) const
+{
+    return interpolation == Interpolation::linear ? readInterpolated(delay) : readNearest(delay);
+}
+
+template <typename SampleType>
+void PagedDelayLine<SampleType>::processSample(SampleType* outSample, const SampleType* inSample, float modInput /*= 0.0f*/)
+{
+    const float delay { delayValue.getSample() + modInput };
+
+    // Write input to the ring, then read
+    pages[writeIndex >> pageShift][writeIndex & pageMask] = *inSample;
+    *outSample = read(delay);
+
+    // Crossfade from the old read head while the delay time jumps
+    if (crossfadeRemaining > 0u)
+    {
+        const SampleType fadeOutGain { static_cast<SampleType>(crossfadeRemaining) / static_cast<SampleType>(crossfadeSamples) };
+        const SampleType fadeOutSample { read(fadeOutDelay + modInput) };
+        *outSample += fadeOutGain * (fadeOutSample - *outSample);
+        --crossfadeRemaining;
+
+        if (crossfadeRemaining == 0u && delayPending)
+            applyDelay();
+    }
+
+    advance(size_t { 1u });
+}
+
+template <typename SampleType>
+void PagedDelayLine<SampleType>::processBlock(SampleType* outBlock, const SampleType* inBlock, uint32_t numSamples, const float* modInput /*= nullptr*/)
+{
+    DSP_TRACE_SCOPE("PagedDelayLine::processBlock");
+    if (modInput == nullptr && interpolation == Interpolation::linear)
+    {
+        processStaticBlock(outBlock, inBlock, numSamples);
+        return;
+    }
+
+    for (uint32_t n = 0; n < numSamples; n++)
+        processSample(&outBlock[n], &inBlock[n], modInput ? modInput[n] : 0.0f);
+}
+
+template <typename SampleType>
+void PagedDelayLine<SampleType>::processStaticBlock(SampleType* outBlock, const SampleType* inBlock, uint32_t numSamples)
+{
+    const auto& kernels { DSP::KernelDispatch::getKernels<SampleType>() };
+
+    uint32_t n { 0u };
+    while (n < numSamples)
+    {
+        // Gliding or crossfading, also when a page turn grew the delay: sample by sample
+        if (crossfadeRemaining > 0u || delayValue.needsSmoothing())
+        {
+            processSample(&outBlock[n], &inBlock[n]);
+            ++n;
+            continue;
+        }
+
+        const float delay { std::min(delayValue.getSample(), static_cast<float>(capacity - size_t { 1u })) };
+        const float delayCeil { std::ceil(delay) };
+        const size_t readOffset { static_cast<size_t>(delayCeil) };
+        const SampleType delayFrac1 { static_cast<SampleType>(delayCeil - delay) };
+        const SampleType delayFrac0 { SampleType { 1 } - delayFrac1 };
+        const size_t readIndex0 { (writeIndex + capacity - readOffset) % capacity };
+
+        // As DelayLine's runs, and within one page: up to the end of the write page, and up to the
+        // end of the read page for the second tap
+        size_t runLength { static_cast<size_t>(numSamples - n) };
+        runLength = std::min(runLength, static_cast<size_t>(pageSize) - (writeIndex & pageMask));
+        runLength = std::min(runLength, static_cast<size_t>(pageSize) - (readIndex0 & pageMask) - size_t { 1u });
+        runLength = std::min(runLength, readOffset > 0u ? capacity - readOffset : size_t { 0u });
+        if (runLength == 0u)
+        {
+            processSample(&outBlock[n], &inBlock[n]);
+            ++n;
+            continue;
+        }
+
+        SampleType* writePage { pages[writeIndex >> pageShift] + (writeIndex & pageMask) };
+        const SampleType* readPage { pages[readIndex0 >> pageShift] + (readIndex0 & pageMask) };
+        std::copy(inBlock + n, inBlock + n + runLength, writePage);
+        kernels.interpolateLinear(outBlock + n, readPage, readPage + 1, delayFrac0, delayFrac1, static_cast<uint32_t>(runLength));
+
+        advance(runLength);
+        n += static_cast<uint32_t>(runLength);
+    }
+}
+
+template <typename SampleType>
+void PagedDelayLine<SampleType>::advance(size_t numSamples)
+{
+    writeIndex += numSamples;
+    if (writeIndex == capacity)
+        writeIndex = size_t { 0u };
+    if ((writeIndex & pageMask) == 0u)
+        turnPage();
+}
+
+template <typename SampleType>
+void PagedDelayLine<SampleType>::turnPage()
+{
+    // The page at the write head holds the oldest samples. A page linked before it holds the delays just
+    // beyond the old memory, silent; a page given up there only loses delays beyond the new memory
+    const size_t wantedPages { getPagesForDelay(requestedDelay.load(std::memory_order_relaxed)) };
+    float headsDelay { std::max(delayValue.getCurrentValue(), delayValue.getTarget()) };
+    if (crossfadeRemaining > 0u)
+        headsDelay = std::max(headsDelay, fadeOutDelay);
+    const size_t keptPages { std::max(wantedPages, static_cast<size_t>(getPagesForDelay(static_cast<uint32_t>(std::ceil(headsDelay))))) };
+    size_t writePage { writeIndex >> pageShift };
+    bool grown { false };
+
+    for (size_t slot = 0; slot < numHandOverSlots && numPages < wantedPages; ++slot)
+    {
+        if (auto* page = committedPages[slot].exchange(nullptr, std::memory_order_acq_rel))
+        {
+            std::copy_backward(pages.begin() + static_cast<std::ptrdiff_t>(writePage), pages.begin() + static_cast<std::ptrdiff_t>(numPages),
+                               pages.begin() + static_cast<std::ptrdiff_t>(numPages + 1u));
+            pages[writePage] = page;
+            ++numPages;
+            grown = true;
+        }
+    }
+
+    // Give up pages only beyond one spare, so that a delay moving around a page boundary does not swap pages
+    for (size_t slot = 0; slot < numHandOverSlots && numPages > keptPages + 1u; ++slot)
+    {
+        if (retiredPages[slot].load(std::memory_order_relaxed) != nullptr)
+            continue;
+
+        retiredPages[slot].store(pages[writePage], std::memory_order_release);
+        std::copy(pages.begin() + static_cast<std::ptrdiff_t>(writePage + 1u), pages.begin() + static_cast<std::ptrdiff_t>(numPages),
+                  pages.begin() + static_cast<std::ptrdiff_t>(writePage));
+        --numPages;
+        if (writePage == numPages)
+            writePage = size_t { 0u };
+    }
+
+    writeIndex = writePage << pageShift;
+    capacity = numPages << pageShift;
+    linkedPages.store(static_cast<uint32_t>(numPages), std::memory_order_release);
+
+    // A delay clamped by the old memory reaches for its request
+    if (grown)
+        applyDelay();
+}
+
+template <typename SampleType>
+void PagedDelayLine<SampleType>::applyDelay()
+{
+    const float newDelay { static_cast<float>(std::min(requestedDelay.load(std::memory_order_relaxed), getCommittedDelay())) };
+    if (! crossfadeRequested)
+    {
+        delayPending = false;
+        delayValue.setTarget(newDelay, false);
+        return;
+    }
+
+    if (newDelay == delayValue.getTarget())
+    {
+        delayPending = false;
+        return;
+    }
+
+    // A running crossfade, e.g. when a page turn grows the delay it is heading to, is not restarted, which
+    // would drop its old head at full gain: the new delay applies once it ends
+    if (crossfadeRemaining > 0u)
+    {
+        delayPending = true;
+        return;
+    }
+    delayPending = false;
+
+    // The old head continues from where the current one is, the new one starts at the new delay
+    fadeOutDelay = delayValue.getCurrentValue();
+    delayValue.setTarget(newDelay, true);
+    crossfadeRemaining = crossfadeSamples;
+}
+
+template <typename SampleType>
+uint32_t PagedDelayLine<SampleType>::getPagesForDelay(uint32_t delaySamples) const
+{
+    // A delay of d samples reads d + 1 samples back, the one just written included
+    return ((delaySamples + pageSize) >> pageShift) + 1u;
+}
+
+//================================================
+
+template class DelayPagePool<float>;
+template class DelayPagePool<double>;
+template class PagedDelayLine<float>;
+template class PagedDelayLine<double>;
+
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include "DelayLine.h"
+#include "MemoryFootprint.h"
+#include "MemoryLock.h"
+#include "SmoothParameter.h"
+
+namespace primitives
+{
+
+// Fixed-size pages of delay memory, shared by the paged delay lines of a process (or of a group of them),
+// so that pages a line gives back serve another. Thread safe, but allocates: not for the audio thread
+template <typename SampleType>
+class DelayPagePool
+{
+public:
+    explicit DelayPagePool(uint32_t initPageSize = defaultPageSize);
+    ~DelayPagePool();
+
+    // No copy or move semantics
+    DelayPagePool(const DelayPagePool&) = delete;
+    DelayPagePool& operator=(const DelayPagePool&) = delete;
+
+    //================================================
+
+    // Samples per page, a power of two: 85 ms at 48 kHz
+    static constexpr uint32_t defaultPageSize { 4096u };
+
+    // Pool of the default page size, for the lines not given one
+    static std::shared_ptr<DelayPagePool> getShared();
+
+    uint32_t getPageSize() const;
+
+    // A zeroed page, idle or newly allocated
+    SampleType* acquire();
+
+    // Give back a page acquired from this pool, to be reused
+    void release(SampleType* page);
+
+    // Free the idle pages beyond the given number
+    void trim(size_t numKeptPages = 0u);
+
+    // Idle pages, held by the pool
+    size_t getNumIdlePages() const;
+    utils::MemoryFootprint getMemoryFootprint() const;
+
+private:
+    const uint32_t pageSize;
+
+    mutable std::mutex mutex;
+    std::vector<SampleType*> idlePages;
+
+    static_assert(std::is_floating_point_v<SampleType>, "DelayPagePool requires a floating-point sample type");
+};
+
+//================================================
+
+// Delay line whose memory follows the delay in use instead of the maximum: a ring of pages from a
+// DelayPagePool. The message thread commits pages ahead of a growing delay (commitPages); the audio
+// thread links them in, and gives back the ones a shorter delay leaves unused, whenever the write head
+// crosses a page boundary. The history is kept across these changes, but for what was never held: a delay
+// grown past the committed memory is clamped until its pages arrive, and then reads silence where it
+// reaches further back than the old memory. Otherwise the same processing as DelayLine
+template <typename SampleType>
+class PagedDelayLine
+{
+public:
+
+    // Constructor: commits the pages of the initial delay
+    PagedDelayLine() = delete;
+    PagedDelayLine(
+        uint32_t maxDelaySamples,
+        uint32_t initDelaySamples,
+        std::shared_ptr<DelayPagePool<SampleType>> initPool = nullptr
+    );
+
+    // Destructor: gives every page back to the pool
+    ~PagedDelayLine();
+
+    // No copy or move semantics: the audio and message threads share its state
+    PagedDelayLine(const PagedDelayLine&) = delete;
+    PagedDelayLine& operator=(const PagedDelayLine&) = delete;
+
+    //================================================
+
+    // Set the current delay time, gliding to it. Within the committed memory until commitPages grows it
+    void setDelay(uint32_t newDelaySamples);
+
+    // Jump to a new delay time, crossfading from the old read head to the new one.
+    // During a crossfade, the latest new delay starts once it ends
+    void crossfadeToDelay(uint32_t newDelaySamples);
+
+    // Set the crossfade duration used by crossfadeToDelay
+    void setCrossfadeTime(uint32_t newTimeInSamples);
+
+    // Set the read interpolation
+    void setInterpolation(Interpolation newInterpolation);
+
+    // Returns the maximum delay time
+    uint32_t getMaxDelay() const;
+
+    // Longest delay the linked pages hold. Audio thread
+    uint32_t getCommittedDelay() const;
+
+    // Commit the pages the requested delay needs and take back the pages the audio thread gave up.
+    // Allocates: message thread only, call periodically
+    void commitPages();
+
+    // Pass the linked and committed pages to a visitor
+    void visitMemory(const utils::MemoryVisitor& visitor) const;
+
+    // Heap memory of the pages the line holds and of its page table. Not while processing
+    utils::MemoryFootprint getMemoryFootprint() const;
+
+    //================================================
+
+    // Prepare the delay line for processing. Commits pages: not for the audio thread
+    void prepare();
+
+    // Clear the content of the delay buffer
+    void clear();
+
+    //================================================
+
+    // Process audio sample - linear interpolation, or none
+    void processSample(SampleType* outSample, const SampleType* inSample, float modInput = 0.0f);
+
+    // Process block of audio. A static delay, unmodulated and linearly interpolated, is processed in
+    // runs of contiguous samples within a page instead
+    void processBlock(SampleType* outBlock, const SampleType* inBlock, uint32_t numSamples, const float* modInput = nullptr);
+
+    //================================================
+
+private:
+
+    // Sample at a ring index
+    SampleType load(size_t index) const;
+
+    // Read the ring at a fractional delay, clamped to the linked pages
+    SampleType readInterpolated(float delay) const;
+    SampleType readNearest(float delay) const;
+    SampleType read(float delay) const;
+
+    // processBlock of a static delay, in runs that stay within one page for the write and both read taps
+    void processStaticBlock(SampleType* outBlock, const SampleType* inBlock, uint32_t numSamples);
+
+    // Advance the write head, and turn the page when it reaches a boundary
+    void advance(size_t numSamples);
+
+    // At a page boundary: link the committed pages, or give back the unused ones, at the write head
+    void turnPage();
+
+    // Glide or crossfade to the requested delay, within the linked pages
+    void applyDelay();
+
+    // Pages holding a delay, with one more so that small changes do not commit or give back pages
+    uint32_t getPagesForDelay(uint32_t delaySamples) const;
+
+    //================================================
+
+    // Pages handed over between the threads at a time, each way
+    static constexpr size_t numHandOverSlots { 32u };
+
+    std::shared_ptr<DelayPagePool<SampleType>> pool;
+    uint32_t pageSize;
+    uint32_t pageShift;
+    size_t pageMask;
+    uint32_t maxDelay;
+
+    // Ring of linked pages, in time order, and the write head in it. Audio thread
+    std::vector<SampleType*> pages;
+    size_t numPages;
+    size_t capacity;
+    size_t writeIndex { 0u };
+
+    // Hand-over: committed pages to the audio thread, given-up pages back
+    std::array<std::atomic<SampleType*>, numHandOverSlots> committedPages;
+    std::array<std::atomic<SampleType*>, numHandOverSlots> retiredPages;
+    // Delay requested, and pages linked, for commitPages
+    std::atomic<uint32_t> requestedDelay;
+    std::atomic<uint32_t> linkedPages { 0u };
+    bool crossfadeRequested { false };
+
+    utils::SmoothParameter delayValue;
+    Interpolation interpolation { Interpolation::linear };
+
+    // Second read head, faded out while crossfading to a new delay time
+    float fadeOutDelay;
+    uint32_t crossfadeSamples { 1024u };
+    uint32_t crossfadeRemaining { 0u };
+    // A new delay arrived during the crossfade, applied after it
+    bool delayPending { false };
+
+    //================================================
+
+    static_assert(std::is_floating_point_v<SampleType>, "PagedDelayLine requires a floating-point sample type");
+};
+
+}
@@ -0,0 +1,307 @@
+#include "PolyphaseResampler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace DSP
+{
+
+namespace
+{
+    // Taps per polyphase branch: the filter has factor * tapsPerPhase taps
+    constexpr uint32_t tapsPerPhase { 32u };
+    // Kaiser window shape for about 60 dB of stopband rejection
+    constexpr double kaiserBeta { 5.65 };
+    // Cutoff, as a fraction of the lower rate: halfway through the transition band from 0.4 to 0.5
+    constexpr double cutoff { 0.45 };
+
+    // Modified Bessel function of the first kind, order 0
+    double besselI0(double x)
+    {
+        double sum { 1.0 };
+        double term { 1.0 };
+        for (int k = 1; k < 32; ++k)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    // Lowpass prototype at the higher rate, unity gain at DC, newest input first. An odd length,
+    // for a whole-sample delay, followed by a zero tap to fill the branches
+    std::vector<double> designLowpass(uint32_t factor)
+    {
+        const size_t numTaps { static_cast<size_t>(factor) * tapsPerPhase - 1u };
+        const double centre { 0.5 * static_cast<double>(numTaps - 1u) };
+        const double normalizedCutoff { cutoff / static_cast<double>(factor) };
+
+        std::vector<double> taps(numTaps + 1u, 0.0);
+        double sum { 0.0 };
+        for (size_t i = 0; i < numTaps; ++i)
+        {
+            const double t { static_cast<double>(i) - centre };
+            const double sinc { t == 0.0 ? 1.0 : std::sin(2.0 * juce::MathConstants<double>::pi * normalizedCutoff * t) / (juce::MathConstants<double>::pi * t) / (2.0 * normalizedCutoff) };
+            const double ratio { t / (centre + 1.0) };
+            taps[i] = sinc * besselI0(kaiserBeta * std::sqrt(1.0 - ratio * ratio)) / besselI0(kaiserBeta);
+            sum += taps[i];
+        }
+        for (auto& tap : taps)
+            tap /= sum;
+        return taps;
+    }
+
+    // Four partial sums, so that the additions do not wait on each other
+    template <typename SampleType>
+    SampleType dotProduct(const SampleType* a, const SampleType* b, size_t size)
+    {
+        SampleType sums[4] { SampleType { 0 }, SampleType { 0 }, SampleType { 0 }, SampleType { 0 } };
+        size_t i { 0u };
+        for (; i + 4u <= size; i += 4u)
+        {
+            sums[0] += a[i] * b[i];
+            sums[1] += a[i + 1u] * b[i + 1u];
+            sums[2] += a[i + 2u] * b[i + 2u];
+            sums[3] += a[i + 3u] * b[i + 3u];
+        }
+        for (; i < size; ++i)
+            sums[0] += a[i] * b[i];
+        return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    }
+}
+
+// =============================================
+
+template <typename SampleType>
+PolyphaseDecimator<SampleType>::PolyphaseDecimator(uint32_t initNumChannels) :
+    numChannels { initNumChannels }
+{
+    jassert(numChannels > 0u && "Number of channels must be greater than zero");
+}
+
+template <typename SampleType>
+PolyphaseDecimator<SampleType>::~PolyphaseDecimator()
+{
+}
+
+template <typename SampleType>
+void PolyphaseDecimator<SampleType>::reserve(uint32_t maxNumChannels, uint32_t maxFactor)
+{
+    coefficients.reserve(static_cast<size_t>(maxFactor) * tapsPerPhase);
+    history.reserve(2u * static_cast<size_t>(maxFactor) * tapsPerPhase * maxNumChannels);
+}
+
+template <typename SampleType>
+void PolyphaseDecimator<SampleType>::prepare(uint32_t newNumChannels, uint32_t newFactor)
+{
+    jassert(newNumChannels > 0u && "Number of channels must be greater than zero");
+    jassert(newFactor > 0u && "Factor must be greater than zero");
+    numChannels = newNumChannels;
+    factor = newFactor;
+
+    // Within the reserved capacity, neither vector reallocates
+    const size_t numTaps { factor > 1u ? static_cast<size_t>(factor) * tapsPerPhase : 0u };
+    if (coefficients.size() != numTaps)
+    {
+        coefficients.clear();
+        if (factor > 1u)
+        {
+            const std::vector<double> taps { designLowpass(factor) };
+            coefficients.assign(taps.rbegin(), taps.rend());
+        }
+    }
+    history.resize(2u * numTaps * numChannels);
+    clear();
+}
+
+template <typename SampleType>
+void PolyphaseDecimator<SampleType>::clear()
+{
+    std::fill(history.begin(), history.end(), SampleType { 0 });
+    writeIndex = 0u;
+    phase = 0u;
+}
+
+template <typename SampleType>
+uint32_t PolyphaseDecimator<SampleType>::getFactor() const
+{
+    return factor;
+}
+
+template <typename SampleType>
+void PolyphaseDecimator<SampleType>::visitMemory(const utils::MemoryVisitor& visitor) const
+{
+    visitor(coefficients.data(), coefficients.size() * sizeof(SampleType));
+    visitor(history.data(), history.size() * sizeof(SampleType));
+}
+
+template <typename SampleType>
+utils::MemoryFootprint PolyphaseDecimator<SampleType>::getMemoryFootprint() const
+{
+    return { utils::MemoryFootprint::of(coefficients) + utils::MemoryFootprint::of(history), 0u };
+}
+
+template <typename SampleType>
+uint32_t PolyphaseDecimator<SampleType>::getLatency() const
+{
+    return factor > 1u ? static_cast<uint32_t>(coefficients.size()) / 2u - 1u : 0u;
+}
+
+template <typename SampleType>
+double PolyphaseDecimator<SampleType>::getCutoff()
+{
+    return cutoff;
+}
+
+template <typename SampleType>
+bool PolyphaseDecimator<SampleType>::processSample(SampleType* outSamples, const SampleType* inSamples, uint32_t numFrameChannels)
+{
+    jassert(numFrameChannels == numChannels && "Number of channels must match the prepared one");
+
+    if (factor == 1u)
+    {
+        std::copy(inSamples, inSamples + numChannels, outSamples);
+        return true;
+    }
+
+    const size_t numTaps { coefficients.size() };
+    for (size_t ch = 0; ch < static_cast<size_t>(numChannels); ++ch)
+    {
+        SampleType* channelHistory { history.data() + ch * 2u * numTaps };
+        channelHistory[writeIndex] = inSamples[ch];
+        channelHistory[writeIndex + numTaps] = inSamples[ch];
+    }
+    writeIndex = writeIndex + 1u == numTaps ? 0u : writeIndex + 1u;
+
+    if (++phase < factor)
+        return false;
+    phase = 0u;
+
+    // The last numTaps inputs, oldest first, start right after the oldest slot
+    for (size_t ch = 0; ch < static_cast<size_t>(numChannels); ++ch)
+        outSamples[ch] = dotProduct(history.data() + ch * 2u * numTaps + writeIndex, coefficients.data(), numTaps);
+    return true;
+}
+
+// =============================================
+
+template <typename SampleType>
+PolyphaseInterpolator<SampleType>::PolyphaseInterpolator(uint32_t initNumChannels) :
+    numChannels { initNumChannels }
+{
+    jassert(numChannels > 0u && "Number of channels must be greater than zero");
+}
+
+template <typename SampleType>
+PolyphaseInterpolator<SampleType>::~PolyphaseInterpolator()
+{
+}
+
+template <typename SampleType>
+void PolyphaseInterpolator<SampleType>::reserve(uint32_t maxNumChannels, uint32_t maxFactor)
+{
+    coefficients.reserve(static_cast<size_t>(maxFactor) * tapsPerPhase);
+    history.reserve(2u * tapsPerPhase * static_cast<size_t>(maxNumChannels));
+}
+
+template <typename SampleType>
+void PolyphaseInterpolator<SampleType>::prepare(uint32_t newNumChannels, uint32_t newFactor)
+{
+    jassert(newNumChannels > 0u && "Number of channels must be greater than zero");
+    jassert(newFactor > 0u && "Factor must be greater than zero");
+    numChannels = newNumChannels;
+    factor = newFactor;
+
+    // Branch p of an output frame p samples after a push: taps p, p + factor, ... of the prototype,
+    // the newest input on the first of them. Within the reserved capacity, neither vector reallocates
+    const size_t numTaps { static_cast<size_t>(factor) * tapsPerPhase };
+    if (coefficients.size() != numTaps)
+    {
+        const std::vector<double> taps { designLowpass(factor) };
+        coefficients.resize(numTaps);
+        for (size_t p = 0; p < static_cast<size_t>(factor); ++p)
+            for (size_t i = 0; i < static_cast<size_t>(tapsPerPhase); ++i)
+                coefficients[p * tapsPerPhase + (tapsPerPhase - 1u - i)] = static_cast<SampleType>(factor * taps[p + i * factor]);
+    }
+
+    history.resize(2u * tapsPerPhase * numChannels);
+    clear();
+}
+
+template <typename SampleType>
+void PolyphaseInterpolator<SampleType>::clear()
+{
+    std::fill(history.begin(), history.end(), SampleType { 0 });
+    writeIndex = 0u;
+    phase = 0u;
+}
+
+template <typename SampleType>
+uint32_t PolyphaseInterpolator<SampleType>::getFactor() const
+{
+    return factor;
+}
+
+template <typename SampleType>
+void PolyphaseInterpolator<SampleType>::visitMemory(const utils::MemoryVisitor& visitor) const
+{
+    visitor(coefficients.data(), coefficients.size() * sizeof(SampleType));
+    visitor(history.data(), history.size() * sizeof(SampleType));
+}
+
+template <typename SampleType>
+utils::MemoryFootprint PolyphaseInterpolator<SampleType>::getMemoryFootprint() const
+{
+    return { utils::MemoryFootprint::of(coefficients) + utils::MemoryFootprint::of(history), 0u };
+}
+
+template <typename SampleType>
+uint32_t PolyphaseInterpolator<SampleType>::getLatency() const
+{
+    return factor > 1u ? factor * tapsPerPhase / 2u - 1u : 0u;
+}
+
+template <typename SampleType>
+void PolyphaseInterpolator<SampleType>::pushSample(const SampleType* inSamples, uint32_t numFrameChannels)
+{
+    jassert(numFrameChannels == numChannels && "Number of channels must match the prepared one");
+
+    for (size_t ch = 0; ch < static_cast<size_t>(numChannels); ++ch)
+    {
+        SampleType* channelHistory { history.data() + ch * 2u * tapsPerPhase };
+        channelHistory[writeIndex] = inSamples[ch];
+        channelHistory[writeIndex + tapsPerPhase] = inSamples[ch];
+    }
+    writeIndex = writeIndex + 1u == tapsPerPhase ? 0u : writeIndex + 1u;
+    phase = 0u;
+}
+
+template <typename SampleType>
+void PolyphaseInterpolator<SampleType>::processSample(SampleType* outSamples, uint32_t numFrameChannels)
+{
+    jassert(numFrameChannels == numChannels && "Number of channels must match the prepared one");
+    jassert(phase < factor && "One frame must be pushed every factor frames");
+
+    if (factor == 1u)
+    {
+        // The pushed frame, passed through
+        const size_t newest { writeIndex == 0u ? tapsPerPhase - 1u : writeIndex - 1u };
+        for (size_t ch = 0; ch < static_cast<size_t>(numChannels); ++ch)
+            outSamples[ch] = history[ch * 2u * tapsPerPhase + newest];
+        return;
+    }
+
+    const SampleType* branch { coefficients.data() + static_cast<size_t>(phase) * tapsPerPhase };
+    for (size_t ch = 0; ch < static_cast<size_t>(numChannels); ++ch)
+        outSamples[ch] = dotProduct(history.data() + ch * 2u * tapsPerPhase + writeIndex, branch, tapsPerPhase);
+    ++phase;
+}
+
+// =============================================
+
+template class PolyphaseDecimator<float>;
+template class PolyphaseDecimator<double>;
+template class PolyphaseInterpolator<float>;
+template class PolyphaseInterpolator<double>;
+
+}
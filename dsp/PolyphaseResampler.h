@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include <JuceHeader.h>
+
+#include "MemoryFootprint.h"
+#include "MemoryLock.h"
+
+namespace DSP
+{
+
+// Integer-factor sample rate conversion, one frame at a time, to run a processor at a lower
+// internal rate. Both directions use the same linear-phase lowpass (Kaiser-windowed sinc, about
+// 60 dB of rejection, flat up to 0.4 of the lower rate), split into one polyphase branch per
+// output phase: decimation computes only the kept samples, interpolation never multiplies the
+// inserted zeros. Each direction delays by factor * 16 - 1 samples at the higher rate.
+// A factor of 1 passes the frames through, without delay.
+
+template <typename SampleType>
+class PolyphaseDecimator
+{
+public:
+    explicit PolyphaseDecimator(uint32_t initNumChannels);
+    ~PolyphaseDecimator();
+
+    // No default ctor
+    PolyphaseDecimator() = delete;
+
+    // No copy semantics
+    PolyphaseDecimator(const PolyphaseDecimator&) = delete;
+    const PolyphaseDecimator& operator=(const PolyphaseDecimator&) = delete;
+
+    // No move semantics
+    PolyphaseDecimator(PolyphaseDecimator&&) noexcept = default;
+    PolyphaseDecimator& operator=(PolyphaseDecimator&&) noexcept = default;
+
+    // =============================================
+
+    // Allocate the coefficients and the history of up to maxNumChannels and maxFactor,
+    // so that prepare does not reallocate. Not for the audio thread
+    void reserve(uint32_t maxNumChannels, uint32_t maxFactor);
+
+    // Design the filter for a factor, when it changes, and clear the history. Not for the audio thread
+    void prepare(uint32_t newNumChannels, uint32_t newFactor);
+
+    // Clear the history
+    void clear();
+
+    uint32_t getFactor() const;
+
+    // Pass the coefficients and the history to a visitor
+    void visitMemory(const utils::MemoryVisitor& visitor) const;
+
+    // Heap memory of the coefficients and the history, as reserved
+    utils::MemoryFootprint getMemoryFootprint() const;
+
+    // Delay of the filter, in samples at the higher rate
+    uint32_t getLatency() const;
+
+    // Cutoff of the lowpass (-6 dB), as a fraction of the lower rate
+    static double getCutoff();
+
+    // =============================================
+
+    // Push a frame at the higher rate. Every factor-th one, write a frame at the lower rate and return true
+    bool processSample(SampleType* outSamples, const SampleType* inSamples, uint32_t numChannels);
+
+private:
+    uint32_t numChannels;
+    uint32_t factor { 1u };
+    uint32_t phase { 0u };
+
+    // Filter taps, oldest input first
+    std::vector<SampleType> coefficients;
+    // Per channel, the inputs written twice, so that the last taps-many are always contiguous
+    std::vector<SampleType> history;
+    size_t writeIndex { 0u };
+
+    static_assert(std::is_floating_point_v<SampleType>, "PolyphaseDecimator requires a floating-point sample type");
+};
+
+template <typename SampleType>
+class PolyphaseInterpolator
+{
+public:
+    explicit PolyphaseInterpolator(uint32_t initNumChannels);
+    ~PolyphaseInterpolator();
+
+    // No default ctor
+    PolyphaseInterpolator() = delete;
+
+    // No copy semantics
+    PolyphaseInterpolator(const PolyphaseInterpolator&) = delete;
+    const PolyphaseInterpolator& operator=(const PolyphaseInterpolator&) = delete;
+
+    // No move semantics
+    PolyphaseInterpolator(PolyphaseInterpolator&&) noexcept = default;
+    PolyphaseInterpolator& operator=(PolyphaseInterpolator&&) noexcept = default;
+
+    // =============================================
+
+    // Allocate the coefficients and the history of up to maxNumChannels and maxFactor,
+    // so that prepare does not reallocate. Not for the audio thread
+    void reserve(uint32_t maxNumChannels, uint32_t maxFactor);
+
+    // Design the filter for a factor, when it changes, and clear the history. Not for the audio thread
+    void prepare(uint32_t newNumChannels, uint32_t newFactor);
+
+    // Clear the history
+    void clear();
+
+    uint32_t getFactor() const;
+
+    // Pass the coefficients and the history to a visitor
+    void visitMemory(const utils::MemoryVisitor& visitor) const;
+
+    // Heap memory of the coefficients and the history, as reserved
+    utils::MemoryFootprint getMemoryFootprint() const;
+
+    // Delay of the filter, in samples at the higher rate
+    uint32_t getLatency() const;
+
+    // =============================================
+
+    // Push a frame at the lower rate, once every factor frames at the higher rate, before processSample
+    void pushSample(const SampleType* inSamples, uint32_t numChannels);
+
+    // Write the next frame at the higher rate
+    void processSample(SampleType* outSamples, uint32_t numChannels);
+
+private:
+    uint32_t numChannels;
+    uint32_t factor { 1u };
+    uint32_t phase { 0u };
+
+    // One branch of taps per phase, oldest input first, scaled by the factor for the inserted zeros
+    std::vector<SampleType> coefficients;
+    // Per channel, the pushed inputs written twice, so that the last branch-many are always contiguous
+    std::vector<SampleType> history;
+    size_t writeIndex { 0u };
+
+    static_assert(std::is_floating_point_v<SampleType>, "PolyphaseInterpolator requires a floating-point sample type");
+};
+
+}
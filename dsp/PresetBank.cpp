@@ -0,0 +1,249 @@
+#include <cstring>
+
+#include "PresetBank.h"
+#include "FDN.h"
+#include "Matrix.h"
+#include "Trace.h"
+
+namespace DSP
+{
+
+namespace
+{
+    // Identifier and version of the bank layout
+    constexpr int bankMagic { 0x54565042 };  // "TVPB"
+    constexpr int bankVersion { 1 };
+
+    // Magic, version, fingerprint and number of presets
+    constexpr size_t headerBytes { 3 * sizeof(int) + sizeof(juce::int64) };
+
+    // Upper bound of the presets accepted on read, so corrupt data cannot trigger huge allocations
+    constexpr int maxPresets { 4096 };
+
+    // FNV-1a, over the bytes of each value in turn
+    constexpr uint64_t fnvOffset { 0xCBF29CE484222325ull };
+    constexpr uint64_t fnvPrime { 0x100000001B3ull };
+
+    void hashBytes(uint64_t& hash, const void* bytes, size_t numBytes)
+    {
+        const auto* byte { static_cast<const unsigned char*>(bytes) };
+        for (size_t i = 0; i < numBytes; ++i)
+            hash = (hash ^ byte[i]) * fnvPrime;
+    }
+
+    template <typename ValueType>
+    void hashValue(uint64_t& hash, ValueType value)
+    {
+        // Fixed-width values only, so that the fingerprint does not depend on the platform
+        static_assert(sizeof(ValueType) == 4u || sizeof(ValueType) == 8u, "Hash fixed-width values");
+        hashBytes(hash, &value, sizeof(value));
+    }
+}
+
+// =============================================
+
+bool PresetBank::load(const juce::File& file, const std::vector<PresetRecipe>& recipes, uint32_t order, int numInputChannels, int numOutputChannels)
+{
+    DSP_TRACE_SCOPE("PresetBank::load");
+    if (recipes.empty())
+        return false;
+
+    const uint64_t fingerprint { getFingerprint(recipes, order, numInputChannels, numOutputChannels) };
+    if (open(file, fingerprint))
+        return true;
+
+    std::vector<Preset> presets;
+    presets.reserve(recipes.size());
+    for (const auto& recipe : recipes)
+        presets.push_back(computePreset(recipe, order, numInputChannels, numOutputChannels));
+
+    // Another instance may have written the same bank meanwhile: any complete file of this fingerprint will do
+    if (writeFile(file, fingerprint, presets) && open(file, fingerprint))
+        return true;
+
+    close();
+    {
+        // The block takes the size of the data when the stream goes away
+        juce::MemoryOutputStream stream { bankInMemory, false };
+        writeBank(stream, fingerprint, presets);
+    }
+    return parse(bankInMemory.getData(), bankInMemory.getSize(), fingerprint);
+}
+
+bool PresetBank::open(const juce::File& file, uint64_t expectedFingerprint)
+{
+    close();
+    if (! file.existsAsFile())
+        return false;
+
+    mappedFile = std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly);
+    if (mappedFile->getData() == nullptr || ! parse(mappedFile->getData(), mappedFile->getSize(), expectedFingerprint))
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void PresetBank::close()
+{
+    entryOffsets.clear();
+    data = nullptr;
+    numBytes = 0u;
+    mappedFile.reset();
+    bankInMemory.reset();
+}
+
+size_t PresetBank::getNumPresets() const
+{
+    return entryOffsets.size();
+}
+
+bool PresetBank::readPreset(size_t index, Preset& preset) const
+{
+    if (index >= entryOffsets.size())
+        return false;
+
+    const size_t offset { static_cast<size_t>(entryOffsets[index]) };
+    juce::MemoryInputStream stream { data + offset, numBytes - offset, false };
+
+    preset.name = stream.readString().toStdString();
+    if (stream.getNumBytesRemaining() < 5 * static_cast<juce::int64>(sizeof(float)))
+        return false;
+    preset.settings.t60 = stream.readFloat();
+    preset.settings.brightness = stream.readFloat();
+    preset.settings.roomSize = stream.readFloat();
+    preset.settings.modulationRate = stream.readFloat();
+    preset.settings.modulationDepth = stream.readFloat();
+
+    return readSnapshot(stream, preset.topology.fdn)
+        && readSnapshot(stream, preset.topology.inputCoupling)
+        && readSnapshot(stream, preset.topology.outputCoupling)
+        && preset.topology.fdn.isValid();
+}
+
+// =============================================
+
+Preset PresetBank::computePreset(const PresetRecipe& recipe, uint32_t order, int numInputChannels, int numOutputChannels)
+{
+    DSP_TRACE_SCOPE("PresetBank::computePreset");
+    Preset preset;
+    preset.name = recipe.name;
+    preset.settings = recipe.settings;
+
+    // Generated in double precision, as the TopologyCache does, so float and double chains restore the same topology
+    const FDN<double> fdn { order, static_cast<double>(recipe.settings.t60), static_cast<double>(recipe.settings.brightness), recipe.fdnSeed };
+    const Matrix<double> inputCoupling { static_cast<int>(order), numInputChannels, recipe.inputCouplingSeed };
+    const Matrix<double> outputCoupling { numOutputChannels, static_cast<int>(order), recipe.outputCouplingSeed };
+    preset.topology.fdn = fdn.getSnapshot();
+    preset.topology.inputCoupling = inputCoupling.getSnapshot();
+    preset.topology.outputCoupling = outputCoupling.getSnapshot();
+    return preset;
+}
+
+uint64_t PresetBank::getFingerprint(const std::vector<PresetRecipe>& recipes, uint32_t order, int numInputChannels, int numOutputChannels)
+{
+    uint64_t hash { fnvOffset };
+    hashValue(hash, bankVersion);
+    hashValue(hash, order);
+    hashValue(hash, numInputChannels);
+    hashValue(hash, numOutputChannels);
+
+    for (const auto& recipe : recipes)
+    {
+        hashBytes(hash, recipe.name.data(), recipe.name.size());
+        hashValue(hash, recipe.fdnSeed);
+        hashValue(hash, recipe.inputCouplingSeed);
+        hashValue(hash, recipe.outputCouplingSeed);
+        for (const float value : { recipe.settings.t60, recipe.settings.brightness, recipe.settings.roomSize,
+                                   recipe.settings.modulationRate, recipe.settings.modulationDepth })
+            hashValue(hash, value);
+    }
+    return hash;
+}
+
+bool PresetBank::writeFile(const juce::File& file, uint64_t fingerprint, const std::vector<Preset>& presets)
+{
+    if (! file.getParentDirectory().createDirectory())
+        return false;
+
+    // Written next to the target and moved over it once complete, so that no reader maps a partial bank
+    juce::TemporaryFile temporary { file };
+    {
+        auto stream = temporary.getFile().createOutputStream();
+        if (stream == nullptr)
+            return false;
+        writeBank(*stream, fingerprint, presets);
+        stream->flush();
+        if (stream->getStatus().failed())
+            return false;
+    }
+    return temporary.overwriteTargetFileWithTemporary();
+}
+
+// =============================================
+
+void PresetBank::writeBank(juce::OutputStream& stream, uint64_t fingerprint, const std::vector<Preset>& presets)
+{
+    // Entries first, to know their offsets
+    juce::MemoryOutputStream entries;
+    std::vector<uint64_t> offsets;
+    offsets.reserve(presets.size());
+    const size_t tableBytes { presets.size() * sizeof(juce::int64) };
+
+    for (const auto& preset : presets)
+    {
+        offsets.push_back(headerBytes + tableBytes + entries.getDataSize());
+        entries.writeString(juce::String::fromUTF8(preset.name.c_str()));
+        entries.writeFloat(preset.settings.t60);
+        entries.writeFloat(preset.settings.brightness);
+        entries.writeFloat(preset.settings.roomSize);
+        entries.writeFloat(preset.settings.modulationRate);
+        entries.writeFloat(preset.settings.modulationDepth);
+        writeSnapshot(entries, preset.topology.fdn);
+        writeSnapshot(entries, preset.topology.inputCoupling);
+        writeSnapshot(entries, preset.topology.outputCoupling);
+    }
+
+    stream.writeInt(bankMagic);
+    stream.writeInt(bankVersion);
+    stream.writeInt64(static_cast<juce::int64>(fingerprint));
+    stream.writeInt(static_cast<int>(presets.size()));
+    for (const uint64_t offset : offsets)
+        stream.writeInt64(static_cast<juce::int64>(offset));
+    stream.write(entries.getData(), entries.getDataSize());
+}
+
+bool PresetBank::parse(const void* bankData, size_t bankBytes, uint64_t expectedFingerprint)
+{
+    entryOffsets.clear();
+    if (bankBytes < headerBytes)
+        return false;
+
+    juce::MemoryInputStream stream { bankData, bankBytes, false };
+    if (stream.readInt() != bankMagic || stream.readInt() != bankVersion
+        || static_cast<uint64_t>(stream.readInt64()) != expectedFingerprint)
+        return false;
+
+    const int numPresets { stream.readInt() };
+    if (numPresets <= 0 || numPresets > maxPresets
+        || stream.getNumBytesRemaining() < static_cast<juce::int64>(numPresets) * static_cast<juce::int64>(sizeof(juce::int64)))
+        return false;
+
+    entryOffsets.resize(static_cast<size_t>(numPresets));
+    for (uint64_t& offset : entryOffsets)
+    {
+        offset = static_cast<uint64_t>(stream.readInt64());
+        if (offset < headerBytes || offset >= bankBytes)
+        {
+            entryOffsets.clear();
+            return false;
+        }
+    }
+
+    data = static_cast<const char*>(bankData);
+    numBytes = bankBytes;
+    return true;
+}
+
+}
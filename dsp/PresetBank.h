@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <JuceHeader.h>
+
+#include "TopologySnapshot.h"
+
+namespace DSP
+{
+
+// Reverb settings of a preset, in the units of the plugin parameters
+struct PresetSettings
+{
+    float t60 { 4.0f };
+    float brightness { 0.5f };
+    float roomSize { 1.0f };
+    float modulationRate { 0.3f };
+    float modulationDepth { 0.0f };     // fraction of the maximum rotation angle
+};
+
+// How a preset is generated: its name, the seeds of its topology and its settings
+struct PresetRecipe
+{
+    std::string name;
+    uint32_t fdnSeed { 0u };
+    uint32_t inputCouplingSeed { 0u };
+    uint32_t outputCouplingSeed { 0u };
+    PresetSettings settings;
+};
+
+// Topology of a full reverb: input coupling, FDN and output coupling
+struct PresetTopology
+{
+    FDNSnapshot fdn;
+    MatrixSnapshot inputCoupling;
+    MatrixSnapshot outputCoupling;
+};
+
+// A computed preset, restored without generating anything
+struct Preset
+{
+    std::string name;
+    PresetSettings settings;
+    PresetTopology topology;
+};
+
+// =============================================
+
+// Bank of presets whose topologies are computed once and stored in a compact binary file, mapped into
+// memory: reading a preset then only parses its entry. The file is keyed by a fingerprint of the recipes and
+// of the configuration, and computed again when they change. Not for the audio thread
+class PresetBank
+{
+public:
+    PresetBank() = default;
+
+    // No copy semantics
+    PresetBank(const PresetBank&) = delete;
+    const PresetBank& operator=(const PresetBank&) = delete;
+
+    // =============================================
+
+    // Map the bank file of the recipes, after computing and writing it when it is missing or stale. Generates the
+    // topologies (QRs): run it on a background thread. When the file cannot be written, the bank is kept in memory.
+    // Returns false if there are no recipes
+    bool load(const juce::File& file, const std::vector<PresetRecipe>& recipes, uint32_t order, int numInputChannels, int numOutputChannels);
+
+    // Map an existing bank file. Returns false if it is missing, truncated or of another fingerprint
+    bool open(const juce::File& file, uint64_t expectedFingerprint);
+
+    // Unmap the bank
+    void close();
+
+    size_t getNumPresets() const;
+
+    // Parse the preset at an index. Returns false if there is none or if its entry is inconsistent
+    bool readPreset(size_t index, Preset& preset) const;
+
+    // =============================================
+
+    // Generate the topology of a recipe for an FDN order and channel counts, in double precision
+    static Preset computePreset(const PresetRecipe& recipe, uint32_t order, int numInputChannels, int numOutputChannels);
+
+    // Key of a bank file: the layout version, the configuration and every recipe
+    static uint64_t getFingerprint(const std::vector<PresetRecipe>& recipes, uint32_t order, int numInputChannels, int numOutputChannels);
+
+    // Write presets as a bank file, replacing the file only once it is complete. Returns false on failure
+    static bool writeFile(const juce::File& file, uint64_t fingerprint, const std::vector<Preset>& presets);
+
+private:
+    // Write the bank layout: header, entry offsets, then the entries (little endian)
+    static void writeBank(juce::OutputStream& stream, uint64_t fingerprint, const std::vector<Preset>& presets);
+
+    // Check the header and read the entry offsets of the bank in data
+    bool parse(const void* bankData, size_t bankBytes, uint64_t expectedFingerprint);
+
+    // Mapped file, or the bank in memory when it could not be written
+    std::unique_ptr<juce::MemoryMappedFile> mappedFile;
+    juce::MemoryBlock bankInMemory;
+    const char* data { nullptr };
+    size_t numBytes { 0u };
+
+    // Offset of each entry from the start of the bank
+    std::vector<uint64_t> entryOffsets;
+};
+
+}
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <cassert>
+
+#include "QualityGovernor.h"
+
+namespace utils
+{
+
+QualityGovernor::QualityGovernor(uint32_t initNumTiers) :
+    numTiers { initNumTiers }
+{
+    assert(numTiers > 0u && "There must be at least one tier");
+}
+
+//================================================
+
+void QualityGovernor::prepare(double newSampleRate)
+{
+    assert(newSampleRate > 0.0);
+    sampleRate = newSampleRate;
+    setHoldTimes(stepDownSeconds, stepUpSeconds);
+}
+
+void QualityGovernor::setThresholds(float newStepDownLoad, float newStepUpLoad)
+{
+    assert(newStepUpLoad < newStepDownLoad && "Thresholds must leave a hysteresis");
+    stepDownLoad = newStepDownLoad;
+    stepUpLoad = newStepUpLoad;
+}
+
+void QualityGovernor::setHoldTimes(double newStepDownSeconds, double newStepUpSeconds)
+{
+    assert(newStepDownSeconds >= 0.0 && newStepUpSeconds >= 0.0);
+    stepDownSeconds = newStepDownSeconds;
+    stepUpSeconds = newStepUpSeconds;
+    stepDownSamples = static_cast<uint64_t>(stepDownSeconds * sampleRate);
+    stepUpSamples = static_cast<uint64_t>(stepUpSeconds * sampleRate);
+}
+
+void QualityGovernor::setEnabled(bool shouldBeEnabled)
+{
+    enabled.store(shouldBeEnabled, std::memory_order_relaxed);
+}
+
+void QualityGovernor::setTier(uint32_t newTier)
+{
+    requestedTier.store(std::min(newTier, numTiers - 1u), std::memory_order_relaxed);
+}
+
+//================================================
+
+uint32_t QualityGovernor::update(float load, uint32_t numSamples) noexcept
+{
+    uint32_t currentTier { tier.load(std::memory_order_relaxed) };
+
+    // A tier set meanwhile replaces the current one, and restarts both holds
+    const uint32_t requested { requestedTier.exchange(noRequest, std::memory_order_relaxed) };
+    if (requested != noRequest)
+    {
+        currentTier = requested;
+        samplesAbove = samplesBelow = 0u;
+    }
+
+    if (! enabled.load(std::memory_order_relaxed))
+    {
+        samplesAbove = samplesBelow = 0u;
+        tier.store(0u, std::memory_order_relaxed);
+        return 0u;
+    }
+
+    samplesAbove = load > stepDownLoad ? samplesAbove + numSamples : 0u;
+    samplesBelow = load < stepUpLoad ? samplesBelow + numSamples : 0u;
+
+    // Each step restarts both holds, so that the load settles at the new tier before the next one
+    if (samplesAbove >= stepDownSamples && currentTier + 1u < numTiers)
+    {
+        ++currentTier;
+        samplesAbove = samplesBelow = 0u;
+    }
+    else if (samplesBelow >= stepUpSamples && currentTier > 0u)
+    {
+        --currentTier;
+        samplesAbove = samplesBelow = 0u;
+    }
+
+    tier.store(currentTier, std::memory_order_relaxed);
+    return currentTier;
+}
+
+uint32_t QualityGovernor::getTier() const noexcept
+{
+    const uint32_t requested { requestedTier.load(std::memory_order_relaxed) };
+    return requested != noRequest ? requested : tier.load(std::memory_order_relaxed);
+}
+
+uint32_t QualityGovernor::getNumTiers() const noexcept
+{
+    return numTiers;
+}
+
+}
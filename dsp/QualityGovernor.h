@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace utils
+{
+
+// Chooses a quality tier from the processing load: steps down one tier (0 being the full quality)
+// when the load stays above a threshold, and back up when it stays below a lower one for longer.
+// The audio thread updates it once per block; the tier can be read from any thread.
+class QualityGovernor
+{
+public:
+
+    // Constructor
+    explicit QualityGovernor(uint32_t initNumTiers);
+
+    // No copy, no move: the tier is shared between threads
+    QualityGovernor(const QualityGovernor&) = delete;
+    QualityGovernor& operator=(const QualityGovernor&) = delete;
+
+    //================================================
+
+    // Set the sample rate the hold times are counted at
+    void prepare(double newSampleRate);
+
+    // Step down above stepDownLoad, up below stepUpLoad (1 being the whole real-time budget)
+    void setThresholds(float newStepDownLoad, float newStepUpLoad);
+
+    // How long the load must stay beyond a threshold before a step, in seconds
+    void setHoldTimes(double newStepDownSeconds, double newStepUpSeconds);
+
+    // Enable the adaptation. Disabled, the tier goes back to the full quality
+    void setEnabled(bool shouldBeEnabled);
+
+    // Start from a tier, e.g. the one a previous session ended at. Any thread: the next update adopts it
+    void setTier(uint32_t newTier);
+
+    //================================================
+
+    // Account one block processed at the given load and return the tier for the next one. Real-time safe
+    uint32_t update(float load, uint32_t numSamples) noexcept;
+
+    // Current tier, or the one set and not yet adopted. Any thread
+    uint32_t getTier() const noexcept;
+
+    uint32_t getNumTiers() const noexcept;
+
+    //================================================
+
+private:
+
+    uint32_t numTiers;
+    double sampleRate { 48000.0 };
+
+    float stepDownLoad { 0.7f };
+    float stepUpLoad { 0.35f };
+    double stepDownSeconds { 0.25 };
+    double stepUpSeconds { 3.0 };
+    uint64_t stepDownSamples { 12000u };
+    uint64_t stepUpSamples { 144000u };
+
+    // Samples spent beyond each threshold, without interruption
+    uint64_t samplesAbove { 0u };
+    uint64_t samplesBelow { 0u };
+
+    std::atomic<bool> enabled { true };
+    std::atomic<uint32_t> tier { 0u };
+    // Tier set by setTier, for update to adopt: only the audio thread writes the tier
+    static constexpr uint32_t noRequest { UINT32_MAX };
+    std::atomic<uint32_t> requestedTier { noRequest };
+};
+
+}
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+
+#include "RealtimeLogger.h"
+
+namespace utils
+{
+
+RealtimeLogger::Channel::Channel(uint32_t capacity) :
+    records(capacity),
+    mask { static_cast<uint64_t>(capacity) - 1u }
+{
+    assert(capacity > 0u && (capacity & (capacity - 1u)) == 0u && "Channel capacity must be a power of two");
+}
+
+uint64_t RealtimeLogger::Channel::getDroppedRecords() const noexcept
+{
+    return dropped.load(std::memory_order_relaxed);
+}
+
+void RealtimeLogger::Channel::pop(std::vector<Record>& output)
+{
+    const uint64_t head { writeIndex.load(std::memory_order_acquire) };
+    uint64_t tail { readIndex.load(std::memory_order_relaxed) };
+
+    for (; tail != head; ++tail)
+        output.push_back(records[tail & mask]);
+
+    readIndex.store(tail, std::memory_order_release);
+}
+
+//================================================
+
+RealtimeLogger::RealtimeLogger(Sink initSink, uint32_t numChannels /*= 1u*/, uint32_t capacityPerChannel /*= 1024u*/) :
+    sink { std::move(initSink) }
+{
+    assert(numChannels > 0u);
+    assert(sink && "Logger needs a sink");
+
+    channels.reserve(numChannels);
+    for (uint32_t c = 0; c < numChannels; ++c)
+        channels.push_back(std::make_unique<Channel>(capacityPerChannel));
+    pending.reserve(static_cast<size_t>(numChannels) * capacityPerChannel);
+
+    thread = std::thread { [this] { run(); } };
+}
+
+RealtimeLogger::~RealtimeLogger()
+{
+    {
+        std::lock_guard<std::mutex> lock { mutex };
+        running = false;
+    }
+    wakeUp.notify_all();
+    thread.join();
+
+    flush();
+}
+
+//================================================
+
+RealtimeLogger::Channel& RealtimeLogger::getChannel(uint32_t channelIndex)
+{
+    assert(channelIndex < channels.size());
+    return *channels[channelIndex];
+}
+
+uint64_t RealtimeLogger::getDroppedRecords() const noexcept
+{
+    uint64_t dropped { 0u };
+    for (const auto& channel : channels)
+        dropped += channel->getDroppedRecords();
+    return dropped;
+}
+
+MemoryFootprint RealtimeLogger::getMemoryFootprint() const
+{
+    MemoryFootprint footprint { MemoryFootprint::of(channels), 0u };
+    for (const auto& channel : channels)
+        footprint.owned += sizeof(Channel) + MemoryFootprint::of(channel->records);
+    return footprint;
+}
+
+//================================================
+
+std::string RealtimeLogger::format(const Record& record)
+{
+    std::ostringstream stream;
+    uint32_t argumentIndex { 0u };
+
+    for (const char* c = record.format; *c != '\0'; ++c)
+    {
+        if (c[0] == '{' && c[1] == '}' && argumentIndex < record.numArguments)
+        {
+            const Argument& argument { record.arguments[argumentIndex++] };
+            switch (argument.type)
+            {
+                case Argument::Type::Signed:   stream << argument.signedValue;   break;
+                case Argument::Type::Unsigned: stream << argument.unsignedValue; break;
+                case Argument::Type::Floating: stream << argument.floatingValue; break;
+            }
+            ++c;
+        }
+        else
+        {
+            stream << *c;
+        }
+    }
+
+    return stream.str();
+}
+
+void RealtimeLogger::flush()
+{
+    pending.clear();
+    for (auto& channel : channels)
+        channel->pop(pending);
+
+    // Each channel is in order: a stable sort by time interleaves them
+    std::stable_sort(pending.begin(), pending.end(),
+                     [](const Record& a, const Record& b) { return a.time < b.time; });
+
+    for (const Record& record : pending)
+        sink(format(record));
+}
+
+void RealtimeLogger::run()
+{
+    std::unique_lock<std::mutex> lock { mutex };
+    while (running)
+    {
+        wakeUp.wait_for(lock, flushInterval);
+        flush();
+    }
+}
+
+}
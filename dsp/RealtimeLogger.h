@@ -0,0 +1,204 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "MemoryFootprint.h"
+
+namespace utils
+{
+
+// Logging from real-time threads. A message is a format literal with "{}" placeholders and up to
+// four numeric arguments, copied as a fixed-size binary record into a single-producer single-consumer
+// ring: no formatting, locks or allocation on the calling thread. A background thread formats the
+// records and passes each line to the sink.
+//
+//     logger.log("Smoothing took {} samples", numSamples);
+//
+// Each producer thread logs through its own channel, or shares one with logShared, which serializes the
+// producers. Records are dropped, never waited for, when a ring is full or another producer is pushing.
+class RealtimeLogger
+{
+public:
+
+    static constexpr uint32_t maxArguments { 4u };
+
+    // Receives each formatted line, on the background thread
+    using Sink = std::function<void(const std::string&)>;
+
+    // One numeric argument of a record
+    struct Argument
+    {
+        enum class Type : uint8_t { Signed, Unsigned, Floating };
+
+        Type type;
+        union
+        {
+            int64_t signedValue;
+            uint64_t unsignedValue;
+            double floatingValue;
+        };
+    };
+
+    // One message, formatted later
+    struct Record
+    {
+        const char* format;
+        std::chrono::steady_clock::time_point time;
+        uint32_t numArguments;
+        std::array<Argument, maxArguments> arguments;
+    };
+
+    //================================================
+
+    // Ring of records filled by a single thread
+    class Channel
+    {
+    public:
+        explicit Channel(uint32_t capacity);
+
+        // Push a message. Real-time safe; returns false if the record was dropped
+        template <typename... Args>
+        bool log(const char* format, Args... args) noexcept
+        {
+            static_assert(sizeof...(Args) <= maxArguments, "Too many log arguments");
+            static_assert((std::is_arithmetic_v<Args> && ...), "Log arguments must be numbers");
+
+            const uint64_t head { writeIndex.load(std::memory_order_relaxed) };
+            if (head - readIndex.load(std::memory_order_acquire) >= records.size())
+            {
+                dropped.fetch_add(1u, std::memory_order_relaxed);
+                return false;
+            }
+
+            Record& record { records[head & mask] };
+            record.format = format;
+            record.time = std::chrono::steady_clock::now();
+            record.numArguments = static_cast<uint32_t>(sizeof...(Args));
+            uint32_t index { 0u };
+            (setArgument(record.arguments[index++], args), ...);
+
+            writeIndex.store(head + 1u, std::memory_order_release);
+            return true;
+        }
+
+        // Push a message from one of several threads sharing the channel. While another one is pushing, the
+        // record is dropped, as on a full ring. Real-time safe
+        template <typename... Args>
+        bool logShared(const char* format, Args... args) noexcept
+        {
+            if (producing.test_and_set(std::memory_order_acquire))
+            {
+                dropped.fetch_add(1u, std::memory_order_relaxed);
+                return false;
+            }
+            const bool pushed { log(format, args...) };
+            producing.clear(std::memory_order_release);
+            return pushed;
+        }
+
+        // Records dropped because the ring was full, or shared and busy
+        uint64_t getDroppedRecords() const noexcept;
+
+    private:
+        friend class RealtimeLogger;
+
+        template <typename Arg>
+        static void setArgument(Argument& argument, Arg value) noexcept
+        {
+            if constexpr (std::is_floating_point_v<Arg>)
+            {
+                argument.type = Argument::Type::Floating;
+                argument.floatingValue = static_cast<double>(value);
+            }
+            else if constexpr (std::is_signed_v<Arg>)
+            {
+                argument.type = Argument::Type::Signed;
+                argument.signedValue = static_cast<int64_t>(value);
+            }
+            else
+            {
+                argument.type = Argument::Type::Unsigned;
+                argument.unsignedValue = static_cast<uint64_t>(value);
+            }
+        }
+
+        // Consumer side: append the available records
+        void pop(std::vector<Record>& output);
+
+        std::vector<Record> records;
+        uint64_t mask;
+        std::atomic<uint64_t> writeIndex { 0u };
+        std::atomic<uint64_t> readIndex { 0u };
+        std::atomic<uint64_t> dropped { 0u };
+        // Held by the thread pushing through logShared
+        std::atomic_flag producing = ATOMIC_FLAG_INIT;
+    };
+
+    //================================================
+
+    // Constructor. Allocates the rings and starts the background thread
+    explicit RealtimeLogger(Sink initSink, uint32_t numChannels = 1u, uint32_t capacityPerChannel = 1024u);
+
+    // Destructor. Flushes the remaining records and stops the background thread
+    ~RealtimeLogger();
+
+    // No copy, no move: the background thread refers to the logger
+    RealtimeLogger(const RealtimeLogger&) = delete;
+    RealtimeLogger& operator=(const RealtimeLogger&) = delete;
+
+    //================================================
+
+    // The channel of one producer thread
+    Channel& getChannel(uint32_t channelIndex);
+
+    // Log through the first channel
+    template <typename... Args>
+    bool log(const char* format, Args... args) noexcept
+    {
+        return channels.front()->log(format, args...);
+    }
+
+    // Records dropped on all channels
+    uint64_t getDroppedRecords() const noexcept;
+
+    // Heap memory of the channel rings, allocated in the constructor
+    MemoryFootprint getMemoryFootprint() const;
+
+    //================================================
+
+    // Replace the placeholders of the record's format with its arguments
+    static std::string format(const Record& record);
+
+private:
+
+    // Pop the records of every channel and pass them to the sink in time order
+    void flush();
+
+    void run();
+
+    //================================================
+
+    static constexpr std::chrono::milliseconds flushInterval { 20 };
+
+    Sink sink;
+    std::vector<std::unique_ptr<Channel>> channels;
+    std::vector<Record> pending;
+
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    bool running { true };
+    std::thread thread;
+};
+
+}
@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+
+#include "SessionCapture.h"
+
+namespace utils
+{
+
+namespace
+{
+    template <typename Value>
+    void writeValue(std::ofstream& stream, const Value& value)
+    {
+        stream.write(reinterpret_cast<const char*>(&value), sizeof(Value));
+    }
+
+    template <typename Value>
+    bool readValue(std::ifstream& stream, Value& value)
+    {
+        return static_cast<bool>(stream.read(reinterpret_cast<char*>(&value), sizeof(Value)));
+    }
+
+    // Upper bounds of the sizes accepted on read, so corrupt data cannot trigger huge allocations
+    constexpr uint32_t maxChannels { 256u };
+    constexpr uint32_t maxParameters { 4096u };
+    constexpr uint32_t maxIdLength { 1024u };
+    constexpr uint32_t maxStateBytes { 1u << 26 };
+    constexpr uint32_t maxBlockSamples { 1u << 20 };
+
+    // Bytes between the read position and the end of the file, 0 if the stream failed
+    uint64_t getBytesLeft(std::ifstream& stream, uint64_t fileBytes)
+    {
+        const std::streamoff position { stream.tellg() };
+        return position < 0 ? 0u : fileBytes - std::min(fileBytes, static_cast<uint64_t>(position));
+    }
+}
+
+//================================================
+
+SessionCapture::SessionCapture(size_t initRingBytes /*= size_t { 1u } << 24*/) :
+    ringBytes { initRingBytes }
+{
+    assert(ringBytes > 0u && (ringBytes & (ringBytes - 1u)) == 0u && "Ring size must be a power of two");
+}
+
+SessionCapture::~SessionCapture()
+{
+    stop();
+}
+
+//================================================
+
+bool SessionCapture::start(const std::string& path, const CaptureHeader& header)
+{
+    stop();
+
+    file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (! file)
+        return false;
+
+    writeValue(file, fileMagic);
+    writeValue(file, fileVersion);
+    writeValue(file, header.sampleRate);
+    writeValue(file, header.numChannels);
+    writeValue(file, header.maxBlockSize);
+    writeValue(file, static_cast<uint32_t>(header.parameterIds.size()));
+    for (const auto& id : header.parameterIds)
+    {
+        writeValue(file, static_cast<uint32_t>(id.size()));
+        file.write(id.data(), static_cast<std::streamsize>(id.size()));
+    }
+    writeValue(file, static_cast<uint32_t>(header.state.size()));
+    file.write(header.state.data(), static_cast<std::streamsize>(header.state.size()));
+
+    // Allocated once and kept: the audio thread may still be reading the capturing flag
+    if (ring == nullptr)
+    {
+        ring = std::make_unique<char[]>(ringBytes);
+        chunk.resize(ringBytes);
+    }
+    writeIndex.store(0u, std::memory_order_relaxed);
+    readIndex.store(0u, std::memory_order_relaxed);
+    pushIndex = 0u;
+    pendingGap = 0u;
+    droppedBlocks.store(0u, std::memory_order_relaxed);
+
+    running = true;
+    writer = std::thread { [this] { run(); } };
+    capturing.store(true, std::memory_order_seq_cst);
+    return true;
+}
+
+void SessionCapture::stop()
+{
+    if (! writer.joinable())
+        return;
+
+    // Wait for a block being pushed, then no other can start
+    capturing.store(false, std::memory_order_seq_cst);
+    while (pushing.load(std::memory_order_acquire))
+        std::this_thread::yield();
+
+    {
+        std::lock_guard<std::mutex> lock { mutex };
+        running = false;
+    }
+    wakeUp.notify_all();
+    writer.join();
+
+    drain();
+    if (pendingGap > 0u)
+    {
+        writeValue(file, static_cast<uint32_t>(RecordType::Gap));
+        writeValue(file, pendingGap);
+    }
+    file.close();
+}
+
+bool SessionCapture::isCapturing() const noexcept
+{
+    return capturing.load(std::memory_order_relaxed);
+}
+
+uint64_t SessionCapture::getDroppedBlocks() const noexcept
+{
+    return droppedBlocks.load(std::memory_order_relaxed);
+}
+
+MemoryFootprint SessionCapture::getMemoryFootprint() const
+{
+    return { ring != nullptr ? ringBytes + MemoryFootprint::of(chunk) : size_t { 0u }, 0u };
+}
+
+//================================================
+
+size_t SessionCapture::getFreeBytes() const noexcept
+{
+    return ringBytes - static_cast<size_t>(pushIndex - readIndex.load(std::memory_order_acquire));
+}
+
+void SessionCapture::writeBytes(const void* data, size_t numBytes) noexcept
+{
+    const size_t start { static_cast<size_t>(pushIndex & (ringBytes - 1u)) };
+    const size_t firstPart { std::min(numBytes, ringBytes - start) };
+
+    std::memcpy(ring.get() + start, data, firstPart);
+    std::memcpy(ring.get(), static_cast<const char*>(data) + firstPart, numBytes - firstPart);
+    pushIndex += numBytes;
+}
+
+void SessionCapture::drain()
+{
+    const uint64_t head { writeIndex.load(std::memory_order_acquire) };
+    const uint64_t tail { readIndex.load(std::memory_order_relaxed) };
+    const size_t numBytes { static_cast<size_t>(head - tail) };
+    if (numBytes == 0u)
+        return;
+
+    // Copy out first, so that the ring space is released before the file write
+    const size_t start { static_cast<size_t>(tail & (ringBytes - 1u)) };
+    const size_t firstPart { std::min(numBytes, ringBytes - start) };
+    std::memcpy(chunk.data(), ring.get() + start, firstPart);
+    std::memcpy(chunk.data() + firstPart, ring.get(), numBytes - firstPart);
+    readIndex.store(head, std::memory_order_release);
+
+    file.write(chunk.data(), static_cast<std::streamsize>(numBytes));
+}
+
+void SessionCapture::run()
+{
+    std::unique_lock<std::mutex> lock { mutex };
+    while (running)
+    {
+        wakeUp.wait_for(lock, std::chrono::milliseconds { 20 });
+        drain();
+    }
+}
+
+//================================================
+
+bool SessionCapture::Reader::open(const std::string& path)
+{
+    file.open(path, std::ios::in | std::ios::binary | std::ios::ate);
+    const std::streamoff endPosition { file.tellg() };
+    if (! file || endPosition < 0)
+        return false;
+    fileBytes = static_cast<uint64_t>(endPosition);
+    file.seekg(0);
+
+    uint32_t magic { 0u };
+    uint32_t version { 0u };
+    if (! readValue(file, magic) || magic != fileMagic || ! readValue(file, version) || version > fileVersion)
+        return false;
+
+    uint32_t numParameters { 0u };
+    if (! readValue(file, header.sampleRate) || ! readValue(file, header.numChannels)
+        || ! readValue(file, header.maxBlockSize) || ! readValue(file, numParameters))
+        return false;
+
+    // Each identifier takes at least its length
+    if (header.numChannels > maxChannels || numParameters > maxParameters
+        || getBytesLeft(file, fileBytes) < static_cast<uint64_t>(numParameters) * sizeof(uint32_t))
+        return false;
+
+    header.parameterIds.resize(numParameters);
+    for (auto& id : header.parameterIds)
+    {
+        uint32_t length { 0u };
+        if (! readValue(file, length) || length > maxIdLength || getBytesLeft(file, fileBytes) < length)
+            return false;
+        id.resize(length);
+        if (! file.read(id.data(), length))
+            return false;
+    }
+
+    uint32_t stateSize { 0u };
+    if (! readValue(file, stateSize) || stateSize > maxStateBytes || getBytesLeft(file, fileBytes) < stateSize)
+        return false;
+    header.state.resize(stateSize);
+    return static_cast<bool>(file.read(header.state.data(), stateSize));
+}
+
+bool SessionCapture::Reader::readBlock(CapturedBlock& block)
+{
+    block.droppedBefore = 0u;
+
+    uint32_t type { 0u };
+    while (readValue(file, type))
+    {
+        if (type == static_cast<uint32_t>(RecordType::Gap))
+        {
+            uint32_t dropped { 0u };
+            if (! readValue(file, dropped))
+                return false;
+            block.droppedBefore += dropped;
+            continue;
+        }
+
+        uint32_t numEvents { 0u };
+        if (type != static_cast<uint32_t>(RecordType::Block) || ! readValue(file, block.numSamples) || ! readValue(file, numEvents))
+            return false;
+
+        const uint64_t numValues { static_cast<uint64_t>(header.numChannels) * block.numSamples };
+        if (block.numSamples > maxBlockSamples
+            || getBytesLeft(file, fileBytes) < numEvents * uint64_t { sizeof(ParameterEvent) } + numValues * sizeof(float))
+            return false;
+
+        block.events.resize(numEvents);
+        block.samples.resize(static_cast<size_t>(numValues));
+        return file.read(reinterpret_cast<char*>(block.events.data()), static_cast<std::streamsize>(numEvents * sizeof(ParameterEvent)))
+            && file.read(reinterpret_cast<char*>(block.samples.data()), static_cast<std::streamsize>(block.samples.size() * sizeof(float)));
+    }
+    return false;
+}
+
+}
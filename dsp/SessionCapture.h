@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "MemoryFootprint.h"
+
+namespace utils
+{
+
+// Everything needed to rebuild the processor before replaying the blocks
+struct CaptureHeader
+{
+    double sampleRate { 48000.0 };
+    uint32_t numChannels { 0u };
+    uint32_t maxBlockSize { 0u };
+    // Identifiers of the parameters, in the order of the parameter indices of the events
+    std::vector<std::string> parameterIds;
+    // Opaque processor state at the start of the capture
+    std::vector<char> state;
+};
+
+// A parameter set to a normalized value at a sample of a block
+struct ParameterEvent
+{
+    uint32_t parameterIndex;
+    uint32_t sampleOffset;
+    float value;
+};
+
+// One captured block: its parameter events and its input, channel after channel
+struct CapturedBlock
+{
+    uint32_t numSamples { 0u };
+    std::vector<ParameterEvent> events;
+    std::vector<float> samples;
+    // Blocks lost just before this one, when the ring was full
+    uint32_t droppedBefore { 0u };
+};
+
+//================================================
+
+// Records the input blocks and parameter events of a processor to a compact binary file.
+// The audio thread copies each block into a preallocated single-producer single-consumer byte ring
+// without locks or allocation; a background thread streams the ring to the file. When the ring is
+// full the block is dropped and the gap is recorded, so that a replay knows it is not exact.
+class SessionCapture
+{
+public:
+
+    // Constructor. The ring is allocated on the first start
+    explicit SessionCapture(size_t initRingBytes = size_t { 1u } << 24);
+
+    // Destructor. Stops a running capture
+    ~SessionCapture();
+
+    // No copy, no move: the writer thread refers to the capture
+    SessionCapture(const SessionCapture&) = delete;
+    SessionCapture& operator=(const SessionCapture&) = delete;
+
+    //================================================
+
+    // Write the header and start capturing. Message thread; returns false if the file cannot be written
+    bool start(const std::string& path, const CaptureHeader& header);
+
+    // Stop capturing and complete the file. Message thread
+    void stop();
+
+    // Whether blocks are being captured. Real-time safe
+    bool isCapturing() const noexcept;
+
+    // Blocks lost to a full ring since the start
+    uint64_t getDroppedBlocks() const noexcept;
+
+    // Heap memory of the ring and of the writer's chunk, allocated by the first start and kept. Message thread
+    MemoryFootprint getMemoryFootprint() const;
+
+    //================================================
+
+    // Capture one block and the events that apply to it. Real-time safe
+    template <typename SampleType>
+    void pushBlock(const SampleType* const* channels, uint32_t numChannels, uint32_t numSamples,
+                   const ParameterEvent* events, uint32_t numEvents) noexcept;
+
+    //================================================
+
+    // Reads a capture back, block after block
+    class Reader
+    {
+    public:
+        // Open the file and read its header. Returns false if it is not a capture, or a corrupt one
+        bool open(const std::string& path);
+
+        const CaptureHeader& getHeader() const { return header; }
+
+        // Read the next block. Returns false at the end of the file
+        bool readBlock(CapturedBlock& block);
+
+    private:
+        std::ifstream file;
+        uint64_t fileBytes { 0u };
+        CaptureHeader header;
+    };
+
+    //================================================
+
+private:
+
+    enum class RecordType : uint32_t { Block = 1u, Gap = 2u };
+
+    static constexpr uint32_t fileMagic { 0x43465654 };  // "TVFC"
+    static constexpr uint32_t fileVersion { 1u };
+
+    //================================================
+
+    size_t getFreeBytes() const noexcept;
+    // Copy to the ring at the push index, wrapping around. Audio thread
+    void writeBytes(const void* data, size_t numBytes) noexcept;
+
+    // Write the ring to the file
+    void drain();
+    void run();
+
+    //================================================
+
+    size_t ringBytes;
+    std::unique_ptr<char[]> ring;
+    std::atomic<uint64_t> writeIndex { 0u };
+    // End of the record being pushed, ahead of the published write index. Audio thread
+    uint64_t pushIndex { 0u };
+    std::atomic<uint64_t> readIndex { 0u };
+
+    std::atomic<bool> capturing { false };
+    // Set by the audio thread while it pushes, so that stop can wait for it
+    std::atomic<bool> pushing { false };
+    std::atomic<uint64_t> droppedBlocks { 0u };
+    uint32_t pendingGap { 0u };
+
+    std::ofstream file;
+    std::vector<char> chunk;
+
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    bool running { false };
+    std::thread writer;
+};
+
+//================================================
+
+template <typename SampleType>
+void SessionCapture::pushBlock(const SampleType* const* channels, uint32_t numChannels, uint32_t numSamples,
+                               const ParameterEvent* events, uint32_t numEvents) noexcept
+{
+    static_assert(std::is_floating_point_v<SampleType>, "Captured samples must be floating point");
+
+    pushing.store(true, std::memory_order_seq_cst);
+    if (capturing.load(std::memory_order_seq_cst))
+    {
+        const size_t gapBytes { pendingGap > 0u ? 2u * sizeof(uint32_t) : 0u };
+        const size_t blockBytes { 3u * sizeof(uint32_t) + numEvents * sizeof(ParameterEvent)
+                                  + static_cast<size_t>(numChannels) * numSamples * sizeof(float) };
+
+        if (gapBytes + blockBytes > getFreeBytes())
+        {
+            ++pendingGap;
+            droppedBlocks.fetch_add(1u, std::memory_order_relaxed);
+        }
+        else
+        {
+            if (pendingGap > 0u)
+            {
+                const uint32_t gap[2] { static_cast<uint32_t>(RecordType::Gap), pendingGap };
+                writeBytes(gap, sizeof(gap));
+                pendingGap = 0u;
+            }
+
+            const uint32_t blockHeader[3] { static_cast<uint32_t>(RecordType::Block), numSamples, numEvents };
+            writeBytes(blockHeader, sizeof(blockHeader));
+            writeBytes(events, numEvents * sizeof(ParameterEvent));
+
+            // Samples are stored in single precision
+            for (uint32_t ch = 0; ch < numChannels; ++ch)
+            {
+                if constexpr (std::is_same_v<SampleType, float>)
+                {
+                    writeBytes(channels[ch], numSamples * sizeof(float));
+                }
+                else
+                {
+                    float converted[256];
+                    for (uint32_t n = 0; n < numSamples; n += 256u)
+                    {
+                        const uint32_t count { std::min(256u, numSamples - n) };
+                        for (uint32_t i = 0; i < count; ++i)
+                            converted[i] = static_cast<float>(channels[ch][n + i]);
+                        writeBytes(converted, count * sizeof(float));
+                    }
+                }
+            }
+
+            // Publish the whole record at once
+            writeIndex.store(pushIndex, std::memory_order_release);
+        }
+    }
+    pushing.store(false, std::memory_order_release);
+}
+
+}
@@ -1,6 +1,6 @@
 #pragma once
 
-// #include <cstdint>
+#include <cstdint>
 // #include <cstddef>
 #include <type_traits>
 
@@ -79,12 +79,10 @@ private:
     uint32_t smoothingSamples;
     float smoothingStep;
 
-    //================================================
-
-    static_assert(std::is_copy_constructible_v<SmoothParameter>, "SmoothParameter must be copyable");
-    static_assert(std::is_move_constructible_v<SmoothParameter>, "SmoothParameter must be movable");
-    static_assert(std::is_nothrow_move_assignable_v<SmoothParameter>, "Move assignment should not throw");
-
 };
 
+static_assert(std::is_copy_constructible_v<SmoothParameter>, "SmoothParameter must be copyable");
+static_assert(std::is_move_constructible_v<SmoothParameter>, "SmoothParameter must be movable");
+static_assert(std::is_nothrow_move_assignable_v<SmoothParameter>, "Move assignment should not throw");
+
 }
\ No newline at end of file
@@ -0,0 +1,330 @@
+#include "SubbandFDN.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstddef>
+
+namespace DSP
+{
+
+template <typename SampleType>
+void SubbandFDN<SampleType>::FrameDelay::prepare(uint32_t newNumChannels, size_t newLength)
+{
+    numChannels = newNumChannels;
+    length = newLength;
+    buffer.resize(length * numChannels);
+    clear();
+}
+
+template <typename SampleType>
+void SubbandFDN<SampleType>::FrameDelay::clear()
+{
+    std::fill(buffer.begin(), buffer.end(), SampleType { 0 });
+    index = 0u;
+}
+
+template <typename SampleType>
+void SubbandFDN<SampleType>::FrameDelay::process(SampleType* frame)
+{
+    if (length == 0u)
+        return;
+
+    SampleType* slot { buffer.data() + index * numChannels };
+    for (size_t ch = 0; ch < static_cast<size_t>(numChannels); ++ch)
+        std::swap(slot[ch], frame[ch]);
+    index = index + 1u == length ? 0u : index + 1u;
+}
+
+// =============================================
+
+template <typename SampleType>
+SubbandFDN<SampleType>::Reverb::Reverb(const BandSettings& settings, uint32_t numInputChannels, uint32_t numOutputChannels, uint32_t seed) :
+    order { settings.order },
+    inputCoupling { static_cast<int>(settings.order), static_cast<int>(numInputChannels), seed + 1u },
+    fdn { settings.order, settings.T60DC, settings.brightness, seed },
+    outputCoupling { static_cast<int>(numOutputChannels), static_cast<int>(settings.order), seed + 2u }
+{
+}
+
+template <typename SampleType>
+SubbandFDN<SampleType>::Band::Band(const BandSettings& settings, uint32_t numInputChannels, uint32_t numOutputChannels, uint32_t seed) :
+    reverb { settings.order > 0u ? std::make_unique<Reverb>(settings, numInputChannels, numOutputChannels, seed) : nullptr },
+    decimator { numInputChannels },
+    analysisInterpolator { numInputChannels },
+    synthesisInterpolator { numOutputChannels }
+{
+}
+
+// =============================================
+
+template <typename SampleType>
+SubbandFDN<SampleType>::SubbandFDN(const std::vector<BandSettings>& initBands, uint32_t initNumInputChannels, uint32_t initNumOutputChannels, uint32_t initSeed /*= 0u*/) :
+    numInputChannels { initNumInputChannels },
+    numOutputChannels { initNumOutputChannels }
+{
+    jassert(! initBands.empty() && "A subband FDN needs at least one band");
+    jassert(numInputChannels > 0u && numOutputChannels > 0u && "Number of channels must be greater than zero");
+
+    // Three seeds per band: FDN, input coupling, output coupling
+    bands.reserve(initBands.size());
+    for (size_t k = 0; k < initBands.size(); ++k)
+        bands.push_back(std::make_unique<Band>(initBands[k], numInputChannels, numOutputChannels, initSeed + 3u * static_cast<uint32_t>(k)));
+}
+
+template <typename SampleType>
+SubbandFDN<SampleType>::~SubbandFDN()
+{
+}
+
+template <typename SampleType>
+uint32_t SubbandFDN<SampleType>::getNumBands() const
+{
+    return static_cast<uint32_t>(bands.size());
+}
+
+template <typename SampleType>
+double SubbandFDN<SampleType>::getCrossoverFrequency(uint32_t band) const
+{
+    jassert(band < bands.size() && "Band index out of range");
+    if (band + 1u == bands.size())
+        return 0.0;
+    // Cutoff of the decimator to the next band
+    return PolyphaseDecimator<SampleType>::getCutoff() * sampleRate / static_cast<double>(2u << band);
+}
+
+template <typename SampleType>
+uint32_t SubbandFDN<SampleType>::getLatency() const
+{
+    return latency;
+}
+
+template <typename SampleType>
+utils::MemoryFootprint SubbandFDN<SampleType>::getMemoryFootprint() const
+{
+    utils::MemoryFootprint footprint { utils::MemoryFootprint::of(bands), 0u };
+    for (const auto& band : bands)
+    {
+        footprint.owned += sizeof(Band);
+        if (band->reverb != nullptr)
+        {
+            footprint.owned += sizeof(Reverb) + utils::MemoryFootprint::of(band->reverb->inBetween);
+            footprint += band->reverb->inputCoupling.getMemoryFootprint();
+            footprint += band->reverb->fdn.getMemoryFootprint().getTotal();
+            footprint += band->reverb->outputCoupling.getMemoryFootprint();
+        }
+
+        footprint += band->decimator.getMemoryFootprint();
+        footprint += band->analysisInterpolator.getMemoryFootprint();
+        footprint += band->synthesisInterpolator.getMemoryFootprint();
+        for (const auto* frameDelay : { &band->analysisDelay, &band->synthesisDelay })
+            footprint.owned += utils::MemoryFootprint::of(frameDelay->buffer);
+        for (const auto* frame : { &band->lowInput, &band->lowOutput, &band->bandInput, &band->delayedInput, &band->lowPart })
+            footprint.owned += utils::MemoryFootprint::of(*frame);
+    }
+    return footprint;
+}
+
+template <typename SampleType>
+void SubbandFDN<SampleType>::setT60(uint32_t band, SampleType newT60DC)
+{
+    jassert(band < bands.size() && "Band index out of range");
+    if (bands[band]->reverb != nullptr)
+        bands[band]->reverb->fdn.setT60(newT60DC);
+}
+
+template <typename SampleType>
+void SubbandFDN<SampleType>::setBrightness(uint32_t band, SampleType newBrightness)
+{
+    jassert(band < bands.size() && "Band index out of range");
+    if (bands[band]->reverb != nullptr)
+        bands[band]->reverb->fdn.setBrightness(newBrightness);
+}
+
+template <typename SampleType>
+void SubbandFDN<SampleType>::setRoomSize(SampleType newRoomSize)
+{
+    for (auto& band : bands)
+        if (band->reverb != nullptr)
+            band->reverb->fdn.setRoomSize(newRoomSize);
+}
+
+template <typename SampleType>
+void SubbandFDN<SampleType>::reserveRoomSize()
+{
+    for (auto& band : bands)
+        if (band->reverb != nullptr)
+            band->reverb->fdn.reserveRoomSize();
+}
+
+template <typename SampleType>
+void SubbandFDN<SampleType>::setModulation(SampleType newRateHz, SampleType newDepth)
+{
+    for (auto& band : bands)
+        if (band->reverb != nullptr)
+            band->reverb->fdn.setModulation(newRateHz, newDepth);
+}
+
+template <typename SampleType>
+FDN<SampleType>& SubbandFDN<SampleType>::getFDN(uint32_t band)
+{
+    jassert(band < bands.size() && bands[band]->reverb != nullptr && "Band index out of range, or muted band");
+    return bands[band]->reverb->fdn;
+}
+
+template <typename SampleType>
+void SubbandFDN<SampleType>::setBypassed(bool shouldBypass)
+{
+    jassert((! shouldBypass || numInputChannels == numOutputChannels) && "Bypass needs as many output channels as input channels");
+    bypassed = shouldBypass;
+}
+
+template <typename SampleType>
+void SubbandFDN<SampleType>::prepare(double newSampleRate, int samplesPerBlock)
+{
+    jassert(newSampleRate > 0.0 && "Sample rate must be greater than zero");
+    sampleRate = newSampleRate;
+
+    double bandRate { sampleRate };
+    int bandBlockSize { samplesPerBlock };
+    for (auto& band : bands)
+    {
+        if (Reverb* reverb { band->reverb.get() })
+        {
+            reverb->inputCoupling.prepare(static_cast<int>(reverb->order), static_cast<int>(numInputChannels));
+            reverb->outputCoupling.prepare(static_cast<int>(numOutputChannels), static_cast<int>(reverb->order));
+            reverb->fdn.prepare(bandRate, bandBlockSize);
+            reverb->inBetween.resize(reverb->order);
+        }
+
+        band->decimator.prepare(numInputChannels, 2u);
+        band->analysisInterpolator.prepare(numInputChannels, 2u);
+        band->synthesisInterpolator.prepare(numOutputChannels, 2u);
+
+        band->lowInput.resize(numInputChannels);
+        band->lowOutput.resize(numOutputChannels);
+        band->bandInput.resize(numInputChannels);
+        band->delayedInput.resize(numInputChannels);
+        band->lowPart.resize(numOutputChannels);
+
+        bandRate *= 0.5;
+        bandBlockSize = (bandBlockSize + 1) / 2;
+    }
+
+    // Align each band with the path through the lower ones, from the bottom up. The band is
+    // delayed like its lower octaves in the analysis, and like the latency of the bands below
+    // (twice as many samples at this rate) in the synthesis
+    latency = 0u;
+    for (size_t k = bands.size(); k-- > 0u;)
+    {
+        Band& band { *bands[k] };
+        if (k + 1u == bands.size())
+        {
+            band.analysisDelay.prepare(numInputChannels, 0u);
+            band.synthesisDelay.prepare(numOutputChannels, 0u);
+            continue;
+        }
+
+        const uint32_t analysisLatency { band.decimator.getLatency() + band.analysisInterpolator.getLatency() };
+        band.analysisDelay.prepare(numInputChannels, analysisLatency);
+        band.synthesisDelay.prepare(numOutputChannels, 2u * latency);
+        latency = analysisLatency + 2u * latency;
+    }
+}
+
+template <typename SampleType>
+void SubbandFDN<SampleType>::clear()
+{
+    for (auto& band : bands)
+    {
+        if (band->reverb != nullptr)
+            band->reverb->fdn.clear();
+        band->decimator.clear();
+        band->analysisInterpolator.clear();
+        band->synthesisInterpolator.clear();
+        band->analysisDelay.clear();
+        band->synthesisDelay.clear();
+    }
+}
+
+template <typename SampleType>
+void SubbandFDN<SampleType>::update()
+{
+    DSP_TRACE_SCOPE("SubbandFDN::update");
+    for (auto& band : bands)
+        if (band->reverb != nullptr)
+            band->reverb->fdn.update();
+}
+
+template <typename SampleType>
+void SubbandFDN<SampleType>::process(SampleType* output, const SampleType* input)
+{
+    processBand(0u, output, input);
+}
+
+template <typename SampleType>
+void SubbandFDN<SampleType>::processBand(size_t index, SampleType* output, const SampleType* input)
+{
+    Band& band { *bands[index] };
+    if (index + 1u == bands.size())
+    {
+        processReverb(band, output, input);
+        return;
+    }
+
+    // The lower octaves, at half the rate, every other frame
+    if (band.decimator.processSample(band.lowInput.data(), input, numInputChannels))
+    {
+        band.analysisInterpolator.pushSample(band.lowInput.data(), numInputChannels);
+        processBand(index + 1u, band.lowOutput.data(), band.lowInput.data());
+        band.synthesisInterpolator.pushSample(band.lowOutput.data(), numOutputChannels);
+    }
+
+    // This band: the input minus its lower octaves, both delayed alike
+    if (band.reverb != nullptr || bypassed)
+    {
+        band.analysisInterpolator.processSample(band.bandInput.data(), numInputChannels);
+        std::copy(input, input + numInputChannels, band.delayedInput.begin());
+        band.analysisDelay.process(band.delayedInput.data());
+        for (size_t ch = 0; ch < static_cast<size_t>(numInputChannels); ++ch)
+            band.bandInput[ch] = band.delayedInput[ch] - band.bandInput[ch];
+
+        processReverb(band, output, band.bandInput.data());
+        band.synthesisDelay.process(output);
+    }
+    else
+    {
+        std::fill(output, output + numOutputChannels, SampleType { 0 });
+    }
+
+    // Merge with the lower octaves
+    band.synthesisInterpolator.processSample(band.lowPart.data(), numOutputChannels);
+    for (size_t ch = 0; ch < static_cast<size_t>(numOutputChannels); ++ch)
+        output[ch] += band.lowPart[ch];
+}
+
+template <typename SampleType>
+void SubbandFDN<SampleType>::processReverb(Band& band, SampleType* output, const SampleType* input)
+{
+    if (bypassed)
+    {
+        std::copy(input, input + numOutputChannels, output);
+        return;
+    }
+
+    Reverb* reverb { band.reverb.get() };
+    if (reverb == nullptr)
+    {
+        std::fill(output, output + numOutputChannels, SampleType { 0 });
+        return;
+    }
+
+    reverb->inputCoupling.processSample(reverb->inBetween.data(), input, reverb->order, numInputChannels);
+    reverb->fdn.process(reverb->inBetween.data(), reverb->inBetween.data(), reverb->order);
+    reverb->outputCoupling.processSample(output, reverb->inBetween.data(), numOutputChannels, reverb->order);
+}
+
+// =============================================
+
+template class SubbandFDN<float>;
+template class SubbandFDN<double>;
+
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include <JuceHeader.h>
+
+#include "FDN.h"
+#include "Matrix.h"
+#include "PolyphaseResampler.h"
+
+namespace DSP
+{
+
+// Multirate reverb: one FDN per octave band, each at the lowest rate its band allows, so that
+// the short-lived high frequencies do not cost as much as the long low-frequency tail.
+// The input is split by a Laplacian pyramid (an oversampled filterbank): band k is the input at
+// rate / 2^k minus its decimated and interpolated lower octaves, and the last band is what is left
+// below. Each band runs its own couplings and FDN, with its own order and T60; the synthesis adds
+// every band to the interpolated sum of the bands below it. Bypassed, without the FDNs, the split
+// reconstructs the input up to rounding, delayed by getLatency.
+// The delay lengths of an FDN are in samples at its own rate, so they last 2^k times longer in band k.
+// A band of order 0 is muted, as if absorbed at once, and costs nothing but the filterbank: the
+// top octave of a dark hall, say.
+template <typename SampleType>
+class SubbandFDN
+{
+public:
+    // Settings of one band, from the highest
+    struct BandSettings
+    {
+        uint32_t order;     // 0 mutes the band
+        SampleType T60DC;
+        SampleType brightness { SampleType { 1 } };
+    };
+
+    SubbandFDN(
+        const std::vector<BandSettings>& initBands,
+        uint32_t initNumInputChannels,
+        uint32_t initNumOutputChannels,
+        uint32_t initSeed = 0u
+    );
+    ~SubbandFDN();
+
+    // No default ctor
+    SubbandFDN() = delete;
+
+    // No copy semantics
+    SubbandFDN(const SubbandFDN&) = delete;
+    const SubbandFDN& operator=(const SubbandFDN&) = delete;
+
+    // No move semantics
+    SubbandFDN(SubbandFDN&&) = delete;
+    const SubbandFDN& operator=(SubbandFDN&&) = delete;
+
+    // =============================================
+
+    uint32_t getNumBands() const;
+
+    // Lower edge of a band in Hz (0 for the last one), at the prepared sample rate
+    double getCrossoverFrequency(uint32_t band) const;
+
+    // Delay of the filterbank, in samples at the full rate
+    uint32_t getLatency() const;
+
+    // Heap memory of the filterbank and of the FDNs of all bands. Not while processing
+    utils::MemoryFootprint getMemoryFootprint() const;
+
+    // Per-band reverberation time at DC and brightness. Ignored by muted bands
+    void setT60(uint32_t band, SampleType newT60DC);
+    void setBrightness(uint32_t band, SampleType newBrightness);
+
+    // For all bands, see FDN
+    void setRoomSize(SampleType newRoomSize);
+    void reserveRoomSize();
+    void setModulation(SampleType newRateHz, SampleType newDepth);
+
+    // Direct access to the FDN of a band, for the settings not forwarded here. Not for muted bands
+    FDN<SampleType>& getFDN(uint32_t band);
+
+    // Pass the input of every band, muted ones included, straight to its output instead of through its couplings
+    // and FDN: the filterbank alone. Needs as many output channels as input channels. Not while processing
+    void setBypassed(bool shouldBypass);
+
+    // =============================================
+
+    // Prepare the filterbank and the FDNs, each at the rate of its band
+    void prepare(double newSampleRate, int samplesPerBlock);
+
+    // Clear contents
+    void clear();
+
+    // Apply pending reconfigurations of the FDNs. Call on the audio thread once per block, before process
+    void update();
+
+    // Process one frame at the full rate: input and output channels, as given to the constructor
+    void process(SampleType* output, const SampleType* input);
+
+private:
+    // Fixed delay of a few frames, to align a band with the path through the lower octaves
+    struct FrameDelay
+    {
+        void prepare(uint32_t newNumChannels, size_t newLength);
+        void clear();
+        // Replace the frame by the one pushed length frames ago
+        void process(SampleType* frame);
+
+        uint32_t numChannels { 0u };
+        size_t length { 0u };
+        size_t index { 0u };
+        std::vector<SampleType> buffer;
+    };
+
+    // Couplings and FDN of a band
+    struct Reverb
+    {
+        Reverb(const BandSettings& settings, uint32_t numInputChannels, uint32_t numOutputChannels, uint32_t seed);
+
+        uint32_t order;
+        DSP::Matrix<SampleType> inputCoupling;
+        DSP::FDN<SampleType> fdn;
+        DSP::Matrix<SampleType> outputCoupling;
+        std::vector<SampleType> inBetween;
+    };
+
+    struct Band
+    {
+        Band(const BandSettings& settings, uint32_t numInputChannels, uint32_t numOutputChannels, uint32_t seed);
+
+        // nullptr when the band is muted
+        std::unique_ptr<Reverb> reverb;
+
+        // Split from and merge with the next band, at half the rate. Unused in the last band
+        DSP::PolyphaseDecimator<SampleType> decimator;
+        DSP::PolyphaseInterpolator<SampleType> analysisInterpolator;
+        DSP::PolyphaseInterpolator<SampleType> synthesisInterpolator;
+        FrameDelay analysisDelay;
+        FrameDelay synthesisDelay;
+
+        // Frames, allocated in prepare
+        std::vector<SampleType> lowInput;
+        std::vector<SampleType> lowOutput;
+        std::vector<SampleType> bandInput;
+        std::vector<SampleType> delayedInput;
+        std::vector<SampleType> lowPart;
+    };
+
+    // One frame of band index at its rate, and of all the bands below it
+    void processBand(size_t index, SampleType* output, const SampleType* input);
+
+    // Couplings and FDN of a band, silence for a muted one, or the input when bypassed
+    void processReverb(Band& band, SampleType* output, const SampleType* input);
+
+    double sampleRate { 48000.0 };
+    uint32_t numInputChannels;
+    uint32_t numOutputChannels;
+    uint32_t latency { 0u };
+    bool bypassed { false };
+
+    std::vector<std::unique_ptr<Band>> bands;
+
+    static_assert(std::is_floating_point_v<SampleType>, "SubbandFDN requires a floating-point sample type");
+};
+
+}
@@ -0,0 +1,178 @@
+#include <map>
+#include <mutex>
+#include <random>
+#include <tuple>
+
+#include "TopologyCache.h"
+#include "Trace.h"
+
+namespace DSP
+{
+
+namespace
+{
+    // Salts keep the random streams of matrices and delays independent for the same seed
+    constexpr uint64_t matrixSalt { 0x9E3779B97F4A7C15ull };
+    constexpr uint64_t delaySalt  { 0xC2B2AE3D27D4EB4Full };
+
+    // Key of a cached matrix: (dim1, dim2, seed)
+    using MatrixKey = std::tuple<int, int, uint32_t>;
+    // Key of a cached delay set: (number, minDelay, maxDelay, seed)
+    using DelayKey = std::tuple<uint32_t, size_t, size_t, uint32_t>;
+
+    std::mutex& getCacheMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    template <typename SampleType>
+    std::map<MatrixKey, std::weak_ptr<const TopologyCache::MatrixType<SampleType>>>& getMatrixEntries()
+    {
+        static std::map<MatrixKey, std::weak_ptr<const TopologyCache::MatrixType<SampleType>>> entries;
+        return entries;
+    }
+
+    std::map<DelayKey, std::weak_ptr<const std::vector<size_t>>>& getDelayEntries()
+    {
+        static std::map<DelayKey, std::weak_ptr<const std::vector<size_t>>> entries;
+        return entries;
+    }
+
+    // Uniform value in [-1, 1) from the raw engine output.
+    // std distributions are implementation defined, the raw mt19937_64 sequence is not.
+    double uniformBipolar(std::mt19937_64& rng)
+    {
+        return static_cast<double>(rng() >> 11) * 0x1.0p-52 - 1.0;
+    }
+}
+
+// =============================================
+
+template <typename SampleType>
+TopologyCache::SharedMatrix<SampleType> TopologyCache::getOrthogonalMatrix(int dim, uint32_t seed)
+{
+    return getCouplingMatrix<SampleType>(dim, dim, seed);
+}
+
+template <typename SampleType>
+TopologyCache::SharedMatrix<SampleType> TopologyCache::getCouplingMatrix(int dim1, int dim2, uint32_t seed)
+{
+    jassert(dim1 >= 0 && dim2 >= 0 && "Matrix dimensions must be greater than or equal to zero");
+
+    const std::lock_guard<std::mutex> lock { getCacheMutex() };
+
+    auto& entries = getMatrixEntries<SampleType>();
+    const MatrixKey key { dim1, dim2, seed };
+    if (auto cached = entries[key].lock())
+        return cached;
+
+    // Top-left corner of the orthogonal matrix: equivalent to I(dim1, maxDim) * Q * I(maxDim, dim2)
+    const int maxDim = std::max(dim1, dim2);
+    const Eigen::MatrixXd orthogonal = generateOrthogonal(maxDim, seed);
+    auto matrix = std::make_shared<const MatrixType<SampleType>>(
+        orthogonal.topLeftCorner(dim1, dim2).template cast<SampleType>()
+    );
+
+    entries[key] = matrix;
+    return matrix;
+}
+
+template <typename SampleType>
+TopologyCache::SharedMatrix<SampleType> TopologyCache::adoptCouplingMatrix(int dim1, int dim2, uint32_t seed, const std::vector<double>& coefficients)
+{
+    jassert(dim1 >= 0 && dim2 >= 0 && "Matrix dimensions must be greater than or equal to zero");
+    jassert(coefficients.size() == static_cast<size_t>(dim1) * static_cast<size_t>(dim2) && "Number of coefficients must match the matrix dimensions");
+
+    const Eigen::Map<const Eigen::MatrixXd> stored(coefficients.data(), dim1, dim2);
+    const MatrixType<SampleType> restored = stored.template cast<SampleType>();
+
+    const std::lock_guard<std::mutex> lock { getCacheMutex() };
+
+    auto& entries = getMatrixEntries<SampleType>();
+    const MatrixKey key { dim1, dim2, seed };
+    auto cached = entries[key].lock();
+    if (cached && *cached == restored)
+        return cached;
+
+    auto matrix = std::make_shared<const MatrixType<SampleType>>(restored);
+
+    // Do not replace a live entry generated from the same seed with different data
+    if (!cached)
+        entries[key] = matrix;
+    return matrix;
+}
+
+TopologyCache::SharedDelays TopologyCache::getDelayLengths(uint32_t number, size_t minDelay, size_t maxDelay, uint32_t seed)
+{
+    jassert(minDelay <= maxDelay && "Minimum delay must not exceed the maximum delay");
+
+    const std::lock_guard<std::mutex> lock { getCacheMutex() };
+
+    auto& entries = getDelayEntries();
+    const DelayKey key { number, minDelay, maxDelay, seed };
+    if (auto cached = entries[key].lock())
+        return cached;
+
+    auto delays = std::make_shared<const std::vector<size_t>>(generateDelayLengths(number, minDelay, maxDelay, seed));
+
+    entries[key] = delays;
+    return delays;
+}
+
+size_t TopologyCache::getNumEntries()
+{
+    const std::lock_guard<std::mutex> lock { getCacheMutex() };
+
+    size_t numEntries { 0u };
+    for (const auto& entry : getMatrixEntries<float>())
+        numEntries += entry.second.expired() ? 0u : 1u;
+    for (const auto& entry : getMatrixEntries<double>())
+        numEntries += entry.second.expired() ? 0u : 1u;
+    for (const auto& entry : getDelayEntries())
+        numEntries += entry.second.expired() ? 0u : 1u;
+    return numEntries;
+}
+
+// =============================================
+
+Eigen::MatrixXd TopologyCache::generateOrthogonal(int dim, uint32_t seed)
+{
+    DSP_TRACE_SCOPE("TopologyCache::generateOrthogonal");
+    std::mt19937_64 rng { static_cast<uint64_t>(seed) ^ matrixSalt };
+
+    // Generate a random square matrix (column major, like Eigen's storage)
+    Eigen::MatrixXd random(dim, dim);
+    for (int col = 0; col < dim; ++col)
+        for (int row = 0; row < dim; ++row)
+            random(row, col) = uniformBipolar(rng);
+
+    // Perform QR decomposition to obtain an orthogonal matrix
+    Eigen::HouseholderQR<Eigen::MatrixXd> qr(random);
+    return qr.householderQ();
+}
+
+std::vector<size_t> TopologyCache::generateDelayLengths(uint32_t number, size_t minDelay, size_t maxDelay, uint32_t seed)
+{
+    DSP_TRACE_SCOPE("TopologyCache::generateDelayLengths");
+    std::mt19937_64 rng { static_cast<uint64_t>(seed) ^ delaySalt };
+    const uint64_t range { static_cast<uint64_t>(maxDelay - minDelay) + 1u };
+
+    std::vector<size_t> delayLengths;
+    delayLengths.reserve(number);
+    for (uint32_t i = 0; i < number; ++i)
+        delayLengths.push_back(minDelay + static_cast<size_t>(rng() % range));
+
+    return delayLengths;
+}
+
+// =============================================
+
+template TopologyCache::SharedMatrix<float> TopologyCache::getOrthogonalMatrix<float>(int, uint32_t);
+template TopologyCache::SharedMatrix<double> TopologyCache::getOrthogonalMatrix<double>(int, uint32_t);
+template TopologyCache::SharedMatrix<float> TopologyCache::getCouplingMatrix<float>(int, int, uint32_t);
+template TopologyCache::SharedMatrix<double> TopologyCache::getCouplingMatrix<double>(int, int, uint32_t);
+template TopologyCache::SharedMatrix<float> TopologyCache::adoptCouplingMatrix<float>(int, int, uint32_t, const std::vector<double>&);
+template TopologyCache::SharedMatrix<double> TopologyCache::adoptCouplingMatrix<double>(int, int, uint32_t, const std::vector<double>&);
+
+}
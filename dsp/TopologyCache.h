@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <JuceHeader.h>
+
+#include <Eigen/Dense>
+
+namespace DSP
+{
+
+// Process-wide cache of the randomly generated FDN topology.
+// Matrices and delay sets are addressed by their dimensions and a seed, so the same
+// configuration always yields the same data and all instances share one read-only copy.
+// Entries are held weakly: they are freed when the last instance using them goes away.
+// Thread safe, but generation may allocate and run a QR: never call from the audio thread.
+class TopologyCache
+{
+public:
+    template <typename SampleType>
+    using MatrixType = Eigen::Matrix<SampleType, Eigen::Dynamic, Eigen::Dynamic>;
+
+    template <typename SampleType>
+    using SharedMatrix = std::shared_ptr<const MatrixType<SampleType>>;
+
+    using SharedDelays = std::shared_ptr<const std::vector<size_t>>;
+
+    // No instances
+    TopologyCache() = delete;
+
+    // =============================================
+
+    // Random orthogonal square matrix
+    template <typename SampleType>
+    static SharedMatrix<SampleType> getOrthogonalMatrix(int dim, uint32_t seed);
+
+    // Random coupling matrix: the top-left corner of the orthogonal matrix of the larger dimension
+    template <typename SampleType>
+    static SharedMatrix<SampleType> getCouplingMatrix(int dim1, int dim2, uint32_t seed);
+
+    // Matrix restored from stored coefficients (column-major, double precision), without generating it.
+    // Shares the cached copy when it holds the same coefficients, otherwise registers the restored one
+    template <typename SampleType>
+    static SharedMatrix<SampleType> adoptCouplingMatrix(int dim1, int dim2, uint32_t seed, const std::vector<double>& coefficients);
+
+    // Random delay lengths in samples, uniformly drawn in [minDelay, maxDelay]
+    static SharedDelays getDelayLengths(uint32_t number, size_t minDelay, size_t maxDelay, uint32_t seed);
+
+    // =============================================
+
+    // Number of matrices and delay sets currently alive in the cache
+    static size_t getNumEntries();
+
+private:
+    // Generation is always done in double precision, so float and double topologies match
+    static Eigen::MatrixXd generateOrthogonal(int dim, uint32_t seed);
+    static std::vector<size_t> generateDelayLengths(uint32_t number, size_t minDelay, size_t maxDelay, uint32_t seed);
+};
+
+}
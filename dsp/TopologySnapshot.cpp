@@ -0,0 +1,111 @@
+#include <algorithm>
+
+#include "TopologySnapshot.h"
+#include "FDN.h"
+
+namespace DSP
+{
+
+namespace
+{
+    // Chunk identifiers, checked on read to catch misaligned or foreign data
+    constexpr int matrixChunkId { 0x4D545258 };  // "MTRX"
+    constexpr int fdnChunkId    { 0x46444E54 };  // "FDNT"
+
+    // Upper bound of the sizes accepted on read, so corrupt data cannot trigger huge allocations
+    constexpr int maxMatrixDim { 1024 };
+}
+
+// =============================================
+
+bool MatrixSnapshot::isValid() const
+{
+    return dim1 >= 0 && dim2 >= 0
+        && dim1 <= maxMatrixDim && dim2 <= maxMatrixDim
+        && coefficients.size() == static_cast<size_t>(dim1) * static_cast<size_t>(dim2);
+}
+
+bool FDNSnapshot::isValid() const
+{
+    return order > 0u
+        && delayLengths.size() == static_cast<size_t>(order)
+        && std::all_of(delayLengths.begin(), delayLengths.end(), [](uint32_t length) { return length > 0u && length <= FDN<double>::maxBaseDelay; })
+        && feedbackMatrix.dim1 == static_cast<int>(order)
+        && feedbackMatrix.dim2 == static_cast<int>(order)
+        && feedbackMatrix.isValid();
+}
+
+// =============================================
+
+void writeSnapshot(juce::OutputStream& stream, const MatrixSnapshot& snapshot)
+{
+    jassert(snapshot.isValid() && "Matrix snapshot is inconsistent");
+
+    stream.writeInt(matrixChunkId);
+    stream.writeInt(snapshot.dim1);
+    stream.writeInt(snapshot.dim2);
+    stream.writeInt(static_cast<int>(snapshot.seed));
+    for (const double coefficient : snapshot.coefficients)
+        stream.writeDouble(coefficient);
+}
+
+void writeSnapshot(juce::OutputStream& stream, const FDNSnapshot& snapshot)
+{
+    jassert(snapshot.isValid() && "FDN snapshot is inconsistent");
+
+    stream.writeInt(fdnChunkId);
+    stream.writeInt(static_cast<int>(snapshot.order));
+    stream.writeInt(static_cast<int>(snapshot.seed));
+    for (const uint32_t delayLength : snapshot.delayLengths)
+        stream.writeInt(static_cast<int>(delayLength));
+    writeSnapshot(stream, snapshot.feedbackMatrix);
+}
+
+// =============================================
+
+bool readSnapshot(juce::InputStream& stream, MatrixSnapshot& snapshot)
+{
+    if (stream.getNumBytesRemaining() < 4 * static_cast<juce::int64>(sizeof(int)) || stream.readInt() != matrixChunkId)
+        return false;
+
+    snapshot.dim1 = stream.readInt();
+    snapshot.dim2 = stream.readInt();
+    snapshot.seed = static_cast<uint32_t>(stream.readInt());
+    if (snapshot.dim1 < 0 || snapshot.dim2 < 0 || snapshot.dim1 > maxMatrixDim || snapshot.dim2 > maxMatrixDim)
+        return false;
+
+    const size_t numCoefficients { static_cast<size_t>(snapshot.dim1) * static_cast<size_t>(snapshot.dim2) };
+    if (stream.getNumBytesRemaining() < static_cast<juce::int64>(numCoefficients * sizeof(double)))
+        return false;
+
+    snapshot.coefficients.resize(numCoefficients);
+    for (double& coefficient : snapshot.coefficients)
+        coefficient = stream.readDouble();
+
+    return snapshot.isValid();
+}
+
+bool readSnapshot(juce::InputStream& stream, FDNSnapshot& snapshot)
+{
+    if (stream.getNumBytesRemaining() < 3 * static_cast<juce::int64>(sizeof(int)) || stream.readInt() != fdnChunkId)
+        return false;
+
+    snapshot.order = static_cast<uint32_t>(stream.readInt());
+    snapshot.seed = static_cast<uint32_t>(stream.readInt());
+    if (snapshot.order == 0u || snapshot.order > static_cast<uint32_t>(maxMatrixDim))
+        return false;
+    if (stream.getNumBytesRemaining() < static_cast<juce::int64>(snapshot.order * sizeof(int)))
+        return false;
+
+    snapshot.delayLengths.resize(static_cast<size_t>(snapshot.order));
+    for (uint32_t& delayLength : snapshot.delayLengths)
+    {
+        delayLength = static_cast<uint32_t>(stream.readInt());
+        if (delayLength == 0u || delayLength > FDN<double>::maxBaseDelay)
+            return false;
+    }
+
+    return readSnapshot(stream, snapshot.feedbackMatrix) && snapshot.isValid();
+}
+
+}
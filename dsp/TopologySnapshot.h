@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <JuceHeader.h>
+
+namespace DSP
+{
+
+// Compact binary snapshots of the computed FDN topology.
+// They restore delay lengths and matrices exactly, without generating them again.
+
+// Matrix coefficients, stored in double precision and column-major order
+struct MatrixSnapshot
+{
+    int dim1 { 0 };
+    int dim2 { 0 };
+    uint32_t seed { 0u };
+    std::vector<double> coefficients;
+
+    // Checks the dimensions against the number of coefficients
+    bool isValid() const;
+};
+
+// Delay lengths and feedback matrix of an FDN
+struct FDNSnapshot
+{
+    uint32_t order { 0u };
+    uint32_t seed { 0u };
+    std::vector<uint32_t> delayLengths;
+    MatrixSnapshot feedbackMatrix;
+
+    // Checks the sizes against the order, and the delay lengths against the longest the FDN generates
+    bool isValid() const;
+};
+
+// =============================================
+
+// Write snapshots to a stream (little endian)
+void writeSnapshot(juce::OutputStream& stream, const MatrixSnapshot& snapshot);
+void writeSnapshot(juce::OutputStream& stream, const FDNSnapshot& snapshot);
+
+// Read snapshots from a stream. Return false if the data is truncated or inconsistent
+bool readSnapshot(juce::InputStream& stream, MatrixSnapshot& snapshot);
+bool readSnapshot(juce::InputStream& stream, FDNSnapshot& snapshot);
+
+}
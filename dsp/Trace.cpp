@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+
+#include "Trace.h"
+
+namespace utils
+{
+
+namespace
+{
+    // Single-producer (the owning thread), single-consumer (the writer thread) ring of records
+    struct ThreadRing
+    {
+        std::atomic<uint64_t> head { 0u };
+        std::atomic<uint64_t> tail { 0u };
+        std::array<TraceRecord, Tracer::recordsPerThread> records;
+    };
+
+    static_assert((Tracer::recordsPerThread & (Tracer::recordsPerThread - 1u)) == 0u, "Ring size must be a power of two");
+
+    // Allocated on the first acquire and never freed: threads keep pointers to their ring
+    std::atomic<ThreadRing*> pool { nullptr };
+    std::atomic<uint32_t> claimedRings { 0u };
+    std::atomic<uint64_t> droppedRecords { 0u };
+
+    // The calling thread's ring, or nullptr before its first record
+    thread_local ThreadRing* threadRing { nullptr };
+    // The pool was exhausted when the calling thread claimed a ring: it never claims again, so that
+    // claimedRings cannot wrap around and hand a taken ring to a second producer
+    thread_local bool threadRefused { false };
+
+    //================================================
+
+    // Writer state, guarded by the mutex
+    std::mutex writerMutex;
+    std::condition_variable writerWakeUp;
+    std::thread writer;
+    bool writerRunning { false };
+    int users { 0 };
+
+    std::ofstream file;
+    bool firstEvent { true };
+    uint64_t originTicks { 0u };
+    double ticksPerMicrosecond { 1.0 };
+
+    // Ticks of Tracer::now per microsecond, measured against the steady clock
+    double calibrate()
+    {
+        const auto clockStart { std::chrono::steady_clock::now() };
+        const uint64_t ticksStart { Tracer::now() };
+        std::this_thread::sleep_for(std::chrono::milliseconds { 20 });
+        const auto clockEnd { std::chrono::steady_clock::now() };
+        const uint64_t ticksEnd { Tracer::now() };
+
+        const double microseconds { std::chrono::duration<double, std::micro>(clockEnd - clockStart).count() };
+        return microseconds > 0.0 ? static_cast<double>(ticksEnd - ticksStart) / microseconds : 1.0;
+    }
+
+    // Pop every available record of every claimed ring and append them as complete events
+    void drain()
+    {
+        ThreadRing* rings { pool.load(std::memory_order_acquire) };
+        const uint32_t numRings { std::min(claimedRings.load(std::memory_order_acquire), Tracer::maxThreads) };
+
+        for (uint32_t r = 0; r < numRings; ++r)
+        {
+            ThreadRing& ring { rings[r] };
+            const uint64_t head { ring.head.load(std::memory_order_acquire) };
+            uint64_t tail { ring.tail.load(std::memory_order_relaxed) };
+
+            for (; tail != head; ++tail)
+            {
+                const TraceRecord& record { ring.records[tail & (Tracer::recordsPerThread - 1u)] };
+                const double start { static_cast<double>(static_cast<int64_t>(record.start - originTicks)) / ticksPerMicrosecond };
+                const double duration { static_cast<double>(record.end - record.start) / ticksPerMicrosecond };
+
+                file << (firstEvent ? "\n" : ",\n")
+                     << "{\"name\":\"" << record.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << r
+                     << ",\"ts\":" << start << ",\"dur\":" << duration << "}";
+                firstEvent = false;
+            }
+
+            ring.tail.store(tail, std::memory_order_release);
+        }
+
+        file.flush();
+    }
+
+    void writerLoop()
+    {
+        std::unique_lock<std::mutex> lock { writerMutex };
+        while (writerRunning)
+        {
+            writerWakeUp.wait_for(lock, std::chrono::milliseconds { 50 });
+            drain();
+        }
+    }
+}
+
+std::atomic<bool> Tracer::recording { false };
+
+//================================================
+
+bool Tracer::acquire(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock { writerMutex };
+
+    if (users++ > 0)
+        return true;
+
+    if (pool.load(std::memory_order_relaxed) == nullptr)
+        pool.store(new ThreadRing[maxThreads], std::memory_order_release);
+
+    file.open(path, std::ios::out | std::ios::trunc);
+    if (! file)
+    {
+        --users;
+        return false;
+    }
+
+    // Records left from a previous session are discarded
+    ThreadRing* rings { pool.load(std::memory_order_relaxed) };
+    for (uint32_t r = 0; r < maxThreads; ++r)
+        rings[r].tail.store(rings[r].head.load(std::memory_order_acquire), std::memory_order_release);
+
+    ticksPerMicrosecond = calibrate();
+    originTicks = now();
+    firstEvent = true;
+    // Microsecond timestamps with nanosecond resolution
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+    writerRunning = true;
+    writer = std::thread { writerLoop };
+    recording.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void Tracer::release()
+{
+    std::thread finishedWriter;
+    {
+        std::lock_guard<std::mutex> lock { writerMutex };
+        assert(users > 0 && "Tracer released more often than acquired");
+        if (--users > 0)
+            return;
+
+        recording.store(false, std::memory_order_relaxed);
+        writerRunning = false;
+        finishedWriter = std::move(writer);
+    }
+
+    writerWakeUp.notify_all();
+    if (finishedWriter.joinable())
+        finishedWriter.join();
+
+    std::lock_guard<std::mutex> lock { writerMutex };
+    drain();
+    file << "\n]}\n";
+    file.close();
+}
+
+uint64_t Tracer::getDroppedRecords()
+{
+    return droppedRecords.load(std::memory_order_relaxed);
+}
+
+void Tracer::record(const char* name, uint64_t start, uint64_t end) noexcept
+{
+    ThreadRing* ring { threadRing };
+
+    // First record of this thread: claim a ring from the pool
+    if (ring == nullptr)
+    {
+        ThreadRing* rings { pool.load(std::memory_order_acquire) };
+        if (rings == nullptr || threadRefused)
+        {
+            droppedRecords.fetch_add(1u, std::memory_order_relaxed);
+            return;
+        }
+
+        const uint32_t index { claimedRings.fetch_add(1u, std::memory_order_acq_rel) };
+        if (index >= maxThreads)
+        {
+            threadRefused = true;
+            droppedRecords.fetch_add(1u, std::memory_order_relaxed);
+            return;
+        }
+        ring = threadRing = &rings[index];
+    }
+
+    const uint64_t head { ring->head.load(std::memory_order_relaxed) };
+    if (head - ring->tail.load(std::memory_order_acquire) >= recordsPerThread)
+    {
+        droppedRecords.fetch_add(1u, std::memory_order_relaxed);
+        return;
+    }
+
+    ring->records[head & (recordsPerThread - 1u)] = { name, start, end };
+    ring->head.store(head + 1u, std::memory_order_release);
+}
+
+}
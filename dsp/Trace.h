@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+// Scoped trace points, compiled in with -DDSP_ENABLE_TRACING=1 (CMake option ENABLE_TRACING).
+// Otherwise the macros expand to nothing and cost nothing.
+//
+//     void process()
+//     {
+//         DSP_TRACE_SCOPE("FDN::process");
+//         ...
+//     }
+//
+// The name must be a string literal: only its pointer is recorded.
+#if DSP_ENABLE_TRACING
+#define DSP_TRACE_CONCAT_INNER(a, b) a##b
+#define DSP_TRACE_CONCAT(a, b) DSP_TRACE_CONCAT_INNER(a, b)
+#define DSP_TRACE_SCOPE(name) const utils::TraceScope DSP_TRACE_CONCAT(traceScope_, __LINE__) { name }
+#else
+#define DSP_TRACE_SCOPE(name) ((void) 0)
+#endif
+
+namespace utils
+{
+
+// One timed scope: name literal and timestamps in ticks of Tracer::now
+struct TraceRecord
+{
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+//================================================
+
+// Process-wide tracer. Each thread pushes its records into its own lock-free ring buffer,
+// claimed from a preallocated pool on its first record; a background thread drains the rings
+// into a Chrome trace / Perfetto JSON file. Records are dropped, never waited for,
+// when a ring is full or the pool is exhausted.
+class Tracer
+{
+public:
+    static constexpr uint32_t recordsPerThread { 1u << 14 };
+    static constexpr uint32_t maxThreads { 16u };
+
+    // No instances
+    Tracer() = delete;
+
+    //================================================
+
+    // Start writing to the file on the first acquire. Message thread; returns false if the file cannot be written
+    static bool acquire(const std::string& path);
+
+    // Stop and complete the file on the last release. Message thread
+    static void release();
+
+    // Records lost to full rings or to the exhausted pool
+    static uint64_t getDroppedRecords();
+
+    //================================================
+
+    // Whether a file is being written. Real-time safe
+    static bool isRecording() noexcept
+    {
+        return recording.load(std::memory_order_relaxed);
+    }
+
+    // Timestamp counter: the TSC on x86, the virtual counter on ARM, else the steady clock
+    static uint64_t now() noexcept
+    {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        uint64_t ticks;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+        return ticks;
+#else
+        return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+
+    // Push a record to the calling thread's ring. Real-time safe: no locks, no allocation
+    static void record(const char* name, uint64_t start, uint64_t end) noexcept;
+
+private:
+    static std::atomic<bool> recording;
+};
+
+//================================================
+
+// Records the time between its construction and destruction, while the tracer is recording
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* initName) noexcept :
+        name { Tracer::isRecording() ? initName : nullptr },
+        start { name != nullptr ? Tracer::now() : 0u }
+    {}
+
+    ~TraceScope()
+    {
+        if (name != nullptr)
+            Tracer::record(name, start, Tracer::now());
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name;
+    uint64_t start;
+};
+
+}
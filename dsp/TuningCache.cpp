@@ -0,0 +1,119 @@
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <utility>
+
+#include "TuningCache.h"
+
+namespace DSP
+{
+
+namespace
+{
+    // Key of a decision: (cpu, configuration)
+    using TuningKey = std::pair<std::string, std::string>;
+
+    struct Entry
+    {
+        std::string instructionSet;
+        double nanosecondsPerSample { 0.0 };
+    };
+
+    struct Cache
+    {
+        std::mutex mutex;
+        std::string path;
+        bool loaded { false };
+        std::map<TuningKey, Entry> entries;
+    };
+
+    Cache& getCache()
+    {
+        static Cache cache;
+        return cache;
+    }
+
+    // Lines that do not parse are dropped, so a damaged file only costs a new measurement
+    void load(Cache& cache)
+    {
+        cache.loaded = true;
+        if (cache.path.empty())
+            return;
+
+        std::ifstream file { cache.path };
+        std::string line;
+        while (std::getline(file, line))
+        {
+            std::istringstream fields { line };
+            std::string cpu, configuration, instructionSet, time;
+            if (! std::getline(fields, cpu, '\t') || ! std::getline(fields, configuration, '\t')
+                || ! std::getline(fields, instructionSet, '\t') || ! std::getline(fields, time))
+                continue;
+
+            Entry entry { instructionSet, 0.0 };
+            std::istringstream { time } >> entry.nanosecondsPerSample;
+            cache.entries[{ cpu, configuration }] = entry;
+        }
+    }
+
+    void save(const Cache& cache)
+    {
+        if (cache.path.empty())
+            return;
+
+        std::ofstream file { cache.path, std::ios::trunc };
+        for (const auto& [key, entry] : cache.entries)
+            file << key.first << '\t' << key.second << '\t' << entry.instructionSet << '\t' << entry.nanosecondsPerSample << '\n';
+    }
+}
+
+// =============================================
+
+void TuningCache::setFile(const std::string& path)
+{
+    Cache& cache { getCache() };
+    const std::lock_guard<std::mutex> lock { cache.mutex };
+    if (path == cache.path)
+        return;
+
+    // Decisions measured so far are merged into the ones of the new file
+    cache.path = path;
+    load(cache);
+}
+
+bool TuningCache::find(const std::string& configuration, TuningDecision& decision)
+{
+    Cache& cache { getCache() };
+    const std::lock_guard<std::mutex> lock { cache.mutex };
+    if (! cache.loaded)
+        load(cache);
+
+    const auto entry = cache.entries.find({ KernelDispatch::getCpuName(), configuration });
+    if (entry == cache.entries.end())
+        return false;
+
+    // A set this build or machine cannot run (e.g. a file copied from another build) is measured again
+    InstructionSet instructionSet { InstructionSet::generic };
+    if (! KernelDispatch::parseName(entry->second.instructionSet.c_str(), instructionSet) || ! KernelDispatch::isSupported(instructionSet))
+        return false;
+
+    decision.tuned = true;
+    decision.instructionSet = instructionSet;
+    decision.nanosecondsPerSample = entry->second.nanosecondsPerSample;
+    decision.fromCache = true;
+    return true;
+}
+
+void TuningCache::store(const std::string& configuration, const TuningDecision& decision)
+{
+    Cache& cache { getCache() };
+    const std::lock_guard<std::mutex> lock { cache.mutex };
+    if (! cache.loaded)
+        load(cache);
+
+    cache.entries[{ KernelDispatch::getCpuName(), configuration }] = Entry { KernelDispatch::getName(decision.instructionSet), decision.nanosecondsPerSample };
+    save(cache);
+}
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+
+#include "KernelDispatch.h"
+
+namespace DSP
+{
+
+// Outcome of the prepare-time tuning of one processor configuration
+struct TuningDecision
+{
+    // False until a tuning ran: the processor follows KernelDispatch
+    bool tuned { false };
+    InstructionSet instructionSet { InstructionSet::generic };
+    // Fastest measured time, or the one stored with the cached decision
+    double nanosecondsPerSample { 0.0 };
+    // Taken from the cache instead of measured
+    bool fromCache { false };
+};
+
+// Process-wide cache of tuning decisions, keyed by the CPU model and a description of the
+// configuration, so that each configuration is measured once per machine. Persisted to a text
+// file when one is set, one decision per line: cpu, configuration, instruction set, ns/sample,
+// tab separated. Decisions of other CPU models in the file are kept.
+// Thread safe, but reads and writes the file: never call from the audio thread.
+class TuningCache
+{
+public:
+    // No instances
+    TuningCache() = delete;
+
+    // =============================================
+
+    // File the decisions are loaded from and saved to. Empty keeps them in memory only
+    static void setFile(const std::string& path);
+
+    // Decision stored for the configuration on this CPU. Returns false if there is none
+    static bool find(const std::string& configuration, TuningDecision& decision);
+
+    // Store the decision for the configuration on this CPU, and rewrite the file
+    static void store(const std::string& configuration, const TuningDecision& decision);
+};
+
+}
@@ -6,12 +6,40 @@ FDNPluginAudioProcessorEditor::FDNPluginAudioProcessorEditor(FDNPluginAudioProce
     genericParameterEditor(audioProcessor.getParameterManager())
 {
     addAndMakeVisible(genericParameterEditor);
+
+    loadLabel.setFont(juce::Font(12.0f));
+    addAndMakeVisible(loadLabel);
+    resetLoadButton.onClick = [this] { audioProcessor.getLoadMeter().resetPeak(); };
+    addAndMakeVisible(resetLoadButton);
+
+    // Captures go to the temporary folder, one file per start
+    captureButton.setClickingTogglesState(true);
+    captureButton.setToggleState(audioProcessor.isCapturing(), juce::dontSendNotification);
+    captureButton.onClick = [this]
+    {
+        if (! captureButton.getToggleState())
+        {
+            audioProcessor.stopCapture();
+            return;
+        }
+
+        const auto file { juce::File::getSpecialLocation(juce::File::tempDirectory)
+                              .getNonexistentChildFile("tvfdn-capture", ".tvfc") };
+        if (! audioProcessor.startCapture(file))
+            captureButton.setToggleState(false, juce::dontSendNotification);
+    };
+    addAndMakeVisible(captureButton);
+
     const int numOfParams { static_cast<int>(audioProcessor.getParameterManager().getParameters().size()) };
-    setSize(300, numOfParams * genericParameterEditor.parameterWidgetHeight);
+    setSize(300, numOfParams * genericParameterEditor.parameterWidgetHeight + meterHeight);
+
+    timerCallback();
+    startTimerHz(4);
 }
 
 FDNPluginAudioProcessorEditor::~FDNPluginAudioProcessorEditor()
 {
+    stopTimer();
 }
 
 //==============================================================================
@@ -22,5 +50,21 @@ void FDNPluginAudioProcessorEditor::paint(juce::Graphics& g)
 
 void FDNPluginAudioProcessorEditor::resized()
 {
-    genericParameterEditor.setBounds(getLocalBounds());
-}
\ No newline at end of file
+    auto bounds { getLocalBounds() };
+    auto meterBounds { bounds.removeFromBottom(meterHeight) };
+    captureButton.setBounds(meterBounds.removeFromRight(70).reduced(2));
+    resetLoadButton.setBounds(meterBounds.removeFromRight(60).reduced(2));
+    loadLabel.setBounds(meterBounds);
+    genericParameterEditor.setBounds(bounds);
+}
+
+void FDNPluginAudioProcessorEditor::timerCallback()
+{
+    const utils::LoadMeter& meter { audioProcessor.getLoadMeter() };
+    loadLabel.setText("CPU " + juce::String(100.0f * meter.getLoad(), 1) + "%  peak "
+                          + juce::String(100.0f * meter.getPeakLoad(), 1) + "%  overruns "
+                          + juce::String(static_cast<juce::int64>(meter.getOverruns()))
+                          + "  tier " + juce::String(static_cast<int>(audioProcessor.getQualityTier()))
+                          + "  memory " + juce::File::descriptionOfSizeInBytes(static_cast<juce::int64>(audioProcessor.getMemoryFootprint().getBytes())),
+                      juce::dontSendNotification);
+}
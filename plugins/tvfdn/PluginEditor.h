@@ -3,7 +3,8 @@
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
 
-class FDNPluginAudioProcessorEditor  : public juce::AudioProcessorEditor
+class FDNPluginAudioProcessorEditor  : public juce::AudioProcessorEditor,
+                                       private juce::Timer
 {
 public:
     FDNPluginAudioProcessorEditor(FDNPluginAudioProcessor&);
@@ -13,8 +14,17 @@ public:
     void resized() override;
 
 private:
+    // Polls the processor's load meter
+    void timerCallback() override;
+
+    static constexpr int meterHeight { 24 };
+
     FDNPluginAudioProcessor& audioProcessor;
     mrta::GenericParameterEditor genericParameterEditor;
 
+    juce::Label loadLabel;
+    juce::TextButton resetLoadButton { "Reset" };
+    juce::TextButton captureButton { "Capture" };
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FDNPluginAudioProcessorEditor)
-};
\ No newline at end of file
+};
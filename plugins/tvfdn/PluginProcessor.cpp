@@ -1,6 +1,8 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 
 static const std::vector<mrta::ParameterInfo> Parameters
@@ -9,19 +11,24 @@ static const std::vector<mrta::ParameterInfo> Parameters
     { Param::ID::Mix,           Param::Name::Mix,           "",                    Param::Ranges::MixDefault,        Param::Ranges::MixMin,        Param::Ranges::MixMax,        Param::Ranges::MixInc,        Param::Ranges::MixSkw },
     // { Param::ID::fdnOrder,      Param::Name::fdnOrder,      Param::Ranges::fdnOrders,  0 },
     { Param::ID::revT60,        Param::Name::revT60,        Param::Units::Seconds, Param::Ranges::T60Default,        Param::Ranges::T60Min,        Param::Ranges::T60Max,        Param::Ranges::T60Inc,        Param::Ranges::T60Skw },
-    { Param::ID::revBrightness, Param::Name::revBrightness, "",                    Param::Ranges::BrightnessDefault, Param::Ranges::BrightnessMin, Param::Ranges::BrightnessMax, Param::Ranges::BrightnessInc, Param::Ranges::BrightnessSkw }
+    { Param::ID::revBrightness, Param::Name::revBrightness, "",                    Param::Ranges::BrightnessDefault, Param::Ranges::BrightnessMin, Param::Ranges::BrightnessMax, Param::Ranges::BrightnessInc, Param::Ranges::BrightnessSkw },
+    { Param::ID::revRoomSize,   Param::Name::revRoomSize,   "",                    Param::Ranges::RoomSizeDefault,   Param::Ranges::RoomSizeMin,   Param::Ranges::RoomSizeMax,   Param::Ranges::RoomSizeInc,   Param::Ranges::RoomSizeSkw },
+    { Param::ID::revModRate,    Param::Name::revModRate,    Param::Units::Hz,      Param::Ranges::ModRateDefault,    Param::Ranges::ModRateMin,    Param::Ranges::ModRateMax,    Param::Ranges::ModRateInc,    Param::Ranges::ModRateSkw },
+    { Param::ID::revModDepth,   Param::Name::revModDepth,   "",                    Param::Ranges::ModDepthDefault,   Param::Ranges::ModDepthMin,   Param::Ranges::ModDepthMax,   Param::Ranges::ModDepthInc,   Param::Ranges::ModDepthSkw },
+    { Param::ID::AdaptiveQuality, Param::Name::AdaptiveQuality, Param::Ranges::AdaptiveQualityOff, Param::Ranges::AdaptiveQualityOn, Param::Ranges::AdaptiveQualityDefault },
+    { Param::ID::ReducedRate,   Param::Name::ReducedRate,   Param::Ranges::ReducedRateOff, Param::Ranges::ReducedRateOn, Param::Ranges::ReducedRateDefault }
 };
 
 FDNPluginAudioProcessor::FDNPluginAudioProcessor() :
     parameterManager(*this, ProjectInfo::projectName, Parameters),
+    logger { [](const std::string& line) { juce::Logger::writeToLog(line); }, 2u, 256u },
     enableRamp { 480u }, // TODO redo Ramp default constructor
     enabled { Param::Ranges::EnabledDefault ? 1.f : 0.f },
     mixRamp { 480u }, // TODO redo Ramp default constructor
     mix { Param::Ranges::MixDefault },
     fdnOrder { uint32_t { 16u } },
-    fdnInputCoupling { static_cast<int>(fdnOrder), getTotalNumInputChannels() },
-    fdn { fdnOrder, Param::Ranges::T60Default, Param::Ranges::BrightnessDefault },
-    fdnOutputCoupling { getTotalNumOutputChannels(), static_cast<int>(fdnOrder) }
+    floatChain { fdnOrder, getTotalNumInputChannels(), getTotalNumOutputChannels() },
+    doubleChain { fdnOrder, getTotalNumInputChannels(), getTotalNumOutputChannels() }
 {
     parameterManager.registerParameterCallback(Param::ID::Enabled,
     [this](float newValue, bool force)
@@ -40,95 +47,949 @@ FDNPluginAudioProcessor::FDNPluginAudioProcessor() :
     [this](float newValue, bool /*force*/)
     {
         jassert(newValue >= Param::Ranges::T60Min && newValue <= Param::Ranges::T60Max && "T60 must be in range");
-        fdn.setT60(newValue);
+        floatChain.setT60(newValue);
+        doubleChain.setT60(static_cast<double>(newValue));
     });
     parameterManager.registerParameterCallback(Param::ID::revBrightness,
     [this](float newValue, bool /*force*/)
     {
         jassert(newValue >= Param::Ranges::BrightnessMin && newValue <= Param::Ranges::BrightnessMax && "Brightness must be in range");
-        fdn.setBrightness(newValue);
+        floatChain.setBrightness(newValue);
+        doubleChain.setBrightness(static_cast<double>(newValue));
     });
+    parameterManager.registerParameterCallback(Param::ID::revRoomSize,
+    [this](float newValue, bool /*force*/)
+    {
+        jassert(newValue >= Param::Ranges::RoomSizeMin && newValue <= Param::Ranges::RoomSizeMax && "Room size must be in range");
+        // Lock-free: larger delay memory is allocated by the timer and adopted in FDN::update
+        floatChain.setRoomSize(newValue);
+        doubleChain.setRoomSize(static_cast<double>(newValue));
+    });
+    parameterManager.registerParameterCallback(Param::ID::revModRate,
+    [this](float newValue, bool /*force*/)
+    {
+        jassert(newValue >= Param::Ranges::ModRateMin && newValue <= Param::Ranges::ModRateMax && "Modulation rate must be in range");
+        revModRate = newValue;
+        const float depth { revModDepth * Param::Ranges::ModMaxAngle };
+        floatChain.setModulation(revModRate, depth);
+        doubleChain.setModulation(static_cast<double>(revModRate), static_cast<double>(depth));
+    });
+    parameterManager.registerParameterCallback(Param::ID::revModDepth,
+    [this](float newValue, bool /*force*/)
+    {
+        jassert(newValue >= Param::Ranges::ModDepthMin && newValue <= Param::Ranges::ModDepthMax && "Modulation depth must be in range");
+        revModDepth = newValue;
+        const float depth { revModDepth * Param::Ranges::ModMaxAngle };
+        floatChain.setModulation(revModRate, depth);
+        doubleChain.setModulation(static_cast<double>(revModRate), static_cast<double>(depth));
+    });
+    parameterManager.registerParameterCallback(Param::ID::AdaptiveQuality,
+    [this](float newValue, bool /*force*/)
+    {
+        qualityGovernor.setEnabled(newValue > 0.5f);
+    });
+    parameterManager.registerParameterCallback(Param::ID::ReducedRate,
+    [this](float newValue, bool /*force*/)
+    {
+        // Applied by the timer, which prepares the chains again
+        reducedRate.store(newValue > 0.5f, std::memory_order_relaxed);
+    });
+
+    capturedValues.resize(static_cast<size_t>(getParameters().size()));
+    captureEvents.reserve(static_cast<size_t>(getParameters().size()));
+
+    enableGain.reserve(static_cast<size_t>(MaxBlockSize));
+    mixGain.reserve(static_cast<size_t>(MaxBlockSize));
+
+#if DSP_LOCK_AUDIO_MEMORY
+    memoryLock.setLocking(true);
+#endif
+
+    measureMemory();
+
+    startTimerHz(10);
+
+    // The kernel tuning of the FDNs is measured once per CPU model and configuration, for all instances
+    const juce::File dataDirectory { juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                                         .getChildFile(JucePlugin_Manufacturer) };
+    const juce::File tuningFile { dataDirectory.getChildFile("tvfdn-tuning.txt") };
+    if (tuningFile.getParentDirectory().createDirectory())
+        DSP::TuningCache::setFile(tuningFile.getFullPathName().toStdString());
+
+    // The topologies of the factory programs are computed once per configuration, for all instances, off the
+    // message thread. Until the bank is mapped, a program change generates its topology on the spot
+    topology = { doubleChain.room->fdn.getSnapshot(), doubleChain.room->inputCoupling.getSnapshot(), doubleChain.room->outputCoupling.getSnapshot() };
+    presetBankLoader = std::thread { [this, presetFile = dataDirectory.getChildFile("tvfdn-presets.bin"),
+                                      numInputChannels = getTotalNumInputChannels(), numOutputChannels = getTotalNumOutputChannels()]
+    {
+        if (presetBank.load(presetFile, Param::Presets::Factory, fdnOrder, numInputChannels, numOutputChannels))
+            presetBankReady.store(true, std::memory_order_release);
+    } };
+
+#if DSP_ENABLE_TRACING
+    // Tracing builds write one Chrome trace for all instances to the temporary folder
+    utils::Tracer::acquire(juce::File::getSpecialLocation(juce::File::tempDirectory)
+                               .getChildFile("tvfdn-trace.json").getFullPathName().toStdString());
+#endif
 }
 
 FDNPluginAudioProcessor::~FDNPluginAudioProcessor()
 {
+    // The bank is computed at most once: wait for it rather than interrupt it
+    if (presetBankLoader.joinable())
+        presetBankLoader.join();
+
+    stopTimer();
+    stopCapture();
+
+#if DSP_ENABLE_TRACING
+    utils::Tracer::release();
+#endif
+}
+
+void FDNPluginAudioProcessor::timerCallback()
+{
+    floatChain.reserveRoomSize();
+    doubleChain.reserveRoomSize();
+
+    // The internal rate reallocates the FDNs and changes the latency: prepare again, with processing suspended
+    if (preparedBlockSize > 0 && reducedRate.load(std::memory_order_relaxed) != preparedReducedRate)
+    {
+        suspendProcessing(true);
+        prepareToPlay(sampleRate, preparedBlockSize);
+        suspendProcessing(false);
+    }
+}
+
+float FDNPluginAudioProcessor::getParameterValue(const juce::String& parameterId) const
+{
+    for (auto* parameter : getParameters())
+    {
+        const auto* withID { dynamic_cast<juce::AudioProcessorParameterWithID*>(parameter) };
+        if (withID != nullptr && withID->paramID == parameterId)
+            return parameter->getValue();
+    }
+    jassert(false && "Unknown parameter");
+    return 0.0f;
+}
+
+void FDNPluginAudioProcessor::setParameterValue(const juce::String& parameterId, float newValue)
+{
+    for (auto* parameter : getParameters())
+    {
+        auto* ranged { dynamic_cast<juce::RangedAudioParameter*>(parameter) };
+        if (ranged != nullptr && ranged->paramID == parameterId)
+        {
+            ranged->setValueNotifyingHost(ranged->convertTo0to1(newValue));
+            return;
+        }
+    }
+    jassert(false && "Unknown parameter");
+}
+
+//==============================================================================
+template <typename SampleType>
+FDNPluginAudioProcessor::FDNChain<SampleType>::Room::Room(uint32_t initOrder, int numInputChannels, int numOutputChannels) :
+    order { initOrder },
+    inputCoupling { static_cast<int>(order), numInputChannels, Param::Topology::InputCouplingSeed },
+    fdn { order, static_cast<SampleType>(Param::Ranges::T60Default), static_cast<SampleType>(Param::Ranges::BrightnessDefault), Param::Topology::FDNSeed },
+    outputCoupling { numOutputChannels, static_cast<int>(order), Param::Topology::OutputCouplingSeed }
+{
+    // All the delay memory the room size can use, so that it never grows while playing
+    fdn.setMaxRoomSize(static_cast<SampleType>(Param::Ranges::RoomSizeMax));
+}
+
+template <typename SampleType>
+FDNPluginAudioProcessor::FDNChain<SampleType>::Room::Room(const DSP::PresetTopology& topology, const DSP::PresetSettings& settings) :
+    order { topology.fdn.order },
+    inputCoupling { topology.inputCoupling },
+    fdn { topology.fdn, static_cast<SampleType>(settings.t60), static_cast<SampleType>(settings.brightness) },
+    outputCoupling { topology.outputCoupling }
+{
+    fdn.setMaxRoomSize(static_cast<SampleType>(Param::Ranges::RoomSizeMax));
+}
+
+template <typename SampleType>
+void FDNPluginAudioProcessor::FDNChain<SampleType>::Room::processFrame(SampleType* outputFrame, const SampleType* inputFrame, SampleType* inBetweenFrame, uint32_t numInputChannels, uint32_t numOutputChannels)
+{
+    // FDN input coupling
+    inputCoupling.processSample(inBetweenFrame, inputFrame, order, numInputChannels);
+    // FDN process
+    fdn.process(inBetweenFrame, inBetweenFrame, order);
+    // FDN output coupling
+    outputCoupling.processSample(outputFrame, inBetweenFrame, numOutputChannels, order);
+}
+
+template <typename SampleType>
+void FDNPluginAudioProcessor::FDNChain<SampleType>::Room::visitMemory(const utils::MemoryVisitor& visitor) const
+{
+    inputCoupling.visitMemory(visitor);
+    fdn.visitMemory(visitor);
+    outputCoupling.visitMemory(visitor);
+}
+
+//==============================================================================
+template <typename SampleType>
+FDNPluginAudioProcessor::FDNChain<SampleType>::FDNChain(uint32_t initOrder, int numInputChannels, int numOutputChannels) :
+    order { initOrder },
+    room { std::make_unique<Room>(order, numInputChannels, numOutputChannels) },
+    reducedOrder { std::max(order / 2u, DSP::FDN<SampleType>::possibleOrders[0]) },
+    reducedInputCoupling { static_cast<int>(reducedOrder), numInputChannels, Param::Topology::InputCouplingSeed },
+    reducedFdn { reducedOrder, static_cast<SampleType>(Param::Ranges::T60Default), static_cast<SampleType>(Param::Ranges::BrightnessDefault), Param::Topology::FDNSeed },
+    reducedOutputCoupling { numOutputChannels, static_cast<int>(reducedOrder), Param::Topology::OutputCouplingSeed },
+    decimator { static_cast<uint32_t>(numInputChannels) },
+    interpolator { static_cast<uint32_t>(numOutputChannels) }
+{
+    // As the rooms: the fastest kernels, and all the delay memory the room size can use
+    reducedFdn.setAutoTuning(true);
+    reducedFdn.setMaxRoomSize(static_cast<SampleType>(Param::Ranges::RoomSizeMax));
+
+    const uint32_t maxInputChannels { std::max(static_cast<uint32_t>(MaxChannels), static_cast<uint32_t>(numInputChannels)) };
+    const uint32_t maxOutputChannels { std::max(static_cast<uint32_t>(MaxChannels), static_cast<uint32_t>(numOutputChannels)) };
+    decimator.reserve(maxInputChannels, MaxRateFactor);
+    interpolator.reserve(maxOutputChannels, MaxRateFactor);
+
+    // Written once, so that its pages are committed before the first block
+    buffer.setSize(static_cast<int>(std::max(maxInputChannels, maxOutputChannels)), MaxBlockSize);
+    bufferBytes = static_cast<size_t>(buffer.getNumChannels()) * static_cast<size_t>(MaxBlockSize) * sizeof(SampleType);
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        std::fill(buffer.getWritePointer(ch), buffer.getWritePointer(ch) + MaxBlockSize, SampleType { 0 });
+
+    inputFrame.reserve(maxInputChannels);
+    inBetweenFrame.resize(static_cast<size_t>(order));
+    outputFrame.reserve(maxOutputChannels);
+    reducedInBetweenFrame.resize(static_cast<size_t>(reducedOrder));
+    reducedOutputFrame.reserve(maxOutputChannels);
+    hostInputFrame.reserve(maxInputChannels);
+    hostOutputFrame.reserve(maxOutputChannels);
+    fadingInBetweenFrame.resize(static_cast<size_t>(order));
+    fadingOutputFrame.reserve(maxOutputChannels);
+}
+
+template <typename SampleType>
+FDNPluginAudioProcessor::FDNChain<SampleType>::~FDNChain()
+{
+    delete pendingRoom.exchange(nullptr);
+    delete retiredRoom.exchange(nullptr);
+}
+
+template <typename SampleType>
+void FDNPluginAudioProcessor::FDNChain<SampleType>::prepare(double newSampleRate, int samplesPerBlock, int numInputChannels, int numOutputChannels, uint32_t newRateFactor)
+{
+    // Delay lengths, absorption and modulation follow the internal rate, so the FDNs sound the same at any host rate
+    rateFactor = newRateFactor;
+    internalRate = newSampleRate / static_cast<double>(rateFactor);
+    internalBlockSize = (samplesPerBlock + static_cast<int>(rateFactor) - 1) / static_cast<int>(rateFactor);
+    numPreparedInputChannels = numInputChannels;
+    numPreparedOutputChannels = numOutputChannels;
+    decimator.prepare(static_cast<uint32_t>(numInputChannels), rateFactor);
+    interpolator.prepare(static_cast<uint32_t>(numOutputChannels), rateFactor);
+
+    // Not processing: the room of a program change is adopted at once, and the replaced ones freed
+    if (auto* newRoom = pendingRoom.exchange(nullptr, std::memory_order_acq_rel))
+    {
+        room.reset(newRoom);
+        applyQualityTier(room->fdn);
+    }
+    fadingRoom.reset();
+    delete retiredRoom.exchange(nullptr, std::memory_order_acq_rel);
+    programFade = 1.0f;
+
+    room->inputCoupling.prepare(static_cast<int>(order), numInputChannels);
+    room->outputCoupling.prepare(numOutputChannels, static_cast<int>(order));
+
+    // Pick the fastest kernels for the host's sample rate and block size. Rooms of later program changes share the
+    // decision rather than timing the kernels again on the message thread
+    room->fdn.setAutoTuning(true);
+    room->fdn.prepare(internalRate, internalBlockSize);
+    preparedTuning = room->fdn.getTuning();
+
+    reducedInputCoupling.prepare(static_cast<int>(reducedOrder), numInputChannels);
+    reducedOutputCoupling.prepare(numOutputChannels, static_cast<int>(reducedOrder));
+    reducedFdn.prepare(internalRate, internalBlockSize);
+    orderFadeStep = static_cast<float>(1.0 / (orderFadeSeconds * internalRate));
+    programFadeStep = static_cast<float>(1.0 / (programFadeSeconds * internalRate));
+
+    // Within the memory of the constructor, none of these reallocate
+    buffer.setSize(std::max(numInputChannels, numOutputChannels), samplesPerBlock, false, false, true);
+    bufferBytes = std::max(bufferBytes, static_cast<size_t>(buffer.getNumChannels()) * static_cast<size_t>(samplesPerBlock) * sizeof(SampleType));
+
+    inputFrame.resize(static_cast<size_t>(numInputChannels));
+    outputFrame.resize(static_cast<size_t>(numOutputChannels));
+    reducedOutputFrame.resize(static_cast<size_t>(numOutputChannels));
+    hostInputFrame.resize(static_cast<size_t>(numInputChannels));
+    hostOutputFrame.resize(static_cast<size_t>(numOutputChannels));
+    fadingOutputFrame.resize(static_cast<size_t>(numOutputChannels));
+
+    clear();
+}
+
+template <typename SampleType>
+void FDNPluginAudioProcessor::FDNChain<SampleType>::clear()
+{
+    buffer.clear();
+    room->fdn.clear();
+    reducedFdn.clear();
+    decimator.clear();
+    interpolator.clear();
+
+    // A pending crossfade completes at once
+    orderFade = orderFadeTarget;
+    fullActive = orderFadeTarget < 1.0f;
+    reducedActive = orderFadeTarget > 0.0f;
+}
+
+template <typename SampleType>
+uint32_t FDNPluginAudioProcessor::FDNChain<SampleType>::getLatency() const
+{
+    return decimator.getLatency() + interpolator.getLatency();
+}
+
+template <typename SampleType>
+void FDNPluginAudioProcessor::FDNChain<SampleType>::visitMemory(const utils::MemoryVisitor& visitor) const
+{
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        visitor(buffer.getReadPointer(ch), static_cast<size_t>(buffer.getNumSamples()) * sizeof(SampleType));
+
+    room->visitMemory(visitor);
+    if (fadingRoom != nullptr)
+        fadingRoom->visitMemory(visitor);
+    reducedInputCoupling.visitMemory(visitor);
+    reducedFdn.visitMemory(visitor);
+    reducedOutputCoupling.visitMemory(visitor);
+    decimator.visitMemory(visitor);
+    interpolator.visitMemory(visitor);
+
+    for (const auto* frame : { &inputFrame, &inBetweenFrame, &outputFrame, &reducedInBetweenFrame, &reducedOutputFrame, &hostInputFrame, &hostOutputFrame,
+                               &fadingInBetweenFrame, &fadingOutputFrame })
+        visitor(frame->data(), frame->size() * sizeof(SampleType));
+}
+
+template <typename SampleType>
+DSP::FDNMemoryFootprint FDNPluginAudioProcessor::FDNChain<SampleType>::getFDNMemoryFootprint() const
+{
+    DSP::FDNMemoryFootprint footprint { room->fdn.getMemoryFootprint() };
+    if (fadingRoom != nullptr)
+        footprint += fadingRoom->fdn.getMemoryFootprint();
+    footprint += reducedFdn.getMemoryFootprint();
+    return footprint;
+}
+
+template <typename SampleType>
+utils::MemoryFootprint FDNPluginAudioProcessor::FDNChain<SampleType>::getMemoryFootprint() const
+{
+    utils::MemoryFootprint footprint { getFDNMemoryFootprint().getTotal() };
+    for (const auto* coupling : { &room->inputCoupling, &room->outputCoupling, &reducedInputCoupling, &reducedOutputCoupling })
+        footprint += coupling->getMemoryFootprint();
+    if (fadingRoom != nullptr)
+    {
+        footprint += fadingRoom->inputCoupling.getMemoryFootprint();
+        footprint += fadingRoom->outputCoupling.getMemoryFootprint();
+    }
+    footprint += decimator.getMemoryFootprint();
+    footprint += interpolator.getMemoryFootprint();
+
+    footprint.owned += bufferBytes;
+    for (const auto* frame : { &inputFrame, &inBetweenFrame, &outputFrame, &reducedInBetweenFrame, &reducedOutputFrame, &hostInputFrame, &hostOutputFrame,
+                               &fadingInBetweenFrame, &fadingOutputFrame })
+        footprint.owned += utils::MemoryFootprint::of(*frame);
+    return footprint;
+}
+
+template <typename SampleType>
+void FDNPluginAudioProcessor::FDNChain<SampleType>::setSnapshots(const DSP::FDNSnapshot& fdnSnapshot, const DSP::MatrixSnapshot& inputSnapshot, const DSP::MatrixSnapshot& outputSnapshot)
+{
+    // The restored topology replaces any program change in flight
+    delete pendingRoom.exchange(nullptr, std::memory_order_acq_rel);
+    fadingRoom.reset();
+    programFade = 1.0f;
+
+    room->fdn.setSnapshot(fdnSnapshot);
+    room->inputCoupling.setSnapshot(inputSnapshot);
+    room->outputCoupling.setSnapshot(outputSnapshot);
+}
+
+template <typename SampleType>
+void FDNPluginAudioProcessor::FDNChain<SampleType>::loadPreset(const DSP::Preset& preset)
+{
+    jassert(preset.topology.fdn.order == order && "Preset order must match the chain order");
+
+    auto newRoom { std::make_unique<Room>(preset.topology, preset.settings) };
+    newRoom->fdn.setRoomSize(static_cast<SampleType>(preset.settings.roomSize));
+    newRoom->fdn.setModulation(static_cast<SampleType>(preset.settings.modulationRate),
+                               static_cast<SampleType>(preset.settings.modulationDepth * Param::Ranges::ModMaxAngle));
+
+    // Prepared as the chain, so that the audio thread only swaps it in. An unprepared chain prepares it with itself
+    if (internalBlockSize > 0)
+    {
+        newRoom->inputCoupling.prepare(static_cast<int>(order), numPreparedInputChannels);
+        newRoom->outputCoupling.prepare(numPreparedOutputChannels, static_cast<int>(order));
+        newRoom->fdn.prepare(internalRate, internalBlockSize);
+        newRoom->fdn.setTuning(preparedTuning);
+        // Fault its pages in here rather than during the crossfade
+        newRoom->visitMemory(utils::MemoryLock::touch);
+    }
+
+    delete pendingRoom.exchange(newRoom.release(), std::memory_order_acq_rel);
+}
+
+template <typename SampleType>
+void FDNPluginAudioProcessor::FDNChain<SampleType>::setT60(SampleType newT60)
+{
+    room->fdn.setT60(newT60);
+    if (fadingRoom != nullptr)
+        fadingRoom->fdn.setT60(newT60);
+    reducedFdn.setT60(newT60);
+}
+
+template <typename SampleType>
+void FDNPluginAudioProcessor::FDNChain<SampleType>::setBrightness(SampleType newBrightness)
+{
+    room->fdn.setBrightness(newBrightness);
+    if (fadingRoom != nullptr)
+        fadingRoom->fdn.setBrightness(newBrightness);
+    reducedFdn.setBrightness(newBrightness);
+}
+
+template <typename SampleType>
+void FDNPluginAudioProcessor::FDNChain<SampleType>::setRoomSize(SampleType newRoomSize)
+{
+    room->fdn.setRoomSize(newRoomSize);
+    if (fadingRoom != nullptr)
+        fadingRoom->fdn.setRoomSize(newRoomSize);
+    reducedFdn.setRoomSize(newRoomSize);
+}
+
+template <typename SampleType>
+void FDNPluginAudioProcessor::FDNChain<SampleType>::setModulation(SampleType newRateHz, SampleType newDepth)
+{
+    room->fdn.setModulation(newRateHz, newDepth);
+    if (fadingRoom != nullptr)
+        fadingRoom->fdn.setModulation(newRateHz, newDepth);
+    reducedFdn.setModulation(newRateHz, newDepth);
+}
+
+template <typename SampleType>
+void FDNPluginAudioProcessor::FDNChain<SampleType>::reserveRoomSize()
+{
+    // Free the room a program change replaced
+    delete retiredRoom.exchange(nullptr, std::memory_order_acq_rel);
+
+    // The rooms are swapped by the audio thread, and never grow: they reserve the largest room size when built
+    reducedFdn.reserveRoomSize();
+}
+
+template <typename SampleType>
+void FDNPluginAudioProcessor::FDNChain<SampleType>::update()
+{
+    // Swap in the room of a program change, once the previous crossfade is over and its room freed
+    if (fadingRoom == nullptr && retiredRoom.load(std::memory_order_acquire) == nullptr)
+    {
+        if (auto* newRoom = pendingRoom.exchange(nullptr, std::memory_order_acq_rel))
+        {
+            applyQualityTier(newRoom->fdn);
+            fadingRoom = std::move(room);
+            room.reset(newRoom);
+            programFade = 0.0f;
+        }
+    }
+
+    // Without the full order playing there is nothing to crossfade: the replaced room goes at once
+    if (fadingRoom != nullptr && ! fullActive)
+    {
+        retiredRoom.store(fadingRoom.release(), std::memory_order_release);
+        programFade = 1.0f;
+    }
+
+    // The inactive FDN adopts its delay memory too, so that it can take over at any time
+    room->fdn.update();
+    if (fadingRoom != nullptr)
+        fadingRoom->fdn.update();
+    reducedFdn.update();
+}
+
+template <typename SampleType>
+void FDNPluginAudioProcessor::FDNChain<SampleType>::setQualityTier(QualityTier newTier)
+{
+    if (newTier == qualityTier)
+        return;
+    qualityTier = newTier;
+
+    applyQualityTier(room->fdn);
+    if (fadingRoom != nullptr)
+        applyQualityTier(fadingRoom->fdn);
+    applyQualityTier(reducedFdn);
+
+    // An FDN is cleared when its crossfade-out completes, as it stops being processed: a step up only
+    // resumes it, so that the expensive clear of its delay memory never adds to the load of a fade
+    if (newTier >= QualityTier::reducedOrder)
+    {
+        reducedActive = true;
+        orderFadeTarget = 1.0f;
+    }
+    else
+    {
+        fullActive = true;
+        orderFadeTarget = 0.0f;
+    }
+}
+
+template <typename SampleType>
+void FDNPluginAudioProcessor::FDNChain<SampleType>::applyQualityTier(DSP::FDN<SampleType>& target) const
+{
+    target.setControlRateSmoothing(qualityTier >= QualityTier::controlRateSmoothing);
+    target.setInterpolation(qualityTier >= QualityTier::noInterpolation ? primitives::Interpolation::none : primitives::Interpolation::linear);
 }
 
+template <typename SampleType>
+void FDNPluginAudioProcessor::FDNChain<SampleType>::processFrame(uint32_t numInputChannels, uint32_t numOutputChannels)
+{
+    if (fullActive)
+    {
+        room->processFrame(outputFrame.data(), inputFrame.data(), inBetweenFrame.data(), numInputChannels, numOutputChannels);
+
+        if (fadingRoom != nullptr)
+        {
+            fadingRoom->processFrame(fadingOutputFrame.data(), inputFrame.data(), fadingInBetweenFrame.data(), numInputChannels, numOutputChannels);
+
+            // Equal-power crossfade from the replaced room, the two being uncorrelated
+            programFade = std::min(programFade + programFadeStep, 1.0f);
+            const SampleType angle { static_cast<SampleType>(programFade) * juce::MathConstants<SampleType>::halfPi };
+            const SampleType roomGain { std::sin(angle) };
+            const SampleType fadingGain { std::cos(angle) };
+            for (uint32_t ch = 0; ch < numOutputChannels; ++ch)
+                outputFrame[ch] = roomGain * outputFrame[ch] + fadingGain * fadingOutputFrame[ch];
+
+            // Freed by the message thread
+            if (programFade >= 1.0f)
+                retiredRoom.store(fadingRoom.release(), std::memory_order_release);
+        }
+    }
+
+    if (! reducedActive)
+        return;
+
+    reducedInputCoupling.processSample(reducedInBetweenFrame.data(), inputFrame.data(), reducedOrder, numInputChannels);
+    reducedFdn.process(reducedInBetweenFrame.data(), reducedInBetweenFrame.data(), reducedOrder);
+    reducedOutputCoupling.processSample(reducedOutputFrame.data(), reducedInBetweenFrame.data(), numOutputChannels, reducedOrder);
+
+    if (! fullActive)
+    {
+        std::copy(reducedOutputFrame.begin(), reducedOutputFrame.end(), outputFrame.begin());
+        return;
+    }
+
+    // Equal-power crossfade, the two FDNs being uncorrelated
+    orderFade = orderFadeTarget > orderFade ? std::min(orderFade + orderFadeStep, orderFadeTarget)
+                                            : std::max(orderFade - orderFadeStep, orderFadeTarget);
+    const SampleType angle { static_cast<SampleType>(orderFade) * juce::MathConstants<SampleType>::halfPi };
+    const SampleType fullGain { std::cos(angle) };
+    const SampleType reducedGain { std::sin(angle) };
+    for (uint32_t ch = 0; ch < numOutputChannels; ++ch)
+        outputFrame[ch] = fullGain * outputFrame[ch] + reducedGain * reducedOutputFrame[ch];
+
+    if (orderFade == orderFadeTarget)
+    {
+        if (orderFadeTarget > 0.0f)
+        {
+            fullActive = false;
+            room->fdn.clear();
+        }
+        else
+        {
+            reducedActive = false;
+            reducedFdn.clear();
+        }
+    }
+}
+
+template <typename SampleType>
+void FDNPluginAudioProcessor::FDNChain<SampleType>::processHostFrame(uint32_t numInputChannels, uint32_t numOutputChannels)
+{
+    if (decimator.processSample(inputFrame.data(), hostInputFrame.data(), numInputChannels))
+    {
+        processFrame(numInputChannels, numOutputChannels);
+        interpolator.pushSample(outputFrame.data(), numOutputChannels);
+    }
+    interpolator.processSample(hostOutputFrame.data(), numOutputChannels);
+}
+
+//==============================================================================
 void FDNPluginAudioProcessor::prepareToPlay(double newSampleRate, int samplesPerBlock)
 {
     jassert(newSampleRate > 0.0 && "Sample rate must be greater than zero");
     jassert(samplesPerBlock > 0 && "Samples per block must be greater than zero");
 
     sampleRate = newSampleRate;
+    preparedBlockSize = samplesPerBlock;
+    loadMeter.prepare(newSampleRate);
+    qualityGovernor.prepare(newSampleRate);
 
     enableRamp.prepare(newSampleRate, samplesPerBlock);
+    enableGain.resize(static_cast<size_t>(samplesPerBlock));
 
     mixRamp.prepare(newSampleRate, samplesPerBlock);
+    mixGain.resize(static_cast<size_t>(samplesPerBlock));
 
     const int numInputChannels  = getTotalNumInputChannels();
     const int numOutputChannels = getTotalNumOutputChannels();
-    fdnInputCoupling.prepare(fdnOrder, numInputChannels);
-    fdnOutputCoupling.prepare(numOutputChannels, fdnOrder);
 
-    fdn.prepare(newSampleRate, samplesPerBlock);
+    // The parameter callbacks run after the chains are prepared, so the internal rate is read from the parameter
+    preparedReducedRate = getParameterValue(Param::ID::ReducedRate) > 0.5f;
+    reducedRate.store(preparedReducedRate, std::memory_order_relaxed);
+    const uint32_t rateFactor { preparedReducedRate ? static_cast<uint32_t>(std::max(1.0, std::floor(newSampleRate / Param::Ranges::MinInternalRate))) : 1u };
+
+    // The host sets the processing precision before preparing, so only one chain needs memory
+    if (isUsingDoublePrecision())
+        doubleChain.prepare(newSampleRate, samplesPerBlock, numInputChannels, numOutputChannels, rateFactor);
+    else
+        floatChain.prepare(newSampleRate, samplesPerBlock, numInputChannels, numOutputChannels, rateFactor);
 
-    fdnBuffer.setSize(std::max(numInputChannels, numOutputChannels), samplesPerBlock);
+    // The output is wet only: reporting the conversion delay lets the host align the tail as at the full rate
+    setLatencySamples(static_cast<int>(isUsingDoublePrecision() ? doubleChain.getLatency() : floatChain.getLatency()));
 
     parameterManager.updateParameters(true);
+
+    lockAudioMemory();
+    measureMemory();
+
+    loggedOverruns = 0u;
+    logger.getChannel(messageLogChannel).logShared("Prepared at {} Hz, blocks of up to {} samples, double precision {}, FDN at 1/{} of the rate",
+                                                   newSampleRate, samplesPerBlock, isUsingDoublePrecision() ? 1 : 0, rateFactor);
+
+    const DSP::TuningDecision tuning { isUsingDoublePrecision() ? doubleChain.room->fdn.getTuning() : floatChain.room->fdn.getTuning() };
+    logger.getChannel(messageLogChannel).logShared("FDN kernels: instruction set {} (0 generic, 1 sse2, 2 avx2, 3 avx512) at {} ns/sample, from cache {}",
+                                                   static_cast<uint32_t>(tuning.instructionSet), tuning.nanosecondsPerSample, tuning.fromCache ? 1 : 0);
 }
 
 void FDNPluginAudioProcessor::releaseResources()
 {
     // This function will be called when playback stops or is about to start again.
     // Here you can use this as an opportunity to free up any spare memory, etc.
-    fdnBuffer.clear();
-    fdn.clear();
+    floatChain.clear();
+    doubleChain.clear();
+    memoryLock.unlockAll();
+}
+
+void FDNPluginAudioProcessor::measureMemory()
+{
+    // Both chains are allocated, even though only the one of the host's precision is processed
+    utils::MemoryFootprint chains { floatChain.getMemoryFootprint() };
+    chains += doubleChain.getMemoryFootprint();
+    chainsOwnedBytes.store(chains.owned, std::memory_order_relaxed);
+    chainsSharedBytes.store(chains.shared, std::memory_order_relaxed);
+
+    DSP::FDNMemoryFootprint fdns { floatChain.getFDNMemoryFootprint() };
+    fdns += doubleChain.getFDNMemoryFootprint();
+    logger.getChannel(messageLogChannel).logShared("FDN memory: delay lines {} bytes, absorption {}, matrices {}, state {}",
+                                                   fdns.delayLines.getBytes(), fdns.absorption.getBytes(), fdns.feedbackMatrix.getBytes(), fdns.state.getBytes());
+    const utils::MemoryFootprint total { getMemoryFootprint() };
+    logger.getChannel(messageLogChannel).logShared("Instance memory: {} bytes, of which {} shared with other instances", total.getBytes(), total.shared);
+}
+
+utils::MemoryFootprint FDNPluginAudioProcessor::getMemoryFootprint() const
+{
+    utils::MemoryFootprint footprint { chainsOwnedBytes.load(std::memory_order_relaxed), chainsSharedBytes.load(std::memory_order_relaxed) };
+    footprint += capture.getMemoryFootprint();
+    footprint += logger.getMemoryFootprint();
+    for (const auto* values : { &enableGain, &mixGain })
+        footprint.owned += utils::MemoryFootprint::of(*values);
+    footprint.owned += utils::MemoryFootprint::of(capturedValues) + utils::MemoryFootprint::of(captureEvents);
+    return footprint;
+}
+
+void FDNPluginAudioProcessor::lockAudioMemory()
+{
+    memoryLock.unlockAll();
+
+    size_t refusedBytes { 0u };
+    const utils::MemoryVisitor lockRegion { [this, &refusedBytes](const void* data, size_t numBytes)
+    {
+        if (! memoryLock.add(data, numBytes))
+            refusedBytes += numBytes;
+    } };
+
+    if (isUsingDoublePrecision())
+        doubleChain.visitMemory(lockRegion);
+    else
+        floatChain.visitMemory(lockRegion);
+    lockRegion(enableGain.data(), enableGain.size() * sizeof(float));
+    lockRegion(mixGain.data(), mixGain.size() * sizeof(float));
+
+    logger.getChannel(messageLogChannel).logShared("Audio memory: {} bytes touched, {} locked, {} refused",
+                                                   memoryLock.getTouchedBytes(), memoryLock.getLockedBytes(), refusedBytes);
+}
+
+bool FDNPluginAudioProcessor::supportsDoublePrecisionProcessing() const
+{
+    return true;
+}
+
+void FDNPluginAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& /*midiMessages*/)
+{
+    {
+        const utils::LoadMeter::ScopedMeasurement measurement { loadMeter, static_cast<uint32_t>(buffer.getNumSamples()) };
+        captureBlock(buffer);
+        processChain(buffer, floatChain);
+    }
+    logOverruns(static_cast<uint32_t>(buffer.getNumSamples()));
+    updateQuality(static_cast<uint32_t>(buffer.getNumSamples()));
+}
+
+void FDNPluginAudioProcessor::processBlock(juce::AudioBuffer<double>& buffer, juce::MidiBuffer& /*midiMessages*/)
+{
+    {
+        const utils::LoadMeter::ScopedMeasurement measurement { loadMeter, static_cast<uint32_t>(buffer.getNumSamples()) };
+        captureBlock(buffer);
+        processChain(buffer, doubleChain);
+    }
+    logOverruns(static_cast<uint32_t>(buffer.getNumSamples()));
+    updateQuality(static_cast<uint32_t>(buffer.getNumSamples()));
+}
+
+void FDNPluginAudioProcessor::logOverruns(uint32_t numSamples)
+{
+    // The editor may reset the count in between: only an increase is an overrun
+    const uint64_t overruns { loadMeter.getOverruns() };
+    if (overruns > loggedOverruns)
+        logger.getChannel(audioLogChannel).log("Block of {} samples overran its budget: load {}, {} overruns",
+                                               numSamples, loadMeter.getLastLoad(), overruns);
+    loggedOverruns = overruns;
+}
+
+void FDNPluginAudioProcessor::updateQuality(uint32_t numSamples)
+{
+    // The smoothed load, so that a single slow block does not step down
+    const uint32_t previousTier { qualityGovernor.getTier() };
+    const uint32_t tier { qualityGovernor.update(loadMeter.getLoad(), numSamples) };
+    if (tier != previousTier)
+        logger.getChannel(audioLogChannel).log("Quality tier {} -> {} at load {}", previousTier, tier, loadMeter.getLoad());
 }
 
-void FDNPluginAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& /*midiMessages*/)
+bool FDNPluginAudioProcessor::startCapture(const juce::File& file)
+{
+    utils::CaptureHeader header;
+    header.sampleRate = sampleRate;
+    header.numChannels = static_cast<uint32_t>(getTotalNumInputChannels());
+    header.maxBlockSize = static_cast<uint32_t>(enableGain.size());
+    for (auto* parameter : getParameters())
+    {
+        const auto* withID { dynamic_cast<juce::AudioProcessorParameterWithID*>(parameter) };
+        header.parameterIds.push_back(withID != nullptr ? withID->paramID.toStdString() : std::string {});
+    }
+
+    // The state holds the topology, which the parameters do not
+    juce::MemoryBlock state;
+    getStateInformation(state);
+    header.state.assign(static_cast<const char*>(state.getData()), static_cast<const char*>(state.getData()) + state.getSize());
+
+    // The first captured block sets every parameter
+    captureAllParameters.store(true, std::memory_order_release);
+    const bool started { capture.start(file.getFullPathName().toStdString(), header) };
+    logger.getChannel(messageLogChannel).logShared(started ? "Capture started" : "Capture could not start");
+    return started;
+}
+
+void FDNPluginAudioProcessor::stopCapture()
+{
+    if (! capture.isCapturing())
+        return;
+
+    capture.stop();
+    logger.getChannel(messageLogChannel).logShared("Capture stopped, {} blocks dropped", capture.getDroppedBlocks());
+}
+
+template <typename SampleType>
+void FDNPluginAudioProcessor::captureBlock(const juce::AudioBuffer<SampleType>& buffer)
+{
+    if (! capture.isCapturing())
+        return;
+
+    DSP_TRACE_SCOPE("TVFDN::captureBlock");
+
+    // Parameters are applied once per block, so every event is at the start of the block
+    const bool captureAll { captureAllParameters.exchange(false, std::memory_order_acq_rel) };
+    const auto& parameters { getParameters() };
+    captureEvents.clear();
+    for (int i = 0; i < parameters.size(); ++i)
+    {
+        const float value { parameters[i]->getValue() };
+        if (captureAll || value != capturedValues[static_cast<size_t>(i)])
+        {
+            capturedValues[static_cast<size_t>(i)] = value;
+            captureEvents.push_back({ static_cast<uint32_t>(i), 0u, value });
+        }
+    }
+
+    capture.pushBlock(buffer.getArrayOfReadPointers(), static_cast<uint32_t>(getTotalNumInputChannels()),
+                      static_cast<uint32_t>(buffer.getNumSamples()), captureEvents.data(), static_cast<uint32_t>(captureEvents.size()));
+}
+
+template <typename SampleType>
+void FDNPluginAudioProcessor::processChain(juce::AudioBuffer<SampleType>& buffer, FDNChain<SampleType>& chain)
+{
+    DSP_TRACE_SCOPE("TVFDN::processBlock");
+    const int maxPartSize { static_cast<int>(enableGain.size()) };
+    const int numSamples { buffer.getNumSamples() };
+    if (maxPartSize == 0)
+    {
+        buffer.clear();
+        return;
+    }
+
+    // Parts refer to the host buffer: no copy, and no allocation below 32 channels
+    for (int start = 0; start < numSamples; start += maxPartSize)
+    {
+        juce::AudioBuffer<SampleType> part { buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start, std::min(maxPartSize, numSamples - start) };
+        processChainPart(part, chain);
+    }
+}
+
+template <typename SampleType>
+void FDNPluginAudioProcessor::processChainPart(juce::AudioBuffer<SampleType>& buffer, FDNChain<SampleType>& chain)
 {
     juce::ScopedNoDenormals noDenormals;
-    parameterManager.updateParameters();
+    {
+        DSP_TRACE_SCOPE("TVFDN::updateParameters");
+        parameterManager.updateParameters();
+    }
 
     const uint32_t numInputChannels  = static_cast<uint32_t>( getTotalNumInputChannels() );
     const uint32_t numOutputChannels = static_cast<uint32_t>( getTotalNumOutputChannels() );
-    const uint32_t trackChannels = std::max(numInputChannels, numOutputChannels);
     const uint32_t numSamples { static_cast<uint32_t>( buffer.getNumSamples() ) };
+    jassert(numSamples <= enableGain.size() && "Part is larger than the prepared block size");
 
-    std::vector<float> fdnInputFrame(numInputChannels);
-    std::vector<float> inBetweenFrame(fdnOrder);
-    std::vector<float> fdnOutputFrame(numOutputChannels);
+    // Apply room size changes and the quality tier once per block
+    chain.update();
+    chain.setQualityTier(getQualityTier());
 
-    for (size_t n = 0; n < static_cast<size_t>(numSamples); ++n)
+    // Coupling and FDN alternate every sample, so they are traced as one phase
     {
-        for (int ch = 0; ch < static_cast<int>(numInputChannels); ++ch)
-            fdnInputFrame[ch] = buffer.getReadPointer(ch)[n];
-        // FDN input coupling
-        fdnInputCoupling.processSample(inBetweenFrame.data(), fdnInputFrame.data(), fdnOrder, numInputChannels);
-        // FDN process
-        fdn.process(inBetweenFrame.data(), inBetweenFrame.data(), fdnOrder);
-        // FDN output coupling
-        fdnOutputCoupling.processSample(fdnOutputFrame.data(), inBetweenFrame.data(), numOutputChannels, fdnOrder);
-        for (int ch = 0; ch < static_cast<int>(numOutputChannels); ++ch)
-            fdnBuffer.getWritePointer(ch)[n] = fdnOutputFrame[ch];
-
+        DSP_TRACE_SCOPE("TVFDN::couplingAndFDN");
+        if (chain.rateFactor == 1u)
+        {
+            for (size_t n = 0; n < static_cast<size_t>(numSamples); ++n)
+            {
+                for (int ch = 0; ch < static_cast<int>(numInputChannels); ++ch)
+                    chain.inputFrame[ch] = buffer.getReadPointer(ch)[n];
+                chain.processFrame(numInputChannels, numOutputChannels);
+                for (int ch = 0; ch < static_cast<int>(numOutputChannels); ++ch)
+                    chain.buffer.getWritePointer(ch)[n] = chain.outputFrame[ch];
+            }
+        }
+        else
+        {
+            for (size_t n = 0; n < static_cast<size_t>(numSamples); ++n)
+            {
+                for (int ch = 0; ch < static_cast<int>(numInputChannels); ++ch)
+                    chain.hostInputFrame[ch] = buffer.getReadPointer(ch)[n];
+                chain.processHostFrame(numInputChannels, numOutputChannels);
+                for (int ch = 0; ch < static_cast<int>(numOutputChannels); ++ch)
+                    chain.buffer.getWritePointer(ch)[n] = chain.hostOutputFrame[ch];
+            }
+        }
     }
 
-    enableRamp.multiplyBuffer(fdnBuffer.getArrayOfWritePointers(), fdnBuffer.getArrayOfReadPointers(), trackChannels, numSamples);
-    mixRamp.multiplyBuffer(fdnBuffer.getArrayOfWritePointers(), fdnBuffer.getArrayOfReadPointers(), numOutputChannels, numSamples);
+    {
+        DSP_TRACE_SCOPE("TVFDN::gainRamps");
+        // The ramps run in single precision for both chains
+        enableRamp.assignBuffer(enableGain.data(), numSamples);
+        mixRamp.assignBuffer(mixGain.data(), numSamples);
+
+        const auto& kernels { DSP::KernelDispatch::getKernels<SampleType>() };
+        for (int ch = 0; ch < static_cast<int>(numOutputChannels); ++ch)
+            kernels.applyGains(chain.buffer.getWritePointer(ch), enableGain.data(), mixGain.data(), numSamples);
+    }
 
-    for (int ch = 0; ch < static_cast<int>(numOutputChannels); ++ch)
-        buffer.copyFrom(ch, int { 0 }, fdnBuffer, ch, int { 0 }, static_cast<int>( numSamples ));
+    {
+        DSP_TRACE_SCOPE("TVFDN::outputCopy");
+        for (int ch = 0; ch < static_cast<int>(numOutputChannels); ++ch)
+            buffer.copyFrom(ch, int { 0 }, chain.buffer, ch, int { 0 }, static_cast<int>( numSamples ));
+    }
 }
 
 void FDNPluginAudioProcessor::getStateInformation(juce::MemoryBlock& destData)
 {
-    parameterManager.getStateInformation(destData);
+    juce::MemoryBlock parameterState;
+    parameterManager.getStateInformation(parameterState);
+
+    juce::MemoryOutputStream stream(destData, false);
+    stream.writeInt(stateMagic);
+    stream.writeInt(stateVersion);
+    stream.writeInt(static_cast<int>(parameterState.getSize()));
+    stream.write(parameterState.getData(), parameterState.getSize());
+
+    // Kept in full precision by the message thread: the audio thread swaps the rooms of the chains.
+    // Copied under the lock, as the host may save the state from another thread while a program is set
+    DSP::PresetTopology stateTopology;
+    int stateProgram { 0 };
+    {
+        const std::lock_guard<std::mutex> lock { programMutex };
+        stateTopology = topology;
+        stateProgram = currentProgram;
+    }
+    DSP::writeSnapshot(stream, stateTopology.fdn);
+    DSP::writeSnapshot(stream, stateTopology.inputCoupling);
+    DSP::writeSnapshot(stream, stateTopology.outputCoupling);
+
+    stream.writeInt(static_cast<int>(qualityGovernor.getTier()));
+    stream.writeInt(stateProgram);
 }
 
 void FDNPluginAudioProcessor::setStateInformation(const void* data, int sizeInBytes)
 {
-    parameterManager.setStateInformation(data, sizeInBytes);
+    juce::MemoryInputStream stream(data, static_cast<size_t>(sizeInBytes), false);
+
+    // States written before the topology was stored only contain the parameters
+    if (sizeInBytes < 3 * static_cast<int>(sizeof(int)) || stream.readInt() != stateMagic)
+    {
+        parameterManager.setStateInformation(data, sizeInBytes);
+        return;
+    }
+    const int version { stream.readInt() };
+
+    // Every version starts with the length-prefixed parameters, so newer states restore those at least
+    const int parameterStateSize { stream.readInt() };
+    if (parameterStateSize < 0 || parameterStateSize > stream.getNumBytesRemaining())
+        return;
+
+    juce::MemoryBlock parameterState;
+    stream.readIntoMemoryBlock(parameterState, parameterStateSize);
+    parameterManager.setStateInformation(parameterState.getData(), static_cast<int>(parameterState.getSize()));
+    if (version > stateVersion)
+        return;
+
+    // Restore the topology, unless it does not fit the current configuration
+    DSP::FDNSnapshot fdnSnapshot;
+    DSP::MatrixSnapshot inputSnapshot;
+    DSP::MatrixSnapshot outputSnapshot;
+    if (!DSP::readSnapshot(stream, fdnSnapshot) || !DSP::readSnapshot(stream, inputSnapshot) || !DSP::readSnapshot(stream, outputSnapshot))
+        return;
+
+    // Read now, applied only with the topology
+    const int tier { version >= 2 && stream.getNumBytesRemaining() >= static_cast<juce::int64>(sizeof(int)) ? stream.readInt() : -1 };
+    const int program { version >= 3 && stream.getNumBytesRemaining() >= static_cast<juce::int64>(sizeof(int)) ? stream.readInt() : -1 };
+
+    if (fdnSnapshot.order != fdnOrder
+        || inputSnapshot.dim1 != static_cast<int>(fdnOrder) || inputSnapshot.dim2 != getTotalNumInputChannels()
+        || outputSnapshot.dim1 != getTotalNumOutputChannels() || outputSnapshot.dim2 != static_cast<int>(fdnOrder))
+        return;
+
+    // Resume at the tier the session ended at, rather than overloading again before stepping down
+    if (tier >= 0)
+        qualityGovernor.setTier(static_cast<uint32_t>(tier));
+
+    // The delay lines are reallocated: keep the audio thread out meanwhile
+    suspendProcessing(true);
+    floatChain.setSnapshots(fdnSnapshot, inputSnapshot, outputSnapshot);
+    doubleChain.setSnapshots(fdnSnapshot, inputSnapshot, outputSnapshot);
+    suspendProcessing(false);
+
+    const std::lock_guard<std::mutex> lock { programMutex };
+    topology = { fdnSnapshot, inputSnapshot, outputSnapshot };
+    // The program only names the state: its topology and settings are restored here
+    if (program >= 0)
+        currentProgram = juce::jlimit(0, getNumPrograms() - 1, program);
 }
 
 //==============================================================================
@@ -139,11 +1000,51 @@ bool FDNPluginAudioProcessor::acceptsMidi() const { return false; }
 bool FDNPluginAudioProcessor::producesMidi() const { return false; }
 bool FDNPluginAudioProcessor::isMidiEffect() const { return false; }
 double FDNPluginAudioProcessor::getTailLengthSeconds() const { return 0.0; }
-int FDNPluginAudioProcessor::getNumPrograms() { return 1; }
-int FDNPluginAudioProcessor::getCurrentProgram() { return 0; }
-void FDNPluginAudioProcessor::setCurrentProgram(int) { }
-const juce::String FDNPluginAudioProcessor::getProgramName (int) { return {}; }
+int FDNPluginAudioProcessor::getNumPrograms() { return static_cast<int>(Param::Presets::Factory.size()); }
+int FDNPluginAudioProcessor::getCurrentProgram()
+{
+    const std::lock_guard<std::mutex> lock { programMutex };
+    return currentProgram;
+}
+
+// Factory programs keep their names
 void FDNPluginAudioProcessor::changeProgramName (int, const juce::String&) { }
+
+const juce::String FDNPluginAudioProcessor::getProgramName (int index)
+{
+    if (index < 0 || index >= getNumPrograms())
+        return {};
+    return juce::String::fromUTF8(Param::Presets::Factory[static_cast<size_t>(index)].name.c_str());
+}
+
+void FDNPluginAudioProcessor::setCurrentProgram(int index)
+{
+    if (index < 0 || index >= getNumPrograms())
+        return;
+
+    // Read from the mapped bank, or generated here while the loader has not mapped it yet
+    DSP::Preset preset;
+    if (! presetBankReady.load(std::memory_order_acquire) || ! presetBank.readPreset(static_cast<size_t>(index), preset))
+        preset = DSP::PresetBank::computePreset(Param::Presets::Factory[static_cast<size_t>(index)], fdnOrder,
+                                                getTotalNumInputChannels(), getTotalNumOutputChannels());
+
+    {
+        const std::lock_guard<std::mutex> lock { programMutex };
+        currentProgram = index;
+        topology = preset.topology;
+    }
+
+    // Both chains, as setStateInformation restores both: the audio thread swaps the new rooms in and crossfades to them
+    floatChain.loadPreset(preset);
+    doubleChain.loadPreset(preset);
+
+    // The parameters follow, for the host and the editor. The new rooms already have these values
+    setParameterValue(Param::ID::revT60, preset.settings.t60);
+    setParameterValue(Param::ID::revBrightness, preset.settings.brightness);
+    setParameterValue(Param::ID::revRoomSize, preset.settings.roomSize);
+    setParameterValue(Param::ID::revModRate, preset.settings.modulationRate);
+    setParameterValue(Param::ID::revModDepth, preset.settings.modulationDepth);
+}
 //==============================================================================
 
 //==============================================================================
@@ -3,9 +3,21 @@
 #include <JuceHeader.h>
 #include <Eigen/Dense>
 
+#include <mutex>
+#include <thread>
+
 #include "Ramp.h"
 #include "Matrix.h"
 #include "FDN.h"
+#include "PresetBank.h"
+#include "PolyphaseResampler.h"
+#include "KernelDispatch.h"
+#include "Trace.h"
+#include "LoadMeter.h"
+#include "MemoryLock.h"
+#include "RealtimeLogger.h"
+#include "SessionCapture.h"
+#include "QualityGovernor.h"
 
 namespace Param
 {
@@ -18,6 +30,12 @@ namespace Param
 
         static const juce::String revT60 { "revT60" };
         static const juce::String revBrightness { "revBrightness" };
+        static const juce::String revRoomSize { "revRoomSize" };
+        static const juce::String revModRate { "revModRate" };
+        static const juce::String revModDepth { "revModDepth" };
+
+        static const juce::String AdaptiveQuality { "adaptiveQuality" };
+        static const juce::String ReducedRate { "reducedRate" };
     }
 
     namespace Name
@@ -29,6 +47,12 @@ namespace Param
 
         static const juce::String revT60 { "Size" };
         static const juce::String revBrightness { "Brightness" };
+        static const juce::String revRoomSize { "Room Size" };
+        static const juce::String revModRate { "Mod Rate" };
+        static const juce::String revModDepth { "Mod Depth" };
+
+        static const juce::String AdaptiveQuality { "Adaptive Quality" };
+        static const juce::String ReducedRate { "Reduced Rate" };
     }
 
     namespace Ranges
@@ -56,6 +80,62 @@ namespace Param
         static constexpr float BrightnessMax { 1.f };
         static constexpr float BrightnessInc { 0.01f };
         static constexpr float BrightnessSkw { 0.5f };
+
+        static constexpr float RoomSizeDefault { 1.f };
+        static constexpr float RoomSizeMin { 0.5f };
+        static constexpr float RoomSizeMax { 2.f };
+        static constexpr float RoomSizeInc { 0.01f };
+        static constexpr float RoomSizeSkw { 1.f };
+
+        static constexpr float ModRateDefault { 0.3f };
+        static constexpr float ModRateMin { 0.01f };
+        static constexpr float ModRateMax { 2.f };
+        static constexpr float ModRateInc { 0.01f };
+        static constexpr float ModRateSkw { 0.5f };
+
+        // Fraction of the maximum feedback matrix rotation angle
+        static constexpr float ModDepthDefault { 0.f };
+        static constexpr float ModDepthMin { 0.f };
+        static constexpr float ModDepthMax { 1.f };
+        static constexpr float ModDepthInc { 0.01f };
+        static constexpr float ModDepthSkw { 1.f };
+        static constexpr float ModMaxAngle { juce::MathConstants<float>::pi / 4.f };
+
+        static constexpr bool AdaptiveQualityDefault { true };
+        static const juce::String AdaptiveQualityOff { "Off" };
+        static const juce::String AdaptiveQualityOn { "On" };
+
+        // The FDN runs at the host rate divided by the largest integer that keeps it at or above MinInternalRate
+        static constexpr bool ReducedRateDefault { false };
+        static const juce::String ReducedRateOff { "Off" };
+        static const juce::String ReducedRateOn { "On" };
+        static constexpr double MinInternalRate { 44100.0 };
+    }
+
+    namespace Topology
+    {
+        // Seeds of the randomly generated topology. Fixed, so every instance sounds the same
+        static constexpr uint32_t FDNSeed { 1u };
+        static constexpr uint32_t InputCouplingSeed { 2u };
+        static constexpr uint32_t OutputCouplingSeed { 3u };
+    }
+
+    namespace Presets
+    {
+        // Factory programs, the first one with the default topology and settings. Their topologies are computed
+        // once into the preset bank file, and again whenever a recipe changes
+        static const std::vector<DSP::PresetRecipe> Factory
+        {
+            { "Default",      Topology::FDNSeed, Topology::InputCouplingSeed, Topology::OutputCouplingSeed,
+                              { Ranges::T60Default, Ranges::BrightnessDefault, Ranges::RoomSizeDefault, Ranges::ModRateDefault, Ranges::ModDepthDefault } },
+            { "Small Room",   11u, 12u, 13u, { 0.6f, 0.7f, 0.5f, 0.3f, 0.0f } },
+            { "Studio",       21u, 22u, 23u, { 1.2f, 0.6f, 0.8f, 0.2f, 0.1f } },
+            { "Chamber",      31u, 32u, 33u, { 2.0f, 0.5f, 1.0f, 0.3f, 0.2f } },
+            { "Concert Hall", 41u, 42u, 43u, { 3.5f, 0.45f, 1.5f, 0.25f, 0.2f } },
+            { "Cathedral",    51u, 52u, 53u, { 8.0f, 0.35f, 2.0f, 0.1f, 0.3f } },
+            { "Dark Cave",    61u, 62u, 63u, { 5.0f, 0.1f, 1.8f, 0.05f, 0.0f } },
+            { "Shimmer",      71u, 72u, 73u, { 6.0f, 0.9f, 1.2f, 1.5f, 0.8f } }
+        };
     }
 
     namespace Units
@@ -67,7 +147,18 @@ namespace Param
     }
 }
 
-class FDNPluginAudioProcessor : public juce::AudioProcessor
+// Quality tiers, stepped down one at a time under CPU pressure
+enum class QualityTier : uint32_t
+{
+    full,
+    controlRateSmoothing,   // absorption ramps and matrix rotations at control rate
+    noInterpolation,        // delay lines read at the nearest sample
+    reducedOrder,           // crossfade to an FDN of half the order
+    numTiers
+};
+
+class FDNPluginAudioProcessor : public juce::AudioProcessor,
+                                private juce::Timer
 {
 public:
     FDNPluginAudioProcessor();
@@ -75,13 +166,31 @@ public:
 
     void prepareToPlay(double sampleRate, int samplesPerBlock) override;
     void processBlock(juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock(juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
     void releaseResources() override;
 
+    bool supportsDoublePrecisionProcessing() const override;
+
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
     mrta::ParameterManager& getParameterManager() { return parameterManager; }
 
+    // Time of each processBlock against its real-time budget, read lock-free by the editor
+    utils::LoadMeter& getLoadMeter() { return loadMeter; }
+
+    // Opt-in capture of the input blocks and parameter changes, for an offline replay with tvfdn_replay. Message thread
+    bool startCapture(const juce::File& file);
+    void stopCapture();
+    bool isCapturing() const { return capture.isCapturing(); }
+
+    // Heap memory of the instance: the chains as measured when constructed and prepared, the capture buffers
+    // and the log rings. Message thread
+    utils::MemoryFootprint getMemoryFootprint() const;
+
+    // Quality tier the load currently allows. Any thread
+    QualityTier getQualityTier() const { return static_cast<QualityTier>(qualityGovernor.getTier()); }
+
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
     bool hasEditor() const override;
@@ -98,26 +207,236 @@ public:
     //==============================================================================
 
     static const unsigned int MaxChannels { 2 };
+    // Worst case the memory of the audio thread is allocated for in the constructor, so that prepareToPlay
+    // only resets state. Larger blocks reallocate in prepareToPlay
+    static const int MaxBlockSize { 4096 };
+    // Largest rate factor of Reduced Rate, at 352.8 and 384 kHz
+    static const unsigned int MaxRateFactor { 8 };
 
 private:
+    // Signal chain of the reverb for one sample type
+    template <typename SampleType>
+    struct FDNChain
+    {
+        // Full-order reverb: input coupling, FDN and output coupling. A program change builds a new one off the
+        // audio thread, which the audio thread swaps in and crossfades to
+        struct Room
+        {
+            // Generated from the default seeds
+            Room(uint32_t order, int numInputChannels, int numOutputChannels);
+            // Restored from a preset, without generating anything
+            Room(const DSP::PresetTopology& topology, const DSP::PresetSettings& settings);
+
+            // Input frame -> coupling -> FDN -> coupling -> output frame
+            void processFrame(SampleType* outputFrame, const SampleType* inputFrame, SampleType* inBetweenFrame, uint32_t numInputChannels, uint32_t numOutputChannels);
+
+            void visitMemory(const utils::MemoryVisitor& visitor) const;
+
+            uint32_t order;
+            DSP::Matrix<SampleType> inputCoupling;
+            DSP::FDN<SampleType> fdn;
+            DSP::Matrix<SampleType> outputCoupling;
+        };
+
+        // Allocates for the worst case: MaxChannels, MaxBlockSize, MaxRateFactor and the largest room size
+        FDNChain(uint32_t order, int numInputChannels, int numOutputChannels);
+        ~FDNChain();
+
+        // The FDNs run at the host rate divided by rateFactor. Resets the state, within the memory of the constructor
+        void prepare(double newSampleRate, int samplesPerBlock, int numInputChannels, int numOutputChannels, uint32_t newRateFactor);
+        void clear();
+
+        // Delay of the rate conversion, in samples at the host rate
+        uint32_t getLatency() const;
+
+        // Pass the memory processFrame and processHostFrame work on to a visitor
+        void visitMemory(const utils::MemoryVisitor& visitor) const;
+
+        // Heap memory of both FDNs, by part, and of the whole chain. Not while processing
+        DSP::FDNMemoryFootprint getFDNMemoryFootprint() const;
+        utils::MemoryFootprint getMemoryFootprint() const;
+
+        // Restore the topology stored in the plugin state. Drops a pending program change. Not while processing
+        void setSnapshots(const DSP::FDNSnapshot& fdnSnapshot, const DSP::MatrixSnapshot& inputSnapshot, const DSP::MatrixSnapshot& outputSnapshot);
+
+        // Build the room of a preset, prepared as the chain, and hand it over to the audio thread, which crossfades
+        // to it in update. Replaces a room not adopted yet. Allocates: message thread
+        void loadPreset(const DSP::Preset& preset);
+
+        // Reverb parameters, for all the FDNs in use
+        void setT60(SampleType newT60);
+        void setBrightness(SampleType newBrightness);
+        void setRoomSize(SampleType newRoomSize);
+        void setModulation(SampleType newRateHz, SampleType newDepth);
+        // Also frees the room a program change retired. Message thread, periodically
+        void reserveRoomSize();
+        // Adopt the room of a program change, and apply pending reconfigurations of the FDNs. Audio thread, once per block
+        void update();
+
+        // Apply the cost reductions of a tier. Audio thread, once per block
+        void setQualityTier(QualityTier newTier);
+        // Smoothing and interpolation of the current tier, for an FDN
+        void applyQualityTier(DSP::FDN<SampleType>& target) const;
+
+        // Input frame -> coupling -> FDN(s) -> coupling -> output frame
+        void processFrame(uint32_t numInputChannels, uint32_t numOutputChannels);
+
+        // Host frame -> decimation -> processFrame, every rateFactor frames -> interpolation -> host frame
+        void processHostFrame(uint32_t numInputChannels, uint32_t numOutputChannels);
+
+        uint32_t order;
+        // Room in use, and the one it replaced while they crossfade. Audio thread
+        std::unique_ptr<Room> room;
+        std::unique_ptr<Room> fadingRoom;
+        // Hand-over of a program change: built room -> audio thread, and the replaced one back
+        std::atomic<Room*> pendingRoom { nullptr };
+        std::atomic<Room*> retiredRoom { nullptr };
+        juce::AudioBuffer<SampleType> buffer;
+        // Allocated by the buffer, which keeps its largest size
+        size_t bufferBytes { 0u };
+
+        // Duration of the crossfade between the full and the reduced order, and between the rooms of two programs
+        static constexpr double orderFadeSeconds { 0.5 };
+        static constexpr double programFadeSeconds { 0.25 };
+
+        // Half-order FDN of the reducedOrder tier, crossfaded with the full one
+        uint32_t reducedOrder;
+        DSP::Matrix<SampleType> reducedInputCoupling;
+        DSP::FDN<SampleType> reducedFdn;
+        DSP::Matrix<SampleType> reducedOutputCoupling;
+
+        // Reduced internal rate
+        uint32_t rateFactor { 1u };
+        // Configuration of the last prepare, for the rooms built later
+        double internalRate { 48000.0 };
+        int internalBlockSize { 0 };
+        int numPreparedInputChannels { 0 };
+        int numPreparedOutputChannels { 0 };
+        DSP::TuningDecision preparedTuning;
+        DSP::PolyphaseDecimator<SampleType> decimator;
+        DSP::PolyphaseInterpolator<SampleType> interpolator;
+
+        QualityTier qualityTier { QualityTier::full };
+        bool fullActive { true };
+        bool reducedActive { false };
+        // 0: full order only, 1: reduced order only; moves by orderFadeStep per sample towards its target
+        float orderFade { 0.0f };
+        float orderFadeTarget { 0.0f };
+        float orderFadeStep { 0.0f };
+        // 0: fading room only, 1: room only; moves by programFadeStep per sample while there is a fading room
+        float programFade { 1.0f };
+        float programFadeStep { 0.0f };
+
+        // Per-sample frames, allocated in the constructor
+        std::vector<SampleType> inputFrame;
+        std::vector<SampleType> inBetweenFrame;
+        std::vector<SampleType> outputFrame;
+        std::vector<SampleType> reducedInBetweenFrame;
+        std::vector<SampleType> reducedOutputFrame;
+        std::vector<SampleType> hostInputFrame;
+        std::vector<SampleType> hostOutputFrame;
+        std::vector<SampleType> fadingInBetweenFrame;
+        std::vector<SampleType> fadingOutputFrame;
+    };
+
+    // Identifier and version of the state layout: parameters followed by the topology snapshot
+    static constexpr int stateMagic { 0x54564644 };  // "TVFD"
+    static constexpr int stateVersion { 3 };  // 2: quality tier after the topology, 3: program after the tier
+
+    // Grows the delay memory for the room size, off the audio thread, and applies a change of the internal rate
+    void timerCallback() override;
+
+    // Touch the memory of the prepared chain, so that the first block takes no page fault, and lock it
+    // when built with LOCK_AUDIO_MEMORY. Message thread
+    void lockAudioMemory();
+
+    // Measure the heap memory of the chains and log it. Not while processing
+    void measureMemory();
+
+    // Normalized value of a parameter, before the callbacks have run
+    float getParameterValue(const juce::String& parameterId) const;
+    // Set a parameter to a value in its range, notifying the host. Message thread
+    void setParameterValue(const juce::String& parameterId, float newValue);
+
+    // Log the blocks that overran their budget since the last call. Audio thread
+    void logOverruns(uint32_t numSamples);
+
+    // Choose the quality tier of the next block from the load. Audio thread
+    void updateQuality(uint32_t numSamples);
+
+    // Push the input block and the parameters changed since the last one to the capture. Audio thread
+    template <typename SampleType>
+    void captureBlock(const juce::AudioBuffer<SampleType>& buffer);
+
+    // Shared implementation of the float and double processBlock: host blocks larger than the prepared
+    // block size are processed in parts that fit the prepared buffers
+    template <typename SampleType>
+    void processChain(juce::AudioBuffer<SampleType>& buffer, FDNChain<SampleType>& chain);
+    // One part, of at most the prepared block size
+    template <typename SampleType>
+    void processChainPart(juce::AudioBuffer<SampleType>& buffer, FDNChain<SampleType>& chain);
+
     double sampleRate { 48000.0 };
+    int preparedBlockSize { 0 };
+
+    // Reduced internal rate requested by the parameter, and the one the chains were prepared with
+    std::atomic<bool> reducedRate { Param::Ranges::ReducedRateDefault };
+    bool preparedReducedRate { Param::Ranges::ReducedRateDefault };
     
     mrta::ParameterManager parameterManager;
 
+    utils::LoadMeter loadMeter;
+    uint64_t loggedOverruns { 0u };
+
+    utils::QualityGovernor qualityGovernor { static_cast<uint32_t>(QualityTier::numTiers) };
+
+    // Diagnostics, written to the JUCE log off the audio thread. The audio thread owns its channel; the message
+    // thread, the timer and the host threads calling prepareToPlay share the other one (logShared)
+    static constexpr uint32_t audioLogChannel { 0u };
+    static constexpr uint32_t messageLogChannel { 1u };
+    utils::RealtimeLogger logger;
+
+    utils::SessionCapture capture;
+    // Normalized parameter values last captured, and the events of a block, allocated in the constructor
+    std::vector<float> capturedValues;
+    std::vector<utils::ParameterEvent> captureEvents;
+    std::atomic<bool> captureAllParameters { false };
+
     DSP::Ramp enableRamp;
     float enabled { 1.f };
 
     DSP::Ramp mixRamp;
     float mix;
 
+    // Per-sample gains of the ramps, allocated in the constructor for MaxBlockSize
+    std::vector<float> enableGain;
+    std::vector<float> mixGain;
+
     uint32_t fdnOrder;
-    juce::AudioBuffer<float> fdnBuffer;
-    DSP::Matrix fdnInputCoupling;
-    DSP::FDN fdn;
-    DSP::Matrix fdnOutputCoupling;
+    // Only the chain matching the host's processing precision is prepared and processed
+    FDNChain<float> floatChain;
+    FDNChain<double> doubleChain;
 
     float revT60;
     float revBrightness;
+    float revModRate { Param::Ranges::ModRateDefault };
+    float revModDepth { Param::Ranges::ModDepthDefault };
+
+    // Factory programs, computed and mapped by the loader thread. The bank is read by the message thread once ready
+    DSP::PresetBank presetBank;
+    std::atomic<bool> presetBankReady { false };
+    std::thread presetBankLoader;
+    // Program and topology of the chains, as last set by the message thread, for the state. Both are guarded by
+    // programMutex: the host may save the state from another thread. Never taken by the audio thread
+    std::mutex programMutex;
+    int currentProgram { 0 };
+    DSP::PresetTopology topology;
+
+    // Memory of the prepared chain, kept resident until the next prepare or release
+    utils::MemoryLock memoryLock;
+    // Heap memory of both chains, measured while not processing, for getMemoryFootprint
+    std::atomic<size_t> chainsOwnedBytes { 0u };
+    std::atomic<size_t> chainsSharedBytes { 0u };
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FDNPluginAudioProcessor)
 };
\ No newline at end of file
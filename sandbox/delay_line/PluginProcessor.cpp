@@ -15,10 +15,12 @@ DelayLineAudioProcessor::DelayLineAudioProcessor() :
     delayLine {maxDelay, defaultDelay}
 {
     parameters.addParameterListener("delayValue", this);
+    startTimerHz(20);
 }
 
 DelayLineAudioProcessor::~DelayLineAudioProcessor()
 {
+    stopTimer();
 }
 
 //==============================================================================
@@ -48,10 +50,7 @@ void DelayLineAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, ju
 
         const int numSamples = buffer.getNumSamples();
         
-        for (uint32_t n = 0; n < static_cast<uint32_t>(numSamples); n++)
-        {
-            delayLine.processSample(&channelData[n], &channelData[n]);
-        }
+        delayLine.processBlock(channelData, channelData, static_cast<uint32_t>(numSamples));
     }
 }
 
@@ -94,6 +93,11 @@ void DelayLineAudioProcessor::setStateInformation (const void* data, int sizeInB
     // whose contents will have been created by the getStateInformation() call.
 }
 
+void DelayLineAudioProcessor::timerCallback()
+{
+    delayLine.commitPages();
+}
+
 //==============================================================================
 bool DelayLineAudioProcessor::hasEditor() const {return true;}
 juce::AudioProcessorEditor* DelayLineAudioProcessor::createEditor() {return new DelayLineAudioProcessorEditor (*this);}
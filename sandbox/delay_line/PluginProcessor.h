@@ -10,13 +10,14 @@
 
 #include <JuceHeader.h>
 
-#include <DelayLine.h>
+#include <PagedDelayLine.h>
 
 //==============================================================================
 /**
 */
 class DelayLineAudioProcessor : public juce::AudioProcessor,
- 								                public juce::AudioProcessorValueTreeState::Listener
+ 								                public juce::AudioProcessorValueTreeState::Listener,
+                                private juce::Timer
 {
 public:
     //==============================================================================
@@ -62,8 +63,11 @@ private:
 
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
 	  void parameterChanged(const juce::String& paramID, float newValue) override;
+	  // Commits the delay pages ahead of the delay parameter
+	  void timerCallback() override;
 
-	  primitives::DelayLine delayLine;
+	  // Memory follows the delay in use, up to maxDelay
+	  primitives::PagedDelayLine<float> delayLine;
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DelayLineAudioProcessor)
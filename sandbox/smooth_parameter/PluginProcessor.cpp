@@ -13,7 +13,8 @@
 
 //==============================================================================
 SmoothParameterAudioProcessor::SmoothParameterAudioProcessor() :
-    parameters(*this, nullptr, "PARAMS", createParameterLayout())
+    parameters(*this, nullptr, "PARAMS", createParameterLayout()),
+    logger([](const std::string& line) { std::cout << line << std::endl; }, 2u)
 {
     parameter.setSmoothingTime(defaultSmoothingTime);
     parameter.setTarget(defaultParameterValue);
@@ -135,11 +136,8 @@ void SmoothParameterAudioProcessor::processBlock (juce::AudioBuffer<float>& buff
             bool isSmoothing = parameter.needsSmoothing();
             if (isSmoothing && !wasSmoothing)
             {
-                std::cout << "Smoothing started at sample "
-                        << sampleCounter
-                        << " with value "
-                        << parameter.getCurrentValue()
-                        << std::endl;
+                logger.getChannel(audioLogChannel).log("Smoothing started at sample {} with value {}",
+                                                       sampleCounter, parameter.getCurrentValue());
                 previousSampleCount = sampleCounter;
             }
 
@@ -149,14 +147,9 @@ void SmoothParameterAudioProcessor::processBlock (juce::AudioBuffer<float>& buff
 
             if (!isSmoothing && wasSmoothing)
             {
-                std::cout << "Smoothing stopped at sample "
-                        << sampleCounter
-                        << " with value "
-                        << parameter.getCurrentValue()
-                        << std::endl;
-                std::cout << "It took "
-                        << sampleCounter - previousSampleCount
-                        << std::endl;
+                logger.getChannel(audioLogChannel).log("Smoothing stopped at sample {} with value {}",
+                                                       sampleCounter, parameter.getCurrentValue());
+                logger.getChannel(audioLogChannel).log("It took {}", sampleCounter - previousSampleCount);
             }
 
             wasSmoothing = isSmoothing;
@@ -192,17 +185,17 @@ void SmoothParameterAudioProcessor::parameterChanged(const juce::String& paramID
 {   
     if (paramID == "parameterValue")
     {
-        std::cout << "Target stored in APVTS: " << *parameters.getRawParameterValue("parameterValue") << std::endl;
-        std::cout << "Target before callback: " << parameter.getTarget() << std::endl;
+        logger.getChannel(parameterLogChannel).logShared("Target stored in APVTS: {}", parameters.getRawParameterValue("parameterValue")->load());
+        logger.getChannel(parameterLogChannel).logShared("Target before callback: {}", parameter.getTarget());
         parameter.setTarget(newValue, false);
-        std::cout << "Target after callback: " << parameter.getTarget() << std::endl;
+        logger.getChannel(parameterLogChannel).logShared("Target after callback: {}", parameter.getTarget());
     }
     else if (paramID == "smoothingTime")
     {
-        std::cout << "Smoothing time stored in APVTS: " << *parameters.getRawParameterValue("smoothingTime") << std::endl;
-        std::cout << "Smoothing time before callback: " << parameter.getSmoothingTime() << std::endl;
+        logger.getChannel(parameterLogChannel).logShared("Smoothing time stored in APVTS: {}", parameters.getRawParameterValue("smoothingTime")->load());
+        logger.getChannel(parameterLogChannel).logShared("Smoothing time before callback: {}", parameter.getSmoothingTime());
         parameter.setSmoothingTime(newValue);
-        std::cout << "Smoothing time after callback: " << parameter.getSmoothingTime() << std::endl;
+        logger.getChannel(parameterLogChannel).logShared("Smoothing time after callback: {}", parameter.getSmoothingTime());
     }
 }
 
@@ -12,6 +12,7 @@
 #include <juce_audio_processors/juce_audio_processors.h>
 
 #include "SmoothParameter.h"
+#include "RealtimeLogger.h"
 
 //==============================================================================
 /**
@@ -69,6 +70,13 @@ private:
 	  static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
 	  void parameterChanged(const juce::String& paramID, float newValue) override;
 
+    // The audio thread owns its log channel. Parameter callbacks come from any thread, the audio thread included:
+    // they share the other one, without waiting (logShared)
+    static constexpr uint32_t audioLogChannel { 0u };
+    static constexpr uint32_t parameterLogChannel { 1u };
+
+    utils::RealtimeLogger logger;
+
     utils::SmoothParameter parameter;
 
 	  bool isSmoothing = false;
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+
+namespace difftest
+{
+
+// Distance in units in the last place between two finite values of the same type
+template <typename SampleType>
+uint64_t ulpDistance(SampleType a, SampleType b)
+{
+    static_assert(std::is_floating_point_v<SampleType>, "ULP distance requires a floating-point type");
+    using Bits = std::conditional_t<sizeof(SampleType) == 4, uint32_t, uint64_t>;
+    constexpr Bits signBit { Bits { 1 } << (sizeof(Bits) * 8u - 1u) };
+
+    if (a == b)
+        return 0u;
+    if (std::isnan(a) || std::isnan(b))
+        return std::numeric_limits<uint64_t>::max();
+
+    // Map the sign-magnitude bit patterns onto a monotonic unsigned line
+    Bits ua;
+    Bits ub;
+    std::memcpy(&ua, &a, sizeof(a));
+    std::memcpy(&ub, &b, sizeof(b));
+    ua = (ua & signBit) ? ~ua : (ua | signBit);
+    ub = (ub & signBit) ? ~ub : (ub | signBit);
+
+    return static_cast<uint64_t>(ua > ub ? ua - ub : ub - ua);
+}
+
+// What a variant is held to against its reference
+struct Tolerance
+{
+    // Every sample must be identical
+    bool bitExact { false };
+    // Largest allowed distance of any sample
+    uint64_t maxUlp { std::numeric_limits<uint64_t>::max() };
+    // Largest allowed error energy relative to the reference energy
+    double maxErrorDb { 0.0 };
+
+    static Tolerance exact() { return { true, 0u, -std::numeric_limits<double>::infinity() }; }
+    static Tolerance db(double maxErrorDb) { return { false, std::numeric_limits<uint64_t>::max(), maxErrorDb }; }
+};
+
+// Accumulates the differences between a reference and a variant, sample by sample
+class Comparison
+{
+public:
+    template <typename SampleType>
+    void add(SampleType referenceSample, SampleType variantSample)
+    {
+        if (referenceSample != variantSample)
+            ++mismatches;
+
+        maxUlp = std::max(maxUlp, ulpDistance(referenceSample, variantSample));
+        const double error { static_cast<double>(variantSample) - static_cast<double>(referenceSample) };
+        errorEnergy += error * error;
+        referenceEnergy += static_cast<double>(referenceSample) * static_cast<double>(referenceSample);
+        ++count;
+    }
+
+    // Error energy relative to the reference energy, in dB (-inf when identical)
+    double getErrorDb() const
+    {
+        if (errorEnergy == 0.0)
+            return -std::numeric_limits<double>::infinity();
+        if (referenceEnergy == 0.0)
+            return std::numeric_limits<double>::infinity();
+        return 10.0 * std::log10(errorEnergy / referenceEnergy);
+    }
+
+    bool passes(const Tolerance& tolerance) const
+    {
+        if (tolerance.bitExact)
+            return mismatches == 0u;
+        return maxUlp <= tolerance.maxUlp && getErrorDb() <= tolerance.maxErrorDb;
+    }
+
+    std::string describe() const
+    {
+        return std::to_string(count) + " samples, " + std::to_string(mismatches) + " differ, max "
+             + std::to_string(maxUlp) + " ulp, error " + std::to_string(getErrorDb()) + " dB";
+    }
+
+private:
+    uint64_t count { 0u };
+    uint64_t mismatches { 0u };
+    uint64_t maxUlp { 0u };
+    double errorEnergy { 0.0 };
+    double referenceEnergy { 0.0 };
+};
+
+}
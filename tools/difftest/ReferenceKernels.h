@@ -0,0 +1,331 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <JuceHeader.h>
+
+// Frozen scalar reference kernels. These are copies of the straightforward per-sample DSP
+// implementations, kept as they were so that optimized rewrites of the library (SIMD, block or
+// fixed-order variants) can be compared against them. Do not optimize or otherwise change them:
+// when an algorithm changes on purpose, change its reference along with the tolerance it is held to.
+namespace reference
+{
+
+// Linear glide of utils::SmoothParameter
+class Glide
+{
+public:
+    explicit Glide(float initValue) :
+        currentValue { initValue },
+        targetValue { initValue }
+    {}
+
+    void setSmoothingTime(uint32_t newTimeInSamples) { smoothingSamples = newTimeInSamples; }
+
+    void setTarget(float newTargetValue, bool skipSmoothing = false)
+    {
+        if (std::abs(newTargetValue - currentValue) > minDelta)
+        {
+            targetValue = newTargetValue;
+            smoothingStep = (targetValue - currentValue) / static_cast<float>(smoothingSamples);
+        }
+
+        if (skipSmoothing)
+            currentValue = targetValue = newTargetValue;
+    }
+
+    float getTarget() const { return targetValue; }
+    float getCurrentValue() const { return currentValue; }
+
+    float getSample()
+    {
+        const float targetDelta { std::fabs(targetValue - currentValue) };
+        if ((targetDelta > std::fabs(2.f * smoothingStep)) && (std::fabs(smoothingStep) > minDelta))
+            currentValue += smoothingStep;
+        else
+            currentValue = targetValue;
+        return currentValue;
+    }
+
+private:
+    static constexpr float minDelta { 1e-9f };
+
+    float currentValue;
+    float targetValue;
+    uint32_t smoothingSamples { 48u };
+    float smoothingStep { 0.0f };
+};
+
+//================================================
+
+// Ring-buffer delay with linear fractional read, glide and crossfaded delay jumps
+template <typename SampleType>
+class DelayLine
+{
+public:
+    DelayLine(uint32_t maxDelaySamples, uint32_t initDelaySamples) :
+        delayValue { static_cast<float>(initDelaySamples) },
+        fadeOutDelay { static_cast<float>(initDelaySamples) },
+        bufferSize { static_cast<size_t>(maxDelaySamples) + 1u },
+        buffer(bufferSize, SampleType { 0 })
+    {
+        delayValue.setSmoothingTime(1200u);
+        delayValue.setTarget(static_cast<float>(initDelaySamples), true);
+    }
+
+    void setDelay(uint32_t newDelaySamples)
+    {
+        delayValue.setTarget(static_cast<float>(newDelaySamples), false);
+    }
+
+    // A new delay during a crossfade waits for it to end
+    void crossfadeToDelay(uint32_t newDelaySamples)
+    {
+        const float newDelay { static_cast<float>(newDelaySamples) };
+        if (crossfadeRemaining > 0u)
+        {
+            pendingDelay = newDelay == delayValue.getTarget() ? 0u : newDelaySamples;
+            return;
+        }
+        if (newDelay == delayValue.getTarget())
+            return;
+
+        startCrossfade(newDelay);
+    }
+
+    SampleType processSample(SampleType input, float modInput = 0.0f)
+    {
+        const float delay { delayValue.getSample() + modInput };
+
+        buffer[writeIndex] = input;
+        SampleType output { read(delay) };
+
+        if (crossfadeRemaining > 0u)
+        {
+            const SampleType fadeOutGain { static_cast<SampleType>(crossfadeRemaining) / static_cast<SampleType>(crossfadeSamples) };
+            const SampleType fadeOutSample { read(fadeOutDelay + modInput) };
+            output += fadeOutGain * (fadeOutSample - output);
+            --crossfadeRemaining;
+
+            if (crossfadeRemaining == 0u && pendingDelay > 0u)
+            {
+                startCrossfade(static_cast<float>(pendingDelay));
+                pendingDelay = 0u;
+            }
+        }
+
+        writeIndex = (writeIndex + 1u) % bufferSize;
+        return output;
+    }
+
+private:
+    void startCrossfade(float newDelay)
+    {
+        fadeOutDelay = delayValue.getCurrentValue();
+        delayValue.setTarget(newDelay, true);
+        crossfadeRemaining = crossfadeSamples;
+    }
+
+    SampleType read(float delay) const
+    {
+        const float delayCeil { std::ceil(delay) };
+        const SampleType frac1 { static_cast<SampleType>(delayCeil - delay) };
+        const SampleType frac0 { SampleType { 1 } - frac1 };
+
+        const size_t index0 { (writeIndex + bufferSize - static_cast<size_t>(delayCeil)) % bufferSize };
+        const size_t index1 { (index0 + 1u) % bufferSize };
+        return buffer[index0] * frac0 + buffer[index1] * frac1;
+    }
+
+    Glide delayValue;
+    float fadeOutDelay;
+    uint32_t crossfadeSamples { 1024u };
+    uint32_t crossfadeRemaining { 0u };
+    uint32_t pendingDelay { 0u };
+    size_t bufferSize;
+    std::vector<SampleType> buffer;
+    size_t writeIndex { 0u };
+};
+
+//================================================
+
+// One-pole absorption filter set by its magnitudes at DC and Nyquist, with coefficients ramped linearly
+// over 480 samples in the sample type
+template <typename SampleType>
+class OnePoleFilter
+{
+public:
+    OnePoleFilter(SampleType magDC, SampleType magNY)
+    {
+        const auto [b0, a1] = coefficients(magDC, magNY);
+        b0Ramp.current = b0Ramp.target = b0;
+        a1Ramp.current = a1Ramp.target = a1;
+    }
+
+    void prepare(double, int) {}
+
+    void setMagValues(SampleType magDC, SampleType magNY)
+    {
+        const auto [b0, a1] = coefficients(magDC, magNY);
+        b0Ramp.start(b0);
+        a1Ramp.start(a1);
+    }
+
+    SampleType processSample(SampleType input)
+    {
+        const SampleType b0 { b0Ramp.next() };
+        const SampleType a1 { a1Ramp.next() };
+
+        state = (b0 * input) - (a1 * state);
+        return state;
+    }
+
+private:
+    struct Ramp
+    {
+        void start(SampleType newTarget)
+        {
+            target = newTarget;
+            step = (target - current) / SampleType { 480 };
+            remaining = 480u;
+        }
+
+        SampleType next()
+        {
+            if (remaining > 0u)
+            {
+                --remaining;
+                current = remaining == 0u ? target : current + step;
+            }
+            return current;
+        }
+
+        SampleType current { 0 };
+        SampleType target { 0 };
+        SampleType step { 0 };
+        uint32_t remaining { 0u };
+    };
+
+    static std::pair<SampleType, SampleType> coefficients(SampleType magDC, SampleType magNY)
+    {
+        const SampleType r { magDC / magNY };
+        const SampleType a1 { (SampleType { 1 } - r) / (SampleType { 1 } + r) };
+        const SampleType b0 { (SampleType { 1 } - a1) * magNY };
+        return { b0, a1 };
+    }
+
+    Ramp b0Ramp;
+    Ramp a1Ramp;
+    SampleType state { 0 };
+};
+
+//================================================
+
+// Dense matrix-vector product, row by row, summed in column order.
+// Coefficients are column-major, as in DSP::MatrixSnapshot
+template <typename SampleType>
+class Matrix
+{
+public:
+    Matrix(int initDim1, int initDim2, const std::vector<double>& columnMajorCoefficients) :
+        dim1 { initDim1 },
+        dim2 { initDim2 },
+        coefficients(columnMajorCoefficients.size())
+    {
+        std::transform(columnMajorCoefficients.begin(), columnMajorCoefficients.end(), coefficients.begin(),
+                       [](double c) { return static_cast<SampleType>(c); });
+    }
+
+    void process(SampleType* output, const SampleType* input) const
+    {
+        for (int i = 0; i < dim1; ++i)
+        {
+            SampleType sum { 0 };
+            for (int j = 0; j < dim2; ++j)
+                sum += coefficients[static_cast<size_t>(j) * static_cast<size_t>(dim1) + static_cast<size_t>(i)] * input[j];
+            output[i] = sum;
+        }
+    }
+
+private:
+    int dim1;
+    int dim2;
+    std::vector<SampleType> coefficients;
+};
+
+//================================================
+
+// Absorption magnitudes at DC and Nyquist of a delay line, for the T60 at DC and brightness
+template <typename SampleType>
+std::pair<SampleType, SampleType> absorptionMagnitudes(size_t delayLength, SampleType T60DC, SampleType brightness, double sampleRate)
+{
+    const SampleType length { static_cast<SampleType>(delayLength) };
+    const SampleType rate { static_cast<SampleType>(sampleRate) };
+    const SampleType magDCdB { length * (SampleType { -60 } / (T60DC * rate)) };
+    const SampleType magNYdB { length * (SampleType { -60 } / (T60DC * brightness * rate)) };
+    return { std::pow(SampleType { 10 }, magDCdB / SampleType { 20 }),
+             std::pow(SampleType { 10 }, magNYdB / SampleType { 20 }) };
+}
+
+// Static FDN: feedback state plus input -> delays -> absorption -> output, and through the matrix back to the state
+template <typename SampleType>
+class FDN
+{
+public:
+    FDN(const std::vector<size_t>& initDelayLengths, const Matrix<SampleType>& initFeedbackMatrix,
+        SampleType initT60DC, SampleType initBrightness, double initSampleRate) :
+        delayLengths { initDelayLengths },
+        feedbackMatrix { initFeedbackMatrix },
+        sampleRate { initSampleRate },
+        order { initDelayLengths.size() },
+        feedbackState(order, SampleType { 0 }),
+        delayed(order, SampleType { 0 })
+    {
+        for (size_t i = 0; i < order; ++i)
+        {
+            delayLines.emplace_back(static_cast<uint32_t>(delayLengths[i] + 100u), static_cast<uint32_t>(delayLengths[i]));
+            const auto [magDC, magNY] = absorptionMagnitudes(delayLengths[i], initT60DC, initBrightness, sampleRate);
+            filters.emplace_back(magDC, magNY);
+        }
+    }
+
+    void prepare(int samplesPerBlock)
+    {
+        for (auto& filter : filters)
+            filter.prepare(sampleRate, samplesPerBlock);
+    }
+
+    void setDecay(SampleType T60DC, SampleType brightness)
+    {
+        for (size_t i = 0; i < order; ++i)
+        {
+            const auto [magDC, magNY] = absorptionMagnitudes(delayLengths[i], T60DC, brightness, sampleRate);
+            filters[i].setMagValues(magDC, magNY);
+        }
+    }
+
+    void process(SampleType* output, const SampleType* input)
+    {
+        for (size_t i = 0; i < order; ++i)
+            delayed[i] = filters[i].processSample(delayLines[i].processSample(feedbackState[i] + input[i]));
+
+        std::copy(delayed.begin(), delayed.end(), output);
+        feedbackMatrix.process(feedbackState.data(), delayed.data());
+    }
+
+private:
+    std::vector<size_t> delayLengths;
+    Matrix<SampleType> feedbackMatrix;
+    double sampleRate;
+    size_t order;
+    std::vector<DelayLine<SampleType>> delayLines;
+    std::vector<OnePoleFilter<SampleType>> filters;
+    std::vector<SampleType> feedbackState;
+    std::vector<SampleType> delayed;
+};
+
+}
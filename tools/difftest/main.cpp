@@ -0,0 +1,1060 @@
+// Differential tests: the DSP library against the frozen scalar reference kernels.
+// Each variant runs on random inputs, random block sizes and random parameter trajectories,
+// and must match its reference bit for bit where the algorithm is unchanged, or within
+// a ULP / dB tolerance where the arithmetic is allowed to differ (summation order, SIMD).
+// The suite runs once with the kernels of each instruction set the machine supports, or of the given one.
+// The preset bank file, which does not depend on the kernels, is checked once.
+//
+// Usage: dsp_difftest [--trials <n>] [--seed <n>] [--instruction-set <generic|sse2|avx2|avx512>]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <JuceHeader.h>
+
+#include "Comparison.h"
+#include "ReferenceKernels.h"
+
+#include "DelayLine.h"
+#include "FDN.h"
+#include "FDNAnalysis.h"
+#include "KernelDispatch.h"
+#include "Matrix.h"
+#include "MultichannelAbsorption.h"
+#include "MultichannelDelay.h"
+#include "OnePoleFilter.h"
+#include "PagedDelayLine.h"
+#include "PolyphaseResampler.h"
+#include "PresetBank.h"
+#include "SubbandFDN.h"
+
+namespace
+{
+
+constexpr double sampleRate { 48000.0 };
+constexpr uint32_t maxBlockSize { 512u };
+constexpr uint32_t samplesPerTrial { 1u << 14 };
+
+struct Options
+{
+    uint32_t trials { 4u };
+    uint32_t seed { 1u };
+    // Only the kernels of this instruction set, instead of all the supported ones
+    bool singleInstructionSet { false };
+    DSP::InstructionSet instructionSet { DSP::InstructionSet::generic };
+};
+
+// Collects the verdicts and prints one line per check
+class Report
+{
+public:
+    void check(const std::string& name, const difftest::Comparison& comparison, const difftest::Tolerance& tolerance)
+    {
+        const bool passed { comparison.passes(tolerance) };
+        if (! passed)
+            ++failures;
+        ++checks;
+        std::printf("%s  %-52s %s\n", passed ? "PASS" : "FAIL", name.c_str(), comparison.describe().c_str());
+    }
+
+    int getFailures() const { return failures; }
+    int getChecks() const { return checks; }
+
+private:
+    int failures { 0 };
+    int checks { 0 };
+};
+
+template <typename SampleType>
+const char* typeName()
+{
+    return std::is_same_v<SampleType, float> ? "float" : "double";
+}
+
+template <typename SampleType>
+SampleType randomSample(std::mt19937& generator)
+{
+    return std::uniform_real_distribution<SampleType> { SampleType { -1 }, SampleType { 1 } } (generator);
+}
+
+uint32_t randomBlockSize(std::mt19937& generator)
+{
+    return std::uniform_int_distribution<uint32_t> { 1u, maxBlockSize } (generator);
+}
+
+// True with the given probability
+bool chance(std::mt19937& generator, double probability)
+{
+    return std::bernoulli_distribution { probability } (generator);
+}
+
+//================================================
+
+// Block processing, glides, crossfaded jumps and modulation: unchanged algorithm, bit-exact
+template <typename SampleType>
+void testDelayLine(Report& report, const Options& options)
+{
+    difftest::Comparison comparison;
+
+    for (uint32_t trial = 0; trial < options.trials; ++trial)
+    {
+        std::mt19937 generator { options.seed + trial };
+        const uint32_t maxDelay { std::uniform_int_distribution<uint32_t> { 64u, 4800u } (generator) };
+        auto randomDelay = [&] { return std::uniform_int_distribution<uint32_t> { 2u, maxDelay - 2u } (generator); };
+        const uint32_t initDelay { randomDelay() };
+
+        primitives::DelayLine<SampleType> variant { maxDelay, initDelay };
+        reference::DelayLine<SampleType> expected { maxDelay, initDelay };
+        variant.prepare();
+
+        std::vector<SampleType> input(maxBlockSize);
+        std::vector<SampleType> output(maxBlockSize);
+        std::vector<float> modulation(maxBlockSize);
+
+        for (uint32_t processed = 0; processed < samplesPerTrial;)
+        {
+            const uint32_t blockSize { randomBlockSize(generator) };
+
+            if (chance(generator, 0.1))
+            {
+                const uint32_t delay { randomDelay() };
+                variant.setDelay(delay);
+                expected.setDelay(delay);
+            }
+            else if (chance(generator, 0.1))
+            {
+                const uint32_t delay { randomDelay() };
+                variant.crossfadeToDelay(delay);
+                expected.crossfadeToDelay(delay);
+            }
+
+            const bool modulated { chance(generator, 0.3) };
+            for (uint32_t n = 0; n < blockSize; ++n)
+            {
+                input[n] = randomSample<SampleType>(generator);
+                modulation[n] = modulated ? std::uniform_real_distribution<float> { -1.0f, 1.0f } (generator) : 0.0f;
+            }
+
+            variant.processBlock(output.data(), input.data(), blockSize, modulated ? modulation.data() : nullptr);
+            for (uint32_t n = 0; n < blockSize; ++n)
+                comparison.add(expected.processSample(input[n], modulation[n]), output[n]);
+
+            processed += blockSize;
+        }
+    }
+
+    report.check(std::string { "DelayLine<" } + typeName<SampleType>() + "> block vs scalar", comparison, difftest::Tolerance::exact());
+}
+
+// Reduced-precision delay storage: the block runs convert like the per-sample path (bit-exact), and the
+// output stays within the rounding noise of the format of the float32 reference
+template <typename SampleType>
+void testDelayStorage(Report& report, const Options& options, primitives::DelayStorage storage, const char* storageName, double maxErrorDb)
+{
+    difftest::Comparison blockComparison;
+    difftest::Comparison referenceComparison;
+
+    for (uint32_t trial = 0; trial < options.trials; ++trial)
+    {
+        std::mt19937 generator { options.seed + trial };
+        const uint32_t maxDelay { std::uniform_int_distribution<uint32_t> { 64u, 4800u } (generator) };
+        auto randomDelay = [&] { return std::uniform_int_distribution<uint32_t> { 2u, maxDelay - 2u } (generator); };
+        const uint32_t initDelay { randomDelay() };
+
+        primitives::DelayLine<SampleType> variant { maxDelay, initDelay, storage };
+        primitives::DelayLine<SampleType> scalar { maxDelay, initDelay, storage };
+        reference::DelayLine<SampleType> expected { maxDelay, initDelay };
+        variant.prepare();
+        scalar.prepare();
+
+        std::vector<SampleType> input(maxBlockSize);
+        std::vector<SampleType> output(maxBlockSize);
+
+        for (uint32_t processed = 0; processed < samplesPerTrial;)
+        {
+            const uint32_t blockSize { randomBlockSize(generator) };
+
+            if (chance(generator, 0.1))
+            {
+                const uint32_t delay { randomDelay() };
+                variant.crossfadeToDelay(delay);
+                scalar.crossfadeToDelay(delay);
+                expected.crossfadeToDelay(delay);
+            }
+
+            for (uint32_t n = 0; n < blockSize; ++n)
+                input[n] = randomSample<SampleType>(generator);
+
+            variant.processBlock(output.data(), input.data(), blockSize);
+            for (uint32_t n = 0; n < blockSize; ++n)
+            {
+                SampleType scalarOutput;
+                scalar.processSample(&scalarOutput, &input[n]);
+                blockComparison.add(scalarOutput, output[n]);
+                referenceComparison.add(expected.processSample(input[n]), output[n]);
+            }
+
+            processed += blockSize;
+        }
+    }
+
+    const std::string name { std::string { "DelayLine<" } + typeName<SampleType>() + "> " + storageName };
+    report.check(name + " block vs scalar", blockComparison, difftest::Tolerance::exact());
+    report.check(name + " vs float32", referenceComparison, difftest::Tolerance::db(maxErrorDb));
+}
+
+// History moved into a larger line a bounded part per block while the smaller one keeps processing, then
+// processed in its place: bit-exact against a copy of the smaller line taken at once when the move completes
+template <typename SampleType>
+void testDelayMigration(Report& report, const Options& options, primitives::DelayStorage storage, const char* storageName)
+{
+    difftest::Comparison comparison;
+
+    for (uint32_t trial = 0; trial < options.trials; ++trial)
+    {
+        std::mt19937 generator { options.seed + trial };
+        const uint32_t maxDelay { std::uniform_int_distribution<uint32_t> { 64u, 4800u } (generator) };
+        const uint32_t grownMaxDelay { maxDelay + std::uniform_int_distribution<uint32_t> { 0u, maxDelay } (generator) };
+        auto randomDelay = [&] { return std::uniform_int_distribution<uint32_t> { 2u, maxDelay - 2u } (generator); };
+        const uint32_t initDelay { randomDelay() };
+
+        primitives::DelayLine<SampleType> source { maxDelay, initDelay, storage };
+        primitives::DelayLine<SampleType> migrated { grownMaxDelay, initDelay, storage };
+        primitives::DelayLine<SampleType> copied { grownMaxDelay, initDelay, storage };
+        source.prepare();
+        migrated.prepare();
+        copied.prepare();
+
+        std::vector<SampleType> input(maxBlockSize);
+        std::vector<SampleType> output(maxBlockSize);
+        std::vector<SampleType> expected(maxBlockSize);
+        auto randomBlock = [&]
+        {
+            const uint32_t blockSize { randomBlockSize(generator) };
+            for (uint32_t n = 0; n < blockSize; ++n)
+                input[n] = randomSample<SampleType>(generator);
+            return blockSize;
+        };
+
+        // Fill the smaller line, then move it while it keeps processing, with jumps of its delay
+        for (uint32_t processed = 0; processed < 2u * maxDelay;)
+        {
+            const uint32_t blockSize { randomBlock() };
+            source.processBlock(output.data(), input.data(), blockSize);
+            processed += blockSize;
+        }
+        while (! migrated.migrateStateFrom(source, maxBlockSize))
+        {
+            if (chance(generator, 0.1))
+                source.crossfadeToDelay(randomDelay());
+            const uint32_t blockSize { randomBlock() };
+            source.processBlock(output.data(), input.data(), blockSize);
+        }
+        copied.copyStateFrom(source);
+
+        for (uint32_t processed = 0; processed < samplesPerTrial;)
+        {
+            if (chance(generator, 0.1))
+            {
+                const uint32_t delay { randomDelay() };
+                migrated.crossfadeToDelay(delay);
+                copied.crossfadeToDelay(delay);
+            }
+            const uint32_t blockSize { randomBlock() };
+            migrated.processBlock(output.data(), input.data(), blockSize);
+            copied.processBlock(expected.data(), input.data(), blockSize);
+            for (uint32_t n = 0; n < blockSize; ++n)
+                comparison.add(expected[n], output[n]);
+            processed += blockSize;
+        }
+    }
+
+    report.check(std::string { "DelayLine<" } + typeName<SampleType>() + "> " + storageName + " migrated vs copied", comparison, difftest::Tolerance::exact());
+}
+
+// Paged delay memory, with small pages so that runs, reads and page turns cross many boundaries.
+// Block processing matches sample processing while pages come and go; against the contiguous
+// reference, it is bit-exact as long as the delays stay within the pages committed up front
+template <typename SampleType>
+void testPagedDelayLine(Report& report, const Options& options)
+{
+    constexpr uint32_t pageSize { 256u };
+    difftest::Comparison blockComparison;
+    difftest::Comparison referenceComparison;
+
+    for (uint32_t trial = 0; trial < options.trials; ++trial)
+    {
+        std::mt19937 generator { options.seed + trial };
+        const uint32_t maxDelay { std::uniform_int_distribution<uint32_t> { 2u * pageSize, 4800u } (generator) };
+        auto randomDelay = [&] { return std::uniform_int_distribution<uint32_t> { 2u, maxDelay - 2u } (generator); };
+        // Within a page of the maximum: the initial pages hold them all, and none is given up
+        auto randomLongDelay = [&] { return std::uniform_int_distribution<uint32_t> { maxDelay - pageSize, maxDelay } (generator); };
+
+        const auto pool { std::make_shared<primitives::DelayPagePool<SampleType>>(pageSize) };
+        const uint32_t initDelay { randomDelay() };
+        primitives::PagedDelayLine<SampleType> variant { maxDelay, initDelay, pool };
+        primitives::PagedDelayLine<SampleType> scalar { maxDelay, initDelay, pool };
+        variant.prepare();
+        scalar.prepare();
+
+        primitives::PagedDelayLine<SampleType> committed { maxDelay, maxDelay, pool };
+        reference::DelayLine<SampleType> expected { maxDelay, maxDelay };
+        committed.prepare();
+
+        std::vector<SampleType> input(maxBlockSize);
+        std::vector<SampleType> output(maxBlockSize);
+        std::vector<SampleType> committedOutput(maxBlockSize);
+
+        for (uint32_t processed = 0; processed < samplesPerTrial;)
+        {
+            const uint32_t blockSize { randomBlockSize(generator) };
+
+            if (chance(generator, 0.1))
+            {
+                const uint32_t delay { randomDelay() };
+                variant.setDelay(delay);
+                scalar.setDelay(delay);
+            }
+            else if (chance(generator, 0.1))
+            {
+                const uint32_t delay { randomDelay() };
+                variant.crossfadeToDelay(delay);
+                scalar.crossfadeToDelay(delay);
+            }
+            if (chance(generator, 0.1))
+            {
+                const uint32_t delay { randomLongDelay() };
+                committed.crossfadeToDelay(delay);
+                expected.crossfadeToDelay(delay);
+            }
+            // The message thread commits pages now and then
+            if (chance(generator, 0.3))
+            {
+                variant.commitPages();
+                scalar.commitPages();
+                committed.commitPages();
+            }
+
+            for (uint32_t n = 0; n < blockSize; ++n)
+                input[n] = randomSample<SampleType>(generator);
+
+            variant.processBlock(output.data(), input.data(), blockSize);
+            committed.processBlock(committedOutput.data(), input.data(), blockSize);
+            for (uint32_t n = 0; n < blockSize; ++n)
+            {
+                SampleType scalarOutput;
+                scalar.processSample(&scalarOutput, &input[n]);
+                blockComparison.add(scalarOutput, output[n]);
+                referenceComparison.add(expected.processSample(input[n]), committedOutput[n]);
+            }
+
+            processed += blockSize;
+        }
+    }
+
+    report.check(std::string { "PagedDelayLine<" } + typeName<SampleType>() + "> block vs scalar", blockComparison, difftest::Tolerance::exact());
+    report.check(std::string { "PagedDelayLine<" } + typeName<SampleType>() + "> committed vs contiguous", referenceComparison, difftest::Tolerance::exact());
+}
+
+// Crossfades to longer delays while the message thread commits their pages, so that pages are linked mid-fade.
+// On a slow sine, no output step may exceed the sine's own plus the largest a crossfade adds
+template <typename SampleType>
+void testPagedDelayLineCrossfade(Report& report, const Options& options)
+{
+    constexpr uint32_t pageSize { 256u };
+    constexpr uint32_t crossfadeSamples { 1024u };
+    constexpr double phaseIncrement { 0.001 };
+    // Linear gain between two heads of a unit sine, plus margin for the interpolation rounding
+    const SampleType maxStep { static_cast<SampleType>(phaseIncrement + 2.0 / crossfadeSamples + 1e-4) };
+    difftest::Comparison comparison;
+
+    for (uint32_t trial = 0; trial < options.trials; ++trial)
+    {
+        std::mt19937 generator { options.seed + trial };
+
+        // Three pages up front, never given up: every delay read below holds the sine, none reads silent memory
+        const auto pool { std::make_shared<primitives::DelayPagePool<SampleType>>(pageSize) };
+        const uint32_t initDelay { std::uniform_int_distribution<uint32_t> { pageSize, 2u * pageSize - 1u } (generator) };
+        primitives::PagedDelayLine<SampleType> variant { 4800u, initDelay, pool };
+        variant.setCrossfadeTime(crossfadeSamples);
+        variant.prepare();
+        auto randomDelay = [&] { return std::uniform_int_distribution<uint32_t> { 2u, 3u * pageSize - 1u } (generator); };
+
+        std::vector<SampleType> input(maxBlockSize);
+        std::vector<SampleType> output(maxBlockSize);
+        double phase { 0.0 };
+        SampleType previous { 0 };
+
+        for (uint32_t processed = 0; processed < samplesPerTrial;)
+        {
+            const uint32_t blockSize { randomBlockSize(generator) };
+
+            if (chance(generator, 0.2))
+                variant.crossfadeToDelay(randomDelay());
+            if (chance(generator, 0.5))
+                variant.commitPages();
+
+            for (uint32_t n = 0; n < blockSize; ++n)
+            {
+                input[n] = static_cast<SampleType>(std::sin(phase));
+                phase += phaseIncrement;
+            }
+            variant.processBlock(output.data(), input.data(), blockSize);
+
+            for (uint32_t n = 0; n < blockSize; ++n)
+            {
+                // Once the longest delay holds the sine
+                const SampleType step { std::abs(output[n] - previous) };
+                previous = output[n];
+                if (processed + n >= 3u * pageSize)
+                    comparison.add(std::min(step, maxStep), step);
+            }
+
+            processed += blockSize;
+        }
+    }
+
+    report.check(std::string { "PagedDelayLine<" } + typeName<SampleType>() + "> steps, commits mid-crossfade", comparison, difftest::Tolerance::exact());
+}
+
+// Buffer processing with coefficient ramps, in parts when blocks exceed the prepared size: unchanged algorithm, bit-exact
+template <typename SampleType>
+void testOnePoleFilter(Report& report, const Options& options)
+{
+    difftest::Comparison comparison;
+
+    for (uint32_t trial = 0; trial < options.trials; ++trial)
+    {
+        std::mt19937 generator { options.seed + trial };
+        auto randomMagnitudes = [&]
+        {
+            const SampleType magDC { std::uniform_real_distribution<SampleType> { SampleType { 0.5 }, SampleType { 0.999 } } (generator) };
+            const SampleType magNY { magDC * std::uniform_real_distribution<SampleType> { SampleType { 0.2 }, SampleType { 1 } } (generator) };
+            return std::make_pair(magDC, magNY);
+        };
+        const auto initMagnitudes { randomMagnitudes() };
+
+        DSP::OnePoleFilter<SampleType> variant { initMagnitudes.first, initMagnitudes.second };
+        reference::OnePoleFilter<SampleType> expected { initMagnitudes.first, initMagnitudes.second };
+        variant.prepare(sampleRate, static_cast<int>(chance(generator, 0.5) ? maxBlockSize : randomBlockSize(generator)));
+        expected.prepare(sampleRate, static_cast<int>(maxBlockSize));
+
+        std::vector<SampleType> input(maxBlockSize);
+        std::vector<SampleType> output(maxBlockSize);
+
+        for (uint32_t processed = 0; processed < samplesPerTrial;)
+        {
+            const uint32_t blockSize { randomBlockSize(generator) };
+
+            if (chance(generator, 0.2))
+            {
+                const auto magnitudes { randomMagnitudes() };
+                variant.setMagValues(magnitudes.first, magnitudes.second);
+                expected.setMagValues(magnitudes.first, magnitudes.second);
+            }
+
+            for (uint32_t n = 0; n < blockSize; ++n)
+                input[n] = randomSample<SampleType>(generator);
+
+            variant.processBuffer(output.data(), input.data(), blockSize);
+            for (uint32_t n = 0; n < blockSize; ++n)
+                comparison.add(expected.processSample(input[n]), output[n]);
+
+            processed += blockSize;
+        }
+    }
+
+    report.check(std::string { "OnePoleFilter<" } + typeName<SampleType>() + "> buffer vs scalar", comparison, difftest::Tolerance::exact());
+}
+
+// Multichannel wrappers: unchanged algorithm, bit-exact per channel
+template <typename SampleType>
+void testMultichannel(Report& report, const Options& options, uint32_t order)
+{
+    difftest::Comparison delayComparison;
+    difftest::Comparison absorptionComparison;
+
+    for (uint32_t trial = 0; trial < options.trials; ++trial)
+    {
+        std::mt19937 generator { options.seed + trial };
+        auto randomLengths = [&]
+        {
+            std::vector<size_t> lengths(order);
+            for (auto& length : lengths)
+                length = std::uniform_int_distribution<size_t> { 100u, 2000u } (generator);
+            return lengths;
+        };
+        auto randomMagnitudes = [&]
+        {
+            std::vector<std::pair<SampleType, SampleType>> magnitudes(order);
+            for (auto& magnitude : magnitudes)
+            {
+                magnitude.first = std::uniform_real_distribution<SampleType> { SampleType { 0.5 }, SampleType { 0.999 } } (generator);
+                magnitude.second = magnitude.first * std::uniform_real_distribution<SampleType> { SampleType { 0.2 }, SampleType { 1 } } (generator);
+            }
+            return magnitudes;
+        };
+
+        const std::vector<size_t> maxLengths(order, 2100u);
+        const auto initLengths { randomLengths() };
+        const auto initMagnitudes { randomMagnitudes() };
+
+        DSP::MultichannelDelay<SampleType> delays { order, maxLengths, initLengths };
+        DSP::MultichannelAbsorption<SampleType> absorption { order, initMagnitudes };
+        delays.prepare(sampleRate, static_cast<int>(maxBlockSize));
+        absorption.prepare(sampleRate, static_cast<int>(maxBlockSize));
+
+        std::vector<reference::DelayLine<SampleType>> expectedDelays;
+        std::vector<reference::OnePoleFilter<SampleType>> expectedFilters;
+        for (uint32_t i = 0; i < order; ++i)
+        {
+            expectedDelays.emplace_back(static_cast<uint32_t>(maxLengths[i]), static_cast<uint32_t>(initLengths[i]));
+            expectedFilters.emplace_back(initMagnitudes[i].first, initMagnitudes[i].second);
+            expectedFilters.back().prepare(sampleRate, static_cast<int>(maxBlockSize));
+        }
+
+        std::vector<SampleType> input(order);
+        std::vector<SampleType> delayed(order);
+        std::vector<SampleType> absorbed(order);
+
+        for (uint32_t processed = 0; processed < samplesPerTrial;)
+        {
+            const uint32_t blockSize { randomBlockSize(generator) };
+
+            if (chance(generator, 0.1))
+            {
+                const auto lengths { randomLengths() };
+                delays.crossfadeDelayLinesLengths(lengths);
+                for (uint32_t i = 0; i < order; ++i)
+                    expectedDelays[i].crossfadeToDelay(static_cast<uint32_t>(lengths[i]));
+            }
+            if (chance(generator, 0.1))
+            {
+                const auto magnitudes { randomMagnitudes() };
+                absorption.setFiltersMagnitudeValues(magnitudes);
+                for (uint32_t i = 0; i < order; ++i)
+                    expectedFilters[i].setMagValues(magnitudes[i].first, magnitudes[i].second);
+            }
+
+            for (uint32_t n = 0; n < blockSize; ++n)
+            {
+                for (auto& sample : input)
+                    sample = randomSample<SampleType>(generator);
+
+                delays.processSample(delayed.data(), input.data(), order);
+                absorption.processSample(absorbed.data(), input.data(), order);
+                for (uint32_t i = 0; i < order; ++i)
+                {
+                    delayComparison.add(expectedDelays[i].processSample(input[i]), delayed[i]);
+                    absorptionComparison.add(expectedFilters[i].processSample(input[i]), absorbed[i]);
+                }
+            }
+
+            processed += blockSize;
+        }
+    }
+
+    const std::string suffix { std::string { "<" } + typeName<SampleType>() + "> order " + std::to_string(order) };
+    report.check("MultichannelDelay" + suffix, delayComparison, difftest::Tolerance::exact());
+    report.check("MultichannelAbsorption" + suffix, absorptionComparison, difftest::Tolerance::exact());
+}
+
+// Eigen product vs row-by-row sums: the summation order differs, so a tolerance applies
+template <typename SampleType>
+void testMatrix(Report& report, const Options& options, int dim1, int dim2)
+{
+    const double maxErrorDb { std::is_same_v<SampleType, float> ? -110.0 : -250.0 };
+    difftest::Comparison comparison;
+
+    for (uint32_t trial = 0; trial < options.trials; ++trial)
+    {
+        std::mt19937 generator { options.seed + trial };
+
+        DSP::Matrix<SampleType> variant { dim1, dim2, options.seed + trial };
+        const DSP::MatrixSnapshot snapshot { variant.getSnapshot() };
+        const reference::Matrix<SampleType> expected { dim1, dim2, snapshot.coefficients };
+
+        std::vector<SampleType> input(static_cast<size_t>(dim2));
+        std::vector<SampleType> output(static_cast<size_t>(dim1));
+        std::vector<SampleType> expectedOutput(static_cast<size_t>(dim1));
+
+        for (uint32_t n = 0; n < samplesPerTrial / 4u; ++n)
+        {
+            for (auto& sample : input)
+                sample = randomSample<SampleType>(generator);
+
+            variant.processSample(output.data(), input.data(), static_cast<uint32_t>(dim1), static_cast<uint32_t>(dim2));
+            expected.process(expectedOutput.data(), input.data());
+            for (int i = 0; i < dim1; ++i)
+                comparison.add(expectedOutput[static_cast<size_t>(i)], output[static_cast<size_t>(i)]);
+        }
+    }
+
+    report.check(std::string { "Matrix<" } + typeName<SampleType>() + "> " + std::to_string(dim1) + "x" + std::to_string(dim2),
+                 comparison, difftest::Tolerance::db(maxErrorDb));
+}
+
+// Time-varying matrix: no reference trajectory, but the product must stay energy preserving
+template <typename SampleType>
+void testMatrixRotations(Report& report, const Options& options, int order)
+{
+    const double maxErrorDb { std::is_same_v<SampleType, float> ? -100.0 : -240.0 };
+    difftest::Comparison comparison;
+
+    for (uint32_t trial = 0; trial < options.trials; ++trial)
+    {
+        std::mt19937 generator { options.seed + trial };
+
+        DSP::Matrix<SampleType> variant { order, order, options.seed + trial };
+        variant.prepareModulation(sampleRate);
+        variant.setModulation(5.0f, 0.7f);
+
+        std::vector<SampleType> input(static_cast<size_t>(order));
+        std::vector<SampleType> output(static_cast<size_t>(order));
+
+        for (uint32_t n = 0; n < samplesPerTrial; ++n)
+        {
+            SampleType inputEnergy { 0 };
+            for (auto& sample : input)
+            {
+                sample = randomSample<SampleType>(generator);
+                inputEnergy += sample * sample;
+            }
+
+            variant.processSample(output.data(), input.data(), static_cast<uint32_t>(order), static_cast<uint32_t>(order));
+
+            SampleType outputEnergy { 0 };
+            for (const auto sample : output)
+                outputEnergy += sample * sample;
+            comparison.add(std::sqrt(inputEnergy), std::sqrt(outputEnergy));
+        }
+    }
+
+    report.check(std::string { "Matrix<" } + typeName<SampleType>() + "> rotations, norm, order " + std::to_string(order),
+                 comparison, difftest::Tolerance::db(maxErrorDb));
+}
+
+// Whole FDN with T60 and brightness trajectories, against the reference built from the same topology.
+// An FDN restored from the snapshot of the topology must not differ from the generated one
+template <typename SampleType>
+void testFDN(Report& report, const Options& options, uint32_t order)
+{
+    const double maxErrorDb { std::is_same_v<SampleType, float> ? -90.0 : -230.0 };
+    difftest::Comparison comparison;
+    difftest::Comparison restoredComparison;
+
+    for (uint32_t trial = 0; trial < options.trials; ++trial)
+    {
+        std::mt19937 generator { options.seed + trial };
+        auto randomT60 = [&] { return std::uniform_real_distribution<SampleType> { SampleType { 0.2 }, SampleType { 8 } } (generator); };
+        auto randomBrightness = [&] { return std::uniform_real_distribution<SampleType> { SampleType { 0.1 }, SampleType { 1 } } (generator); };
+        const SampleType initT60 { randomT60() };
+        const SampleType initBrightness { randomBrightness() };
+
+        DSP::FDN<SampleType> variant { order, initT60, initBrightness, options.seed + trial };
+        variant.prepare(sampleRate, static_cast<int>(maxBlockSize));
+
+        const DSP::FDNSnapshot snapshot { variant.getSnapshot() };
+        DSP::FDN<SampleType> restored { snapshot, initT60, initBrightness };
+        restored.prepare(sampleRate, static_cast<int>(maxBlockSize));
+
+        const std::vector<size_t> delayLengths(snapshot.delayLengths.begin(), snapshot.delayLengths.end());
+        const reference::Matrix<SampleType> feedbackMatrix { snapshot.feedbackMatrix.dim1, snapshot.feedbackMatrix.dim2, snapshot.feedbackMatrix.coefficients };
+        reference::FDN<SampleType> expected { delayLengths, feedbackMatrix, initT60, initBrightness, sampleRate };
+        expected.prepare(static_cast<int>(maxBlockSize));
+
+        std::vector<SampleType> input(order);
+        std::vector<SampleType> output(order);
+        std::vector<SampleType> expectedOutput(order);
+        std::vector<SampleType> restoredOutput(order);
+
+        for (uint32_t processed = 0; processed < samplesPerTrial;)
+        {
+            const uint32_t blockSize { randomBlockSize(generator) };
+
+            if (chance(generator, 0.2))
+            {
+                const SampleType T60 { randomT60() };
+                const SampleType brightness { randomBrightness() };
+                variant.setT60(T60);
+                variant.setBrightness(brightness);
+                restored.setT60(T60);
+                restored.setBrightness(brightness);
+                expected.setDecay(T60, brightness);
+            }
+            variant.update();
+            restored.update();
+
+            // Sparse excitation, so that the tail between bursts is compared too
+            const bool excited { chance(generator, 0.3) };
+            for (uint32_t n = 0; n < blockSize; ++n)
+            {
+                for (auto& sample : input)
+                    sample = excited ? randomSample<SampleType>(generator) : SampleType { 0 };
+
+                variant.process(output.data(), input.data(), order);
+                restored.process(restoredOutput.data(), input.data(), order);
+                expected.process(expectedOutput.data(), input.data());
+                for (uint32_t i = 0; i < order; ++i)
+                {
+                    comparison.add(expectedOutput[i], output[i]);
+                    restoredComparison.add(output[i], restoredOutput[i]);
+                }
+            }
+
+            processed += blockSize;
+        }
+    }
+
+    report.check(std::string { "FDN<" } + typeName<SampleType>() + "> order " + std::to_string(order), comparison, difftest::Tolerance::db(maxErrorDb));
+    report.check(std::string { "FDN<" } + typeName<SampleType>() + "> restored from snapshot, order " + std::to_string(order), restoredComparison, difftest::Tolerance::exact());
+}
+
+// Impulse response computed from the topology by blocks, against the one FDN::process renders sample by sample.
+// Every line is fed and summed, as FDNAnalysis does without couplings
+template <typename SampleType>
+void testFDNAnalysis(Report& report, const Options& options, uint32_t order)
+{
+    const double maxErrorDb { std::is_same_v<SampleType, float> ? -90.0 : -230.0 };
+    difftest::Comparison comparison;
+
+    for (uint32_t trial = 0; trial < options.trials; ++trial)
+    {
+        std::mt19937 generator { options.seed + trial };
+        const double T60 { std::uniform_real_distribution<double> { 0.2, 8.0 } (generator) };
+        const double brightness { std::uniform_real_distribution<double> { 0.1, 1.0 } (generator) };
+
+        DSP::FDN<SampleType> fdn { order, static_cast<SampleType>(T60), static_cast<SampleType>(brightness), options.seed + trial };
+        fdn.prepare(sampleRate, static_cast<int>(maxBlockSize));
+        const DSP::FDNAnalysis analysis { fdn.getSnapshot(), static_cast<double>(static_cast<SampleType>(T60)),
+                                          static_cast<double>(static_cast<SampleType>(brightness)), sampleRate };
+        const Eigen::MatrixXd expected { analysis.computeImpulseResponse(samplesPerTrial) };
+
+        std::vector<SampleType> input(order, SampleType { 1 });
+        std::vector<SampleType> output(order);
+        for (uint32_t n = 0; n < samplesPerTrial; ++n)
+        {
+            fdn.process(output.data(), input.data(), order);
+            std::fill(input.begin(), input.end(), SampleType { 0 });
+
+            SampleType sum { 0 };
+            for (const SampleType sample : output)
+                sum += sample;
+            comparison.add(static_cast<SampleType>(expected(0, n)), sum);
+        }
+    }
+
+    report.check(std::string { "FDNAnalysis vs FDN<" } + typeName<SampleType>() + "> order " + std::to_string(order), comparison, difftest::Tolerance::db(maxErrorDb));
+}
+
+// Octave-band T60 fitted on the computed response, against the T60 the absorption filters are designed for.
+// The fit of a finite, dense FDN scatters around the design by a few percent: -30 to -36 dB over seeds
+void testFDNAnalysisBands(Report& report, const Options& options, uint32_t order)
+{
+    difftest::Comparison comparison;
+
+    for (uint32_t trial = 0; trial < options.trials; ++trial)
+    {
+        std::mt19937 generator { options.seed + trial };
+        const double T60 { std::uniform_real_distribution<double> { 0.5, 2.0 } (generator) };
+        const double brightness { std::uniform_real_distribution<double> { 0.3, 1.0 } (generator) };
+
+        const DSP::FDN<double> fdn { order, T60, brightness, options.seed + trial };
+        const DSP::FDNAnalysis analysis { fdn.getSnapshot(), T60, brightness, sampleRate };
+        const Eigen::MatrixXd response { analysis.computeImpulseResponse(static_cast<uint32_t>(1.2 * T60 * sampleRate)) };
+
+        for (const auto& band : analysis.analyzeBands(response.data(), static_cast<size_t>(response.cols())))
+            comparison.add(band.designT60, band.t60);
+    }
+
+    report.check("FDNAnalysis band T60 vs design, order " + std::to_string(order), comparison, difftest::Tolerance::db(-28.0));
+}
+
+// Decimation then interpolation of a sine within the passband: the input delayed by the summed latencies of both
+// filters. The passband ripple of the lowpass, about 60 dB down, bounds the error. The start, until the filters
+// are filled, is skipped
+template <typename SampleType>
+void testPolyphaseRoundTrip(Report& report, const Options& options, uint32_t factor)
+{
+    constexpr uint32_t numChannels { 2u };
+    difftest::Comparison comparison;
+
+    for (uint32_t trial = 0; trial < options.trials; ++trial)
+    {
+        std::mt19937 generator { options.seed + trial };
+        // Up to 0.3 of the lower rate, below the edge of the flat band at 0.4
+        const double frequency { std::uniform_real_distribution<double> { 0.02, 0.3 } (generator) / static_cast<double>(factor) };
+        const double phase { std::uniform_real_distribution<double> { 0.0, 2.0 * juce::MathConstants<double>::pi } (generator) };
+
+        DSP::PolyphaseDecimator<SampleType> decimator { numChannels };
+        DSP::PolyphaseInterpolator<SampleType> interpolator { numChannels };
+        decimator.prepare(numChannels, factor);
+        interpolator.prepare(numChannels, factor);
+        const uint32_t latency { decimator.getLatency() + interpolator.getLatency() };
+
+        // Channels in quadrature
+        auto sine = [&] (int64_t n, uint32_t ch)
+        {
+            return static_cast<SampleType>(0.5 * std::sin(2.0 * juce::MathConstants<double>::pi * frequency * static_cast<double>(n)
+                                                          + phase + 0.5 * juce::MathConstants<double>::pi * ch));
+        };
+
+        std::vector<SampleType> input(numChannels);
+        std::vector<SampleType> lower(numChannels);
+        std::vector<SampleType> output(numChannels);
+        for (uint32_t n = 0; n < samplesPerTrial; ++n)
+        {
+            for (uint32_t ch = 0; ch < numChannels; ++ch)
+                input[ch] = sine(n, ch);
+            if (decimator.processSample(lower.data(), input.data(), numChannels))
+                interpolator.pushSample(lower.data(), numChannels);
+            interpolator.processSample(output.data(), numChannels);
+
+            if (n >= 2u * latency)
+                for (uint32_t ch = 0; ch < numChannels; ++ch)
+                    comparison.add(sine(static_cast<int64_t>(n) - latency, ch), output[ch]);
+        }
+    }
+
+    report.check(std::string { "Polyphase<" } + typeName<SampleType>() + "> round trip vs delayed sine, factor " + std::to_string(factor),
+                 comparison, difftest::Tolerance::db(-50.0));
+}
+
+// Filterbank of the subband FDN with every band bypassed, muted ones included: the input delayed by getLatency.
+// The bands are subtracted and added back, so it matches up to the rounding of those sums
+template <typename SampleType>
+void testSubbandReconstruction(Report& report, const Options& options)
+{
+    const double maxErrorDb { std::is_same_v<SampleType, float> ? -120.0 : -280.0 };
+    difftest::Comparison comparison;
+
+    for (uint32_t trial = 0; trial < options.trials; ++trial)
+    {
+        std::mt19937 generator { options.seed + trial };
+        const uint32_t numChannels { std::uniform_int_distribution<uint32_t> { 1u, 2u } (generator) };
+        std::vector<typename DSP::SubbandFDN<SampleType>::BandSettings> settings(std::uniform_int_distribution<size_t> { 1u, 5u } (generator));
+        for (auto& band : settings)
+            band = { chance(generator, 0.5) ? 4u : 0u, SampleType { 1 } };
+
+        DSP::SubbandFDN<SampleType> subband { settings, numChannels, numChannels, options.seed + trial };
+        subband.prepare(sampleRate, static_cast<int>(maxBlockSize));
+        subband.setBypassed(true);
+        const uint32_t latency { subband.getLatency() };
+
+        std::vector<SampleType> input(static_cast<size_t>(samplesPerTrial) * numChannels);
+        for (auto& sample : input)
+            sample = randomSample<SampleType>(generator);
+        std::vector<SampleType> output(numChannels);
+
+        for (uint32_t processed = 0; processed < samplesPerTrial;)
+        {
+            const uint32_t blockSize { std::min(randomBlockSize(generator), samplesPerTrial - processed) };
+            subband.update();
+            for (uint32_t n = processed; n < processed + blockSize; ++n)
+            {
+                subband.process(output.data(), input.data() + static_cast<size_t>(n) * numChannels);
+                for (uint32_t ch = 0; ch < numChannels; ++ch)
+                    comparison.add(n >= latency ? input[static_cast<size_t>(n - latency) * numChannels + ch] : SampleType { 0 }, output[ch]);
+            }
+            processed += blockSize;
+        }
+    }
+
+    report.check(std::string { "SubbandFDN<" } + typeName<SampleType>() + "> bypassed vs delayed input", comparison, difftest::Tolerance::db(maxErrorDb));
+}
+
+// Bank file written, mapped and read back: every entry bit-exact against the computed preset.
+// Truncated files, another fingerprint and entry offsets outside the file must be rejected
+void testPresetBank(Report& report, const Options& options)
+{
+    constexpr uint32_t order { 16u };
+    constexpr int numChannels { 2 };
+    // Magic, version, fingerprint and number of presets, then one 64-bit offset per entry
+    constexpr size_t headerBytes { 3 * sizeof(int) + sizeof(juce::int64) };
+
+    std::mt19937 generator { options.seed };
+    std::vector<DSP::PresetRecipe> recipes;
+    std::vector<DSP::Preset> presets;
+    for (uint32_t trial = 0; trial < options.trials; ++trial)
+    {
+        DSP::PresetRecipe recipe;
+        recipe.name = "Preset " + std::to_string(trial);
+        recipe.fdnSeed = generator();
+        recipe.inputCouplingSeed = generator();
+        recipe.outputCouplingSeed = generator();
+        recipe.settings.t60 = std::uniform_real_distribution<float> { 0.5f, 8.0f } (generator);
+        recipe.settings.brightness = std::uniform_real_distribution<float> { 0.0f, 1.0f } (generator);
+        recipes.push_back(recipe);
+        presets.push_back(DSP::PresetBank::computePreset(recipe, order, numChannels, numChannels));
+    }
+    const uint64_t fingerprint { DSP::PresetBank::getFingerprint(recipes, order, numChannels, numChannels) };
+
+    // Verdicts as values, 1 for accepted, against the expected ones
+    difftest::Comparison roundTrip;
+    difftest::Comparison verdicts;
+    auto expect = [&verdicts] (bool expected, bool accepted) { verdicts.add(expected ? 1.0 : 0.0, accepted ? 1.0 : 0.0); };
+    auto addValues = [&roundTrip, &expect] (const auto& written, const auto& restored)
+    {
+        expect(true, written.size() == restored.size());
+        for (size_t i = 0; i < std::min(written.size(), restored.size()); ++i)
+            roundTrip.add(static_cast<double>(written[i]), static_cast<double>(restored[i]));
+    };
+
+    const juce::File file { juce::File::getSpecialLocation(juce::File::tempDirectory).getNonexistentChildFile("dsp_difftest", ".bank", false) };
+    DSP::PresetBank bank;
+    expect(true, DSP::PresetBank::writeFile(file, fingerprint, presets) && bank.open(file, fingerprint));
+    expect(true, bank.getNumPresets() == presets.size());
+
+    for (size_t index = 0; index < presets.size(); ++index)
+    {
+        const DSP::Preset& written { presets[index] };
+        DSP::Preset restored;
+        expect(true, bank.readPreset(index, restored));
+        expect(true, restored.name == written.name);
+
+        const auto settingsOf = [] (const DSP::PresetSettings& settings)
+        {
+            return std::vector<float> { settings.t60, settings.brightness, settings.roomSize, settings.modulationRate, settings.modulationDepth };
+        };
+        addValues(settingsOf(written.settings), settingsOf(restored.settings));
+        addValues(written.topology.fdn.delayLengths, restored.topology.fdn.delayLengths);
+        addValues(written.topology.fdn.feedbackMatrix.coefficients, restored.topology.fdn.feedbackMatrix.coefficients);
+        addValues(written.topology.inputCoupling.coefficients, restored.topology.inputCoupling.coefficients);
+        addValues(written.topology.outputCoupling.coefficients, restored.topology.outputCoupling.coefficients);
+    }
+    DSP::Preset outOfRange;
+    expect(false, bank.readPreset(presets.size(), outOfRange));
+    expect(false, bank.open(file, fingerprint + 1u));
+
+    juce::MemoryBlock original;
+    expect(true, file.loadFileAsData(original));
+    auto openModified = [&] (const juce::MemoryBlock& modified)
+    {
+        return file.replaceWithData(modified.getData(), modified.getSize()) && bank.open(file, fingerprint);
+    };
+
+    // Truncated within the header and within the offsets: rejected by open. Within the last entry: by readPreset
+    const size_t tableEnd { headerBytes + presets.size() * sizeof(juce::int64) };
+    for (const size_t truncatedBytes : { headerBytes - 1u, tableEnd - 1u })
+        expect(false, openModified(juce::MemoryBlock { original.getData(), truncatedBytes }));
+    DSP::Preset truncated;
+    expect(true, openModified(juce::MemoryBlock { original.getData(), original.getSize() - 1u }));
+    expect(false, bank.readPreset(presets.size() - 1u, truncated));
+
+    // First entry offset into the header, and past the end of the file
+    for (const size_t offset : { size_t { 0u }, original.getSize() })
+    {
+        juce::MemoryBlock modified { original };
+        const juce::int64 value { juce::ByteOrder::swapIfBigEndian(static_cast<juce::int64>(offset)) };
+        modified.copyFrom(&value, static_cast<int>(headerBytes), sizeof(value));
+        expect(false, openModified(modified));
+    }
+
+    bank.close();
+    file.deleteFile();
+
+    report.check("PresetBank round trip", roundTrip, difftest::Tolerance::exact());
+    report.check("PresetBank accepts intact, rejects corrupt", verdicts, difftest::Tolerance::exact());
+}
+
+//================================================
+
+bool parseArguments(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string argument { argv[i] };
+        const bool hasValue { i + 1 < argc };
+
+        if (argument == "--trials" && hasValue)
+            options.trials = static_cast<uint32_t>(std::max(std::atoi(argv[++i]), 1));
+        else if (argument == "--seed" && hasValue)
+            options.seed = static_cast<uint32_t>(std::atoi(argv[++i]));
+        else if (argument == "--instruction-set" && hasValue && DSP::KernelDispatch::parseName(argv[++i], options.instructionSet))
+            options.singleInstructionSet = true;
+        else
+        {
+            std::fprintf(stderr, "Usage: %s [--trials <n>] [--seed <n>] [--instruction-set <generic|sse2|avx2|avx512>]\n", argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename SampleType>
+void runAll(Report& report, const Options& options)
+{
+    testDelayLine<SampleType>(report, options);
+    // Relative rounding noise of 2^-9 for bfloat16; steps of 2^-13 against a white input at -4.8 dBFS for fixed16
+    testDelayStorage<SampleType>(report, options, primitives::DelayStorage::bfloat16, "bfloat16", -45.0);
+    testDelayStorage<SampleType>(report, options, primitives::DelayStorage::fixed16, "fixed16", -80.0);
+    testDelayMigration<SampleType>(report, options, primitives::DelayStorage::float32, "float32");
+    testDelayMigration<SampleType>(report, options, primitives::DelayStorage::fixed16, "fixed16");
+    testPagedDelayLine<SampleType>(report, options);
+    testPagedDelayLineCrossfade<SampleType>(report, options);
+    testOnePoleFilter<SampleType>(report, options);
+
+    for (const uint32_t order : { 2u, 16u, 64u })
+        testMultichannel<SampleType>(report, options, order);
+
+    for (const int order : { 2, 4, 8, 16, 32, 64 })
+        testMatrix<SampleType>(report, options, order, order);
+    // Input and output coupling shapes
+    testMatrix<SampleType>(report, options, 16, 2);
+    testMatrix<SampleType>(report, options, 2, 16);
+
+    for (const int order : { 2, 16, 64 })
+        testMatrixRotations<SampleType>(report, options, order);
+
+    for (const uint32_t order : { 2u, 4u, 8u, 16u, 32u, 64u })
+        testFDN<SampleType>(report, options, order);
+
+    for (const uint32_t order : { 2u, 16u, 64u })
+        testFDNAnalysis<SampleType>(report, options, order);
+    if constexpr (std::is_same_v<SampleType, double>)
+        for (const uint32_t order : { 16u, 64u })
+            testFDNAnalysisBands(report, options, order);
+
+    for (const uint32_t factor : { 2u, 3u, 4u })
+        testPolyphaseRoundTrip<SampleType>(report, options, factor);
+    testSubbandReconstruction<SampleType>(report, options);
+}
+
+}
+
+//================================================
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (! parseArguments(argc, argv, options))
+        return 1;
+
+    if (options.singleInstructionSet && ! DSP::KernelDispatch::isSupported(options.instructionSet))
+    {
+        std::fprintf(stderr, "This machine or build does not support %s\n", DSP::KernelDispatch::getName(options.instructionSet));
+        return 1;
+    }
+
+    Report report;
+    const uint32_t first { static_cast<uint32_t>(options.singleInstructionSet ? options.instructionSet : DSP::InstructionSet::generic) };
+    const uint32_t last { static_cast<uint32_t>(options.singleInstructionSet ? options.instructionSet : DSP::KernelDispatch::getSupported()) };
+    for (uint32_t set = first; set <= last; ++set)
+    {
+        std::printf("Kernels: %s\n", DSP::KernelDispatch::getName(DSP::KernelDispatch::setActive(static_cast<DSP::InstructionSet>(set))));
+        runAll<float>(report, options);
+        runAll<double>(report, options);
+    }
+
+    // The bank file does not depend on the kernels
+    testPresetBank(report, options);
+
+    std::printf("%d of %d checks failed\n", report.getFailures(), report.getChecks());
+    return report.getFailures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,477 @@
+// DSP benchmark suite: ns/sample and samples/s of each primitive and of the whole FDN,
+// over orders, block sizes, and with or without parameter automation. Results are written as JSON.
+//
+// Usage: dsp_bench [--quick] [--filter <kernel>] [--output <file.json>] [--repetitions <n>]
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <JuceHeader.h>
+
+#include "BenchHarness.h"
+
+#include "DelayLine.h"
+#include "FDN.h"
+#include "FDNAnalysis.h"
+#include "Matrix.h"
+#include "MultichannelAbsorption.h"
+#include "MultichannelDelay.h"
+#include "OnePoleFilter.h"
+#include "OscillatorBank.h"
+#include "PagedDelayLine.h"
+#include "SmoothParameter.h"
+#include "SubbandFDN.h"
+
+namespace
+{
+
+constexpr double sampleRate { 48000.0 };
+constexpr uint32_t maxBlockSize { 4096u };
+constexpr uint32_t maxChannels { 64u };
+
+// Grid of the measurements
+struct Grid
+{
+    std::vector<uint32_t> orders;
+    std::vector<uint32_t> blockSizes;
+};
+
+Grid makeGrid(bool quick)
+{
+    if (quick)
+        return { { 4u, 16u, 64u }, { 1u, 64u, 1024u } };
+    return { { 2u, 4u, 8u, 16u, 32u, 64u }, { 1u, 4u, 16u, 64u, 256u, 1024u, 4096u } };
+}
+
+const char* automationName(bool automated)
+{
+    return automated ? "automated" : "static";
+}
+
+// Deterministic white noise, interleaved: frame n, channel c at [n * channels + c]
+std::vector<float> makeNoise(size_t numSamples)
+{
+    std::mt19937 generator { 12345u };
+    std::uniform_real_distribution<float> distribution { -1.0f, 1.0f };
+    std::vector<float> noise(numSamples);
+    for (auto& sample : noise)
+        sample = distribution(generator);
+    return noise;
+}
+
+const std::vector<float>& getNoise()
+{
+    static const std::vector<float> noise { makeNoise(static_cast<size_t>(maxBlockSize) * maxChannels) };
+    return noise;
+}
+
+//================================================
+
+void benchSmoothParameter(bench::Runner& runner, const Grid& grid)
+{
+    const std::string kernel { "SmoothParameter" };
+    if (! runner.isSelected(kernel))
+        return;
+
+    for (const bool automated : { false, true })
+        for (const uint32_t blockSize : grid.blockSizes)
+        {
+            utils::SmoothParameter parameter { 0.5f };
+            parameter.prepare();
+            std::vector<float> output(blockSize);
+            float target { 0.5f };
+
+            runner.run({ kernel, "float", automationName(automated), 1u, blockSize }, [&](uint32_t numSamples)
+            {
+                if (automated)
+                {
+                    target = 1.0f - target;
+                    parameter.setTarget(target);
+                }
+                parameter.getBlock(output.data(), numSamples);
+                bench::doNotOptimize(output[numSamples - 1]);
+            });
+        }
+}
+
+void benchDelayLine(bench::Runner& runner, const Grid& grid)
+{
+    const std::string kernel { "DelayLine" };
+    if (! runner.isSelected(kernel))
+        return;
+
+    const auto& noise { getNoise() };
+
+    for (const bool automated : { false, true })
+        for (const uint32_t blockSize : grid.blockSizes)
+        {
+            primitives::DelayLine<float> delayLine { 4800u, 1000u };
+            delayLine.prepare();
+            std::vector<float> output(blockSize);
+            uint32_t delay { 1000u };
+
+            runner.run({ kernel, "float", automationName(automated), 1u, blockSize, delayLine.getMemoryFootprint().getBytes() }, [&](uint32_t numSamples)
+            {
+                if (automated)
+                {
+                    delay = delay == 1000u ? 1500u : 1000u;
+                    delayLine.setDelay(delay);
+                }
+                delayLine.processBlock(output.data(), noise.data(), numSamples);
+                bench::doNotOptimize(output[numSamples - 1]);
+            });
+        }
+}
+
+// The same delays as DelayLine, in pages from a pool of its own
+void benchPagedDelayLine(bench::Runner& runner, const Grid& grid)
+{
+    const std::string kernel { "PagedDelayLine" };
+    if (! runner.isSelected(kernel))
+        return;
+
+    const auto& noise { getNoise() };
+
+    for (const bool automated : { false, true })
+        for (const uint32_t blockSize : grid.blockSizes)
+        {
+            const auto pool { std::make_shared<primitives::DelayPagePool<float>>() };
+            primitives::PagedDelayLine<float> delayLine { 4800u, 1000u, pool };
+            delayLine.prepare();
+            std::vector<float> output(blockSize);
+            uint32_t delay { 1000u };
+
+            runner.run({ kernel, "float", automationName(automated), 1u, blockSize, delayLine.getMemoryFootprint().getBytes() }, [&](uint32_t numSamples)
+            {
+                if (automated)
+                {
+                    delay = delay == 1000u ? 1500u : 1000u;
+                    delayLine.setDelay(delay);
+                }
+                delayLine.processBlock(output.data(), noise.data(), numSamples);
+                bench::doNotOptimize(output[numSamples - 1]);
+            });
+        }
+}
+
+void benchOnePoleFilter(bench::Runner& runner, const Grid& grid)
+{
+    const std::string kernel { "OnePoleFilter" };
+    if (! runner.isSelected(kernel))
+        return;
+
+    const auto& noise { getNoise() };
+
+    for (const bool automated : { false, true })
+        for (const uint32_t blockSize : grid.blockSizes)
+        {
+            DSP::OnePoleFilter<float> filter { 0.9f, 0.5f };
+            filter.prepare(sampleRate, static_cast<int>(blockSize));
+            std::vector<float> output(blockSize);
+            float magNY { 0.5f };
+
+            runner.run({ kernel, "float", automationName(automated), 1u, blockSize }, [&](uint32_t numSamples)
+            {
+                if (automated)
+                {
+                    magNY = magNY == 0.5f ? 0.3f : 0.5f;
+                    filter.setMagValues(0.9f, magNY);
+                }
+                filter.processBuffer(output.data(), noise.data(), numSamples);
+                bench::doNotOptimize(output[numSamples - 1]);
+            });
+        }
+}
+
+void benchOscillatorBank(bench::Runner& runner, const Grid& grid)
+{
+    const std::string kernel { "OscillatorBank" };
+    if (! runner.isSelected(kernel))
+        return;
+
+    for (const bool automated : { false, true })
+        for (const uint32_t order : grid.orders)
+            for (const uint32_t blockSize : grid.blockSizes)
+            {
+                primitives::OscillatorBank oscillators { order, primitives::Waveform::sine, 0.5f };
+                oscillators.prepare(sampleRate, blockSize);
+                std::vector<std::vector<float>> outputs(order, std::vector<float>(blockSize));
+                std::vector<float*> outputPointers;
+                for (auto& output : outputs)
+                    outputPointers.push_back(output.data());
+                float frequency { 0.5f };
+
+                runner.run({ kernel, "float", automationName(automated), order, blockSize, oscillators.getMemoryFootprint().getBytes() }, [&](uint32_t numSamples)
+                {
+                    if (automated)
+                    {
+                        frequency = frequency == 0.5f ? 0.7f : 0.5f;
+                        oscillators.setFrequency(frequency);
+                    }
+                    oscillators.processBlock(outputPointers.data(), numSamples);
+                    bench::doNotOptimize(outputs[0][numSamples - 1]);
+                });
+            }
+}
+
+void benchMatrix(bench::Runner& runner, const Grid& grid)
+{
+    const std::string kernel { "Matrix" };
+    if (! runner.isSelected(kernel))
+        return;
+
+    const auto& noise { getNoise() };
+
+    // Automated: the time-varying rotations are running
+    for (const bool automated : { false, true })
+        for (const uint32_t order : grid.orders)
+            for (const uint32_t blockSize : grid.blockSizes)
+            {
+                DSP::Matrix<float> matrix { static_cast<int>(order), static_cast<int>(order), 1u };
+                matrix.prepareModulation(sampleRate);
+                matrix.setModulation(0.3f, automated ? 0.5f : 0.0f);
+                std::vector<float> output(order);
+
+                runner.run({ kernel, "float", automationName(automated), order, blockSize, matrix.getMemoryFootprint().getBytes() }, [&](uint32_t numSamples)
+                {
+                    for (uint32_t n = 0; n < numSamples; ++n)
+                        matrix.processSample(output.data(), &noise[static_cast<size_t>(n) * order], order, order);
+                    bench::doNotOptimize(output[0]);
+                });
+            }
+}
+
+void benchMultichannelDelay(bench::Runner& runner, const Grid& grid)
+{
+    const std::string kernel { "MultichannelDelay" };
+    if (! runner.isSelected(kernel))
+        return;
+
+    const auto& noise { getNoise() };
+
+    for (const bool automated : { false, true })
+        for (const uint32_t order : grid.orders)
+            for (const uint32_t blockSize : grid.blockSizes)
+            {
+                std::vector<size_t> lengths(order);
+                std::vector<size_t> otherLengths(order);
+                std::vector<size_t> maxLengths(order);
+                for (uint32_t i = 0; i < order; ++i)
+                {
+                    lengths[i] = 300u + 37u * i;
+                    otherLengths[i] = 400u + 41u * i;
+                    maxLengths[i] = 3000u;
+                }
+
+                DSP::MultichannelDelay<float> delays { order, maxLengths, lengths };
+                delays.prepare(sampleRate, static_cast<int>(blockSize));
+                std::vector<float> output(order);
+                bool swapped { false };
+
+                runner.run({ kernel, "float", automationName(automated), order, blockSize, delays.getMemoryFootprint().getBytes() }, [&](uint32_t numSamples)
+                {
+                    if (automated)
+                    {
+                        swapped = ! swapped;
+                        delays.crossfadeDelayLinesLengths(swapped ? otherLengths : lengths);
+                    }
+                    for (uint32_t n = 0; n < numSamples; ++n)
+                        delays.processSample(output.data(), &noise[static_cast<size_t>(n) * order], order);
+                    bench::doNotOptimize(output[0]);
+                });
+            }
+}
+
+void benchMultichannelAbsorption(bench::Runner& runner, const Grid& grid)
+{
+    const std::string kernel { "MultichannelAbsorption" };
+    if (! runner.isSelected(kernel))
+        return;
+
+    const auto& noise { getNoise() };
+
+    for (const bool automated : { false, true })
+        for (const uint32_t order : grid.orders)
+            for (const uint32_t blockSize : grid.blockSizes)
+            {
+                std::vector<std::pair<float, float>> magValues(order, { 0.95f, 0.7f });
+                std::vector<std::pair<float, float>> otherMagValues(order, { 0.9f, 0.5f });
+
+                DSP::MultichannelAbsorption<float> absorption { order, magValues };
+                absorption.prepare(sampleRate, static_cast<int>(blockSize));
+                std::vector<float> output(order);
+                bool swapped { false };
+
+                runner.run({ kernel, "float", automationName(automated), order, blockSize, absorption.getMemoryFootprint().getBytes() }, [&](uint32_t numSamples)
+                {
+                    if (automated)
+                    {
+                        swapped = ! swapped;
+                        absorption.setFiltersMagnitudeValues(swapped ? otherMagValues : magValues);
+                    }
+                    for (uint32_t n = 0; n < numSamples; ++n)
+                        absorption.processSample(output.data(), &noise[static_cast<size_t>(n) * order], order);
+                    bench::doNotOptimize(output[0]);
+                });
+            }
+}
+
+// The FDN with its delay memory in a storage format, named by kernel
+template <typename SampleType>
+void benchFDN(bench::Runner& runner, const Grid& grid, const char* sampleTypeName, primitives::DelayStorage storage, const std::string& kernel)
+{
+    if (! runner.isSelected(kernel))
+        return;
+
+    // The FDN is fed with a single excitation channel
+    const auto& noise { getNoise() };
+
+    for (const bool automated : { false, true })
+        for (const uint32_t order : grid.orders)
+            for (const uint32_t blockSize : grid.blockSizes)
+            {
+                DSP::FDN<SampleType> fdn { order, SampleType { 2 }, SampleType { 0.5 }, 1u };
+                fdn.setDelayStorage(storage);
+                fdn.prepare(sampleRate, static_cast<int>(blockSize));
+                std::vector<SampleType> input(order, SampleType { 0 });
+                std::vector<SampleType> output(order);
+                uint32_t blockIndex { 0u };
+
+                const uint64_t memoryBytes { fdn.getMemoryFootprint().getTotal().getBytes() };
+                runner.run({ kernel, sampleTypeName, automationName(automated), order, blockSize, memoryBytes }, [&](uint32_t numSamples)
+                {
+                    // T60, brightness and room size move every block, within the reserved delay memory
+                    if (automated)
+                    {
+                        const bool odd { (++blockIndex & 1u) != 0u };
+                        fdn.setT60(odd ? SampleType { 2 } : SampleType { 3 });
+                        fdn.setBrightness(odd ? SampleType { 0.5 } : SampleType { 0.6 });
+                        fdn.setRoomSize(odd ? SampleType { 1 } : SampleType { 0.9 });
+                    }
+                    fdn.update();
+
+                    for (uint32_t n = 0; n < numSamples; ++n)
+                    {
+                        input[0] = static_cast<SampleType>(noise[n]);
+                        fdn.process(output.data(), input.data(), order);
+                    }
+                    bench::doNotOptimize(output[0]);
+                });
+            }
+}
+
+
+template <typename SampleType>
+void benchSubbandFDN(bench::Runner& runner, const Grid& grid, const char* sampleTypeName)
+{
+    const std::string kernel { "SubbandFDN" };
+    if (! runner.isSelected(kernel))
+        return;
+
+    // A long, dark hall, to compare with the full-rate FDN of the last band's order: top octave
+    // absorbed at once, then 4, 8 and 16 lines with longer and longer tails
+    using BandSettings = typename DSP::SubbandFDN<SampleType>::BandSettings;
+    const std::vector<BandSettings> darkHall {
+        { 0u, SampleType { 1 } },
+        { 4u, SampleType { 0.8 } },
+        { 8u, SampleType { 2 } },
+        { 16u, SampleType { 4 } }
+    };
+    const auto& noise { getNoise() };
+
+    for (const uint32_t blockSize : grid.blockSizes)
+    {
+        DSP::SubbandFDN<SampleType> subbandFdn { darkHall, 1u, 2u, 1u };
+        subbandFdn.prepare(sampleRate, static_cast<int>(blockSize));
+        SampleType input { 0 };
+        SampleType output[2] {};
+
+        const uint64_t memoryBytes { subbandFdn.getMemoryFootprint().getBytes() };
+        runner.run({ kernel, sampleTypeName, automationName(false), darkHall.back().order, blockSize, memoryBytes }, [&](uint32_t numSamples)
+        {
+            subbandFdn.update();
+            for (uint32_t n = 0; n < numSamples; ++n)
+            {
+                input = static_cast<SampleType>(noise[n]);
+                subbandFdn.process(output, &input);
+            }
+            bench::doNotOptimize(output[0]);
+        });
+    }
+}
+
+
+// Impulse responses of one second computed offline from the topology, one per block, to compare with rendering
+// them through the FDN case of the same order
+void benchFDNAnalysis(bench::Runner& runner, const Grid& grid)
+{
+    const std::string kernel { "FDNAnalysis" };
+    if (! runner.isSelected(kernel))
+        return;
+
+    for (const uint32_t order : grid.orders)
+    {
+        const DSP::FDN<double> fdn { order, 2.0, 0.5, 1u };
+        const DSP::FDNAnalysis analysis { fdn.getSnapshot(), 2.0, 0.5, sampleRate };
+
+        runner.run({ kernel, "double", automationName(false), order, static_cast<uint32_t>(sampleRate) }, [&](uint32_t numSamples)
+        {
+            const Eigen::MatrixXd response { analysis.computeImpulseResponse(numSamples) };
+            bench::doNotOptimize(response(0, 0));
+        });
+    }
+}
+
+}
+
+//================================================
+
+int main(int argc, char** argv)
+{
+    bench::Settings settings;
+    if (! bench::parseArguments(argc, argv, settings))
+        return 1;
+
+    bench::Runner runner { settings };
+    const Grid grid { makeGrid(settings.quick) };
+
+    // Primitives
+    benchSmoothParameter(runner, grid);
+    benchDelayLine(runner, grid);
+    benchPagedDelayLine(runner, grid);
+    benchOnePoleFilter(runner, grid);
+    benchOscillatorBank(runner, grid);
+    benchMatrix(runner, grid);
+    benchMultichannelDelay(runner, grid);
+    benchMultichannelAbsorption(runner, grid);
+
+    // Whole FDN
+    benchFDN<float>(runner, grid, "float", primitives::DelayStorage::float32, "FDN");
+    benchFDN<double>(runner, grid, "double", primitives::DelayStorage::float32, "FDN");
+    // Reduced-precision delay memory
+    benchFDN<float>(runner, grid, "float", primitives::DelayStorage::bfloat16, "FDN.bfloat16");
+    benchFDN<float>(runner, grid, "float", primitives::DelayStorage::fixed16, "FDN.fixed16");
+    benchSubbandFDN<float>(runner, grid, "float");
+    benchSubbandFDN<double>(runner, grid, "double");
+    benchFDNAnalysis(runner, grid);
+
+    if (settings.outputPath.empty())
+    {
+        runner.writeJson(std::cout);
+    }
+    else
+    {
+        std::ofstream file { settings.outputPath };
+        if (! file)
+        {
+            std::cerr << "Cannot write " << settings.outputPath << "\n";
+            return 1;
+        }
+        runner.writeJson(file);
+    }
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+// With glibc, the C allocation functions are replaced as well, since JUCE (HeapBlock, AudioBuffer) and Eigen
+// allocate through malloc. Operator new then counts through malloc. Elsewhere only operator new is counted
+#if defined(__GLIBC__)
+#define ALLOCATION_COUNTER_MALLOC 1
+#define ALLOCATION_COUNTER_TLS __attribute__((tls_model("initial-exec")))
+#else
+#define ALLOCATION_COUNTER_MALLOC 0
+#define ALLOCATION_COUNTER_TLS
+#endif
+
+#if ALLOCATION_COUNTER_MALLOC
+extern "C"
+{
+    // glibc's own implementations, which the replacements forward to
+    void* __libc_malloc(std::size_t size) noexcept;
+    void* __libc_calloc(std::size_t count, std::size_t size) noexcept;
+    void* __libc_realloc(void* pointer, std::size_t size) noexcept;
+    void __libc_free(void* pointer) noexcept;
+}
+#endif
+
+namespace
+{
+    // Per thread, so that allocations of other threads (message thread, timers) are not counted.
+    // Initial-exec, so that reading them from malloc never allocates the thread's TLS block
+    thread_local bool counting ALLOCATION_COUNTER_TLS { false };
+    thread_local uint64_t allocations ALLOCATION_COUNTER_TLS { 0u };
+
+    void countAllocation()
+    {
+        if (counting)
+            ++allocations;
+    }
+
+    void* allocate(std::size_t size)
+    {
+#if ! ALLOCATION_COUNTER_MALLOC
+        countAllocation();
+#endif
+
+        if (void* pointer = std::malloc(size == 0u ? 1u : size))
+            return pointer;
+        throw std::bad_alloc {};
+    }
+}
+
+namespace bench
+{
+
+AllocationCounter::AllocationCounter() :
+    startCount { allocations }
+{
+    counting = true;
+}
+
+AllocationCounter::~AllocationCounter()
+{
+    counting = false;
+}
+
+uint64_t AllocationCounter::getCount() const
+{
+    return allocations - startCount;
+}
+
+}
+
+//================================================
+
+// Replacements of the global allocation functions. The aligned overloads keep their default implementation,
+// counted through malloc where it is replaced
+
+void* operator new(std::size_t size)
+{
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return allocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    try { return allocate(size); }
+    catch (...) { return nullptr; }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    try { return allocate(size); }
+    catch (...) { return nullptr; }
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+#if ALLOCATION_COUNTER_MALLOC
+
+//================================================
+
+// Replacements of the C allocation functions. A realloc counts as an allocation, since it may move the block
+
+extern "C" void* malloc(std::size_t size) noexcept
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(std::size_t count, std::size_t size) noexcept
+{
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, std::size_t size) noexcept
+{
+    countAllocation();
+    return __libc_realloc(pointer, size);
+}
+
+extern "C" void free(void* pointer) noexcept
+{
+    __libc_free(pointer);
+}
+
+#endif
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+namespace bench
+{
+
+// Counts the heap allocations of the calling thread while a scope is active.
+// Linking AllocationCounter.cpp replaces the global operator new of the executable, and with glibc
+// malloc, calloc, realloc and free as well: only link it into harnesses that need the count.
+class AllocationCounter
+{
+public:
+    // Start counting on this thread
+    AllocationCounter();
+    // Stop counting
+    ~AllocationCounter();
+
+    AllocationCounter(const AllocationCounter&) = delete;
+    AllocationCounter& operator=(const AllocationCounter&) = delete;
+
+    // Allocations made by this thread since the scope started
+    uint64_t getCount() const;
+
+private:
+    uint64_t startCount;
+};
+
+}
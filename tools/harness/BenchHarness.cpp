@@ -0,0 +1,208 @@
+#include "BenchHarness.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+namespace bench
+{
+
+namespace
+{
+    // Escape the characters JSON does not allow in strings
+    std::string escape(const std::string& text)
+    {
+        std::string escaped;
+        escaped.reserve(text.size());
+        for (const char c : text)
+        {
+            switch (c)
+            {
+                case '"':  escaped += "\\\""; break;
+                case '\\': escaped += "\\\\"; break;
+                case '\n': escaped += "\\n"; break;
+                case '\t': escaped += "\\t"; break;
+                default:   escaped += c; break;
+            }
+        }
+        return escaped;
+    }
+
+    std::string compilerName()
+    {
+#if defined(__clang__)
+        return "clang " __clang_version__;
+#elif defined(__GNUC__)
+        return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+        return "msvc " + std::to_string(_MSC_VER);
+#else
+        return "unknown";
+#endif
+    }
+}
+
+//================================================
+
+bool parseArguments(int argc, char** argv, Settings& settings)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string argument { argv[i] };
+        const bool hasValue { i + 1 < argc };
+
+        if (argument == "--quick")
+        {
+            settings.quick = true;
+            settings.repetitions = 5u;
+            settings.samplesPerRepetition = 1u << 14;
+        }
+        else if (argument == "--filter" && hasValue)
+            settings.filter = argv[++i];
+        else if (argument == "--output" && hasValue)
+            settings.outputPath = argv[++i];
+        else if (argument == "--no-counters")
+            settings.counters = false;
+        else if (argument == "--repetitions" && hasValue)
+            settings.repetitions = static_cast<uint32_t>(std::max(std::atoi(argv[++i]), 1));
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--quick] [--filter <kernel>] [--output <file.json>] [--repetitions <n>] [--no-counters]\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+//================================================
+
+Runner::Runner(const Settings& initSettings) :
+    settings { initSettings }
+{
+    if (settings.counters && ! counters.isAvailable())
+    {
+        std::fprintf(stderr, "Hardware performance counters are not available: reporting wall-clock timing only\n");
+        settings.counters = false;
+    }
+}
+
+bool Runner::isSelected(const std::string& kernel) const
+{
+    return settings.filter.empty() || kernel.find(settings.filter) != std::string::npos;
+}
+
+const Settings& Runner::getSettings() const
+{
+    return settings;
+}
+
+const std::vector<Result>& Runner::getResults() const
+{
+    return results;
+}
+
+void Runner::addResult(const Case& measuredCase, uint64_t samplesPerRepetition, std::vector<double>& nanoseconds)
+{
+    std::sort(nanoseconds.begin(), nanoseconds.end());
+    const double samples { static_cast<double>(samplesPerRepetition) };
+
+    Result result;
+    result.measuredCase = measuredCase;
+    result.samplesPerRepetition = samplesPerRepetition;
+    result.nsPerSample = nanoseconds[nanoseconds.size() / 2] / samples;
+    result.nsPerSampleMin = nanoseconds.front() / samples;
+    result.nsPerSampleMax = nanoseconds.back() / samples;
+    result.samplesPerSecond = result.nsPerSample > 0.0 ? 1.0e9 / result.nsPerSample : 0.0;
+
+    if (settings.counters)
+    {
+        const double totalSamples { samples * static_cast<double>(nanoseconds.size()) };
+        result.hasCounters = true;
+        for (int event = 0; event < PerfCounters::numEvents; ++event)
+        {
+            const auto e { static_cast<PerfCounters::Event>(event) };
+            result.counterAvailable[event] = counters.isAvailable(e);
+            result.countersPerSample[event] = counters.getValue(e) / totalSamples;
+        }
+
+        const double cycles { counters.getValue(PerfCounters::cycles) };
+        if (counters.isAvailable(PerfCounters::cycles) && counters.isAvailable(PerfCounters::instructions) && cycles > 0.0)
+            result.instructionsPerCycle = counters.getValue(PerfCounters::instructions) / cycles;
+    }
+
+    results.push_back(result);
+
+    // Progress on stderr, so that the JSON can go to stdout
+    std::fprintf(stderr, "%-24s %-6s %-9s ch %3u  block %5u  %10.2f ns/sample  %12.0f samples/s",
+                 measuredCase.kernel.c_str(), measuredCase.sampleType.c_str(), measuredCase.automation.c_str(),
+                 measuredCase.channels, measuredCase.blockSize, result.nsPerSample, result.samplesPerSecond);
+    if (result.hasCounters)
+        std::fprintf(stderr, "  %9.1f cycles/sample  IPC %4.2f",
+                     result.countersPerSample[PerfCounters::cycles], result.instructionsPerCycle);
+    std::fprintf(stderr, "\n");
+}
+
+void Runner::writeJson(std::ostream& stream) const
+{
+    const std::time_t now { std::time(nullptr) };
+    char timestamp[32] {};
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+#if defined(NDEBUG)
+    const char* buildType { "release" };
+#else
+    const char* buildType { "debug" };
+#endif
+
+    stream << "{\n";
+    stream << "  \"timestamp\": \"" << timestamp << "\",\n";
+    stream << "  \"compiler\": \"" << escape(compilerName()) << "\",\n";
+    stream << "  \"build\": \"" << buildType << "\",\n";
+    stream << "  \"settings\": { \"samplesPerRepetition\": " << settings.samplesPerRepetition
+           << ", \"repetitions\": " << settings.repetitions
+           << ", \"warmupRepetitions\": " << settings.warmupRepetitions
+           << ", \"quick\": " << (settings.quick ? "true" : "false")
+           << ", \"counters\": " << (settings.counters ? "true" : "false") << " },\n";
+    stream << "  \"results\": [\n";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const Result& result { results[i] };
+        const Case& c { result.measuredCase };
+        stream << "    { \"kernel\": \"" << escape(c.kernel) << "\""
+               << ", \"sampleType\": \"" << escape(c.sampleType) << "\""
+               << ", \"automation\": \"" << escape(c.automation) << "\""
+               << ", \"channels\": " << c.channels
+               << ", \"blockSize\": " << c.blockSize
+               << ", \"memoryBytes\": " << c.memoryBytes
+               << ", \"samples\": " << result.samplesPerRepetition
+               << ", \"nsPerSample\": " << result.nsPerSample
+               << ", \"nsPerSampleMin\": " << result.nsPerSampleMin
+               << ", \"nsPerSampleMax\": " << result.nsPerSampleMax
+               << ", \"samplesPerSecond\": " << result.samplesPerSecond;
+
+        // Counters per sample, null when an event is not supported
+        if (result.hasCounters)
+        {
+            stream << ", \"counters\": {";
+            for (int event = 0; event < PerfCounters::numEvents; ++event)
+            {
+                stream << (event > 0 ? ", " : " ") << "\"" << PerfCounters::getName(static_cast<PerfCounters::Event>(event)) << "PerSample\": ";
+                if (result.counterAvailable[event])
+                    stream << result.countersPerSample[event];
+                else
+                    stream << "null";
+            }
+            stream << ", \"ipc\": " << result.instructionsPerCycle << " }";
+        }
+
+        stream << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+
+    stream << "  ]\n";
+    stream << "}\n";
+}
+
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "PerfCounters.h"
+
+namespace bench
+{
+
+// Keep a computed value alive, so the compiler cannot optimize the kernel away
+template <typename T>
+inline void doNotOptimize(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+//================================================
+
+// Settings shared by all the measurements of a run
+struct Settings
+{
+    // Sample frames processed per timed repetition, rounded up to whole blocks
+    uint32_t samplesPerRepetition { 1u << 16 };
+    uint32_t repetitions { 15u };
+    uint32_t warmupRepetitions { 2u };
+    // Reduced grid of orders and block sizes, for a quick check
+    bool quick { false };
+    // Only the kernels whose name contains the filter are measured
+    std::string filter;
+    // JSON destination, standard output when empty
+    std::string outputPath;
+    // Read the hardware performance counters, when available
+    bool counters { true };
+};
+
+// Parse --quick, --filter <name>, --output <path>, --repetitions <n>, --no-counters. Returns false on bad arguments
+bool parseArguments(int argc, char** argv, Settings& settings);
+
+//================================================
+
+// What is measured
+struct Case
+{
+    std::string kernel;
+    std::string sampleType { "float" };
+    // "static" or "automated": parameters change every block
+    std::string automation { "static" };
+    uint32_t channels { 1u };
+    uint32_t blockSize { 1u };
+    // Heap memory of the measured object, owned and shared, when reported (see utils::MemoryFootprint)
+    uint64_t memoryBytes { 0u };
+};
+
+// Timing of one case. Samples are frames: a frame holds one sample per channel
+struct Result
+{
+    Case measuredCase;
+    uint64_t samplesPerRepetition { 0u };
+    double nsPerSample { 0.0 };      // median over the repetitions
+    double nsPerSampleMin { 0.0 };
+    double nsPerSampleMax { 0.0 };
+    double samplesPerSecond { 0.0 }; // from the median
+
+    // Hardware counters per sample over all the repetitions, when available
+    bool hasCounters { false };
+    std::array<bool, PerfCounters::numEvents> counterAvailable {};
+    std::array<double, PerfCounters::numEvents> countersPerSample {};
+    double instructionsPerCycle { 0.0 };
+};
+
+//================================================
+
+// Runs the measurements and collects their results
+class Runner
+{
+public:
+    explicit Runner(const Settings& initSettings);
+
+    // Whether the kernel passes the filter
+    bool isSelected(const std::string& kernel) const;
+
+    // Time processBlock(numSamples), called on consecutive blocks of the case's block size
+    template <typename ProcessBlock>
+    void run(const Case& measuredCase, ProcessBlock&& processBlock);
+
+    const Settings& getSettings() const;
+    const std::vector<Result>& getResults() const;
+
+    // Write the settings and all the results as a JSON document
+    void writeJson(std::ostream& stream) const;
+
+private:
+    // Summarize the repetitions of a case, with the counters read over all of them, and print a progress line
+    void addResult(const Case& measuredCase, uint64_t samplesPerRepetition, std::vector<double>& nanoseconds);
+
+    Settings settings;
+    PerfCounters counters;
+    std::vector<Result> results;
+};
+
+//================================================
+
+template <typename ProcessBlock>
+void Runner::run(const Case& measuredCase, ProcessBlock&& processBlock)
+{
+    const uint32_t blockSize { std::max(measuredCase.blockSize, 1u) };
+    const uint32_t numBlocks { std::max((settings.samplesPerRepetition + blockSize - 1u) / blockSize, 1u) };
+
+    for (uint32_t r = 0; r < settings.warmupRepetitions; ++r)
+        for (uint32_t b = 0; b < numBlocks; ++b)
+            processBlock(blockSize);
+
+    std::vector<double> nanoseconds;
+    nanoseconds.reserve(settings.repetitions);
+
+    // The counters run over all the repetitions: their ioctls stay out of the timed loops
+    if (settings.counters)
+        counters.start();
+
+    for (uint32_t r = 0; r < settings.repetitions; ++r)
+    {
+        const auto start { std::chrono::steady_clock::now() };
+        for (uint32_t b = 0; b < numBlocks; ++b)
+            processBlock(blockSize);
+        const auto stop { std::chrono::steady_clock::now() };
+
+        nanoseconds.push_back(std::chrono::duration<double, std::nano>(stop - start).count());
+    }
+
+    if (settings.counters)
+        counters.stop();
+
+    addResult(measuredCase, static_cast<uint64_t>(numBlocks) * blockSize, nanoseconds);
+}
+
+}
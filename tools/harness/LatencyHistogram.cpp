@@ -0,0 +1,117 @@
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace bench
+{
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::reset()
+{
+    buckets.fill(0u);
+    count = 0u;
+    max = 0u;
+    sum = 0.0;
+}
+
+uint32_t LatencyHistogram::bucketIndex(uint64_t nanoseconds)
+{
+    // Values below subBuckets are exact, one bucket each
+    if (nanoseconds < subBuckets)
+        return static_cast<uint32_t>(nanoseconds);
+
+    uint32_t highestBit { 0u };
+    for (uint64_t v = nanoseconds; v > 1u; v >>= 1)
+        ++highestBit;
+
+    // The top subBucketBits + 1 bits select the bucket within the power of two
+    const uint32_t shift { highestBit - subBucketBits };
+    const uint32_t top { static_cast<uint32_t>(nanoseconds >> shift) };
+    return shift * subBuckets + top;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(uint32_t index)
+{
+    if (index < subBuckets)
+        return index;
+
+    const uint32_t shift { index / subBuckets - 1u };
+    const uint64_t top { index % subBuckets + subBuckets };
+    return ((top + 1u) << shift) - 1u;
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds)
+{
+    const uint32_t index { std::min(bucketIndex(nanoseconds), numBuckets - 1u) };
+    ++buckets[index];
+    ++count;
+    max = std::max(max, nanoseconds);
+    sum += static_cast<double>(nanoseconds);
+}
+
+uint64_t LatencyHistogram::getCount() const
+{
+    return count;
+}
+
+uint64_t LatencyHistogram::getMax() const
+{
+    return max;
+}
+
+double LatencyHistogram::getMean() const
+{
+    return count > 0u ? sum / static_cast<double>(count) : 0.0;
+}
+
+uint64_t LatencyHistogram::getPercentile(double percentile) const
+{
+    if (count == 0u)
+        return 0u;
+
+    const double clamped { std::clamp(percentile, 0.0, 100.0) };
+    const uint64_t rank { std::max(static_cast<uint64_t>(std::ceil(clamped / 100.0 * static_cast<double>(count))), uint64_t { 1u }) };
+
+    uint64_t seen { 0u };
+    for (uint32_t i = 0; i < numBuckets; ++i)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+            return std::min(bucketUpperBound(i), max);
+    }
+    return max;
+}
+
+void LatencyHistogram::printRanges(std::ostream& stream) const
+{
+    // Merge the buckets into power-of-two ranges
+    std::array<uint64_t, 64> ranges {};
+    for (uint32_t i = 0; i < numBuckets; ++i)
+    {
+        if (buckets[i] == 0u)
+            continue;
+        uint32_t bit { 0u };
+        for (uint64_t v = bucketUpperBound(i); v > 1u; v >>= 1)
+            ++bit;
+        ranges[bit] += buckets[i];
+    }
+
+    const uint64_t largest { *std::max_element(ranges.begin(), ranges.end()) };
+    for (uint32_t bit = 0; bit < ranges.size(); ++bit)
+    {
+        if (ranges[bit] == 0u)
+            continue;
+        const uint64_t low { bit == 0u ? 0u : uint64_t { 1u } << bit };
+        const uint64_t high { (uint64_t { 1u } << (bit + 1u)) - 1u };
+        const size_t barLength { static_cast<size_t>(50.0 * static_cast<double>(ranges[bit]) / static_cast<double>(largest)) };
+        stream << "  [" << low << ", " << high << "] ns: " << ranges[bit] << " " << std::string(std::max(barLength, size_t { 1u }), '#') << "\n";
+    }
+}
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+namespace bench
+{
+
+// Histogram of latencies in nanoseconds, with log-linear buckets: every power of two is split
+// into subBuckets linear buckets, so percentiles are resolved to within 1/subBuckets (~3%).
+// Fixed size, so recording never allocates. The exact maximum is kept besides the buckets.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    // Record one latency
+    void record(uint64_t nanoseconds);
+
+    // Forget all recorded latencies
+    void reset();
+
+    uint64_t getCount() const;
+    uint64_t getMax() const;
+    double getMean() const;
+
+    // Upper bound of the bucket holding the given percentile, in [0, 100]
+    uint64_t getPercentile(double percentile) const;
+
+    // Print the count of each non-empty power-of-two range, with a bar
+    void printRanges(std::ostream& stream) const;
+
+private:
+    static constexpr uint32_t subBucketBits { 5u };
+    static constexpr uint32_t subBuckets { 1u << subBucketBits };
+    static constexpr uint32_t numRanges { 64u - subBucketBits };
+    static constexpr uint32_t numBuckets { (numRanges + 1u) * subBuckets };
+
+    // Bucket of a latency, and the largest latency that falls into a bucket
+    static uint32_t bucketIndex(uint64_t nanoseconds);
+    static uint64_t bucketUpperBound(uint32_t index);
+
+    std::array<uint64_t, numBuckets> buckets;
+    uint64_t count { 0u };
+    uint64_t max { 0u };
+    double sum { 0.0 };
+};
+
+}
@@ -0,0 +1,135 @@
+#include "PerfCounters.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+namespace bench
+{
+
+#if defined(__linux__)
+namespace
+{
+    // Cache events are encoded as cache | (operation << 8) | (result << 16)
+    constexpr uint64_t cacheEvent(uint64_t cache, uint64_t operation, uint64_t result)
+    {
+        return cache | (operation << 8) | (result << 16);
+    }
+
+    int openEvent(uint32_t type, uint64_t config)
+    {
+        perf_event_attr attributes;
+        std::memset(&attributes, 0, sizeof(attributes));
+        attributes.size = sizeof(attributes);
+        attributes.type = type;
+        attributes.config = config;
+        attributes.disabled = 1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        // This thread, any CPU
+        return static_cast<int>(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+    }
+}
+#endif
+
+PerfCounters::PerfCounters()
+{
+    fileDescriptors.fill(-1);
+    values.fill(0.0);
+
+#if defined(__linux__)
+    fileDescriptors[cycles] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    fileDescriptors[instructions] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fileDescriptors[l1dMisses] = openEvent(PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+    fileDescriptors[llcMisses] = openEvent(PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+    fileDescriptors[branchMisses] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    fileDescriptors[dtlbMisses] = openEvent(PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+#if defined(__linux__)
+    for (const int fileDescriptor : fileDescriptors)
+        if (fileDescriptor >= 0)
+            close(fileDescriptor);
+#endif
+}
+
+bool PerfCounters::isAvailable() const
+{
+    for (int event = 0; event < numEvents; ++event)
+        if (isAvailable(static_cast<Event>(event)))
+            return true;
+    return false;
+}
+
+bool PerfCounters::isAvailable(Event event) const
+{
+    return fileDescriptors[event] >= 0;
+}
+
+void PerfCounters::start()
+{
+#if defined(__linux__)
+    for (const int fileDescriptor : fileDescriptors)
+        if (fileDescriptor >= 0)
+        {
+            ioctl(fileDescriptor, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fileDescriptor, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+}
+
+void PerfCounters::stop()
+{
+#if defined(__linux__)
+    for (const int fileDescriptor : fileDescriptors)
+        if (fileDescriptor >= 0)
+            ioctl(fileDescriptor, PERF_EVENT_IOC_DISABLE, 0);
+
+    for (int event = 0; event < numEvents; ++event)
+    {
+        values[event] = 0.0;
+        if (fileDescriptors[event] < 0)
+            continue;
+
+        // value, time enabled, time running
+        uint64_t reading[3] {};
+        if (read(fileDescriptors[event], reading, sizeof(reading)) != static_cast<ssize_t>(sizeof(reading)))
+            continue;
+
+        // The kernel counted only part of the time when more events than counters are open
+        const double scale { reading[2] > 0u ? static_cast<double>(reading[1]) / static_cast<double>(reading[2]) : 0.0 };
+        values[event] = static_cast<double>(reading[0]) * scale;
+    }
+#endif
+}
+
+double PerfCounters::getValue(Event event) const
+{
+    return values[event];
+}
+
+const char* PerfCounters::getName(Event event)
+{
+    switch (event)
+    {
+        case cycles:        return "cycles";
+        case instructions:  return "instructions";
+        case l1dMisses:     return "l1dMisses";
+        case llcMisses:     return "llcMisses";
+        case branchMisses:  return "branchMisses";
+        case dtlbMisses:    return "dtlbMisses";
+        case numEvents:     break;
+    }
+    return "unknown";
+}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace bench
+{
+
+// Hardware performance counters of the calling thread, read through Linux perf_event_open.
+// Each event is opened on its own, so that the ones the CPU, kernel or virtual machine do not
+// support are skipped. Elsewhere, or when perf is not permitted, no event is available
+// and the benchmarks report wall-clock timing only.
+class PerfCounters
+{
+public:
+    enum Event
+    {
+        cycles,
+        instructions,
+        l1dMisses,
+        llcMisses,
+        branchMisses,
+        dtlbMisses,
+        numEvents
+    };
+
+    // Open the counters, disabled
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // Whether any event, or the given one, could be opened
+    bool isAvailable() const;
+    bool isAvailable(Event event) const;
+
+    // Reset and enable the counters
+    void start();
+    // Disable the counters and read them, scaled up when the kernel multiplexed them
+    void stop();
+
+    // Value of an event between the last start and stop
+    double getValue(Event event) const;
+
+    // Name of an event, as written in the results
+    static const char* getName(Event event);
+
+private:
+    std::array<int, numEvents> fileDescriptors;
+    std::array<double, numEvents> values;
+};
+
+}
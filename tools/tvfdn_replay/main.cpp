@@ -0,0 +1,281 @@
+// Offline replay of a TVFDN capture (see FDNPluginAudioProcessor::startCapture).
+// Restores the captured state, then feeds the captured blocks and parameter events back into the
+// processor, as the host did, and reports the per-block latency and a checksum of the output.
+// Run it under a profiler, or built with ENABLE_TRACING to get the Chrome trace of the session.
+//
+// Usage: tvfdn_replay <capture.tvfc> [--repeat <n>] [--double] [--output <file.json>]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <JuceHeader.h>
+
+#include "LatencyHistogram.h"
+#include "SessionCapture.h"
+
+#include "PluginProcessor.h"
+
+namespace
+{
+
+struct Options
+{
+    std::string capturePath;
+    uint32_t repeat { 1u };
+    bool doublePrecision { false };
+    std::string outputPath;
+};
+
+bool parseArguments(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string argument { argv[i] };
+        const bool hasValue { i + 1 < argc };
+
+        if (argument == "--repeat" && hasValue)
+            options.repeat = static_cast<uint32_t>(std::max(std::atoi(argv[++i]), 1));
+        else if (argument == "--double")
+            options.doublePrecision = true;
+        else if (argument == "--output" && hasValue)
+            options.outputPath = argv[++i];
+        else if (options.capturePath.empty() && argument.rfind("--", 0) != 0)
+            options.capturePath = argument;
+        else
+        {
+            options.capturePath.clear();
+            break;
+        }
+    }
+
+    if (options.capturePath.empty())
+    {
+        std::cerr << "Usage: " << argv[0] << " <capture.tvfc> [--repeat <n>] [--double] [--output <file.json>]\n";
+        return false;
+    }
+    return true;
+}
+
+struct Report
+{
+    bench::LatencyHistogram latency;
+    uint64_t numSamples { 0u };
+    uint64_t deadlineMisses { 0u };
+    double worstLoad { 0.0 };
+    uint64_t droppedBlocks { 0u };
+    uint64_t unknownEvents { 0u };
+    // Heap memory of the processor once prepared
+    utils::MemoryFootprint memory;
+    // Of the first pass: identical captures and builds give identical checksums
+    double outputEnergy { 0.0 };
+    uint64_t outputHash { 14695981039346656037u };
+};
+
+// Index of each captured parameter in the processor, or -1 if it has no parameter with that ID
+std::vector<int> mapParameters(FDNPluginAudioProcessor& processor, const utils::CaptureHeader& header)
+{
+    std::vector<int> indices;
+    const auto& parameters { processor.getParameters() };
+    for (const auto& id : header.parameterIds)
+    {
+        int index { -1 };
+        for (int i = 0; i < parameters.size(); ++i)
+        {
+            const auto* withID { dynamic_cast<juce::AudioProcessorParameterWithID*>(parameters[i]) };
+            if (withID != nullptr && withID->paramID.toStdString() == id)
+                index = i;
+        }
+        if (index < 0)
+            std::cerr << "Parameter " << id << " is not in this build, its events are skipped\n";
+        indices.push_back(index);
+    }
+    return indices;
+}
+
+template <typename SampleType>
+bool replay(FDNPluginAudioProcessor& processor, const Options& options, Report& report)
+{
+    for (uint32_t pass = 0; pass < options.repeat; ++pass)
+    {
+        utils::SessionCapture::Reader reader;
+        if (! reader.open(options.capturePath))
+        {
+            std::cerr << "Cannot read " << options.capturePath << "\n";
+            return false;
+        }
+        const auto& header { reader.getHeader() };
+
+        if (header.numChannels != static_cast<uint32_t>(processor.getTotalNumInputChannels()))
+        {
+            std::cerr << "The capture has " << header.numChannels << " channels, the processor "
+                      << processor.getTotalNumInputChannels() << "\n";
+            return false;
+        }
+
+        // Every pass starts from the captured state
+        const std::vector<int> parameterIndices { mapParameters(processor, header) };
+        processor.setStateInformation(header.state.data(), static_cast<int>(header.state.size()));
+        processor.setProcessingPrecision(std::is_same_v<SampleType, double> ? juce::AudioProcessor::doublePrecision
+                                                                             : juce::AudioProcessor::singlePrecision);
+        processor.prepareToPlay(header.sampleRate, static_cast<int>(header.maxBlockSize));
+        report.memory = processor.getMemoryFootprint();
+
+        const int numChannels { std::max(processor.getTotalNumInputChannels(), processor.getTotalNumOutputChannels()) };
+        juce::AudioBuffer<SampleType> buffer { numChannels, static_cast<int>(header.maxBlockSize) };
+        juce::MidiBuffer midi;
+        const auto& parameters { processor.getParameters() };
+
+        utils::CapturedBlock block;
+        while (reader.readBlock(block))
+        {
+            report.droppedBlocks += block.droppedBefore;
+
+            buffer.clear();
+            for (uint32_t ch = 0; ch < header.numChannels; ++ch)
+            {
+                const float* source { block.samples.data() + static_cast<size_t>(ch) * block.numSamples };
+                SampleType* destination { buffer.getWritePointer(static_cast<int>(ch)) };
+                std::transform(source, source + block.numSamples, destination,
+                               [](float sample) { return static_cast<SampleType>(sample); });
+            }
+
+            // Events split the block at their offsets, as a host splitting the block for sample-accurate automation
+            std::stable_sort(block.events.begin(), block.events.end(),
+                             [](const utils::ParameterEvent& a, const utils::ParameterEvent& b) { return a.sampleOffset < b.sampleOffset; });
+            size_t event { 0u };
+            uint32_t start { 0u };
+            while (start < block.numSamples)
+            {
+                for (; event < block.events.size() && block.events[event].sampleOffset <= start; ++event)
+                {
+                    const uint32_t captured { block.events[event].parameterIndex };
+                    if (captured < parameterIndices.size() && parameterIndices[captured] >= 0)
+                        parameters[parameterIndices[captured]]->setValueNotifyingHost(block.events[event].value);
+                    else
+                        ++report.unknownEvents;
+                }
+                const uint32_t end { event < block.events.size() ? std::min(block.events[event].sampleOffset, block.numSamples) : block.numSamples };
+
+                juce::AudioBuffer<SampleType> segment { buffer.getArrayOfWritePointers(), numChannels,
+                                                        static_cast<int>(start), static_cast<int>(end - start) };
+
+                const auto startTime { std::chrono::steady_clock::now() };
+                processor.processBlock(segment, midi);
+                const auto stopTime { std::chrono::steady_clock::now() };
+
+                const uint64_t nanoseconds { static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(stopTime - startTime).count()) };
+                const double deadline { 1.0e9 * static_cast<double>(end - start) / header.sampleRate };
+                report.latency.record(nanoseconds);
+                report.numSamples += end - start;
+                report.worstLoad = std::max(report.worstLoad, static_cast<double>(nanoseconds) / deadline);
+                if (static_cast<double>(nanoseconds) > deadline)
+                    ++report.deadlineMisses;
+
+                start = end;
+            }
+
+            if (pass == 0u)
+            {
+                for (int ch = 0; ch < processor.getTotalNumOutputChannels(); ++ch)
+                {
+                    const SampleType* data { buffer.getReadPointer(ch) };
+                    for (uint32_t n = 0; n < block.numSamples; ++n)
+                    {
+                        report.outputEnergy += static_cast<double>(data[n]) * static_cast<double>(data[n]);
+                        uint64_t bits { 0u };
+                        std::memcpy(&bits, &data[n], sizeof(SampleType));
+                        report.outputHash = (report.outputHash ^ bits) * 1099511628211u;
+                    }
+                }
+            }
+        }
+
+        processor.releaseResources();
+    }
+    return true;
+}
+
+void printReport(const Report& report, const Options& options)
+{
+    const auto& latency { report.latency };
+    std::cout << "Blocks: " << latency.getCount() << ", samples: " << report.numSamples
+              << ", precision: " << (options.doublePrecision ? "double" : "float")
+              << ", passes: " << options.repeat << "\n";
+    if (report.droppedBlocks > 0u)
+        std::cout << "Warning: " << report.droppedBlocks << " blocks were dropped during the capture, the replay is not exact\n";
+    if (report.unknownEvents > 0u)
+        std::cout << "Warning: " << report.unknownEvents << " parameter events were skipped\n";
+    std::cout << "Latency per block (ns): mean " << static_cast<uint64_t>(latency.getMean())
+              << ", p50 " << latency.getPercentile(50.0)
+              << ", p99 " << latency.getPercentile(99.0)
+              << ", p99.9 " << latency.getPercentile(99.9)
+              << ", max " << latency.getMax() << "\n";
+    std::cout << "Deadline misses: " << report.deadlineMisses << ", worst load: " << report.worstLoad * 100.0 << " %\n";
+    std::cout << "Memory: " << report.memory.getBytes() << " bytes, " << report.memory.shared << " of them shared between instances\n";
+    std::cout << "Output energy: " << report.outputEnergy << ", hash: " << std::hex << report.outputHash << std::dec << "\n";
+}
+
+void writeJson(std::ostream& stream, const Report& report, const Options& options)
+{
+    const auto& latency { report.latency };
+    stream << "{\n";
+    stream << "  \"precision\": \"" << (options.doublePrecision ? "double" : "float") << "\",\n";
+    stream << "  \"passes\": " << options.repeat << ",\n";
+    stream << "  \"blocks\": " << latency.getCount() << ",\n";
+    stream << "  \"samples\": " << report.numSamples << ",\n";
+    stream << "  \"droppedBlocks\": " << report.droppedBlocks << ",\n";
+    stream << "  \"latencyNs\": { \"mean\": " << latency.getMean()
+           << ", \"p50\": " << latency.getPercentile(50.0)
+           << ", \"p99\": " << latency.getPercentile(99.0)
+           << ", \"p99.9\": " << latency.getPercentile(99.9)
+           << ", \"max\": " << latency.getMax() << " },\n";
+    stream << "  \"deadlineMisses\": " << report.deadlineMisses << ",\n";
+    stream << "  \"worstLoad\": " << report.worstLoad << ",\n";
+    stream << "  \"memoryBytes\": { \"owned\": " << report.memory.owned << ", \"shared\": " << report.memory.shared << " },\n";
+    stream << "  \"outputEnergy\": " << report.outputEnergy << ",\n";
+    stream << "  \"outputHash\": \"" << std::hex << report.outputHash << std::dec << "\"\n";
+    stream << "}\n";
+}
+
+}
+
+//================================================
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (! parseArguments(argc, argv, options))
+        return 1;
+
+    // The processor runs a timer and owns parameters that post to the message thread
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    FDNPluginAudioProcessor processor;
+    Report report;
+    const bool replayed { options.doublePrecision ? replay<double>(processor, options, report) : replay<float>(processor, options, report) };
+    if (! replayed)
+        return 1;
+
+    printReport(report, options);
+
+    if (! options.outputPath.empty())
+    {
+        std::ofstream file { options.outputPath };
+        if (! file)
+        {
+            std::cerr << "Cannot write " << options.outputPath << "\n";
+            return 1;
+        }
+        writeJson(file, report, options);
+    }
+
+    return 0;
+}
@@ -0,0 +1,230 @@
+// Headless worst-case latency stress test of the TVFDN processor.
+// Drives prepareToPlay and processBlock directly, with random buffer sizes and every parameter
+// automated at random every block, and reports the per-block latency percentiles and allocations.
+// No message loop runs: room sizes beyond the reserved delay memory stay clamped, as before the timer runs.
+//
+// Usage: tvfdn_stress [--blocks <n>] [--max-block <n>] [--sample-rate <hz>] [--seed <n>] [--double] [--output <file.json>]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <JuceHeader.h>
+
+#include "AllocationCounter.h"
+#include "LatencyHistogram.h"
+
+#include "PluginProcessor.h"
+
+namespace
+{
+
+struct Options
+{
+    uint32_t numBlocks { 20000u };
+    uint32_t maxBlockSize { 2048u };
+    double sampleRate { 48000.0 };
+    uint32_t seed { 1u };
+    bool doublePrecision { false };
+    std::string outputPath;
+};
+
+bool parseArguments(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string argument { argv[i] };
+        const bool hasValue { i + 1 < argc };
+
+        if (argument == "--blocks" && hasValue)
+            options.numBlocks = static_cast<uint32_t>(std::max(std::atoi(argv[++i]), 1));
+        else if (argument == "--max-block" && hasValue)
+            options.maxBlockSize = static_cast<uint32_t>(std::max(std::atoi(argv[++i]), 1));
+        else if (argument == "--sample-rate" && hasValue)
+            options.sampleRate = std::max(std::atof(argv[++i]), 1.0);
+        else if (argument == "--seed" && hasValue)
+            options.seed = static_cast<uint32_t>(std::atoi(argv[++i]));
+        else if (argument == "--double")
+            options.doublePrecision = true;
+        else if (argument == "--output" && hasValue)
+            options.outputPath = argv[++i];
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--blocks <n>] [--max-block <n>] [--sample-rate <hz>] [--seed <n>] [--double] [--output <file.json>]\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Per-block statistics of a run
+struct Report
+{
+    bench::LatencyHistogram latency;
+    uint64_t numSamples { 0u };
+    uint64_t deadlineMisses { 0u };
+    double worstLoad { 0.0 };           // latency over the block duration
+    uint64_t allocatingBlocks { 0u };
+    uint64_t totalAllocations { 0u };
+    uint64_t maxAllocationsPerBlock { 0u };
+};
+
+// Block sizes are mostly the usual powers of two, sometimes anything up to the maximum, as some hosts do
+uint32_t randomBlockSize(std::mt19937& generator, uint32_t maxBlockSize)
+{
+    std::uniform_int_distribution<int> kind { 0, 3 };
+    if (kind(generator) == 0)
+        return std::uniform_int_distribution<uint32_t> { 1u, maxBlockSize } (generator);
+
+    std::vector<uint32_t> powers;
+    for (uint32_t size = 16u; size <= maxBlockSize; size *= 2u)
+        powers.push_back(size);
+    if (powers.empty())
+        return maxBlockSize;
+    return powers[std::uniform_int_distribution<size_t> { 0u, powers.size() - 1u } (generator)];
+}
+
+template <typename SampleType>
+Report run(FDNPluginAudioProcessor& processor, const Options& options)
+{
+    const int numChannels { std::max(processor.getTotalNumInputChannels(), processor.getTotalNumOutputChannels()) };
+
+    processor.setProcessingPrecision(std::is_same_v<SampleType, double> ? juce::AudioProcessor::doublePrecision
+                                                                         : juce::AudioProcessor::singlePrecision);
+    processor.prepareToPlay(options.sampleRate, static_cast<int>(options.maxBlockSize));
+
+    juce::AudioBuffer<SampleType> buffer { numChannels, static_cast<int>(options.maxBlockSize) };
+    juce::MidiBuffer midi;
+
+    std::mt19937 generator { options.seed };
+    std::uniform_real_distribution<float> unit { 0.0f, 1.0f };
+    std::uniform_real_distribution<SampleType> noise { SampleType { -1 }, SampleType { 1 } };
+
+    // Every parameter is automated
+    const auto& parameters { processor.getParameters() };
+
+    Report report;
+    for (uint32_t block = 0; block < options.numBlocks; ++block)
+    {
+        const uint32_t blockSize { randomBlockSize(generator, options.maxBlockSize) };
+
+        // Host side, outside the timed region: new input and new parameter values
+        buffer.setSize(numChannels, static_cast<int>(blockSize), false, false, true);
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            SampleType* data { buffer.getWritePointer(ch) };
+            for (uint32_t n = 0; n < blockSize; ++n)
+                data[n] = noise(generator) * SampleType { 0.1 };
+        }
+        for (auto* parameter : parameters)
+            parameter->setValueNotifyingHost(unit(generator));
+
+        // Timed region: one processBlock, as the host's audio callback would call it
+        uint64_t allocations { 0u };
+        const auto start { std::chrono::steady_clock::now() };
+        {
+            bench::AllocationCounter counter;
+            processor.processBlock(buffer, midi);
+            allocations = counter.getCount();
+        }
+        const auto stop { std::chrono::steady_clock::now() };
+
+        const uint64_t nanoseconds { static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()) };
+        const double deadline { 1.0e9 * static_cast<double>(blockSize) / options.sampleRate };
+
+        report.latency.record(nanoseconds);
+        report.numSamples += blockSize;
+        report.worstLoad = std::max(report.worstLoad, static_cast<double>(nanoseconds) / deadline);
+        if (static_cast<double>(nanoseconds) > deadline)
+            ++report.deadlineMisses;
+        if (allocations > 0u)
+            ++report.allocatingBlocks;
+        report.totalAllocations += allocations;
+        report.maxAllocationsPerBlock = std::max(report.maxAllocationsPerBlock, allocations);
+    }
+
+    processor.releaseResources();
+    return report;
+}
+
+void printReport(const Report& report, const Options& options)
+{
+    const auto& latency { report.latency };
+    std::cout << "Blocks: " << latency.getCount() << ", samples: " << report.numSamples
+              << ", precision: " << (options.doublePrecision ? "double" : "float")
+              << ", sample rate: " << options.sampleRate << " Hz, max block: " << options.maxBlockSize << "\n";
+    std::cout << "Latency per block (ns): mean " << static_cast<uint64_t>(latency.getMean())
+              << ", p50 " << latency.getPercentile(50.0)
+              << ", p99 " << latency.getPercentile(99.0)
+              << ", p99.9 " << latency.getPercentile(99.9)
+              << ", max " << latency.getMax() << "\n";
+    std::cout << "Deadline misses: " << report.deadlineMisses << ", worst load: " << report.worstLoad * 100.0 << " %\n";
+    std::cout << "Allocations: " << report.totalAllocations << " in " << report.allocatingBlocks << " blocks"
+              << " (" << static_cast<double>(report.totalAllocations) / static_cast<double>(std::max(latency.getCount(), uint64_t { 1u })) << " per block"
+              << ", max " << report.maxAllocationsPerBlock << ")\n";
+    std::cout << "Histogram:\n";
+    latency.printRanges(std::cout);
+}
+
+void writeJson(std::ostream& stream, const Report& report, const Options& options)
+{
+    const auto& latency { report.latency };
+    stream << "{\n";
+    stream << "  \"precision\": \"" << (options.doublePrecision ? "double" : "float") << "\",\n";
+    stream << "  \"sampleRate\": " << options.sampleRate << ",\n";
+    stream << "  \"maxBlockSize\": " << options.maxBlockSize << ",\n";
+    stream << "  \"seed\": " << options.seed << ",\n";
+    stream << "  \"blocks\": " << latency.getCount() << ",\n";
+    stream << "  \"samples\": " << report.numSamples << ",\n";
+    stream << "  \"latencyNs\": { \"mean\": " << latency.getMean()
+           << ", \"p50\": " << latency.getPercentile(50.0)
+           << ", \"p99\": " << latency.getPercentile(99.0)
+           << ", \"p99.9\": " << latency.getPercentile(99.9)
+           << ", \"max\": " << latency.getMax() << " },\n";
+    stream << "  \"deadlineMisses\": " << report.deadlineMisses << ",\n";
+    stream << "  \"worstLoad\": " << report.worstLoad << ",\n";
+    stream << "  \"allocations\": { \"total\": " << report.totalAllocations
+           << ", \"blocks\": " << report.allocatingBlocks
+           << ", \"maxPerBlock\": " << report.maxAllocationsPerBlock << " }\n";
+    stream << "}\n";
+}
+
+}
+
+//================================================
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (! parseArguments(argc, argv, options))
+        return 1;
+
+    // The processor runs a timer and owns parameters that post to the message thread
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    FDNPluginAudioProcessor processor;
+    const Report report { options.doublePrecision ? run<double>(processor, options) : run<float>(processor, options) };
+
+    printReport(report, options);
+
+    if (! options.outputPath.empty())
+    {
+        std::ofstream file { options.outputPath };
+        if (! file)
+        {
+            std::cerr << "Cannot write " << options.outputPath << "\n";
+            return 1;
+        }
+        writeJson(file, report, options);
+    }
+
+    // Allocations on the audio path are failures
+    return report.totalAllocations == 0u ? 0 : 2;
+}